@@ -8,35 +8,315 @@
 // Includes
 //
 
-// Precompiled Headers
-#include "Stdafx.h"
+// N.B. This file is also built into the (portable) benchmarks,
+// so it doesn't use the application's precompiled headers
+
+// Windows Headers
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <strsafe.h>
+#endif // defined(_WIN32)
 
 // C++ Standard Library Headers
-#include <set>
-#include <array>
+#include <vector>
 #include <algorithm>
 
+// C Standard Library Headers
+#include <string.h>
+
 // Intrinsics Headers
+#if defined(_MSC_VER)
 #include <intrin.h>
-#if defined(_M_ARM64)
+#endif // defined(_MSC_VER)
+#if defined(_M_ARM64) || defined(__aarch64__)
 #include <arm_neon.h>
 #else
 #include <xmmintrin.h>
-#endif  //!defined(_M_ARM64)
+#include <immintrin.h>
+#endif  // defined(_M_ARM64) || defined(__aarch64__)
 
 // Local Project Headers
 #include "BitOps.h"
+#include "CpuFeatures.h"
+
+// Macros
+//
+
+// Insists that helpers which pass vectors around be inlined
+#if defined(_MSC_VER)
+#define BITOPS_FORCEINLINE __forceinline
+#else
+#define BITOPS_FORCEINLINE inline __attribute__((always_inline))
+#endif // defined(_MSC_VER)
+
+// Helpers
+//
+
+// Scrubs the given buffer in a way which the compiler won't optimise away
+static inline void secure_zero(void* ptr, size_t cb) {
+#if defined(_WIN32)
+	SecureZeroMemory( ptr, cb );
+#else
+	volatile unsigned char* p = static_cast<volatile unsigned char*>( ptr );
+	while (cb--){
+		*(p++) = 0;
+	}
+#endif // defined(_WIN32)
+}
+
+// Emits the accepted lanes of a combined block, as identified by the given mask,
+// which has _stride bits per lane, the lowest of which is set for accepted lanes
+template <size_t _stride, typename T>
+static inline size_t emit_lanes(const unsigned char* lanes, size_t count, unsigned long long mask, const T* table, T* out, size_t n, size_t cch) {
+
+	if ((cch - n) >= count){
+		// There's room for every lane, so write each one but only advance past
+		// those which were accepted: no branches, and no scanning for bits
+		for (size_t lane = 0; lane < count; ++lane){
+			*(out + n) = table[lanes[lane]];
+			n += static_cast<size_t>( (mask >> (lane * _stride)) & 1 );
+		}
+		return n;
+	}
+
+	// Otherwise, stop as soon as the output is full
+	while (mask && (n < cch)){
+		const auto lane = (lowest_set_bit( mask ) / _stride);
+		*(out + (n++)) = table[lanes[lane]];
+		mask &= ~(((1ULL << _stride) - 1) << (lane * _stride));
+	}
+	return n;
+}
+
+// Copies the surviving lanes of a block of indices to the output, as identified by the
+// given mask (which has _stride bits per lane, the lowest of which is set for survivors)
+template <size_t _stride>
+static inline size_t compact_lanes(const unsigned char* lanes, size_t count, unsigned long long mask, unsigned char* out, size_t n) {
+
+	for (size_t j = 0; j < count; ++j){
+		*(out + n) = lanes[j];
+		n += static_cast<size_t>( (mask >> (j * _stride)) & 1 );
+	}
+	return n;
+}
+
+// The alphabets of the token encodings
+static const char base16_digits[] = "0123456789abcdef";
+static const char base32_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+static const char base58_alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char base64url_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
 
 // Classes
 //
 
-#if !defined (_WIN64)
+encode_t::size_type encode_t::encode(Encoding encoding, operand_type in, size_type cb, char_type* out) {
+
+	switch (encoding){
+		case EncodingBASE16:
+			return base16( in, cb, out );
+
+		case EncodingBASE32:
+			return base32( in, cb, out );
+
+		case EncodingBASE58:
+			return base58( in, cb, out );
+
+		case EncodingBASE64:
+		case EncodingBASE64URL:
+			return base64( in, cb, out, (encoding == EncodingBASE64) );
+
+		default:
+			break;
+	}
+	return 0;
+}
+
+encode_t::size_type encode_t::base16(operand_type in, size_type cb, char_type* out) {
+
+	for (decltype(cb) i = 0; i < cb; ++i){
+		*(out++) = base16_digits[*(in + i) >> 4];
+		*(out++) = base16_digits[*(in + i) & 0x0F];
+	}
+	return (cb * 2);
+}
+
+encode_t::size_type encode_t::base32(operand_type in, size_type cb, char_type* out) {
+
+	// Each 5 bytes give 8 characters
+	size_type n = 0;
+	decltype(cb) i = 0;
+	for (; (cb - i) >= 5; i += 5){
+		unsigned long long v = 0;
+		for (size_t j = 0; j < 5; ++j){
+			v = (v << 8) | *(in + i + j);
+		}
+		for (size_t d = 0; d < 8; ++d){
+			*(out + n + d) = base32_alphabet[(v >> (35 - (5 * d))) & 31];
+		}
+		n += 8;
+	}
+
+	// Pad the last, partial group out to 8 characters
+	if (i < cb){
+		const size_t r = (cb - i);
+		unsigned long long v = 0;
+		for (size_t j = 0; j < 5; ++j){
+			v = (v << 8) | ((j < r) ? *(in + i + j) : 0);
+		}
+		const size_t cch = ((r * 8) + 4) / 5;
+		for (size_t d = 0; d < 8; ++d){
+			*(out + n + d) = (d < cch) ? base32_alphabet[(v >> (35 - (5 * d))) & 31] : '=';
+		}
+		n += 8;
+	}
+	return n;
+}
+
+encode_t::size_type encode_t::base58(operand_type in, size_type cb, char_type* out) {
+
+	// Keep each leading zero byte as a leading '1'
+	size_type n = 0;
+	while ((n < cb) && (*(in + n) == 0)){
+		*(out + n) = base58_alphabet[0];
+		++n;
+	}
+
+	// Convert the rest into limbs of 5 base-58 digits each (least significant first), by
+	// multiplying in up to 4 bytes at a time; a limb is under 2^30, so neither the product
+	// nor the carry can overflow
+	const unsigned long long radix = (58ULL * 58ULL * 58ULL * 58ULL * 58ULL);
+	std::vector<unsigned long long> limbs;
+	limbs.reserve( (encoded_size( EncodingBASE58, cb - n ) / 5) + 1 );
+	for (decltype(cb) i = n; i < cb; ){
+		const size_t k = ((cb - i) % 4) ? ((cb - i) % 4) : 4;
+		unsigned long long carry = 0;
+		for (size_t j = 0; j < k; ++j){
+			carry = (carry << 8) | *(in + i + j);
+		}
+		for (auto& limb : limbs){
+			const unsigned long long x = (limb << (8 * k)) + carry;
+			limb = (x % radix);
+			carry = (x / radix);
+		}
+		for (; carry; carry /= radix){
+			limbs.push_back( carry % radix );
+		}
+		i += k;
+	}
+	if (limbs.empty( )){
+		return n;
+	}
+
+	// Write out the most significant limb without its leading zeroes, then the rest in full
+	char_type digits[5];
+	size_t m = 0;
+	for (auto top = limbs.back( ); top; top /= 58){
+		digits[m++] = base58_alphabet[top % 58];
+	}
+	while (m){
+		*(out + (n++)) = digits[--m];
+	}
+	for (size_t l = (limbs.size( ) - 1); l-- > 0; ){
+		auto limb = limbs[l];
+		for (size_t d = 5; d-- > 0; limb /= 58){
+			*(out + n + d) = base58_alphabet[limb % 58];
+		}
+		n += 5;
+	}
+	secure_zero( limbs.data( ), limbs.size( ) * sizeof( limbs[0] ) );
+	secure_zero( digits, sizeof( digits ) );
+	return n;
+}
+
+encode_t::size_type encode_t::base64(operand_type in, size_type cb, char_type* out, bool padded) {
+
+	const char* alphabet = padded ? base64_alphabet : base64url_alphabet;
+
+	// Each 3 bytes give 4 characters
+	size_type n = 0;
+	decltype(cb) i = 0;
+	for (; (cb - i) >= 3; i += 3){
+		const unsigned long v = (static_cast<unsigned long>( *(in + i) ) << 16) | (static_cast<unsigned long>( *(in + i + 1) ) << 8) | *(in + i + 2);
+		*(out + n) = alphabet[v >> 18];
+		*(out + n + 1) = alphabet[(v >> 12) & 63];
+		*(out + n + 2) = alphabet[(v >> 6) & 63];
+		*(out + n + 3) = alphabet[v & 63];
+		n += 4;
+	}
+
+	// Then the last, partial group, padded out to 4 characters if asked
+	if (i < cb){
+		const size_t r = (cb - i);
+		const unsigned long v = (static_cast<unsigned long>( *(in + i) ) << 16) | ((r > 1) ? (static_cast<unsigned long>( *(in + i + 1) ) << 8) : 0);
+		*(out + (n++)) = alphabet[v >> 18];
+		*(out + (n++)) = alphabet[(v >> 12) & 63];
+		if (r > 1){
+			*(out + (n++)) = alphabet[(v >> 6) & 63];
+		}else if (padded){
+			*(out + (n++)) = '=';
+		}
+		if (padded){
+			*(out + (n++)) = '=';
+		}
+	}
+	return n;
+}
+
+void encode_t::stamp(unsigned char* uuids, size_type count, unsigned version, unsigned long long ms, unsigned long long counter) {
+
+	if (version == 7){
+		stamp_times( uuids, count, ms, counter );
+	}
+	for (decltype(count) i = 0; i < count; ++i){
+		unsigned char* uuid = uuids + (i * uuid_size);
+		*(uuid + 6) = static_cast<unsigned char>( (*(uuid + 6) & 0x0F) | (version << 4) );
+		*(uuid + 8) = static_cast<unsigned char>( (*(uuid + 8) & 0x3F) | 0x80 );
+	}
+}
+
+void encode_t::stamp_times(unsigned char* uuids, size_type count, unsigned long long ms, unsigned long long counter) {
+
+	// The 48-bit timestamp, big-endian, then the counter: 12 bits in place of rand_a, and the next 30 in the
+	// top of rand_b (around the version and variant bits, which the caller sets); the rest of rand_b stays random
+	for (decltype(count) i = 0; i < count; ++i, ++counter){
+		unsigned char* uuid = uuids + (i * uuid_size);
+		for (size_t j = 0; j < 6; ++j){
+			*(uuid + j) = static_cast<unsigned char>( ms >> (40 - (8 * j)) );
+		}
+		*(uuid + 6) = static_cast<unsigned char>( (counter >> 38) & 0x0F );
+		*(uuid + 7) = static_cast<unsigned char>( counter >> 30 );
+		*(uuid + 8) = static_cast<unsigned char>( (counter >> 24) & 0x3F );
+		*(uuid + 9) = static_cast<unsigned char>( counter >> 16 );
+		*(uuid + 10) = static_cast<unsigned char>( counter >> 8 );
+		*(uuid + 11) = static_cast<unsigned char>( counter );
+	}
+}
+
+encode_t::size_type encode_t::format(operand_type uuids, size_type count, char_type delimiter, char_type* out) {
+
+	for (decltype(count) i = 0; i < count; ++i){
+		operand_type uuid = uuids + (i * uuid_size);
+		for (size_t j = 0; j < uuid_size; ++j){
+			if ((j == 4) || (j == 6) || (j == 8) || (j == 10)){
+				*(out++) = '-';
+			}
+			*(out++) = base16_digits[*(uuid + j) >> 4];
+			*(out++) = base16_digits[*(uuid + j) & 0x0F];
+		}
+		*(out++) = delimiter;
+	}
+	return (count * (uuid_chars + 1));
+}
+
+#if defined(_MSC_VER) && defined(_M_IX86)
 class mmx_xor_t : public xor_t {
 public:
 	size_type apply(operand_type front, operand_type back, size_type cb) const {
 
 		for (decltype(cb) i = 0; i < cb; ){
-			const decltype(i) j = min( (cb - i), sizeof( __m64 ) );
+			const decltype(i) j = (std::min)( (cb - i), sizeof( __m64 ) );
 
 			// Get the next chunk
 			__m64 mm1 = { 0 }, mm2 = { 0 };
@@ -56,9 +336,9 @@ public:
 		return XORVexMMX;
 	}
 };
-#endif // _WIN64
+#endif // defined(_MSC_VER) && defined(_M_IX86)
 
-#if defined(_M_ARM64)
+#if defined(BITOPS_ARM64)
 class neon_xor_t : public xor_t {
 public:
 	size_type apply(operand_type front, operand_type back, size_type cb) const {
@@ -89,10 +369,265 @@ public:
 		return XORVexNEON;
 	}
 };
+
+class neon_emit_t : public emit_t {
+public:
+	size_type apply(operand_type front, operand_type back, size_type cb, const map_t& map, char_type* out, size_type cch) const {
+		return emit_vector( front, back, cb, map, map.chars( ), map_t::reject_char, out, cch );
+	}
+
+	size_type apply(operand_type front, operand_type back, size_type cb, const map_t& map, index_type* out, size_type cch) const {
+		return emit_vector( front, back, cb, map, map.indices( ), map_t::reject_index, out, cch );
+	}
+
+	XORVex vex() const {
+		return XORVexNEON;
+	}
+
+private:
+	template <typename T>
+	static size_type emit_vector(operand_type front, operand_type back, size_type cb, const map_t& map, const T* table, T reject, T* out, size_type cch) {
+
+		if (map.size( ) == 0){
+			return 0;
+		}
+
+		const size_t s = sizeof( uint8x16_t );
+		const uint8x16_t limit = vdupq_n_u8( static_cast<uint8_t>( map.limit( ) - 1 ) );
+		alignas(16) unsigned char lanes[sizeof( uint8x16_t )];
+
+		size_type n = 0;
+		decltype(cb) i = 0;
+		for (; ((cb - i) >= s) && (n < cch); i += s){
+			// Combine
+			uint8x16_t w = veorq_u8( vld1q_u8( front + i ), vld1q_u8( back + i ) );
+
+			// Find the bytes which don't exceed the limit; NEON has no movemask,
+			// so narrow the comparison to a nibble per lane instead
+			uint8x16_t accepted = vcleq_u8( w, limit );
+			uint64_t mask = vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16( vreinterpretq_u16_u8( accepted ), 4 ) ), 0 );
+
+			// Map and emit them
+			vst1q_u8( lanes, w );
+			n = emit_lanes<4>( lanes, s, mask, table, out, n, cch );
+		}
+		secure_zero( lanes, sizeof( lanes ) );
+
+		// Fallback for the remainder
+		if ((i < cb) && (n < cch)){
+			n += emit( front + i, back + i, (cb - i), table, reject, out + n, (cch - n) );
+		}
+		return n;
+	}
+};
+
+// Finds the lanes which repeat an earlier lane of the same vector, by comparing
+// it with itself shifted up by 1..15 lanes (shifting in lanes which can't match)
+template <int _k>
+struct neon_conflicts_t {
+	static inline uint8x16_t apply(uint8x16_t v, uint8x16_t sentinel) {
+		return vorrq_u8( vceqq_u8( v, vextq_u8( sentinel, v, 16 - _k ) ), neon_conflicts_t<_k - 1>::apply( v, sentinel ) );
+	}
+};
+
+template <>
+struct neon_conflicts_t<0> {
+	static inline uint8x16_t apply(uint8x16_t, uint8x16_t) {
+		return vdupq_n_u8( 0 );
+	}
+};
+
+// Gives the table lookups which move the low 64 bits of a vector to the given word of
+// a 256-bit bitset held in a pair of vectors (lower, then upper), zeroing everything else;
+// this lets the kernel keep the bitset in registers, rather than going through memory
+// for each index (and then stalling on reloading it as a vector)
+alignas(16) static const unsigned char dedupe_word_controls[4][2][16] = {
+	{ { 0, 1, 2, 3, 4, 5, 6, 7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+	  { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } },
+	{ { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0, 1, 2, 3, 4, 5, 6, 7 },
+	  { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } },
+	{ { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+	  { 0, 1, 2, 3, 4, 5, 6, 7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } },
+	{ { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+	  { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0, 1, 2, 3, 4, 5, 6, 7 } }
+};
+
+// Sets each of the given lanes in a 256-bit bitset held in a pair of vectors
+static inline void neon_set_lanes(const unsigned char* lanes, size_t count, uint8x16_t& lower, uint8x16_t& upper) {
+
+	for (size_t j = 0; j < count; ++j){
+		const uint8x16_t bit = vreinterpretq_u8_u64( vcombine_u64( vcreate_u64( 1ULL << (lanes[j] & 63) ), vcreate_u64( 0 ) ) );
+		const auto controls = dedupe_word_controls[lanes[j] >> 6];
+		lower = vorrq_u8( lower, vqtbl1q_u8( bit, vld1q_u8( controls[0] ) ) );
+		upper = vorrq_u8( upper, vqtbl1q_u8( bit, vld1q_u8( controls[1] ) ) );
+	}
+}
+
+class neon_dedupe_t : public dedupe_t {
+public:
+	size_type apply(bitset_type& seen, const index_type* indices, size_type count, index_type* out) const {
+
+		const size_t s = sizeof( uint8x16_t );
+		const uint8x16_t sentinel = vdupq_n_u8( map_t::reject_index );
+		const uint8x16_t seven = vdupq_n_u8( 7 );
+		alignas(16) static const unsigned char bits[sizeof( uint8x16_t )] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+		const uint8x16_t bit_table = vld1q_u8( bits );
+		alignas(16) unsigned char lanes[sizeof( uint8x16_t )];
+
+		auto bytes = reinterpret_cast<unsigned char*>( seen.words( ) );
+		uint8x16_t lower = vld1q_u8( bytes ), upper = vld1q_u8( bytes + s );
+
+		size_type n = 0;
+		decltype(count) i = 0;
+		for (; (count - i) >= s; i += s){
+			const uint8x16_t v = vld1q_u8( indices + i );
+			vst1q_u8( lanes, v );
+
+			// Find the lanes which repeat an earlier one
+			const uint8x16_t repeated = neon_conflicts_t<15>::apply( v, sentinel );
+
+			// Find the lanes which are already set: look up the byte of the bitset for each lane, and test its bit
+			const uint8x16x2_t table = { { lower, upper } };
+			const uint8x16_t byte = vqtbl2q_u8( table, vshrq_n_u8( v, 3 ) );
+			const uint8x16_t already = vtstq_u8( byte, vqtbl1q_u8( bit_table, vandq_u8( v, seven ) ) );
+
+			// NEON has no movemask, so narrow the rejections to a nibble per lane instead
+			const uint8x16_t rejected = vorrq_u8( repeated, already );
+			const uint64_t mask = ~vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16( vreinterpretq_u16_u8( rejected ), 4 ) ), 0 );
+			n = compact_lanes<4>( lanes, s, mask, out, n );
+			neon_set_lanes( lanes, s, lower, upper );
+		}
+		vst1q_u8( bytes, lower );
+		vst1q_u8( bytes + s, upper );
+		secure_zero( lanes, sizeof( lanes ) );
+
+		// Fallback for the remainder
+		if (i < count){
+			n += dedupe_t::apply( seen, indices + i, (count - i), out + n );
+		}
+		return n;
+	}
+
+	XORVex vex() const {
+		return XORVexNEON;
+	}
+};
+
+class neon_encode_t : public encode_t {
+public:
+	size_type apply(Encoding encoding, operand_type in, size_type cb, char_type* out) const {
+
+		switch (encoding){
+			case EncodingBASE16:
+				return base16_vector( in, cb, out );
+
+			case EncodingBASE64:
+			case EncodingBASE64URL:
+				return base64_vector( in, cb, out, (encoding == EncodingBASE64) );
+
+			default:
+				break;
+		}
+		return encode( encoding, in, cb, out );
+	}
+
+	void stamp_uuids(unsigned char* uuids, size_type count, unsigned version, unsigned long long ms, unsigned long long counter) const {
+
+		if (version == 7){
+			stamp_times( uuids, count, ms, counter );
+		}
+
+		// Keep all but the version and variant bits, then set those
+		alignas(16) const unsigned char keep[16] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0xFF, 0x3F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+		alignas(16) unsigned char set[16] = { 0 };
+		set[6] = static_cast<unsigned char>( version << 4 );
+		set[8] = 0x80;
+		const uint8x16_t k = vld1q_u8( keep ), o = vld1q_u8( set );
+		for (decltype(count) i = 0; i < count; ++i){
+			unsigned char* uuid = uuids + (i * uuid_size);
+			vst1q_u8( uuid, vorrq_u8( vandq_u8( vld1q_u8( uuid ), k ), o ) );
+		}
+	}
+
+	size_type format_uuids(operand_type uuids, size_type count, char_type delimiter, char_type* out) const {
+
+		const uint8x16_t digits = vld1q_u8( reinterpret_cast<const uint8_t*>( base16_digits ) );
+		const uint8x16_t low = vdupq_n_u8( 0x0F );
+
+		// Shuffle the digits apart, leaving zeroes (from out-of-range lookups) where the dashes go, and or those in
+		alignas(16) static const unsigned char front_controls[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 0xFF, 8, 9, 10, 11, 0xFF, 12, 13 };
+		alignas(16) static const unsigned char middle_controls[16] = { 0, 1, 0xFF, 2, 3, 4, 5, 0xFF, 6, 7, 8, 9, 10, 11, 12, 13 };
+		alignas(16) static const unsigned char front_dashes[16] = { 0, 0, 0, 0, 0, 0, 0, 0, '-', 0, 0, 0, 0, '-', 0, 0 };
+		alignas(16) static const unsigned char middle_dashes[16] = { 0, 0, '-', 0, 0, 0, 0, '-', 0, 0, 0, 0, 0, 0, 0, 0 };
+		const uint8x16_t fc = vld1q_u8( front_controls ), mc = vld1q_u8( middle_controls );
+		const uint8x16_t fd = vld1q_u8( front_dashes ), md = vld1q_u8( middle_dashes );
+		for (decltype(count) i = 0; i < count; ++i){
+			const uint8x16_t v = vld1q_u8( uuids + (i * uuid_size) );
+			const uint8x16_t hi = vqtbl1q_u8( digits, vshrq_n_u8( v, 4 ) );
+			const uint8x16_t lo = vqtbl1q_u8( digits, vandq_u8( v, low ) );
+			const uint8x16_t hex0 = vzip1q_u8( hi, lo ), hex1 = vzip2q_u8( hi, lo );
+			uint8_t* text = reinterpret_cast<uint8_t*>( out + (i * (uuid_chars + 1)) );
+			vst1q_u8( text, vorrq_u8( vqtbl1q_u8( hex0, fc ), fd ) );
+			vst1q_u8( text + 16, vorrq_u8( vqtbl1q_u8( vextq_u8( hex0, hex1, 14 ), mc ), md ) );
+			vst1q_lane_u32( reinterpret_cast<uint32_t*>( text + 32 ), vreinterpretq_u32_u8( hex1 ), 3 );
+			*(text + uuid_chars) = static_cast<uint8_t>( delimiter );
+		}
+		return (count * (uuid_chars + 1));
+	}
+
+	XORVex vex() const {
+		return XORVexNEON;
+	}
+
+private:
+	static size_type base16_vector(operand_type in, size_type cb, char_type* out) {
+
+		const size_t s = sizeof( uint8x16_t );
+		const uint8x16_t digits = vld1q_u8( reinterpret_cast<const uint8_t*>( base16_digits ) );
+		const uint8x16_t low = vdupq_n_u8( 0x0F );
+
+		decltype(cb) i = 0;
+		for (; (cb - i) >= s; i += s){
+			// Look up each nibble, and store them interleaved
+			const uint8x16_t v = vld1q_u8( in + i );
+			const uint8x16x2_t pair = { { vqtbl1q_u8( digits, vshrq_n_u8( v, 4 ) ), vqtbl1q_u8( digits, vandq_u8( v, low ) ) } };
+			vst2q_u8( reinterpret_cast<uint8_t*>( out + (2 * i) ), pair );
+		}
+
+		// Fallback for the remainder
+		return (2 * i) + base16( in + i, (cb - i), out + (2 * i) );
+	}
+
+	static size_type base64_vector(operand_type in, size_type cb, char_type* out, bool padded) {
+
+		const uint8_t* alphabet = reinterpret_cast<const uint8_t*>( padded ? base64_alphabet : base64url_alphabet );
+		const uint8x16x4_t table = { { vld1q_u8( alphabet ), vld1q_u8( alphabet + 16 ), vld1q_u8( alphabet + 32 ), vld1q_u8( alphabet + 48 ) } };
+		const uint8x16_t six = vdupq_n_u8( 0x3F );
+
+		// De-interleave 16 groups of 3 bytes, split them into 6-bit indices, look those
+		// up in the 64-byte table, and store them interleaved as 16 groups of 4 characters
+		const size_t s = (3 * sizeof( uint8x16_t ));
+		size_type n = 0;
+		decltype(cb) i = 0;
+		for (; (cb - i) >= s; i += s){
+			const uint8x16x3_t v = vld3q_u8( in + i );
+			uint8x16x4_t chars;
+			chars.val[0] = vqtbl4q_u8( table, vshrq_n_u8( v.val[0], 2 ) );
+			chars.val[1] = vqtbl4q_u8( table, vandq_u8( vorrq_u8( vshlq_n_u8( v.val[0], 4 ), vshrq_n_u8( v.val[1], 4 ) ), six ) );
+			chars.val[2] = vqtbl4q_u8( table, vandq_u8( vorrq_u8( vshlq_n_u8( v.val[1], 2 ), vshrq_n_u8( v.val[2], 6 ) ), six ) );
+			chars.val[3] = vqtbl4q_u8( table, vandq_u8( v.val[2], six ) );
+			vst4q_u8( reinterpret_cast<uint8_t*>( out + n ), chars );
+			n += (4 * sizeof( uint8x16_t ));
+		}
+
+		// Fallback for the remainder
+		return n + base64( in + i, (cb - i), out + n, padded );
+	}
+};
 #else
 class sse_xor_t : public xor_t {
 public:
-	size_type apply(operand_type front, operand_type back, size_type cb) const {
+	BITOPS_TARGET("sse") size_type apply(operand_type front, operand_type back, size_type cb) const {
 
 		const size_t s = sizeof( __m128 );
 		for (decltype(cb) i = 0; i < cb; ) {
@@ -124,7 +659,7 @@ public:
 
 class sse2_xor_t : public xor_t {
 public:
-	size_type apply(operand_type front, operand_type back, size_type cb) const {
+	BITOPS_TARGET("sse2") size_type apply(operand_type front, operand_type back, size_type cb) const {
 
 		const size_t s = sizeof( __m128i );
 		for (decltype(cb) i = 0; i < cb; ) {
@@ -156,7 +691,7 @@ public:
 
 class avx_xor_t : public xor_t {
 public:
-	size_type apply(operand_type front, operand_type back, size_type cb) const {
+	BITOPS_TARGET("avx") size_type apply(operand_type front, operand_type back, size_type cb) const {
 
 		const size_t s = sizeof( __m256 );
 		for (decltype(cb) i = 0; i < cb; ) {
@@ -185,12 +720,578 @@ public:
 		return XORVexAVX;
 	}
 };
-#endif // defined(_M_ARM64)
+
+class sse2_emit_t : public emit_t {
+public:
+	size_type apply(operand_type front, operand_type back, size_type cb, const map_t& map, char_type* out, size_type cch) const {
+		return emit_vector( front, back, cb, map, map.chars( ), map_t::reject_char, out, cch );
+	}
+
+	size_type apply(operand_type front, operand_type back, size_type cb, const map_t& map, index_type* out, size_type cch) const {
+		return emit_vector( front, back, cb, map, map.indices( ), map_t::reject_index, out, cch );
+	}
+
+	XORVex vex() const {
+		return XORVexSSE2;
+	}
+
+private:
+	template <typename T>
+	BITOPS_TARGET("sse2") static size_type emit_vector(operand_type front, operand_type back, size_type cb, const map_t& map, const T* table, T reject, T* out, size_type cch) {
+
+		if (map.size( ) == 0){
+			return 0;
+		}
+
+		const size_t s = sizeof( __m128i );
+		const __m128i limit = _mm_set1_epi8( static_cast<char>( map.limit( ) - 1 ) );
+		alignas(16) unsigned char lanes[sizeof( __m128i )];
+
+		size_type n = 0;
+		decltype(cb) i = 0;
+		for (; ((cb - i) >= s) && (n < cch); i += s){
+			// Combine
+			__m128i u = _mm_loadu_si128( reinterpret_cast<const __m128i*>( front + i ) );
+			__m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( back + i ) );
+			__m128i w = _mm_xor_si128( u, v );
+
+			// Find the bytes which don't exceed the limit
+			__m128i accepted = _mm_cmpeq_epi8( _mm_min_epu8( w, limit ), w );
+			const auto mask = static_cast<unsigned long>( _mm_movemask_epi8( accepted ) );
+
+			// Map and emit them
+			_mm_store_si128( reinterpret_cast<__m128i*>( lanes ), w );
+			n = emit_lanes<1>( lanes, s, mask, table, out, n, cch );
+		}
+		secure_zero( lanes, sizeof( lanes ) );
+
+		// Fallback for the remainder
+		if ((i < cb) && (n < cch)){
+			n += emit( front + i, back + i, (cb - i), table, reject, out + n, (cch - n) );
+		}
+		return n;
+	}
+};
+
+class avx2_emit_t : public emit_t {
+public:
+	size_type apply(operand_type front, operand_type back, size_type cb, const map_t& map, char_type* out, size_type cch) const {
+		return emit_vector( front, back, cb, map, map.chars( ), map_t::reject_char, out, cch );
+	}
+
+	size_type apply(operand_type front, operand_type back, size_type cb, const map_t& map, index_type* out, size_type cch) const {
+		return emit_vector( front, back, cb, map, map.indices( ), map_t::reject_index, out, cch );
+	}
+
+	XORVex vex() const {
+		return XORVexAVX2;
+	}
+
+private:
+	template <typename T>
+	BITOPS_TARGET("avx2") static size_type emit_vector(operand_type front, operand_type back, size_type cb, const map_t& map, const T* table, T reject, T* out, size_type cch) {
+
+		if (map.size( ) == 0){
+			return 0;
+		}
+
+		const size_t s = sizeof( __m256i );
+		const __m256i limit = _mm256_set1_epi8( static_cast<char>( map.limit( ) - 1 ) );
+		alignas(32) unsigned char lanes[sizeof( __m256i )];
+
+		size_type n = 0;
+		decltype(cb) i = 0;
+		for (; ((cb - i) >= s) && (n < cch); i += s){
+			// Combine
+			__m256i u = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( front + i ) );
+			__m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( back + i ) );
+			__m256i w = _mm256_xor_si256( u, v );
+
+			// Find the bytes which don't exceed the limit
+			__m256i accepted = _mm256_cmpeq_epi8( _mm256_min_epu8( w, limit ), w );
+			const auto mask = static_cast<unsigned long>( static_cast<unsigned int>( _mm256_movemask_epi8( accepted ) ) );
+
+			// Map and emit them
+			_mm256_store_si256( reinterpret_cast<__m256i*>( lanes ), w );
+			n = emit_lanes<1>( lanes, s, mask, table, out, n, cch );
+		}
+		secure_zero( lanes, sizeof( lanes ) );
+
+		// Fallback for the remainder
+		if ((i < cb) && (n < cch)){
+			n += emit( front + i, back + i, (cb - i), table, reject, out + n, (cch - n) );
+		}
+		return n;
+	}
+};
+
+// Finds the lanes which repeat an earlier lane of the same vector, by comparing
+// it with itself shifted up by 1..15 lanes (shifting in lanes which can't match)
+template <int _k>
+struct ssse3_conflicts_t {
+	BITOPS_TARGET("ssse3") static inline __m128i apply(__m128i v, __m128i sentinel) {
+		return _mm_or_si128( _mm_cmpeq_epi8( v, _mm_alignr_epi8( v, sentinel, 16 - _k ) ), ssse3_conflicts_t<_k - 1>::apply( v, sentinel ) );
+	}
+};
+
+template <>
+struct ssse3_conflicts_t<0> {
+	BITOPS_TARGET("ssse3") static inline __m128i apply(__m128i, __m128i) {
+		return _mm_setzero_si128( );
+	}
+};
+
+// Sets each of the given lanes in a 256-bit bitset held in a register, without touching
+// memory or handling lanes one at a time: each lane's bit is built within a 64-bit word,
+// the bits for each word are gathered into their own vector, and those are transposed
+// and combined so that each ends up in the word it belongs to
+BITOPS_TARGET("avx2") static BITOPS_FORCEINLINE __m256i avx2_set_lanes(__m128i v, __m256i seen) {
+
+	// Widen the lanes to 64 bits, 4 to a vector
+	const __m256i widened[4] = {
+		_mm256_cvtepu8_epi64( v ),
+		_mm256_cvtepu8_epi64( _mm_srli_si128( v, 4 ) ),
+		_mm256_cvtepu8_epi64( _mm_srli_si128( v, 8 ) ),
+		_mm256_cvtepu8_epi64( _mm_srli_si128( v, 12 ) )
+	};
+	const __m256i one = _mm256_set1_epi64x( 1 );
+	const __m256i sixty_three = _mm256_set1_epi64x( 63 );
+
+	__m256i bits[4], words[4];
+	for (size_t j = 0; j < 4; ++j){
+		bits[j] = _mm256_sllv_epi64( one, _mm256_and_si256( widened[j], sixty_three ) );
+		words[j] = _mm256_srli_epi64( widened[j], 6 );
+	}
+
+	// Gather the bits for each word
+	__m256i gathered[4];
+	for (size_t k = 0; k < 4; ++k){
+		const __m256i key = _mm256_set1_epi64x( static_cast<long long>( k ) );
+		gathered[k] = _mm256_or_si256(
+			_mm256_or_si256( _mm256_and_si256( _mm256_cmpeq_epi64( words[0], key ), bits[0] ), _mm256_and_si256( _mm256_cmpeq_epi64( words[1], key ), bits[1] ) ),
+			_mm256_or_si256( _mm256_and_si256( _mm256_cmpeq_epi64( words[2], key ), bits[2] ), _mm256_and_si256( _mm256_cmpeq_epi64( words[3], key ), bits[3] ) )
+		);
+	}
+
+	// Transpose, so that the nth lane of each vector holds bits for the nth word, and combine
+	const __m256i t0 = _mm256_unpacklo_epi64( gathered[0], gathered[1] );
+	const __m256i t1 = _mm256_unpackhi_epi64( gathered[0], gathered[1] );
+	const __m256i t2 = _mm256_unpacklo_epi64( gathered[2], gathered[3] );
+	const __m256i t3 = _mm256_unpackhi_epi64( gathered[2], gathered[3] );
+	const __m256i u0 = _mm256_or_si256( t0, t1 );
+	const __m256i u1 = _mm256_or_si256( t2, t3 );
+	const __m256i combined = _mm256_or_si256( _mm256_permute2x128_si256( u0, u1, 0x20 ), _mm256_permute2x128_si256( u0, u1, 0x31 ) );
+	return _mm256_or_si256( seen, combined );
+}
+
+class avx2_dedupe_t : public dedupe_t {
+public:
+	BITOPS_TARGET("avx2") size_type apply(bitset_type& seen, const index_type* indices, size_type count, index_type* out) const {
+
+		const size_t s = sizeof( __m128i );
+		const __m128i sentinel = _mm_set1_epi8( static_cast<char>( map_t::reject_index ) );
+		const __m128i seven = _mm_set1_epi8( 7 );
+		const __m128i fifteen = _mm_set1_epi8( 15 );
+		const __m128i bit_table = _mm_setr_epi8( 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128 );
+		alignas(16) unsigned char lanes[sizeof( __m128i )];
+
+		auto words = reinterpret_cast<__m256i*>( seen.words( ) );
+		__m256i table = _mm256_loadu_si256( words );
+
+		size_type n = 0;
+		decltype(count) i = 0;
+		for (; (count - i) >= s; i += s){
+			const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( indices + i ) );
+			_mm_store_si128( reinterpret_cast<__m128i*>( lanes ), v );
+
+			// Find the lanes which repeat an earlier one
+			const __m128i repeated = ssse3_conflicts_t<15>::apply( v, sentinel );
+
+			// Find the lanes which are already set: look up the byte of the bitset for each
+			// lane (in one of two halves, since a shuffle only indexes 16 bytes), and test its bit
+			const __m128i lower = _mm256_castsi256_si128( table );
+			const __m128i upper = _mm256_extracti128_si256( table, 1 );
+			const __m128i offsets = _mm_and_si128( _mm_srli_epi16( v, 3 ), _mm_set1_epi8( 0x1F ) );
+			const __m128i in_upper = _mm_cmpgt_epi8( offsets, fifteen );
+			const __m128i byte = _mm_or_si128(
+				_mm_and_si128( in_upper, _mm_shuffle_epi8( upper, offsets ) ),
+				_mm_andnot_si128( in_upper, _mm_shuffle_epi8( lower, offsets ) )
+			);
+			const __m128i bit = _mm_shuffle_epi8( bit_table, _mm_and_si128( v, seven ) );
+			const __m128i already = _mm_cmpeq_epi8( _mm_and_si128( byte, bit ), bit );
+
+			const auto rejected = static_cast<unsigned int>( _mm_movemask_epi8( _mm_or_si128( repeated, already ) ) );
+			n = compact_lanes<1>( lanes, s, ~rejected, out, n );
+			table = avx2_set_lanes( v, table );
+		}
+		_mm256_storeu_si256( words, table );
+		secure_zero( lanes, sizeof( lanes ) );
+
+		// Fallback for the remainder
+		if (i < count){
+			n += dedupe_t::apply( seen, indices + i, (count - i), out + n );
+		}
+		return n;
+	}
+
+	XORVex vex() const {
+		return XORVexAVX2;
+	}
+};
+
+// GCC before 13 warns that the (deliberately) self-initialised placeholder behind every unmasked AVX-512
+// intrinsic may be used uninitialized (c.f. https://gcc.gnu.org/bugzilla/show_bug.cgi?id=105593)
+#if defined (__GNUC__) && !defined (__clang__) && (__GNUC__ < 13)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+class avx512_dedupe_t : public dedupe_t {
+public:
+	BITOPS_TARGET("avx2,avx512f,avx512cd") size_type apply(bitset_type& seen, const index_type* indices, size_type count, index_type* out) const {
+
+		const size_t s = sizeof( __m128i );
+		const __m512i one = _mm512_set1_epi32( 1 );
+		const __m512i thirty_one = _mm512_set1_epi32( 31 );
+
+		auto words = reinterpret_cast<__m256i*>( seen.words( ) );
+		__m256i table = _mm256_loadu_si256( words );
+
+		size_type n = 0;
+		decltype(count) i = 0;
+		for (; (count - i) >= s; i += s){
+			const __m128i u = _mm_loadu_si128( reinterpret_cast<const __m128i*>( indices + i ) );
+			const __m512i v = _mm512_cvtepu8_epi32( u );
+
+			// Find the lanes which don't repeat an earlier one: their conflict masks are empty
+			const __m512i conflicts = _mm512_conflict_epi32( v );
+			const __mmask16 first = _mm512_testn_epi32_mask( conflicts, conflicts );
+
+			// Find the lanes which are already set: the bitset fits in the lower half of a register (zero-extended,
+			// rather than cast, so that the upper half is defined), so permute its dwords into place, and shift
+			// each lane's bit down
+			const __m512i dwords = _mm512_permutexvar_epi32( _mm512_srli_epi32( v, 5 ), _mm512_zextsi256_si512( table ) );
+			const __mmask16 already = _mm512_test_epi32_mask( _mm512_srlv_epi32( dwords, _mm512_and_si512( v, thirty_one ) ), one );
+
+			// Compress the survivors into the output; it trails the input, so
+			// a full-width store only overwrites indices we've already read
+			const __mmask16 kept = first & static_cast<__mmask16>( ~already );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( out + n ), _mm512_cvtepi32_epi8( _mm512_maskz_compress_epi32( kept, v ) ) );
+			n += popcount( kept );
+			table = avx2_set_lanes( u, table );
+		}
+		_mm256_storeu_si256( words, table );
+
+		// Fallback for the remainder
+		if (i < count){
+			n += dedupe_t::apply( seen, indices + i, (count - i), out + n );
+		}
+		return n;
+	}
+
+	XORVex vex() const {
+		return XORVexAVX512;
+	}
+};
+#if defined (__GNUC__) && !defined (__clang__) && (__GNUC__ < 13)
+#pragma GCC diagnostic pop
+#endif
+
+// Spreads each 3 bytes of (the low 12 bytes of each 128-bit lane of) the given vector
+// over 4 bytes, as the 6-bit indices into the base64 alphabet, after Muła and Lemire
+// (c.f. https://arxiv.org/abs/1704.00605): shuffle each group to b1,b0,b2,b1, then
+// shift each pair of indices into place with a multiply
+BITOPS_TARGET("ssse3") static BITOPS_FORCEINLINE __m128i ssse3_base64_indices(__m128i v) {
+
+	v = _mm_shuffle_epi8( v, _mm_setr_epi8( 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10 ) );
+	const __m128i t0 = _mm_mulhi_epu16( _mm_and_si128( v, _mm_set1_epi32( 0x0FC0FC00 ) ), _mm_set1_epi32( 0x04000040 ) );
+	const __m128i t1 = _mm_mullo_epi16( _mm_and_si128( v, _mm_set1_epi32( 0x003F03F0 ) ), _mm_set1_epi32( 0x01000010 ) );
+	return _mm_or_si128( t0, t1 );
+}
+
+// Maps 6-bit indices onto the base64 alphabet, by adding the offset for the range which
+// each falls in; the ranges are numbered so that the offsets can be looked up in one shuffle
+BITOPS_TARGET("ssse3") static BITOPS_FORCEINLINE __m128i ssse3_base64_chars(__m128i indices, __m128i offsets) {
+
+	__m128i ranges = _mm_subs_epu8( indices, _mm_set1_epi8( 51 ) );
+	ranges = _mm_or_si128( ranges, _mm_and_si128( _mm_cmpgt_epi8( _mm_set1_epi8( 26 ), indices ), _mm_set1_epi8( 13 ) ) );
+	return _mm_add_epi8( indices, _mm_shuffle_epi8( offsets, ranges ) );
+}
+
+// Returns the offsets which ssse3_base64_chars adds to each range of indices: 26..51 ('a'..'z'),
+// 52..61 ('0'..'9') in the next 10, then 62 and 63, and 0..25 ('A'..'Z') last
+static inline void base64_offsets(bool padded, signed char (&offsets)[16]) {
+
+	offsets[0] = static_cast<signed char>( 'a' - 26 );
+	for (size_t r = 1; r <= 10; ++r){
+		offsets[r] = static_cast<signed char>( '0' - 52 );
+	}
+	offsets[11] = static_cast<signed char>( (padded ? '+' : '-') - 62 );
+	offsets[12] = static_cast<signed char>( (padded ? '/' : '_') - 63 );
+	offsets[13] = static_cast<signed char>( 'A' );
+	offsets[14] = offsets[15] = 0;
+}
+
+// Gives the masks with which the version and variant bits of a UUID are set: the bits to keep, then those to set
+static inline void uuid_masks(unsigned version, unsigned char (&keep)[16], unsigned char (&set)[16]) {
+
+	memset( keep, 0xFF, sizeof( keep ) );
+	memset( set, 0, sizeof( set ) );
+	keep[6] = 0x0F;
+	set[6] = static_cast<unsigned char>( version << 4 );
+	keep[8] = 0x3F;
+	set[8] = 0x80;
+}
+
+// Writes the canonical text of a UUID, given the hex of its first and last 8 bytes: the dashes go in
+// by shuffling the digits apart (leaving zeroes where the dashes go) and or'ing them in
+BITOPS_TARGET("ssse3") static BITOPS_FORCEINLINE void ssse3_format_uuid(__m128i hex0, __m128i hex1, char* out) {
+
+	const __m128i front = _mm_shuffle_epi8( hex0, _mm_setr_epi8( 0, 1, 2, 3, 4, 5, 6, 7, -1, 8, 9, 10, 11, -1, 12, 13 ) );
+	const __m128i middle = _mm_shuffle_epi8( _mm_alignr_epi8( hex1, hex0, 14 ), _mm_setr_epi8( 0, 1, -1, 2, 3, 4, 5, -1, 6, 7, 8, 9, 10, 11, 12, 13 ) );
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( out ), _mm_or_si128( front, _mm_setr_epi8( 0, 0, 0, 0, 0, 0, 0, 0, '-', 0, 0, 0, 0, '-', 0, 0 ) ) );
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( out + 16 ), _mm_or_si128( middle, _mm_setr_epi8( 0, 0, '-', 0, 0, 0, 0, '-', 0, 0, 0, 0, 0, 0, 0, 0 ) ) );
+	const int tail = _mm_cvtsi128_si32( _mm_srli_si128( hex1, 12 ) );
+	memcpy( out + 32, &tail, sizeof( tail ) );
+}
+
+// Formats the given UUIDs, one at a time
+BITOPS_TARGET("ssse3") static encode_t::size_type ssse3_format_uuids(const unsigned char* uuids, size_t count, char delimiter, char* out) {
+
+	const __m128i digits = _mm_loadu_si128( reinterpret_cast<const __m128i*>( base16_digits ) );
+	const __m128i low = _mm_set1_epi8( 0x0F );
+	for (size_t i = 0; i < count; ++i){
+		const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( uuids + (i * encode_t::uuid_size) ) );
+		const __m128i hi = _mm_shuffle_epi8( digits, _mm_and_si128( _mm_srli_epi16( v, 4 ), low ) );
+		const __m128i lo = _mm_shuffle_epi8( digits, _mm_and_si128( v, low ) );
+		char* text = out + (i * (encode_t::uuid_chars + 1));
+		ssse3_format_uuid( _mm_unpacklo_epi8( hi, lo ), _mm_unpackhi_epi8( hi, lo ), text );
+		*(text + encode_t::uuid_chars) = delimiter;
+	}
+	return (count * (encode_t::uuid_chars + 1));
+}
+
+class ssse3_encode_t : public encode_t {
+public:
+	size_type apply(Encoding encoding, operand_type in, size_type cb, char_type* out) const {
+
+		switch (encoding){
+			case EncodingBASE16:
+				return base16_vector( in, cb, out );
+
+			case EncodingBASE64:
+			case EncodingBASE64URL:
+				return base64_vector( in, cb, out, (encoding == EncodingBASE64) );
+
+			default:
+				break;
+		}
+		return encode( encoding, in, cb, out );
+	}
+
+	void stamp_uuids(unsigned char* uuids, size_type count, unsigned version, unsigned long long ms, unsigned long long counter) const {
+
+		if (version == 7){
+			stamp_times( uuids, count, ms, counter );
+		}
+		stamp_vector( uuids, count, version );
+	}
+
+	size_type format_uuids(operand_type uuids, size_type count, char_type delimiter, char_type* out) const {
+		return ssse3_format_uuids( uuids, count, delimiter, out );
+	}
+
+	XORVex vex() const {
+		return XORVexSSSE3;
+	}
+
+private:
+	BITOPS_TARGET("sse2") static void stamp_vector(unsigned char* uuids, size_type count, unsigned version) {
+
+		alignas(16) unsigned char keep[16], set[16];
+		uuid_masks( version, keep, set );
+		const __m128i k = _mm_load_si128( reinterpret_cast<const __m128i*>( keep ) );
+		const __m128i o = _mm_load_si128( reinterpret_cast<const __m128i*>( set ) );
+		for (decltype(count) i = 0; i < count; ++i){
+			__m128i* uuid = reinterpret_cast<__m128i*>( uuids + (i * uuid_size) );
+			_mm_storeu_si128( uuid, _mm_or_si128( _mm_and_si128( _mm_loadu_si128( uuid ), k ), o ) );
+		}
+	}
+
+	BITOPS_TARGET("ssse3") static size_type base16_vector(operand_type in, size_type cb, char_type* out) {
+
+		const size_t s = sizeof( __m128i );
+		const __m128i digits = _mm_loadu_si128( reinterpret_cast<const __m128i*>( base16_digits ) );
+		const __m128i low = _mm_set1_epi8( 0x0F );
+
+		decltype(cb) i = 0;
+		for (; (cb - i) >= s; i += s){
+			// Look up each nibble, and interleave them
+			const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i ) );
+			const __m128i hi = _mm_shuffle_epi8( digits, _mm_and_si128( _mm_srli_epi16( v, 4 ), low ) );
+			const __m128i lo = _mm_shuffle_epi8( digits, _mm_and_si128( v, low ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( out + (2 * i) ), _mm_unpacklo_epi8( hi, lo ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( out + (2 * i) + s ), _mm_unpackhi_epi8( hi, lo ) );
+		}
+
+		// Fallback for the remainder
+		return (2 * i) + base16( in + i, (cb - i), out + (2 * i) );
+	}
+
+	BITOPS_TARGET("ssse3") static size_type base64_vector(operand_type in, size_type cb, char_type* out, bool padded) {
+
+		signed char table[16];
+		base64_offsets( padded, table );
+		const __m128i offsets = _mm_loadu_si128( reinterpret_cast<const __m128i*>( table ) );
+
+		// Each load takes 12 bytes, of the 16 read
+		size_type n = 0;
+		decltype(cb) i = 0;
+		for (; (cb - i) >= sizeof( __m128i ); i += 12){
+			const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( out + n ), ssse3_base64_chars( ssse3_base64_indices( v ), offsets ) );
+			n += sizeof( __m128i );
+		}
+
+		// Fallback for the remainder
+		return n + base64( in + i, (cb - i), out + n, padded );
+	}
+};
+
+class avx2_encode_t : public encode_t {
+public:
+	size_type apply(Encoding encoding, operand_type in, size_type cb, char_type* out) const {
+
+		switch (encoding){
+			case EncodingBASE16:
+				return base16_vector( in, cb, out );
+
+			case EncodingBASE64:
+			case EncodingBASE64URL:
+				return base64_vector( in, cb, out, (encoding == EncodingBASE64) );
+
+			default:
+				break;
+		}
+		return encode( encoding, in, cb, out );
+	}
+
+	void stamp_uuids(unsigned char* uuids, size_type count, unsigned version, unsigned long long ms, unsigned long long counter) const {
+
+		if (version == 7){
+			stamp_times( uuids, count, ms, counter );
+		}
+		stamp_vector( uuids, count, version );
+	}
+
+	size_type format_uuids(operand_type uuids, size_type count, char_type delimiter, char_type* out) const {
+		return format_vector( uuids, count, delimiter, out );
+	}
+
+	XORVex vex() const {
+		return XORVexAVX2;
+	}
+
+private:
+	BITOPS_TARGET("avx2") static void stamp_vector(unsigned char* uuids, size_type count, unsigned version) {
+
+		alignas(16) unsigned char keep[16], set[16];
+		uuid_masks( version, keep, set );
+		const __m256i k = _mm256_broadcastsi128_si256( _mm_load_si128( reinterpret_cast<const __m128i*>( keep ) ) );
+		const __m256i o = _mm256_broadcastsi128_si256( _mm_load_si128( reinterpret_cast<const __m128i*>( set ) ) );
+
+		// Two at a time, then the odd one out
+		decltype(count) i = 0;
+		for (; (count - i) >= 2; i += 2){
+			__m256i* pair = reinterpret_cast<__m256i*>( uuids + (i * uuid_size) );
+			_mm256_storeu_si256( pair, _mm256_or_si256( _mm256_and_si256( _mm256_loadu_si256( pair ), k ), o ) );
+		}
+		if (i < count){
+			__m128i* uuid = reinterpret_cast<__m128i*>( uuids + (i * uuid_size) );
+			_mm_storeu_si128( uuid, _mm_or_si128( _mm_and_si128( _mm_loadu_si128( uuid ), _mm256_castsi256_si128( k ) ), _mm256_castsi256_si128( o ) ) );
+		}
+	}
+
+	BITOPS_TARGET("avx2") static size_type format_vector(operand_type uuids, size_type count, char_type delimiter, char_type* out) {
+
+		const __m256i digits = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( base16_digits ) ) );
+		const __m256i low = _mm256_set1_epi8( 0x0F );
+
+		// Take the hex of two at a time (one per lane), then lay each out in turn
+		decltype(count) i = 0;
+		for (; (count - i) >= 2; i += 2){
+			const __m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( uuids + (i * uuid_size) ) );
+			const __m256i hi = _mm256_shuffle_epi8( digits, _mm256_and_si256( _mm256_srli_epi16( v, 4 ), low ) );
+			const __m256i lo = _mm256_shuffle_epi8( digits, _mm256_and_si256( v, low ) );
+			const __m256i hex0 = _mm256_unpacklo_epi8( hi, lo ), hex1 = _mm256_unpackhi_epi8( hi, lo );
+			char_type* text = out + (i * (uuid_chars + 1));
+			ssse3_format_uuid( _mm256_castsi256_si128( hex0 ), _mm256_castsi256_si128( hex1 ), text );
+			*(text + uuid_chars) = delimiter;
+			text += (uuid_chars + 1);
+			ssse3_format_uuid( _mm256_extracti128_si256( hex0, 1 ), _mm256_extracti128_si256( hex1, 1 ), text );
+			*(text + uuid_chars) = delimiter;
+		}
+		if (i < count){
+			ssse3_format_uuids( uuids + (i * uuid_size), (count - i), delimiter, out + (i * (uuid_chars + 1)) );
+		}
+		return (count * (uuid_chars + 1));
+	}
+
+	BITOPS_TARGET("avx2") static size_type base16_vector(operand_type in, size_type cb, char_type* out) {
+
+		const size_t s = sizeof( __m256i );
+		const __m256i digits = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( base16_digits ) ) );
+		const __m256i low = _mm256_set1_epi8( 0x0F );
+
+		decltype(cb) i = 0;
+		for (; (cb - i) >= s; i += s){
+			// Put the (64-bit) quarters in the order 0, 2, 1, 3, so that the in-lane
+			// interleaves give the first and second halves of the output
+			const __m256i v = _mm256_permute4x64_epi64( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( in + i ) ), 0xD8 );
+			const __m256i hi = _mm256_shuffle_epi8( digits, _mm256_and_si256( _mm256_srli_epi16( v, 4 ), low ) );
+			const __m256i lo = _mm256_shuffle_epi8( digits, _mm256_and_si256( v, low ) );
+			_mm256_storeu_si256( reinterpret_cast<__m256i*>( out + (2 * i) ), _mm256_unpacklo_epi8( hi, lo ) );
+			_mm256_storeu_si256( reinterpret_cast<__m256i*>( out + (2 * i) + s ), _mm256_unpackhi_epi8( hi, lo ) );
+		}
+
+		// Fallback for the remainder
+		return (2 * i) + base16( in + i, (cb - i), out + (2 * i) );
+	}
+
+	BITOPS_TARGET("avx2") static size_type base64_vector(operand_type in, size_type cb, char_type* out, bool padded) {
+
+		signed char table[16];
+		base64_offsets( padded, table );
+		const __m256i offsets = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( table ) ) );
+		const __m256i shuffle = _mm256_setr_epi8( 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10 );
+
+		// Each iteration takes 24 bytes, 12 into each lane, of the 28 read
+		size_type n = 0;
+		decltype(cb) i = 0;
+		for (; (cb - i) >= 28; i += 24){
+			__m256i v = _mm256_inserti128_si256( _mm256_castsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i ) ) ),
+				_mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i + 12 ) ), 1 );
+
+			// As ssse3_base64_indices and ssse3_base64_chars, but across both lanes
+			v = _mm256_shuffle_epi8( v, shuffle );
+			const __m256i t0 = _mm256_mulhi_epu16( _mm256_and_si256( v, _mm256_set1_epi32( 0x0FC0FC00 ) ), _mm256_set1_epi32( 0x04000040 ) );
+			const __m256i t1 = _mm256_mullo_epi16( _mm256_and_si256( v, _mm256_set1_epi32( 0x003F03F0 ) ), _mm256_set1_epi32( 0x01000010 ) );
+			const __m256i indices = _mm256_or_si256( t0, t1 );
+			__m256i ranges = _mm256_subs_epu8( indices, _mm256_set1_epi8( 51 ) );
+			ranges = _mm256_or_si256( ranges, _mm256_and_si256( _mm256_cmpgt_epi8( _mm256_set1_epi8( 26 ), indices ), _mm256_set1_epi8( 13 ) ) );
+			_mm256_storeu_si256( reinterpret_cast<__m256i*>( out + n ), _mm256_add_epi8( indices, _mm256_shuffle_epi8( offsets, ranges ) ) );
+			n += sizeof( __m256i );
+		}
+
+		// Fallback for the remainder
+		return n + base64( in + i, (cb - i), out + n, padded );
+	}
+};
+#endif // defined(BITOPS_ARM64)
 
 // Functions
 //
 
-#if defined (_DEBUG)
+#if defined (_DEBUG) && defined (_WIN32)
 VOID DebugOut(LPCTSTR pszLabel, const unsigned char* ptr, size_t cb) {
 
 	OutputDebugString( pszLabel );
@@ -249,69 +1350,246 @@ std::unique_ptr<xor_t> get_vex_xor(void) {
 }
 #else
 #define get_vex_xor_impl get_vex_xor
-#endif // defined (_DEBUG)
+#endif // defined (_DEBUG) && defined (_WIN32)
 
-// Given the output of CPUID, returns the name of the CPU vendor in a string
-std::string get_cpu_vendor(int cpuid[]) {
+// Returns the widest vector extensions supported by both the CPU and the OS
+static XORVex get_vex_supported(void) {
 
-	std::string name;
-	std::array<int, 3> indices = { 1, 3, 2 };
-	std::for_each( indices.cbegin( ), indices.cend( ), [&](int offset) {
-		auto ptr = reinterpret_cast<char*>( cpuid + offset );
-		for (auto i = 0; i < sizeof( int ); ++i){
-			name.append( 1, *(ptr + i) );
-		}
-	} );
-	return name;
+	const auto& features = get_cpu_features( );
+#if defined(BITOPS_ARM64)
+	return features.neon ? XORVexNEON : XORVexNONE;
+#else
+	if (features.avx2){
+		return XORVexAVX2;
+	}
+	if (features.avx){
+		return XORVexAVX;
+	}
+	if (features.sse2){
+		return XORVexSSE2;
+	}
+	if (features.sse){
+		return XORVexSSE;
+	}
+	if (features.mmx){
+		return XORVexMMX;
+	}
+	return XORVexNONE;
+#endif // defined(BITOPS_ARM64)
+}
+
+// Returns a readable name for the given vector extensions
+const char* get_vex_name(XORVex vex) {
+
+	switch (vex){
+		case XORVexMMX:
+			return "MMX";
+
+		case XORVexSSE:
+			return "SSE";
+
+		case XORVexSSE2:
+			return "SSE2";
+
+		case XORVexAVX:
+			return "AVX";
+
+		case XORVexAVX2:
+			return "AVX2";
+
+		case XORVexNEON:
+			return "NEON";
+
+		case XORVexAVX512:
+			return "AVX-512";
+
+		case XORVexSSSE3:
+			return "SSSE3";
+
+		default:
+			break;
+	}
+	return "scalar";
 }
 
 std::unique_ptr<xor_t> get_vex_xor_impl(void) {
 
-#if defined(_M_ARM64)
-	return std::make_unique<neon_xor_t>( );
-#else
-	// Get the CPU ID
-	int info[4] = { -1, -1, -1, -1 };
-	__cpuid(info, 0);
-
-	// Check if we are on supported hardware
-	const std::set<std::string> vendors = { "GenuineIntel", "AuthenticAMD" };
-	const auto vendor = get_cpu_vendor( info );
-	if (vendors.count( vendor ) > 0){
-		// Query for the feature flags
-		__cpuid( info, 1 );
-
-		// Is AVX supported? (c.f. http://software.intel.com/en-us/blogs/2011/04/14/is-avx-enabled/)
-		const bool os_uses_XSAVE = (info[2] & (1 << 27)) != 0;
-		const bool cpu_supports_AVX = (info[2] & (1 << 28)) != 0;
-		if (os_uses_XSAVE && cpu_supports_AVX){
-			// Check if the OS will save the YMM registers
-			unsigned long long xcr_feature_mask = _xgetbv( _XCR_XFEATURE_ENABLED_MASK );
-			if ((xcr_feature_mask & 0x6) != 0){
-				// AVX: good to G.O.
-				return std::make_unique<avx_xor_t>( );
-			}
-		}
+	switch (get_vex_supported( )){
+#if defined(BITOPS_ARM64)
+		case XORVexNEON:
+			return std::make_unique<neon_xor_t>( );
+#elif defined(BITOPS_X86)
+		case XORVexAVX2:
+		case XORVexAVX:
+			return std::make_unique<avx_xor_t>( );
 
-		// How about SSE2?
-		if ((info[3] & (1 << 26)) != 0){
+		case XORVexSSE2:
 			return std::make_unique<sse2_xor_t>( );
-		}
 
-		// SSE?
-		if ((info[3] & (1 << 25)) != 0){
+		case XORVexSSE:
 			return std::make_unique<sse_xor_t>( );
-		}
 
-#if !defined (_WIN64)
-		// MMX?
-		if ((info[3] & (1 << 23)) != 0){
+#if defined(_MSC_VER) && defined(_M_IX86)
+		case XORVexMMX:
 			return std::make_unique<mmx_xor_t>( );
-		}
-#endif // _WIN64
+#endif // defined(_MSC_VER) && defined(_M_IX86)
+#endif // defined(BITOPS_ARM64)
+
+		default:
+			break;
 	}
-#endif // !defined(_M_ARM64)
 
 	// If we get here, just return the default implementation
 	return std::make_unique<xor_t>( );
 }
+
+std::unique_ptr<emit_t> get_vex_emit(void) {
+
+	switch (get_vex_supported( )){
+#if defined(BITOPS_ARM64)
+		case XORVexNEON:
+			return std::make_unique<neon_emit_t>( );
+#elif defined(BITOPS_X86)
+		case XORVexAVX2:
+			return std::make_unique<avx2_emit_t>( );
+
+		case XORVexAVX:
+		case XORVexSSE2:
+			return std::make_unique<sse2_emit_t>( );
+#endif // defined(BITOPS_ARM64)
+
+		default:
+			break;
+	}
+
+	// If we get here, just return the default implementation
+	return std::make_unique<emit_t>( );
+}
+
+std::unique_ptr<dedupe_t> get_vex_dedupe(void) {
+
+	// Only AVX-512 finds conflicts (and compresses the survivors) cheaply enough to beat the
+	// scalar test-and-set over runs as short as a password; the compare-based AVX2 and NEON
+	// kernels are offered by get_all_dedupe, for comparison (c.f. the benchmarks)
+#if defined(BITOPS_X86)
+	const auto& features = get_cpu_features( );
+	if (features.avx512f && features.avx512cd){
+		return std::make_unique<avx512_dedupe_t>( );
+	}
+#endif // defined(BITOPS_X86)
+
+	// If we get here, just return the default implementation
+	return std::make_unique<dedupe_t>( );
+}
+
+std::vector<std::unique_ptr<xor_t>> get_all_xor(void) {
+
+	std::vector<std::unique_ptr<xor_t>> all;
+	all.push_back( std::make_unique<xor_t>( ) );
+
+	const auto vex = get_vex_supported( );
+#if defined(BITOPS_ARM64)
+	if (vex == XORVexNEON){
+		all.push_back( std::make_unique<neon_xor_t>( ) );
+	}
+#elif defined(BITOPS_X86)
+#if defined(_MSC_VER) && defined(_M_IX86)
+	if (vex >= XORVexMMX){
+		all.push_back( std::make_unique<mmx_xor_t>( ) );
+	}
+#endif // defined(_MSC_VER) && defined(_M_IX86)
+	if (vex >= XORVexSSE){
+		all.push_back( std::make_unique<sse_xor_t>( ) );
+	}
+	if (vex >= XORVexSSE2){
+		all.push_back( std::make_unique<sse2_xor_t>( ) );
+	}
+	if (vex >= XORVexAVX){
+		all.push_back( std::make_unique<avx_xor_t>( ) );
+	}
+#endif // defined(BITOPS_ARM64)
+	return all;
+}
+
+std::vector<std::unique_ptr<emit_t>> get_all_emit(void) {
+
+	std::vector<std::unique_ptr<emit_t>> all;
+	all.push_back( std::make_unique<emit_t>( ) );
+
+	const auto vex = get_vex_supported( );
+#if defined(BITOPS_ARM64)
+	if (vex == XORVexNEON){
+		all.push_back( std::make_unique<neon_emit_t>( ) );
+	}
+#elif defined(BITOPS_X86)
+	if (vex >= XORVexSSE2){
+		all.push_back( std::make_unique<sse2_emit_t>( ) );
+	}
+	if (vex >= XORVexAVX2){
+		all.push_back( std::make_unique<avx2_emit_t>( ) );
+	}
+#endif // defined(BITOPS_ARM64)
+	return all;
+}
+
+std::vector<std::unique_ptr<dedupe_t>> get_all_dedupe(void) {
+
+	std::vector<std::unique_ptr<dedupe_t>> all;
+	all.push_back( std::make_unique<dedupe_t>( ) );
+
+	const auto& features = get_cpu_features( );
+#if defined(BITOPS_ARM64)
+	if (features.neon){
+		all.push_back( std::make_unique<neon_dedupe_t>( ) );
+	}
+#elif defined(BITOPS_X86)
+	if (features.avx2){
+		all.push_back( std::make_unique<avx2_dedupe_t>( ) );
+	}
+	if (features.avx512f && features.avx512cd){
+		all.push_back( std::make_unique<avx512_dedupe_t>( ) );
+	}
+#endif // defined(BITOPS_ARM64)
+	return all;
+}
+
+std::unique_ptr<encode_t> get_vex_encode(void) {
+
+	const auto& features = get_cpu_features( );
+#if defined(BITOPS_ARM64)
+	if (features.neon){
+		return std::make_unique<neon_encode_t>( );
+	}
+#elif defined(BITOPS_X86)
+	if (features.avx2){
+		return std::make_unique<avx2_encode_t>( );
+	}
+	if (features.ssse3){
+		return std::make_unique<ssse3_encode_t>( );
+	}
+#endif // defined(BITOPS_ARM64)
+
+	// If we get here, just return the default implementation
+	return std::make_unique<encode_t>( );
+}
+
+std::vector<std::unique_ptr<encode_t>> get_all_encode(void) {
+
+	std::vector<std::unique_ptr<encode_t>> all;
+	all.push_back( std::make_unique<encode_t>( ) );
+
+	const auto& features = get_cpu_features( );
+#if defined(BITOPS_ARM64)
+	if (features.neon){
+		all.push_back( std::make_unique<neon_encode_t>( ) );
+	}
+#elif defined(BITOPS_X86)
+	if (features.ssse3){
+		all.push_back( std::make_unique<ssse3_encode_t>( ) );
+	}
+	if (features.avx2){
+		all.push_back( std::make_unique<avx2_encode_t>( ) );
+	}
+#endif // defined(BITOPS_ARM64)
+	return all;
+}
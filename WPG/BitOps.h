@@ -15,9 +15,34 @@
 // C++ Standard Library Headers
 #include <string>
 #include <memory>
+#include <vector>
 
 // C Standard Library Headers
 #include <limits.h>
+#include <string.h>
+
+// Intrinsics Headers
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif // defined(_MSC_VER)
+
+// Macros
+//
+
+// Identifies the target architecture, independently of the compiler
+#if defined(_M_ARM64) || defined(__aarch64__)
+#define BITOPS_ARM64
+#elif defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BITOPS_X86
+#endif
+
+// Allows functions to use vector extensions beyond those of the compiler's
+// baseline; MSVC doesn't need telling
+#if defined(_MSC_VER)
+#define BITOPS_TARGET(ext)
+#else
+#define BITOPS_TARGET(ext) __attribute__((target(ext)))
+#endif // defined(_MSC_VER)
 
 // Types
 //
@@ -32,113 +57,191 @@ typedef enum _XORVex {
 	XORVexSSE = 2,
 	XORVexSSE2 = 4,
 	XORVexAVX = 8,
-    XORVexNEON = 16
+    XORVexNEON = 16,
+	XORVexAVX2 = 32,
+	XORVexAVX512 = 64,
+
+	// Not one of the (ordered) levels given by the XOR kernels; only the encoders use it
+	XORVexSSSE3 = 128
 
 } XORVex;
 
+// Enumerates the encodings into which encode_t renders raw bytes, as tokens
+typedef enum _Encoding {
+
+	// Lower-case hexadecimal
+	EncodingBASE16 = 0,
+
+	// RFC 4648, with padding
+	EncodingBASE32 = 1,
+
+	// The (Bitcoin) alphabet without 0, O, I or l; the bytes are taken as one big-endian number,
+	// and each leading zero byte is kept as a leading '1'
+	EncodingBASE58 = 2,
+
+	// RFC 4648, with padding
+	EncodingBASE64 = 3,
+
+	// RFC 4648's URL- and filename-safe alphabet, without padding
+	EncodingBASE64URL = 4
+
+} Encoding;
+
+// Functions
+//
+
+// Returns the index of the lowest set bit in the given (non-zero) mask
+inline unsigned long lowest_set_bit(unsigned long long mask) {
+#if defined(_MSC_VER) && defined(_M_IX86)
+	unsigned long index = 0;
+	if (!_BitScanForward( &index, static_cast<unsigned long>( mask ) )){
+		_BitScanForward( &index, static_cast<unsigned long>( mask >> 32 ) );
+		index += 32;
+	}
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index = 0;
+	_BitScanForward64( &index, mask );
+	return index;
+#else
+	return static_cast<unsigned long>( __builtin_ctzll( mask ) );
+#endif // defined(_MSC_VER) && defined(_M_IX86)
+}
+
+// Returns the number of set bits in the given mask; MSVC's intrinsic for
+// this needs the POPCNT instruction, which we can't assume, so count in parallel
+inline size_t popcount(unsigned long long mask) {
+#if defined(_MSC_VER)
+	mask = mask - ((mask >> 1) & 0x5555555555555555ULL);
+	mask = (mask & 0x3333333333333333ULL) + ((mask >> 2) & 0x3333333333333333ULL);
+	mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return static_cast<size_t>( (mask * 0x0101010101010101ULL) >> 56 );
+#else
+	return static_cast<size_t>( __builtin_popcountll( mask ) );
+#endif // defined(_MSC_VER)
+}
+
 // Classes
 //
 
-// Defines the interface for a class for tracking the state of
-// variable-sized sets of individual bits
-class empty_bitset_t {
+// Tracks the state of a fixed-capacity collection of bits, held inline (i.e.
+// on the stack, for locals) in 64-bit words, so that whole words can be
+// tested, counted and searched at once
+template <size_t _capacity>
+class bitset_t {
 public:
-    empty_bitset_t(size_t size): m_size( size ) { }
-    virtual ~empty_bitset_t() {
-#if defined (_DEBUG)
-		OutputDebugString( TEXT( "Destroying empty_bitset_t...\x0A" ) );
-#endif
-    }
+	typedef unsigned long long word_type;
 
-    virtual void set(size_t bit) {
-        // Do nothing
-        ;
-    }
+	static const size_t bits_per_word = (CHAR_BIT * sizeof( word_type ));
+	static const size_t word_count = ((_capacity + bits_per_word - 1) / bits_per_word);
 
-    virtual bool is_set(size_t bit) const {
-        return false;
-    }
+	bitset_t(size_t size = _capacity): m_size( (size < _capacity) ? size : _capacity ) {
+		reset( );
+	}
 
-    virtual void reset() { }
+	void set(size_t bit) {
+		m_words[bit / bits_per_word] |= mask( bit );
+	}
 
-    size_t size(void) const {
-        return m_size;
-    }
+	bool is_set(size_t bit) const {
+		return (m_words[bit / bits_per_word] & mask( bit )) != 0;
+	}
 
-private:
-    size_t m_size;
-};
+	// Sets the given bit; returns true if it was already set
+	bool test_and_set(size_t bit) {
 
-// Defines the implementation for a class for tracking the state of
-// variable-sized sets of individual bits
-class bitset_t : public empty_bitset_t {
-public:
-    bitset_t(size_t size):
-        empty_bitset_t( size ),
-        m_words( word_count( size ), zero_word ) { }
-    virtual ~bitset_t() {
-#if defined (_DEBUG)
-		OutputDebugString( TEXT( "Destroying bitset_t...\x0A" ) );
-#endif
-    }
-
-    void set(size_t bit) {
-        apply(
-            [this](size_t word, const word_type& mask) -> void {
-                const auto masked = (m_words[word] | mask);
-                m_words.replace( word, 1, 1, masked );
-            },
-            bit
-        );
-    }
-
-    bool is_set(size_t bit) const {
-
-        bool result = false;
-        apply(
-            [this, &result](size_t word, const word_type& mask) -> void {
-                result = ((m_words[word] & mask) != 0);
-            },
-            bit
-        );
-        return result;
-    }
-
-    void reset() {
-        
-        for (auto it = m_words.begin( ), end = m_words.end( ); it != end; ++it){
-            (*it) = zero_word;
-        }
-    }
+		word_type& word = m_words[bit / bits_per_word];
+		const word_type m = mask( bit );
+		const bool result = (word & m) != 0;
+		word |= m;
+		return result;
+	}
 
-private:
-    static size_t word_count(size_t size) {
+	// Sets each of the given bits in turn, and copies those which weren't already set
+	// to the given output, in order and without branching; the output may alias the
+	// input. Returns the number of bits copied to the output
+	template <typename _index>
+	size_t test_and_set(const _index* indices, size_t count, _index* fresh) {
+
+		size_t n = 0;
+		if (word_count == 1){
+			// Keep the only word in a register, rather than going through memory for each bit
+			word_type word = m_words[0];
+			for (size_t i = 0; i < count; ++i){
+				const _index index = *(indices + i);
+				const word_type m = mask( static_cast<size_t>( index ) );
+				*(fresh + n) = index;
+				n += static_cast<size_t>( (word & m) == 0 );
+				word |= m;
+			}
+			m_words[0] = word;
+			return n;
+		}
+		for (size_t i = 0; i < count; ++i){
+			const _index index = *(indices + i);
+			word_type& word = m_words[static_cast<size_t>( index ) / bits_per_word];
+			const word_type m = mask( static_cast<size_t>( index ) );
+			*(fresh + n) = index;
+			n += static_cast<size_t>( (word & m) == 0 );
+			word |= m;
+		}
+		return n;
+	}
+
+	// Returns the number of set bits
+	size_t count(void) const {
 
-        const auto wc = size / bits_per_word;
-        return ((size % bits_per_word) == 0)
-            ? wc
-            : (wc + 1);
-    }
+		size_t result = 0;
+		for (size_t w = 0; w < word_count; ++w){
+			result += popcount( m_words[w] );
+		}
+		return result;
+	}
 
-    template<typename Lambda>
-    void apply(Lambda lambda, size_t index) const {
+	// Returns the index of the first unset bit at or after the given one, or size() if there isn't one
+	size_t find_next_unset(size_t bit = 0) const {
+
+		for (size_t w = (bit / bits_per_word); (w < word_count) && (bit < m_size); ++w){
+			// Invert the word, and clear the bits below the one we're starting from
+			const word_type unset = ~m_words[w] & (~static_cast<word_type>( 0 ) << (bit % bits_per_word));
+			if (unset){
+				const size_t result = (w * bits_per_word) + lowest_set_bit( unset );
+				return (result < m_size) ? result : m_size;
+			}
+			bit = (w + 1) * bits_per_word;
+		}
+		return m_size;
+	}
 
-        // Find the word
-        const auto word = (index / bits_per_word);
+	// Clears all of the bits at once
+	void reset(void) {
+		memset( m_words, 0, sizeof( m_words ) );
+	}
 
-        // Generate the mask
-        const auto bit = (index % bits_per_word);
-        const word_type mask = (1 << bit);
-        lambda( word, mask );
-    }
+	size_t size(void) const {
+		return m_size;
+	}
 
-    typedef unsigned int word_type;
-    typedef ::std::basic_string<word_type> word_string;
+	static size_t capacity(void) {
+		return _capacity;
+	}
 
-    static const word_type zero_word = 0;
-    static const size_t bits_per_word = (CHAR_BIT * sizeof( word_type ));
+	// Gives the underlying words, least significant first
+	const word_type* words(void) const {
+		return m_words;
+	}
 
-    word_string m_words;
+	word_type* words(void) {
+		return m_words;
+	}
+
+private:
+	static word_type mask(size_t bit) {
+		return static_cast<word_type>( 1 ) << (bit % bits_per_word);
+	}
+
+	size_t m_size;
+	word_type m_words[word_count];
 };
 
 class xor_t {
@@ -159,6 +262,202 @@ public:
 	}
 };
 
+// Describes how combined random bytes map onto the characters of an alphabet:
+// bytes at or above the limit are rejected, so that every character is equally
+// likely to be selected; those below it map to the character (or its index)
+class map_t {
+public:
+	typedef wchar_t char_type;
+	typedef unsigned char index_type;
+
+	// Marks a rejected byte in the respective lookup tables
+	static const char_type reject_char = 0;
+	static const index_type reject_index = 0xFF;
+
+	// The largest alphabet which can be mapped from a single byte
+	static const size_t max_size = 0xFF;
+
+	map_t(void): m_size( 0 ), m_limit( 0 ) {
+		for (size_t i = 0; i < table_size; ++i){
+			m_chars[i] = reject_char;
+			m_indices[i] = reject_index;
+		}
+	}
+
+	map_t(const char_type* alphabet, size_t size): map_t( ) {
+
+		m_size = (size < max_size) ? size : max_size;
+		if (m_size == 0){
+			return;
+		}
+
+		// Reject the remainder at the top of the range
+		m_limit = table_size - (table_size % m_size);
+		for (size_t i = 0; i < m_limit; ++i){
+			const auto index = (i % m_size);
+			m_chars[i] = alphabet[index];
+			m_indices[i] = static_cast<index_type>( index );
+		}
+	}
+
+	size_t size(void) const {
+		return m_size;
+	}
+
+	// Returns the (exclusive) upper bound on accepted bytes
+	size_t limit(void) const {
+		return m_limit;
+	}
+
+	const char_type* chars(void) const {
+		return m_chars;
+	}
+
+	const index_type* indices(void) const {
+		return m_indices;
+	}
+
+private:
+	static const size_t table_size = (1 << CHAR_BIT);
+
+	size_t m_size;
+	size_t m_limit;
+	char_type m_chars[table_size];
+	index_type m_indices[table_size];
+};
+
+// Fuses the final combine of a pair of byte buffers with the mapping of the
+// result through a map_t and the emission of the accepted characters (or indices)
+class emit_t {
+public:
+	typedef size_t size_type;
+	typedef unsigned char* operand_type;
+	typedef map_t::char_type char_type;
+	typedef map_t::index_type index_type;
+
+	// Writes up to cch characters to the output; returns the number written
+	virtual size_type apply(operand_type front, operand_type back, size_type cb, const map_t& map, char_type* out, size_type cch) const {
+		return emit( front, back, cb, map.chars( ), map_t::reject_char, out, cch );
+	}
+
+	// Writes up to cch alphabet indices to the output; returns the number written
+	virtual size_type apply(operand_type front, operand_type back, size_type cb, const map_t& map, index_type* out, size_type cch) const {
+		return emit( front, back, cb, map.indices( ), map_t::reject_index, out, cch );
+	}
+
+	virtual XORVex vex() const {
+		return XORVexNONE;
+	}
+
+protected:
+	template <typename T>
+	static size_type emit(operand_type front, operand_type back, size_type cb, const T* table, T reject, T* out, size_type cch) {
+
+		size_type n = 0;
+		for (decltype(cb) i = 0; (i < cb) && (n < cch); ++i){
+			const T value = table[*(front + i) ^ *(back + i)];
+			*(out + n) = value;
+			n += (value != reject) ? 1 : 0;
+		}
+		return n;
+	}
+};
+
+// Removes duplicates from a run of alphabet indices: those which repeat an earlier
+// index in the run, and those which are already set in the given bitset. The
+// survivors are copied to the output, in order (the output may alias the input, or
+// else must have room for all of it), and set in the bitset. N.B. the indices must
+// not include map_t::reject_index, which the vector kernels use as a sentinel
+class dedupe_t {
+public:
+	typedef size_t size_type;
+	typedef map_t::index_type index_type;
+	typedef bitset_t<map_t::max_size + 1> bitset_type;
+
+	// Returns the number of indices written to the output
+	virtual size_type apply(bitset_type& seen, const index_type* indices, size_type count, index_type* out) const {
+		return seen.test_and_set( indices, count, out );
+	}
+
+	virtual XORVex vex() const {
+		return XORVexNONE;
+	}
+};
+
+// Renders raw bytes as text in one of the token encodings, and (random) bytes as UUIDs; the vector
+// kernels accelerate base16, base64 and UUIDs, falling back on the scalar reference for the rest
+class encode_t {
+public:
+	typedef size_t size_type;
+	typedef const unsigned char* operand_type;
+	typedef char char_type;
+
+	// Returns the most characters which the given number of bytes can encode to
+	static size_type encoded_size(Encoding encoding, size_type cb) {
+
+		switch (encoding){
+			case EncodingBASE16:
+				return (cb * 2);
+
+			case EncodingBASE32:
+				return (((cb + 4) / 5) * 8);
+
+			case EncodingBASE58:
+				// log(256) / log(58) is just under 1.3658
+				return (((cb * 1366) + 999) / 1000);
+
+			case EncodingBASE64:
+				return (((cb + 2) / 3) * 4);
+
+			case EncodingBASE64URL:
+				return (((cb * 4) + 2) / 3);
+
+			default:
+				break;
+		}
+		return 0;
+	}
+
+	// Writes the encoding of the given bytes to the output, which must have room for
+	// encoded_size characters (and isn't terminated); returns the number written
+	virtual size_type apply(Encoding encoding, operand_type in, size_type cb, char_type* out) const {
+		return encode( encoding, in, cb, out );
+	}
+
+	// The size of a UUID, and the length of its canonical (8-4-4-4-12, lower-case hex) text
+	static const size_type uuid_size = 16;
+	static const size_type uuid_chars = 36;
+
+	// Sets the version (4 or 7) and variant bits of the given (random) UUIDs, in place; for version 7,
+	// also writes the given Unix time, in milliseconds, and a 42-bit counter (after RFC 9562, 6.2, method 1)
+	// which starts from the given value and increments across the UUIDs, so that they sort as they're given
+	virtual void stamp_uuids(unsigned char* uuids, size_type count, unsigned version, unsigned long long ms, unsigned long long counter) const {
+		stamp( uuids, count, version, ms, counter );
+	}
+
+	// Writes the canonical text of each of the given UUIDs, followed by the given delimiter, to the output,
+	// which must have room for (uuid_chars + 1) characters per UUID; returns the number written
+	virtual size_type format_uuids(operand_type uuids, size_type count, char_type delimiter, char_type* out) const {
+		return format( uuids, count, delimiter, out );
+	}
+
+	virtual XORVex vex() const {
+		return XORVexNONE;
+	}
+
+protected:
+	static size_type encode(Encoding, operand_type, size_type, char_type*);
+
+	static void stamp(unsigned char*, size_type, unsigned, unsigned long long, unsigned long long);
+	static void stamp_times(unsigned char*, size_type, unsigned long long, unsigned long long);
+	static size_type format(operand_type, size_type, char_type, char_type*);
+
+	static size_type base16(operand_type, size_type, char_type*);
+	static size_type base32(operand_type, size_type, char_type*);
+	static size_type base58(operand_type, size_type, char_type*);
+	static size_type base64(operand_type, size_type, char_type*, bool);
+};
+
 // Functions
 //
 
@@ -166,4 +465,26 @@ public:
 // of byte buffers using the widest-available vector extensions
 std::unique_ptr<xor_t> get_vex_xor(void);
 
+// Returns an object which can be used to combine, map and emit pairs
+// of byte buffers using the widest-available vector extensions
+std::unique_ptr<emit_t> get_vex_emit(void);
+
+// Returns an object which can be used to remove duplicates from runs of
+// alphabet indices using the widest-available vector extensions
+std::unique_ptr<dedupe_t> get_vex_dedupe(void);
+
+// Returns an object which can be used to encode raw bytes as tokens
+// using the widest-available vector extensions
+std::unique_ptr<encode_t> get_vex_encode(void);
+
+// Returns a readable name for the given vector extensions
+const char* get_vex_name(XORVex);
+
+// Return every implementation of the respective kernel which can run
+// on the current hardware, starting with the scalar reference
+std::vector<std::unique_ptr<xor_t>> get_all_xor(void);
+std::vector<std::unique_ptr<emit_t>> get_all_emit(void);
+std::vector<std::unique_ptr<dedupe_t>> get_all_dedupe(void);
+std::vector<std::unique_ptr<encode_t>> get_all_encode(void);
+
 #endif // __BITOPS_H__
@@ -0,0 +1,205 @@
+// CpuFeatures.cpp: defines the implementation for detecting the features of
+//					the CPU (and OS) on which we're running
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+// Includes
+//
+
+// N.B. This file is also built into the (portable) benchmarks,
+// so it doesn't use the application's precompiled headers
+
+// Windows Headers
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__aarch64__)
+#include <sys/auxv.h>
+#endif // defined(_WIN32)
+
+// C++ Standard Library Headers
+#include <array>
+#include <vector>
+#include <algorithm>
+
+// Intrinsics Headers
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif // defined(_MSC_VER)
+
+// Declarations
+#include "CpuFeatures.h"
+
+// Macros
+//
+
+#if defined(_M_ARM64) || defined(__aarch64__)
+#define CPU_FEATURES_ARM64
+#elif defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CPU_FEATURES_X86
+#endif
+
+// Older SDKs (and C libraries) predate some of the features we look for
+#if defined(_WIN32)
+#if !defined(PF_ARM_SVE_INSTRUCTIONS_AVAILABLE)
+#define PF_ARM_SVE_INSTRUCTIONS_AVAILABLE 46
+#endif
+#if !defined(PF_ARM_SHA3_INSTRUCTIONS_AVAILABLE)
+#define PF_ARM_SHA3_INSTRUCTIONS_AVAILABLE 64
+#endif
+#elif defined(__aarch64__)
+#if !defined(HWCAP_ASIMD)
+#define HWCAP_ASIMD (1 << 1)
+#endif
+#if !defined(HWCAP_AES)
+#define HWCAP_AES (1 << 3)
+#endif
+#if !defined(HWCAP_SHA3)
+#define HWCAP_SHA3 (1 << 17)
+#endif
+#if !defined(HWCAP_SVE)
+#define HWCAP_SVE (1 << 22)
+#endif
+#endif // defined(_WIN32)
+
+// Functions
+//
+
+#if defined(CPU_FEATURES_X86)
+// Executes CPUID for the given leaf (and sub-leaf)
+static inline void cpuid(int info[4], int leaf, int subleaf = 0) {
+#if defined(_MSC_VER)
+	__cpuidex( info, leaf, subleaf );
+#else
+	__cpuid_count( leaf, subleaf, info[0], info[1], info[2], info[3] );
+#endif // defined(_MSC_VER)
+}
+
+// Reads the given extended control register; only valid when the OS has set OSXSAVE
+static inline unsigned long long xgetbv(unsigned int index) {
+#if defined(_MSC_VER)
+	return _xgetbv( index );
+#else
+	unsigned int eax = 0, edx = 0;
+	__asm__ __volatile__ ( "xgetbv" : "=a" ( eax ), "=d" ( edx ) : "c" ( index ) );
+	return (static_cast<unsigned long long>( edx ) << 32) | eax;
+#endif // defined(_MSC_VER)
+}
+
+// Given the output of CPUID, returns the name of the CPU vendor in a string
+static std::string get_cpu_vendor(int info[]) {
+
+	std::string name;
+	std::array<int, 3> indices = { 1, 3, 2 };
+	std::for_each( indices.cbegin( ), indices.cend( ), [&](int offset) {
+		auto ptr = reinterpret_cast<char*>( info + offset );
+		for (size_t i = 0; i < sizeof( int ); ++i){
+			name.append( 1, *(ptr + i) );
+		}
+	} );
+	return name;
+}
+#endif // defined(CPU_FEATURES_X86)
+
+cpu_features_t cpu_features_t::detect(void) {
+
+	cpu_features_t features;
+#if defined(CPU_FEATURES_X86)
+	// Get the vendor, and the highest leaf we can ask about; we don't filter on
+	// the vendor (Hygon, Zhaoxin, VIA etc. set the same bits as Intel and AMD)
+	int info[4] = { -1, -1, -1, -1 };
+	cpuid( info, 0 );
+	const int leaves = info[0];
+	features.vendor = get_cpu_vendor( info );
+	if (leaves < 1){
+		return features;
+	}
+
+	// Query for the basic feature flags
+	cpuid( info, 1 );
+	const auto ecx = static_cast<unsigned int>( info[2] );
+	const auto edx = static_cast<unsigned int>( info[3] );
+	features.mmx = (edx & (1U << 23)) != 0;
+	features.sse = (edx & (1U << 25)) != 0;
+	features.sse2 = (edx & (1U << 26)) != 0;
+	features.sse3 = (ecx & (1U << 0)) != 0;
+	features.ssse3 = (ecx & (1U << 9)) != 0;
+	features.sse41 = (ecx & (1U << 19)) != 0;
+	features.sse42 = (ecx & (1U << 20)) != 0;
+	features.aesni = (ecx & (1U << 25)) != 0;
+	features.rdrand = (ecx & (1U << 30)) != 0;
+
+	// The wider registers are only usable if the OS saves (all of) them on a
+	// context switch, c.f. http://software.intel.com/en-us/blogs/2011/04/14/is-avx-enabled/
+	const bool os_uses_XSAVE = (ecx & (1U << 27)) != 0;
+	const unsigned long long xcr0 = os_uses_XSAVE ? xgetbv( 0 ) : 0; // XCR0, a.k.a. _XCR_XFEATURE_ENABLED_MASK
+	const bool os_saves_YMM = (xcr0 & 0x6) == 0x6; // XMM, YMM
+	const bool os_saves_ZMM = (xcr0 & 0xE6) == 0xE6; // ..plus opmask, ZMM0-15 (upper), ZMM16-31
+	features.avx = os_saves_YMM && ((ecx & (1U << 28)) != 0);
+
+	// Query for the extended feature flags
+	if (leaves >= 7){
+		cpuid( info, 7, 0 );
+		const auto ebx = static_cast<unsigned int>( info[1] );
+		features.avx2 = features.avx && ((ebx & (1U << 5)) != 0);
+		features.avx512f = os_saves_ZMM && ((ebx & (1U << 16)) != 0);
+		features.avx512cd = features.avx512f && ((ebx & (1U << 28)) != 0);
+		features.avx512bw = features.avx512f && ((ebx & (1U << 30)) != 0);
+		features.avx512vl = features.avx512f && ((ebx & (1U << 31)) != 0);
+		features.rdseed = (ebx & (1U << 18)) != 0;
+		features.sha = (ebx & (1U << 29)) != 0;
+	}
+#elif defined(CPU_FEATURES_ARM64)
+#if defined(_WIN32)
+	// NEON is mandatory on Windows on ARM; ask anyway
+	features.neon = IsProcessorFeaturePresent( PF_ARM_NEON_INSTRUCTIONS_AVAILABLE ) != FALSE;
+	features.arm_aes = IsProcessorFeaturePresent( PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE ) != FALSE;
+	features.arm_sha3 = IsProcessorFeaturePresent( PF_ARM_SHA3_INSTRUCTIONS_AVAILABLE ) != FALSE;
+	features.sve = IsProcessorFeaturePresent( PF_ARM_SVE_INSTRUCTIONS_AVAILABLE ) != FALSE;
+#else
+	const unsigned long hwcap = getauxval( AT_HWCAP );
+	features.neon = (hwcap & HWCAP_ASIMD) != 0;
+	features.arm_aes = (hwcap & HWCAP_AES) != 0;
+	features.arm_sha3 = (hwcap & HWCAP_SHA3) != 0;
+	features.sve = (hwcap & HWCAP_SVE) != 0;
+#endif // defined(_WIN32)
+	features.vendor = "ARM64";
+#endif // defined(CPU_FEATURES_X86)
+	return features;
+}
+
+std::string cpu_features_t::describe(void) const {
+
+	const std::vector<std::pair<bool, const char*>> names = {
+		{ sse2, "SSE2" }, { ssse3, "SSSE3" }, { sse41, "SSE4.1" }, { sse42, "SSE4.2" },
+		{ avx, "AVX" }, { avx2, "AVX2" },
+		{ avx512f, "AVX-512F" }, { avx512cd, "AVX-512CD" }, { avx512bw, "AVX-512BW" }, { avx512vl, "AVX-512VL" },
+		{ aesni, "AES-NI" }, { sha, "SHA" }, { rdrand, "RDRAND" }, { rdseed, "RDSEED" },
+		{ neon, "NEON" }, { arm_aes, "AES" }, { arm_sha3, "SHA3" }, { sve, "SVE" }
+	};
+
+	std::string description = vendor.empty( ) ? std::string( "Unknown CPU" ) : vendor;
+	description.append( ":" );
+	bool any = false;
+	std::for_each( names.cbegin( ), names.cend( ), [&](const std::pair<bool, const char*>& name) {
+		if (name.first){
+			description.append( " " ).append( name.second );
+			any = true;
+		}
+	} );
+	if (!any){
+		description.append( " (no extensions)" );
+	}
+	return description;
+}
+
+const cpu_features_t& get_cpu_features(void) {
+
+	// Initialised exactly once, on the first call, even if that's made from multiple threads
+	static const cpu_features_t features = cpu_features_t::detect( );
+	return features;
+}
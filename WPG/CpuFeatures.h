@@ -0,0 +1,68 @@
+// CpuFeatures.h: declares the interface for detecting the features of the CPU
+//				  (and OS) on which we're running
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__CPU_FEATURES_H__)
+#define __CPU_FEATURES_H__
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <string>
+
+// Classes
+//
+
+// Describes the features of the CPU which we can use, having checked
+// that the OS also supports them (e.g. by saving the wider registers)
+class cpu_features_t {
+public:
+	cpu_features_t(void) = default;
+
+	// The vendor string reported by CPUID, if any
+	std::string vendor;
+
+	// x86/x64
+	bool mmx = false;
+	bool sse = false;
+	bool sse2 = false;
+	bool sse3 = false;
+	bool ssse3 = false;
+	bool sse41 = false;
+	bool sse42 = false;
+	bool avx = false;
+	bool avx2 = false;
+	bool avx512f = false;
+	bool avx512cd = false;
+	bool avx512bw = false;
+	bool avx512vl = false;
+	bool aesni = false;
+	bool sha = false;
+	bool rdrand = false;
+	bool rdseed = false;
+
+	// ARM64
+	bool neon = false;
+	bool arm_aes = false;
+	bool arm_sha3 = false;
+	bool sve = false;
+
+	// Returns a short, human-readable summary of the features
+	std::string describe(void) const;
+
+	// Queries the hardware; prefer get_cpu_features (below), which caches the result
+	static cpu_features_t detect(void);
+};
+
+// Functions
+//
+
+// Returns the features of the current CPU; these are detected on the first call
+// (which should be made at startup) and are the same for the life of the process
+const cpu_features_t& get_cpu_features(void);
+
+#endif // !defined(__CPU_FEATURES_H__)
@@ -13,6 +13,9 @@
 // Cryptographic API Headers
 #include <wincrypt.h>
 
+// Local Project Headers
+#include "CpuFeatures.h"
+
 // Declarations
 #include "WPGAboutEtc.h"
 
@@ -99,6 +102,14 @@ BOOL OnInitAboutDialog(HWND hDlg, WPARAM WParam, LPARAM lParam) {
 			uID = IDS_USING_VEX_AVX;
 			break;
 
+		case XORVexAVX2:
+			uID = IDS_USING_VEX_AVX2;
+			break;
+
+		case XORVexAVX512:
+			uID = IDS_USING_VEX_AVX512;
+			break;
+
 		case XORVexNEON:
 			uID = IDS_USING_VEX_ARM_NEON;
 			break;
@@ -115,6 +126,10 @@ BOOL OnInitAboutDialog(HWND hDlg, WPARAM WParam, LPARAM lParam) {
 		? IDS_TPM_VERSION_20
 		: ((caps & WPGCapTPM12) ? IDS_TPM_VERSION_12 : 0);
 	SetAboutStringMaybe( hDlg, IDC_TPM_VERSION, uID );
+
+	// Summarise the features of the CPU (which are plain ASCII)
+	const std::string features = get_cpu_features( ).describe( );
+	SetDlgItemTextA( hDlg, IDC_CPU_FEATURES, features.c_str( ) );
 	return TRUE;
 }
 
@@ -32,6 +32,9 @@ typedef struct _UIState {
 
 	WPG_H wpgHandle;
 
+	// Set while a UWM_REFRESH is waiting in the dialog's queue
+	BOOL fRefreshPending;
+
 } UIState, *UIStatePtr;
 
 // Functions
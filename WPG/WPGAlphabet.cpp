@@ -0,0 +1,424 @@
+// WPGAlphabet.cpp: gives the implementation for generating passwords from large alphabets.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// wpg_t::Generate maps each byte of raw output onto a character, so it can't draw from more than
+// 255 of them, nor from any beyond the BMP. Here, an alphabet is compiled into a sorted table of
+// its distinct code points, four bytes apiece (so even the largest takes 4MB), and each index is
+// drawn from as many bytes as leave at least eight bits over the alphabet's size, so that the
+// values rejected to keep it unbiased (i.e. at or past the last whole multiple of the size) are
+// fewer than one in 256. Each password draws the bytes for all of its symbols, and one over, in
+// a fill; the symbols are then written out directly, as UTF-16 or UTF-8, without conversion.
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// C++ Standard Library Headers
+#include <algorithm>
+#include <new>
+
+// Declarations
+#include "WPGAlphabet.h"
+
+// Constants
+//
+
+// The bytes of raw output drawn from the sources at a time; a whole number of indices of any size
+constexpr SIZE_T c_cbAlphabetEntropy = 0xF0;
+
+// The most symbols in a password
+constexpr SIZE_T c_cMaxAlphabetSymbols = 0xFF;
+
+// Returned for an alphabet which isn't well-formed
+constexpr SIZE_T c_cAlphabetInvalid = static_cast<SIZE_T>( -1 );
+
+// Types
+//
+
+typedef struct _WPG_ALPHABET_INSTANCE {
+
+	// The code points, in ascending order
+	LPDWORD lpCodePoints;
+	DWORD cSymbols;
+
+	// The most any one symbol takes in UTF-16 (characters) and UTF-8 (bytes)
+	BYTE cchMaxUtf16;
+	BYTE cbMaxUtf8;
+
+	// The bytes drawn for each index, and the (exclusive) upper bound on the values accepted, i.e. 256^cbIndex - (256^cbIndex % cSymbols)
+	BYTE cbIndex;
+	ULONG64 ullLimit;
+
+} WPG_ALPHABET_INSTANCE, *PWPG_ALPHABET_INSTANCE;
+
+// Gives the raw output from which indices are drawn, and how much of it has been taken
+typedef struct _WPG_ALPHABET_DRAW {
+
+	BYTE bEntropy[c_cbAlphabetEntropy];
+	SIZE_T cbDrawn;
+	SIZE_T cbTaken;
+
+} WPG_ALPHABET_DRAW, *PWPG_ALPHABET_DRAW;
+
+// Functions
+//
+
+// Returns TRUE if the given code point is to be left out of an alphabet
+static inline BOOL WPGAlphabetSkip(__in DWORD dwCodePoint) {
+	return (dwCodePoint == 0) || (dwCodePoint == '\r') || (dwCodePoint == '\n') || (dwCodePoint == 0xFEFF);
+}
+
+static inline BOOL WPGAlphabetIsHighSurrogate(__in WCHAR wc) {
+	return (wc >= 0xD800) && (wc <= 0xDBFF);
+}
+
+static inline BOOL WPGAlphabetIsLowSurrogate(__in WCHAR wc) {
+	return (wc >= 0xDC00) && (wc <= 0xDFFF);
+}
+
+// Decodes the given UTF-16 into the given buffer (if any); returns the number of code points, or c_cAlphabetInvalid
+static SIZE_T WPGAlphabetDecode(__in_ecount(cch) LPCWSTR psz, __in SIZE_T cch, __out_opt LPDWORD lpCodePoints) {
+
+	SIZE_T cCodePoints = 0;
+	for (SIZE_T n = 0; n < cch; n++){
+		DWORD dwCodePoint = psz[n];
+		if (WPGAlphabetIsHighSurrogate( psz[n] )){
+			if (((n + 1) == cch) || !WPGAlphabetIsLowSurrogate( psz[n + 1] )){
+				return c_cAlphabetInvalid;
+			}
+			dwCodePoint = 0x10000 + ((dwCodePoint - 0xD800) << 10) + (psz[++n] - 0xDC00);
+		}else if (WPGAlphabetIsLowSurrogate( psz[n] )){
+			return c_cAlphabetInvalid;
+		}
+		if (!WPGAlphabetSkip( dwCodePoint )){
+			if (lpCodePoints){
+				lpCodePoints[cCodePoints] = dwCodePoint;
+			}
+			cCodePoints++;
+		}
+	}
+	return cCodePoints;
+}
+
+// Decodes the given UTF-8 into the given buffer (if any); returns the number of code points, or c_cAlphabetInvalid
+// if there are any overlong sequences, surrogates or values beyond U+10FFFF
+static SIZE_T WPGAlphabetDecode(__in_bcount(cb) LPCSTR psz, __in SIZE_T cb, __out_opt LPDWORD lpCodePoints) {
+
+	static const DWORD c_dwLeast[] = { 0, 0x80, 0x800, 0x10000 };
+
+	const BYTE* pb = reinterpret_cast<const BYTE*>( psz );
+	SIZE_T cCodePoints = 0;
+	for (SIZE_T n = 0; n < cb; ){
+		const BYTE bLead = pb[n++];
+		DWORD dwCodePoint = bLead;
+		SIZE_T cTrail = 0;
+		if (bLead >= 0xF0){
+			dwCodePoint &= 0x07;
+			cTrail = 3;
+		}else if (bLead >= 0xE0){
+			dwCodePoint &= 0x0F;
+			cTrail = 2;
+		}else if (bLead >= 0xC0){
+			dwCodePoint &= 0x1F;
+			cTrail = 1;
+		}else if (bLead >= 0x80){
+			return c_cAlphabetInvalid;
+		}
+		if ((bLead >= 0xF8) || ((cb - n) < cTrail)){
+			return c_cAlphabetInvalid;
+		}
+		for (SIZE_T t = 0; t < cTrail; t++){
+			const BYTE bTrail = pb[n++];
+			if ((bTrail & 0xC0) != 0x80){
+				return c_cAlphabetInvalid;
+			}
+			dwCodePoint = (dwCodePoint << 6) | (bTrail & 0x3F);
+		}
+		if ((dwCodePoint < c_dwLeast[cTrail]) || (dwCodePoint > 0x10FFFF) || ((dwCodePoint >= 0xD800) && (dwCodePoint <= 0xDFFF))){
+			return c_cAlphabetInvalid;
+		}
+		if (!WPGAlphabetSkip( dwCodePoint )){
+			if (lpCodePoints){
+				lpCodePoints[cCodePoints] = dwCodePoint;
+			}
+			cCodePoints++;
+		}
+	}
+	return cCodePoints;
+}
+
+// Compiles the given alphabet, in either encoding
+template <typename T>
+static WPG_ALPHABET_H WPGAlphabetCompile(__in_ecount(cAlphabet) const T* pAlphabet, __in SIZE_T cAlphabet) {
+
+	if (pAlphabet == NULL){
+		SetLastError( ERROR_INVALID_PARAMETER );
+		return NULL;
+	}
+	const SIZE_T cCodePoints = WPGAlphabetDecode( pAlphabet, cAlphabet, NULL );
+	if ((cCodePoints == c_cAlphabetInvalid) || (cCodePoints == 0)){
+		SetLastError( (cCodePoints == 0) ? ERROR_INVALID_DATA : ERROR_NO_UNICODE_TRANSLATION );
+		return NULL;
+	}
+	PWPG_ALPHABET_INSTANCE pInstance = static_cast<PWPG_ALPHABET_INSTANCE>(
+		PH_ALLOC( sizeof( WPG_ALPHABET_INSTANCE ) )
+	);
+	if (pInstance == NULL){
+		SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+		return NULL;
+	}
+	new (pInstance) WPG_ALPHABET_INSTANCE( );
+	pInstance->lpCodePoints = static_cast<LPDWORD>( PH_ALLOC( sizeof( DWORD ) * cCodePoints ) );
+	if (pInstance->lpCodePoints == NULL){
+		CloseWPGAlphabet( reinterpret_cast<WPG_ALPHABET_H>( pInstance ) );
+		SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+		return NULL;
+	}
+
+	// Decode, then sort out the duplicates
+	WPGAlphabetDecode( pAlphabet, cAlphabet, pInstance->lpCodePoints );
+	std::sort( pInstance->lpCodePoints, pInstance->lpCodePoints + cCodePoints );
+	const SIZE_T cSymbols = static_cast<SIZE_T>( std::unique( pInstance->lpCodePoints, pInstance->lpCodePoints + cCodePoints ) - pInstance->lpCodePoints );
+	if (cSymbols > WPG_ALPHABET_MAX){
+		CloseWPGAlphabet( reinterpret_cast<WPG_ALPHABET_H>( pInstance ) );
+		SetLastError( ERROR_INVALID_DATA );
+		return NULL;
+	}
+	pInstance->cSymbols = static_cast<DWORD>( cSymbols );
+
+	// The largest code point is the longest in both encodings
+	const DWORD dwLargest = pInstance->lpCodePoints[cSymbols - 1];
+	pInstance->cchMaxUtf16 = (dwLargest >= 0x10000) ? 2 : 1;
+	pInstance->cbMaxUtf8 = (dwLargest >= 0x10000) ? 4 : ((dwLargest >= 0x800) ? 3 : ((dwLargest >= 0x80) ? 2 : 1));
+
+	// Take enough bytes for each index that no more than one value in 256 is rejected
+	pInstance->cbIndex = 1;
+	while ((1ULL << (8 * pInstance->cbIndex)) < (256ULL * cSymbols)){
+		pInstance->cbIndex++;
+	}
+	const ULONG64 ullRange = 1ULL << (8 * pInstance->cbIndex);
+	pInstance->ullLimit = ullRange - (ullRange % cSymbols);
+	return reinterpret_cast<WPG_ALPHABET_H>( pInstance );
+}
+
+BOOL WPGAlphabetNeeded(__in_ecount(cchAlphabet) LPCWSTR pszAlphabet, __in SIZE_T cchAlphabet) {
+
+	if (cchAlphabet > 0xFF){
+		return TRUE;
+	}
+	for (SIZE_T n = 0; (n < cchAlphabet) && pszAlphabet; n++){
+		if (WPGAlphabetIsHighSurrogate( pszAlphabet[n] ) || WPGAlphabetIsLowSurrogate( pszAlphabet[n] )){
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+WPG_ALPHABET_H CompileWPGAlphabet(__in_ecount(cchAlphabet) LPCWSTR pszAlphabet, __in SIZE_T cchAlphabet) {
+
+	return WPGAlphabetCompile( pszAlphabet, cchAlphabet );
+}
+
+WPG_ALPHABET_H CompileWPGAlphabetUtf8(__in_bcount(cbAlphabet) LPCSTR pszAlphabet, __in SIZE_T cbAlphabet) {
+
+	return WPGAlphabetCompile( pszAlphabet, cbAlphabet );
+}
+
+WPG_ALPHABET_H LoadWPGAlphabet(__in_z LPCWSTR pszPath) {
+
+	HANDLE hFile = CreateFileW( pszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if (hFile == INVALID_HANDLE_VALUE){
+		return NULL;
+	}
+
+	// The table is taken from the view, so it's done with as soon as it's compiled; (and an empty file can't be mapped)
+	WPG_ALPHABET_H hAlphabet = NULL;
+	LARGE_INTEGER size = { 0 };
+	if (!GetFileSizeEx( hFile, &size )){
+		// Leave the last error as it is
+	}else if ((size.QuadPart == 0) || (size.QuadPart > MAXDWORD)){
+		SetLastError( (size.QuadPart == 0) ? ERROR_INVALID_DATA : ERROR_FILE_TOO_LARGE );
+	}else{
+		HANDLE hMapping = CreateFileMappingW( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+		LPCSTR pszView = (hMapping) ? static_cast<LPCSTR>( MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 ) ) : NULL;
+		if (pszView){
+			hAlphabet = CompileWPGAlphabetUtf8( pszView, static_cast<SIZE_T>( size.QuadPart ) );
+		}
+		const DWORD dwError = GetLastError( );
+		if (pszView){
+			UnmapViewOfFile( pszView );
+		}
+		if (hMapping){
+			CloseHandle( hMapping );
+		}
+		SetLastError( dwError );
+	}
+	const DWORD dwError = GetLastError( );
+	CloseHandle( hFile );
+	SetLastError( dwError );
+	return hAlphabet;
+}
+
+DWORD GetWPGAlphabetSize(__in WPG_ALPHABET_H wpgAlphabetHandle) {
+
+	return reinterpret_cast<PWPG_ALPHABET_INSTANCE>( wpgAlphabetHandle )->cSymbols;
+}
+
+BYTE GetWPGAlphabetUnits(__in WPG_ALPHABET_H wpgAlphabetHandle) {
+
+	return reinterpret_cast<PWPG_ALPHABET_INSTANCE>( wpgAlphabetHandle )->cchMaxUtf16;
+}
+
+// Draws the index of a symbol, from the given raw output, filling it from the given generator's sources as needed (with
+// enough for the given number of symbols still to be drawn, and one over); returns FALSE if they failed
+static BOOL WPGAlphabetIndex(__in const WPG_ALPHABET_INSTANCE* pInstance, __inout PWPG_ALPHABET_DRAW pDraw, __in SIZE_T cRemaining, __in wpg_t& wpg, __in WPGCaps wpgCaps, __in_opt PCWPG_CANCEL pCancel, __in_opt PCWPG_DEADLINE pDeadline, __out LPDWORD pdwIndex, __inout WPGCaps* pwpgCapsFailed) {
+
+	*pdwIndex = 0;
+	if (pInstance->cSymbols < 2){
+		return TRUE;
+	}
+	const SIZE_T cbIndex = pInstance->cbIndex;
+	for (;;){
+		if (pDraw->cbTaken == pDraw->cbDrawn){
+			const SIZE_T cbDraw = min( c_cbAlphabetEntropy, (cRemaining + 1) * cbIndex );
+			*pwpgCapsFailed |= wpg.Entropy( pDraw->bEntropy, static_cast<BYTE>( cbDraw ), wpgCaps, pCancel, pDeadline );
+			if (!WPGSucceeded( *pwpgCapsFailed )){
+				return FALSE;
+			}
+			pDraw->cbDrawn = cbDraw;
+			pDraw->cbTaken = 0;
+		}
+		DWORD dwValue = 0;
+		for (SIZE_T b = 0; b < cbIndex; b++){
+			dwValue = (dwValue << 8) | pDraw->bEntropy[pDraw->cbTaken++];
+		}
+		if (dwValue < pInstance->ullLimit){
+			*pdwIndex = dwValue % pInstance->cSymbols;
+			return TRUE;
+		}
+	}
+}
+
+// Writes the given code point as UTF-16; returns the number of characters written
+static inline SIZE_T WPGAlphabetEncode(__in DWORD dwCodePoint, __out LPWSTR psz) {
+
+	if (dwCodePoint < 0x10000){
+		psz[0] = static_cast<WCHAR>( dwCodePoint );
+		return 1;
+	}
+	dwCodePoint -= 0x10000;
+	psz[0] = static_cast<WCHAR>( 0xD800 | (dwCodePoint >> 10) );
+	psz[1] = static_cast<WCHAR>( 0xDC00 | (dwCodePoint & 0x3FF) );
+	return 2;
+}
+
+// Writes the given code point as UTF-8; returns the number of bytes written
+static inline SIZE_T WPGAlphabetEncode(__in DWORD dwCodePoint, __out LPSTR psz) {
+
+	if (dwCodePoint < 0x80){
+		psz[0] = static_cast<CHAR>( dwCodePoint );
+		return 1;
+	}
+	if (dwCodePoint < 0x800){
+		psz[0] = static_cast<CHAR>( 0xC0 | (dwCodePoint >> 6) );
+		psz[1] = static_cast<CHAR>( 0x80 | (dwCodePoint & 0x3F) );
+		return 2;
+	}
+	if (dwCodePoint < 0x10000){
+		psz[0] = static_cast<CHAR>( 0xE0 | (dwCodePoint >> 12) );
+		psz[1] = static_cast<CHAR>( 0x80 | ((dwCodePoint >> 6) & 0x3F) );
+		psz[2] = static_cast<CHAR>( 0x80 | (dwCodePoint & 0x3F) );
+		return 3;
+	}
+	psz[0] = static_cast<CHAR>( 0xF0 | (dwCodePoint >> 18) );
+	psz[1] = static_cast<CHAR>( 0x80 | ((dwCodePoint >> 12) & 0x3F) );
+	psz[2] = static_cast<CHAR>( 0x80 | ((dwCodePoint >> 6) & 0x3F) );
+	psz[3] = static_cast<CHAR>( 0x80 | (dwCodePoint & 0x3F) );
+	return 4;
+}
+
+// Generates a password into the given buffer, in either encoding, where no symbol takes more than the given number of units
+template <typename T>
+static WPGCaps WPGAlphabetGenerateAs(__in WPG_ALPHABET_H wpgAlphabetHandle, __in wpg_t& wpg, __out T* pszBuffer, __in BYTE cSymbols, __in BOOL fDuplicatesAllowed, __out_opt PSIZE_T pcchWritten, __in WPGCaps wpgCaps, __in_opt PCWPG_CANCEL pCancel, __in_opt PCWPG_DEADLINE pDeadline, __in BYTE cMaxUnits) {
+
+	const PWPG_ALPHABET_INSTANCE pInstance = reinterpret_cast<PWPG_ALPHABET_INSTANCE>( wpgAlphabetHandle );
+	if (cSymbols == 0){
+		pszBuffer[0] = 0;
+		if (pcchWritten){
+			*pcchWritten = 0;
+		}
+		return WPGCapNOSOURCE;
+	}
+	if (!fDuplicatesAllowed && (cSymbols > pInstance->cSymbols)){
+		cSymbols = static_cast<BYTE>( pInstance->cSymbols );
+	}
+
+	// Draw the indices, redrawing any repeats (if they're not allowed); everything is on the stack, so
+	// that concurrent calls share no scratch
+	WPG_ALPHABET_DRAW draw = { 0 };
+	DWORD dwIndices[c_cMaxAlphabetSymbols] = { 0 };
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	BOOL fDrawn = TRUE;
+	for (BYTE b = 0; (b < cSymbols) && fDrawn; ){
+		DWORD dwIndex = 0;
+		fDrawn = WPGAlphabetIndex( pInstance, &draw, cSymbols - b, wpg, wpgCaps, pCancel, pDeadline, &dwIndex, &wpgCapsFailed );
+		BOOL fRepeat = FALSE;
+		for (BYTE r = 0; (r < b) && !fDuplicatesAllowed && !fRepeat; r++){
+			fRepeat = (dwIndices[r] == dwIndex);
+		}
+		if (!fRepeat){
+			dwIndices[b++] = dwIndex;
+		}
+	}
+
+	// Then write out their symbols
+	SIZE_T cch = 0;
+	for (BYTE b = 0; (b < cSymbols) && fDrawn; b++){
+		cch += WPGAlphabetEncode( pInstance->lpCodePoints[dwIndices[b]], pszBuffer + cch );
+	}
+	SecureZeroMemory( &draw, sizeof( draw ) );
+	SecureZeroMemory( dwIndices, sizeof( dwIndices ) );
+
+	if (!fDrawn){
+		SecureZeroMemory( pszBuffer, sizeof( T ) * ((static_cast<SIZE_T>( cSymbols ) * cMaxUnits) + 1U) );
+		cch = 0;
+	}else{
+		pszBuffer[cch] = 0;
+	}
+	if (pcchWritten){
+		*pcchWritten = cch;
+	}
+	return wpgCapsFailed;
+}
+
+WPGCaps WPGAlphabetGenerate(__in WPG_ALPHABET_H wpgAlphabetHandle, __in wpg_t& wpg, __out LPWSTR pszBuffer, __in BYTE cSymbols, __in BOOL fDuplicatesAllowed, __out_opt PSIZE_T pcchWritten, __in WPGCaps wpgCaps, __in_opt PCWPG_CANCEL pCancel, __in_opt PCWPG_DEADLINE pDeadline) {
+
+	const BYTE cMaxUnits = reinterpret_cast<PWPG_ALPHABET_INSTANCE>( wpgAlphabetHandle )->cchMaxUtf16;
+	return WPGAlphabetGenerateAs( wpgAlphabetHandle, wpg, pszBuffer, cSymbols, fDuplicatesAllowed, pcchWritten, wpgCaps, pCancel, pDeadline, cMaxUnits );
+}
+
+WPGCaps WPGAlphabetGenerateUtf8(__in WPG_ALPHABET_H wpgAlphabetHandle, __in wpg_t& wpg, __out LPSTR pszBuffer, __in BYTE cSymbols, __in BOOL fDuplicatesAllowed, __out_opt PSIZE_T pcbWritten, __in WPGCaps wpgCaps, __in_opt PCWPG_CANCEL pCancel, __in_opt PCWPG_DEADLINE pDeadline) {
+
+	const BYTE cMaxUnits = reinterpret_cast<PWPG_ALPHABET_INSTANCE>( wpgAlphabetHandle )->cbMaxUtf8;
+	return WPGAlphabetGenerateAs( wpgAlphabetHandle, wpg, pszBuffer, cSymbols, fDuplicatesAllowed, pcbWritten, wpgCaps, pCancel, pDeadline, cMaxUnits );
+}
+
+VOID CloseWPGAlphabet(__in WPG_ALPHABET_H wpgAlphabetHandle) {
+
+	PWPG_ALPHABET_INSTANCE pInstance = reinterpret_cast<PWPG_ALPHABET_INSTANCE>( wpgAlphabetHandle );
+	if (pInstance == NULL){
+		return;
+	}
+	if (pInstance->lpCodePoints){
+		SecureZeroMemory( pInstance->lpCodePoints, sizeof( DWORD ) * pInstance->cSymbols );
+		PH_FREE( pInstance->lpCodePoints );
+	}
+	pInstance->~WPG_ALPHABET_INSTANCE( );
+	SecureZeroMemory( pInstance, sizeof( WPG_ALPHABET_INSTANCE ) );
+	PH_FREE( pInstance );
+}
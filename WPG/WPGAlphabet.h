@@ -0,0 +1,73 @@
+// WPGAlphabet.h: declares the interface for generating passwords from large (and non-BMP) alphabets
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_ALPHABET_H__)
+#define __WPG_ALPHABET_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGGenerators.h"
+
+// Macros
+//
+
+DECLARE_HANDLE(WPG_ALPHABET_H);
+
+// The most distinct symbols (i.e. code points) in an alphabet
+#define WPG_ALPHABET_MAX	0x100000
+
+// The most UTF-16 characters any one symbol takes, i.e. a surrogate pair
+#define WPG_ALPHABET_UNITS_MAX	2
+
+// Functions
+//
+
+// Returns TRUE if the given alphabet is beyond what wpg_t::Generate maps, i.e. it has more than 255 characters,
+// or any (surrogate pairs) beyond the Basic Multilingual Plane, and so should be compiled (see CompileWPGAlphabet)
+BOOL WPGAlphabetNeeded(__in_ecount(cchAlphabet) LPCWSTR, __in SIZE_T cchAlphabet);
+
+// Compiles the given alphabet, in UTF-16, into a table of its distinct code points (duplicates, line breaks and byte
+// order marks are dropped). Returns NULL (with the last error set) if it isn't well-formed, e.g. ERROR_NO_UNICODE_TRANSLATION
+// for an unpaired surrogate, or ERROR_INVALID_DATA if it's empty or has more than WPG_ALPHABET_MAX symbols
+WPG_ALPHABET_H CompileWPGAlphabet(__in_ecount(cchAlphabet) LPCWSTR, __in SIZE_T cchAlphabet);
+
+// Compiles the given alphabet, in UTF-8, as CompileWPGAlphabet does
+WPG_ALPHABET_H CompileWPGAlphabetUtf8(__in_bcount(cbAlphabet) LPCSTR, __in SIZE_T cbAlphabet);
+
+// Maps the given file, and compiles the alphabet in it, in UTF-8 (see CompileWPGAlphabetUtf8); it may run
+// over any number of lines. Returns NULL (with the last error set) on failure
+WPG_ALPHABET_H LoadWPGAlphabet(__in_z LPCWSTR);
+
+// Returns the number of symbols in the given alphabet
+DWORD GetWPGAlphabetSize(__in WPG_ALPHABET_H);
+
+// Returns the most UTF-16 characters any one symbol in the given alphabet takes: one, or two if any is beyond the BMP
+BYTE GetWPGAlphabetUnits(__in WPG_ALPHABET_H);
+
+// Returns the number of symbols which fit in the given number of UTF-16 characters, at worst; that's none if
+// the alphabet has any symbols beyond the BMP, and there's room for just the one character
+inline BYTE WPGAlphabetSymbols(__in WPG_ALPHABET_H wpgAlphabetHandle, __in BYTE cchLength) {
+	return static_cast<BYTE>( cchLength / GetWPGAlphabetUnits( wpgAlphabetHandle ) );
+}
+
+// Generates a password of the given number of symbols, each drawn uniformly from the given alphabet, into the given buffer
+// as UTF-16, which must have room for (cSymbols*GetWPGAlphabetUnits) characters plus a terminator. Without duplicates, no
+// symbol is repeated (so there are no more of them than in the alphabet). Indices are drawn a few bytes at a time, from
+// fills of the raw output of the given generator's sources (see wpg_t::Entropy), rejecting the few values which would bias
+// them. Gives the characters written, less the terminator; returns as wpg_t::Generate does, in which case the buffer is zeroed,
+// or WPGCapNOSOURCE if asked for no symbols at all, rather than pass off an empty password
+WPGCaps WPGAlphabetGenerate(__in WPG_ALPHABET_H, __in wpg_t&, __out LPWSTR, __in BYTE cSymbols, __in BOOL, __out_opt PSIZE_T, __in WPGCaps, __in_opt PCWPG_CANCEL = NULL, __in_opt PCWPG_DEADLINE = NULL);
+
+// Generates a password as WPGAlphabetGenerate does, but into the given buffer as UTF-8, which must have room for
+// four bytes per symbol plus a terminator; gives the bytes written, less the terminator
+WPGCaps WPGAlphabetGenerateUtf8(__in WPG_ALPHABET_H, __in wpg_t&, __out LPSTR, __in BYTE cSymbols, __in BOOL, __out_opt PSIZE_T, __in WPGCaps, __in_opt PCWPG_CANCEL = NULL, __in_opt PCWPG_DEADLINE = NULL);
+
+// Cleans up after the given alphabet
+VOID CloseWPGAlphabet(__in WPG_ALPHABET_H);
+
+#endif // !defined(__WPG_ALPHABET_H__)
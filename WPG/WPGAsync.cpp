@@ -0,0 +1,325 @@
+// WPGAsync.cpp: gives the implementation of the awaitable interface for generating passwords.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// C++ Standard Library Headers
+#include <utility>
+
+// Declarations
+#include "WPGAsync.h"
+
+// Constants
+//
+
+// The number of jobs to keep in flight, per worker, for a batch
+constexpr DWORD c_cJobsPerWorker = 2;
+
+// Classes
+//
+
+// Gives the state of a batch, shared between the stream and its jobs in flight; the last of them to let go deletes it
+class wpg_batch_stream_t::state_t {
+public:
+	// Gives one of the jobs in flight, and the buffer it generates into
+	struct slot_t {
+		WPG_POOL_JOB job;
+		TCHAR sz[0x100];
+		state_t* pState;
+	};
+
+	state_t(WPG_POOL_H, const wpg_config_t&, SIZE_T, ::std::stop_token);
+
+	void add_ref(void) {
+		InterlockedIncrement( &m_lRefs );
+	}
+
+	void release(void) {
+		if (InterlockedDecrement( &m_lRefs ) == 0){
+			delete this;
+		}
+	}
+
+	// Submits the initial window of jobs
+	void start(void);
+
+	void cancel(void);
+
+	BOOL cancelled(void) const {
+		return (InterlockedCompareExchange( const_cast<volatile LONG*>( &m_lCancelled ), 0, 0 ) != 0);
+	}
+
+	// Returns true if there's nothing more to yield; called with the lock held
+	bool done(void) const {
+		return m_ready.empty( ) && (cancelled( ) || ((m_cUnsubmitted == 0) && (m_dwInFlight == 0)));
+	}
+
+	static VOID CALLBACK OnJobDone(PWPG_POOL_JOB, WPGCaps);
+
+	// Completes the given slot, which the pool wouldn't take, as a failure
+	void OnSubmitFailed(slot_t*);
+
+	SRWLOCK m_srw;
+	::std::deque<wpg_password_t> m_ready;
+	::std::coroutine_handle<> m_waiter;
+
+private:
+	~state_t(void) {
+		SecureZeroMemory( m_slots.get( ), sizeof( slot_t ) * m_cSlots );
+	}
+
+	volatile LONG m_lRefs;
+	volatile LONG m_lCancelled;
+
+	WPG_POOL_H m_hPool;
+	wpg_config_t m_config;
+	SIZE_T m_cUnsubmitted;
+	DWORD m_dwInFlight;
+
+	DWORD m_cSlots;
+	::std::unique_ptr<slot_t[]> m_slots;
+	::std::optional<::std::stop_callback<wpg_stop_fn_t>> m_onStop;
+};
+
+// Functions
+//
+
+void wpg_stop_fn_t::operator()(void) const noexcept {
+	InterlockedExchange( plCancelled, 1 );
+}
+
+wpg_generate_awaitable_t::wpg_generate_awaitable_t(WPG_POOL_H hPool, const wpg_config_t& config, ::std::stop_token stop):
+	m_hPool( hPool ), m_config( config ), m_stop( stop ), m_lCancelled( 0 ), m_job{ } {
+}
+
+bool wpg_generate_awaitable_t::await_suspend(::std::coroutine_handle<> handle) {
+
+	m_handle = handle;
+	m_job.pszBuffer = m_password.m_sz;
+	m_job.cchLength = m_config.cchLength;
+	m_job.wpgCaps = m_config.wpgCaps;
+	m_job.pszAlphabet = m_config.alphabet.c_str( );
+	m_job.fDuplicatesAllowed = m_config.fDuplicatesAllowed;
+	m_job.cancel.plLatest = &m_lCancelled;
+	m_job.cancel.lGeneration = 0;
+	m_job.pfnCallback = OnJobDone;
+	m_job.lpContext = this;
+	if (m_stop.stop_possible( )){
+		m_onStop.emplace( m_stop, wpg_stop_fn_t{ &m_lCancelled } );
+	}
+
+	// N.B. once submitted, the coroutine may be resumed (and this destroyed) before we return
+	if (!WPGPoolSubmit( m_hPool, &m_job )){
+		m_password.m_failed = m_config.wpgCaps;
+		return false;
+	}
+	return true;
+}
+
+wpg_password_t wpg_generate_awaitable_t::await_resume(void) {
+
+	m_onStop.reset( );
+	return m_password;
+}
+
+VOID CALLBACK wpg_generate_awaitable_t::OnJobDone(PWPG_POOL_JOB pJob, WPGCaps wpgCapsFailed) {
+
+	wpg_generate_awaitable_t* pThis = static_cast<wpg_generate_awaitable_t*>( pJob->lpContext );
+	pThis->m_password.m_cch = pJob->cchGenerated;
+	pThis->m_password.m_failed = wpgCapsFailed;
+	pThis->m_handle.resume( );
+}
+
+wpg_batch_stream_t::state_t::state_t(WPG_POOL_H hPool, const wpg_config_t& config, SIZE_T cPasswords, ::std::stop_token stop):
+	m_lRefs( 1 ), m_lCancelled( 0 ), m_hPool( hPool ), m_config( config ), m_cUnsubmitted( 0 ), m_dwInFlight( 0 ), m_cSlots( 0 ) {
+
+	InitializeSRWLock( &m_srw );
+
+	// Size the window to keep every worker busy, with another job waiting behind it
+	const SIZE_T cWindow = static_cast<SIZE_T>( GetWPGPoolSize( hPool ) ) * c_cJobsPerWorker;
+	m_cSlots = static_cast<DWORD>( min( cPasswords, cWindow ) );
+	m_cUnsubmitted = (m_cSlots > 0) ? (cPasswords - m_cSlots) : 0;
+	m_slots.reset( new slot_t[m_cSlots]( ) );
+	if (stop.stop_possible( )){
+		m_onStop.emplace( stop, wpg_stop_fn_t{ &m_lCancelled } );
+	}
+}
+
+void wpg_batch_stream_t::state_t::start(void) {
+
+	// Account for the whole window up front, since the first jobs may finish before the last are submitted
+	m_dwInFlight = m_cSlots;
+	for (DWORD dw = 0; dw < m_cSlots; dw++){
+		add_ref( );
+	}
+	for (DWORD dw = 0; dw < m_cSlots; dw++){
+		slot_t& slot = m_slots[dw];
+		slot.pState = this;
+		slot.job.pszBuffer = slot.sz;
+		slot.job.cchLength = m_config.cchLength;
+		slot.job.wpgCaps = m_config.wpgCaps;
+		slot.job.pszAlphabet = m_config.alphabet.c_str( );
+		slot.job.fDuplicatesAllowed = m_config.fDuplicatesAllowed;
+		slot.job.cancel.plLatest = &m_lCancelled;
+		slot.job.cancel.lGeneration = 0;
+		slot.job.pfnCallback = OnJobDone;
+		slot.job.lpContext = &slot;
+		if (!WPGPoolSubmit( m_hPool, &(slot.job) )){
+			OnSubmitFailed( &slot );
+		}
+	}
+}
+
+void wpg_batch_stream_t::state_t::OnSubmitFailed(slot_t* pSlot) {
+
+	// Yield a failure in its place, as the single password does, and give up on the rest, which
+	// the pool won't take either; then let go of the slot, and resume whoever's waiting
+	AcquireSRWLockExclusive( &m_srw );
+	if (!cancelled( )){
+		wpg_password_t password;
+		password.m_failed = m_config.wpgCaps;
+		m_ready.push_back( password );
+	}
+	m_cUnsubmitted = 0;
+	m_dwInFlight--;
+	const ::std::coroutine_handle<> waiter = ::std::exchange( m_waiter, nullptr );
+	ReleaseSRWLockExclusive( &m_srw );
+	SecureZeroMemory( pSlot->sz, sizeof( pSlot->sz ) );
+
+	release( );
+	if (waiter){
+		waiter.resume( );
+	}
+}
+
+void wpg_batch_stream_t::state_t::cancel(void) {
+
+	InterlockedExchange( &m_lCancelled, 1 );
+	AcquireSRWLockExclusive( &m_srw );
+	m_cUnsubmitted = 0;
+	m_ready.clear( );
+	ReleaseSRWLockExclusive( &m_srw );
+}
+
+VOID CALLBACK wpg_batch_stream_t::state_t::OnJobDone(PWPG_POOL_JOB pJob, WPGCaps wpgCapsFailed) {
+
+	slot_t* pSlot = static_cast<slot_t*>( pJob->lpContext );
+	state_t* pState = pSlot->pState;
+
+	// Queue the result (unless we've been cancelled), and decide whether this slot goes round again; a job
+	// completed with WPGCapCANCELLED, but not by us, was drained from a pool being destroyed, which won't
+	// take any more of them
+	bool fResubmit = false;
+	AcquireSRWLockExclusive( &(pState->m_srw) );
+	if (wpgCapsFailed & WPGCapCANCELLED){
+		pState->m_cUnsubmitted = 0;
+	}else if (!pState->cancelled( )){
+		wpg_password_t password;
+		CopyMemory( password.m_sz, pSlot->sz, sizeof( TCHAR ) * pJob->cchGenerated );
+		password.m_cch = pJob->cchGenerated;
+		password.m_failed = wpgCapsFailed;
+		pState->m_ready.push_back( password );
+		if (pState->m_cUnsubmitted > 0){
+			pState->m_cUnsubmitted--;
+			fResubmit = true;
+		}
+	}
+	if (!fResubmit){
+		pState->m_dwInFlight--;
+	}
+	const ::std::coroutine_handle<> waiter = ::std::exchange( pState->m_waiter, nullptr );
+	ReleaseSRWLockExclusive( &(pState->m_srw) );
+	SecureZeroMemory( pSlot->sz, sizeof( pSlot->sz ) );
+
+	// Either send the slot round again (keeping its reference), or let go of it, before resuming
+	// whoever's waiting, who may well let go of the state altogether
+	if (fResubmit && !WPGPoolSubmit( pState->m_hPool, pJob )){
+		// Count it as having been submitted, and then failed
+		AcquireSRWLockExclusive( &(pState->m_srw) );
+		if (waiter){
+			pState->m_waiter = waiter;
+		}
+		ReleaseSRWLockExclusive( &(pState->m_srw) );
+		pState->OnSubmitFailed( pSlot );
+		return;
+	}
+	if (!fResubmit){
+		pState->release( );
+	}
+	if (waiter){
+		waiter.resume( );
+	}
+}
+
+bool wpg_batch_stream_t::next_awaitable_t::await_ready(void) const {
+
+	if (m_pState == NULL){
+		return true;
+	}
+	AcquireSRWLockExclusive( &(m_pState->m_srw) );
+	const bool fReady = !m_pState->m_ready.empty( ) || m_pState->done( );
+	ReleaseSRWLockExclusive( &(m_pState->m_srw) );
+	return fReady;
+}
+
+bool wpg_batch_stream_t::next_awaitable_t::await_suspend(::std::coroutine_handle<> handle) {
+
+	AcquireSRWLockExclusive( &(m_pState->m_srw) );
+	const bool fSuspend = m_pState->m_ready.empty( ) && !m_pState->done( );
+	if (fSuspend){
+		m_pState->m_waiter = handle;
+	}
+	ReleaseSRWLockExclusive( &(m_pState->m_srw) );
+	return fSuspend;
+}
+
+::std::optional<wpg_password_t> wpg_batch_stream_t::next_awaitable_t::await_resume(void) {
+
+	::std::optional<wpg_password_t> password;
+	if (m_pState){
+		AcquireSRWLockExclusive( &(m_pState->m_srw) );
+		if (!m_pState->m_ready.empty( ) && !m_pState->cancelled( )){
+			password.emplace( m_pState->m_ready.front( ) );
+			m_pState->m_ready.pop_front( );
+		}
+		ReleaseSRWLockExclusive( &(m_pState->m_srw) );
+	}
+	return password;
+}
+
+wpg_batch_stream_t::wpg_batch_stream_t(WPG_POOL_H hPool, const wpg_config_t& config, SIZE_T cPasswords, ::std::stop_token stop):
+	m_pState( new state_t( hPool, config, cPasswords, stop ) ) {
+	m_pState->start( );
+}
+
+wpg_batch_stream_t::wpg_batch_stream_t(wpg_batch_stream_t&& other) noexcept: m_pState( ::std::exchange( other.m_pState, nullptr ) ) {
+}
+
+wpg_batch_stream_t::~wpg_batch_stream_t(void) {
+
+	if (m_pState){
+		m_pState->cancel( );
+		m_pState->release( );
+	}
+}
+
+void wpg_batch_stream_t::cancel(void) {
+
+	if (m_pState){
+		m_pState->cancel( );
+	}
+}
+
+wpg_async_t::wpg_async_t(DWORD dwWorkers): m_hPool( CreateWPGPool( dwWorkers ) ) {
+}
+
+wpg_async_t::~wpg_async_t(void) {
+	DestroyWPGPool( m_hPool );
+}
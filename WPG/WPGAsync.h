@@ -0,0 +1,183 @@
+// WPGAsync.h: declares an awaitable (C++20 coroutine) interface for generating passwords, without a window
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_ASYNC_H__)
+#define __WPG_ASYNC_H__
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <coroutine>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <string>
+
+// Local Project Headers
+#include "WPGPool.h"
+
+// Types
+//
+
+// Describes the password(s) to be generated
+struct wpg_config_t {
+	BYTE cchLength = 0x10;
+	WPGCaps wpgCaps = (WPGCapRDRAND | WPGCapTPM12 | WPGCapTPM20);
+	::std::basic_string<TCHAR> alphabet;
+	BOOL fDuplicatesAllowed = TRUE;
+};
+
+// Classes
+//
+
+// Gives one generated password, which is wiped when it goes out of scope
+class wpg_password_t {
+public:
+	wpg_password_t(void): m_sz{ 0 }, m_cch( 0 ), m_failed( WPGCapNONE ) { }
+	~wpg_password_t(void) {
+		SecureZeroMemory( m_sz, sizeof( m_sz ) );
+	}
+
+	wpg_password_t(const wpg_password_t&) = default;
+	wpg_password_t& operator=(const wpg_password_t&) = default;
+
+	LPCTSTR c_str(void) const {
+		return m_sz;
+	}
+
+	BYTE size(void) const {
+		return m_cch;
+	}
+
+	// Returns an enumeration of the generators which failed (or WPGCapCANCELLED, or WPGCapPARTIAL with those skipped)
+	WPGCaps failed(void) const {
+		return m_failed;
+	}
+
+	bool cancelled(void) const {
+		return (m_failed & WPGCapCANCELLED) != 0;
+	}
+
+	explicit operator bool() const {
+		return WPGSucceeded( m_failed );
+	}
+
+private:
+	friend class wpg_generate_awaitable_t;
+	friend class wpg_batch_stream_t;
+
+	TCHAR m_sz[0x100];
+	BYTE m_cch;
+	WPGCaps m_failed;
+};
+
+// Sets the flag it's given when a stop is requested, which cancels the job(s) watching it
+struct wpg_stop_fn_t {
+	volatile LONG* plCancelled;
+	void operator()(void) const noexcept;
+};
+
+// Gives the result of async_generate: awaiting it queues a job with the pool, and resumes
+// the awaiting coroutine (on the worker thread) with the password once it's done
+class wpg_generate_awaitable_t {
+public:
+	wpg_generate_awaitable_t(WPG_POOL_H, const wpg_config_t&, ::std::stop_token);
+
+	bool await_ready(void) const noexcept {
+		return false;
+	}
+
+	bool await_suspend(::std::coroutine_handle<>);
+
+	wpg_password_t await_resume(void);
+
+	// Lives in the awaiting coroutine's frame while the job is in flight, so can't be moved
+	wpg_generate_awaitable_t(const wpg_generate_awaitable_t&) = delete;
+	wpg_generate_awaitable_t& operator=(const wpg_generate_awaitable_t&) = delete;
+
+private:
+	static VOID CALLBACK OnJobDone(PWPG_POOL_JOB, WPGCaps);
+
+	WPG_POOL_H m_hPool;
+	wpg_config_t m_config;
+	::std::stop_token m_stop;
+	::std::optional<::std::stop_callback<wpg_stop_fn_t>> m_onStop;
+	volatile LONG m_lCancelled;
+	WPG_POOL_JOB m_job;
+	wpg_password_t m_password;
+	::std::coroutine_handle<> m_handle;
+};
+
+// Generates a batch of passwords, a window's worth at a time across the pool, and yields
+// them (in whatever order they finish) to whoever awaits next( )
+class wpg_batch_stream_t {
+public:
+	class state_t;
+
+	// Gives the result of next( ): resumes with the next password, or nothing once the batch is done
+	class next_awaitable_t {
+	public:
+		explicit next_awaitable_t(state_t* pState): m_pState( pState ) { }
+
+		bool await_ready(void) const;
+		bool await_suspend(::std::coroutine_handle<>);
+		::std::optional<wpg_password_t> await_resume(void);
+
+	private:
+		state_t* m_pState;
+	};
+
+	wpg_batch_stream_t(WPG_POOL_H, const wpg_config_t&, SIZE_T, ::std::stop_token);
+	~wpg_batch_stream_t(void);
+
+	wpg_batch_stream_t(wpg_batch_stream_t&&) noexcept;
+	wpg_batch_stream_t& operator=(wpg_batch_stream_t&&) = delete;
+	wpg_batch_stream_t(const wpg_batch_stream_t&) = delete;
+	wpg_batch_stream_t& operator=(const wpg_batch_stream_t&) = delete;
+
+	// Awaits the next password; only one coroutine should be awaiting at a time
+	next_awaitable_t next(void) {
+		return next_awaitable_t( m_pState );
+	}
+
+	// Stops generating any more of the batch; whatever has already been generated is discarded
+	void cancel(void);
+
+private:
+	state_t* m_pState;
+};
+
+// Owns a pool of workers (sharing one generator) which serves awaitable requests
+class wpg_async_t {
+public:
+	// Starts the given number of workers, or one per logical processor if zero
+	explicit wpg_async_t(DWORD dwWorkers = 0);
+	~wpg_async_t(void);
+
+	wpg_async_t(const wpg_async_t&) = delete;
+	wpg_async_t& operator=(const wpg_async_t&) = delete;
+
+	operator bool() const {
+		return (m_hPool != NULL);
+	}
+
+	// Generates one password with the given configuration
+	wpg_generate_awaitable_t async_generate(const wpg_config_t& config, ::std::stop_token stop = { }) const {
+		return wpg_generate_awaitable_t( m_hPool, config, stop );
+	}
+
+	// Generates the given number of passwords with the given configuration, yielding each as it's done
+	wpg_batch_stream_t async_batch(const wpg_config_t& config, SIZE_T cPasswords, ::std::stop_token stop = { }) const {
+		return wpg_batch_stream_t( m_hPool, config, cPasswords, stop );
+	}
+
+private:
+	WPG_POOL_H m_hPool;
+};
+
+#endif // !defined(__WPG_ASYNC_H__)
@@ -10,58 +10,159 @@
 // Precompiled Headers
 #include "Stdafx.h"
 
+// C++ Standard Library Headers
+#include <new>
+
+// Local Project Headers
+#include "WPGPool.h"
+#include "WPGQueue.h"
+
 // Declarations
 #include "WPGGenerator.h"
 
 // Macros
 //
 
-#define AWM_WPG_ALPHABET		(AWM_WPG_STOPPED+1)
+#define AWM_WPG_ALPHABET		(AWM_WPG_COMPLETED+1)
 #define AWM_WPG_DUPLICATES		(AWM_WPG_ALPHABET+1)
-#define AWM_WPG_GENERATE		(AWM_WPG_DUPLICATES+1)
-#define AWM_WPG_STOP			(AWM_WPG_GENERATE+1)
+#define AWM_WPG_DEADLINE		(AWM_WPG_DUPLICATES+1)
+#define AWM_WPG_GENERATE		(AWM_WPG_DEADLINE+1)
+#define AWM_WPG_GENERATE_BATCH	(AWM_WPG_GENERATE+1)
+#define AWM_WPG_STOP			(AWM_WPG_GENERATE_BATCH+1)
 
 // Constants
 //
 
 constexpr LONG WPG_NON_STOP = 0;
 
+// The number of requests which can be waiting for the generator
+constexpr size_t c_cRequestsMax = 64;
+
+// The number of completions which can be waiting for the host
+constexpr size_t c_cCompletionsMax = 16;
+
+// The number of batches which can be outstanding, i.e. accepted but not yet drained by the host
+constexpr LONG c_cBatchesMax = 2;
+
+// The number of completion slots kept back from generated passwords, so that the host is always told
+// that the generator started and stopped, however far it's fallen behind (batches have slots of their own)
+constexpr size_t c_cCompletionsReserved = 2U;
+static_assert( c_cCompletionsReserved < c_cCompletionsMax, "Generated passwords need at least one slot" );
+
+// The time, in milliseconds, allowed for generating a password (unless the host says otherwise),
+// past which any source which has yet to deliver is skipped
+constexpr DWORD c_dwDeadlineDefault = 500;
+
 // Types
 //
 
-typedef struct _WPG_INSTANCE {
+// Describes one request to the generator; the message identifies what's being asked for
+typedef struct _WPG_REQUEST {
+
+	UINT uMessage;
+	WPARAM wParam;
+	LPARAM lParam;
+
+	// For passwords, the generation of the request; only the latest is generated
+	LONG lGeneration;
+
+} WPG_REQUEST, *PWPG_REQUEST;
+
+typedef struct alignas(queue_line_size) _WPG_INSTANCE {
 
 	HANDLE hThread;
 	DWORD dwThreadId;
 	LONG* plStop;
 
+	// The window, if any, to be told when there are completions waiting
+	HWND hWnd;
+	volatile LONG lDoorbell;
+
+	// Counts requests for passwords; anything older than the latest is superseded
+	volatile LONG lGeneration;
+
+	BYTE cchMax;
+	DWORD dwPoolWorkers;
+
+	mpsc_queue_t<WPG_REQUEST, c_cRequestsMax> requests;
+	wakeup_t requestsWakeup;
+
+	spsc_queue_t<WPG_COMPLETION, c_cCompletionsMax> completions;
+	wakeup_t completionsWakeup;
+
+	// Counts the batches outstanding (see c_cBatchesMax), and holds those completed, which are
+	// produced by the batch thread rather than the generator thread, until the host takes them
+	volatile LONG lBatches;
+	spsc_queue_t<WPG_COMPLETION, static_cast<size_t>( c_cBatchesMax )> batches;
+
+	// Holds the latest generated password, once the host has fallen too far behind for it to be queued; each
+	// supersedes (and counts) the one before it, until the host drains it, after the rest of the queue
+	SRWLOCK srwLatest;
+	BOOL fLatest;
+	WPG_COMPLETION latest;
+
 } WPG_INSTANCE, *PWPG_INSTANCE;
 
 typedef struct _WPG_THREAD_PROPS {
 
-	HWND hWnd;
-	LONG* plStop;
+	PWPG_INSTANCE pInstance;
 
 	BYTE cchMax;
 	LPTSTR pszBuffer;
+	SIZE_T cchBuffer;
 
 	std::shared_ptr<wpg_t> wpg;
 
-	BYTE cchAlphabet;
+	DWORD cchAlphabet;
 	LPCTSTR pszAlphabet;
 
+	// The alphabet, compiled, if it's too large (or too wide) to be mapped by the generator (see WPGAlphabetNeeded),
+	// or why it couldn't be, in which case every password is refused until it's next set
+	WPG_ALPHABET_H hAlphabet;
+	DWORD dwAlphabetError;
+
 	BOOL fDuplicatesAllowed;
 
+	// The time allowed for each password, and the sources which may not be skipped when it runs out
+	DWORD dwDeadline;
+	WPGCaps wpgCapsRequired;
+
+	// The thread (and so the pool) for batches, started on the first of them
+	DWORD dwPoolWorkers;
+	struct _WPG_BATCH_THREAD* pBatchThread;
+
 } WPG_THREAD_PROPS, *PWPG_THREAD_PROPS;
 
-// Constants
-//
+typedef struct _WPG_BATCH_REQUEST {
+
+	LPTSTR pszBuffer;
+	SIZE_T cPasswords;
+	BYTE cchLength;
+	WPGCaps wpgCaps;
+
+	// The generator thread's alphabet (a copy) and duplicates toggle, as of when the batch was handed over
+	LPTSTR pszAlphabet;
+	DWORD cchAlphabet;
+	BOOL fDuplicatesAllowed;
+
+} WPG_BATCH_REQUEST, *PWPG_BATCH_REQUEST;
 
-// Message window "class" name
-static LPCTSTR c_pszWindowClass = TEXT( "WPGGeneratorWindowClass" );
+// Runs batches across the pool, which it owns, on a thread of its own, so that they don't hold up the
+// interactive requests; the generator thread hands them over, and so is the only producer
+typedef struct alignas(queue_line_size) _WPG_BATCH_THREAD {
 
-// Message window "title"
-static LPCTSTR c_pszWindowTitle = TEXT( "WPGGenerator" );
+	HANDLE hThread;
+	volatile LONG lStop;
+
+	PWPG_INSTANCE pInstance;
+	DWORD dwPoolWorkers;
+	std::shared_ptr<wpg_t> wpg;
+
+	// There are never more batches waiting than are outstanding, so handing one over can't fail
+	spsc_queue_t<PWPG_BATCH_REQUEST, static_cast<size_t>( c_cBatchesMax )> requests;
+	wakeup_t requestsWakeup;
+
+} WPG_BATCH_THREAD, *PWPG_BATCH_THREAD;
 
 // Prototypes
 //
@@ -69,108 +170,271 @@ static LPCTSTR c_pszWindowTitle = TEXT( "WPGGenerator" );
 // Gives the starting address for the worker thread
 DWORD WINAPI WPGGeneratorThreadProc(__in LPVOID);
 
-// Processes messages for the message window
-LRESULT CALLBACK WPGGeneratorWindowProcedure(HWND, UINT, WPARAM, LPARAM);
+// Gives the starting address for the batch thread
+DWORD WINAPI WPGBatchThreadProc(__in LPVOID);
 
 // Called when a new password is to be generated
-HRESULT OnGeneratePassword(HWND, WPARAM, LPARAM);
+HRESULT OnGeneratePassword(PWPG_THREAD_PROPS, WPARAM, LPARAM, LONG);
+
+// Called when a batch of passwords is to be generated
+HRESULT OnGeneratePasswordBatch(PWPG_THREAD_PROPS, WPARAM, LPARAM);
 
 // Called when the alphabet to use for password generation changes
-HRESULT OnSetPwdAlphabet(HWND, WPARAM, LPARAM);
+HRESULT OnSetPwdAlphabet(PWPG_THREAD_PROPS, WPARAM, LPARAM);
 
 // Called when the 'allow duplicates' toggle is flipped
-HRESULT OnEnablePwdDuplicates(HWND, WPARAM, LPARAM);
+HRESULT OnEnablePwdDuplicates(PWPG_THREAD_PROPS, WPARAM, LPARAM);
+
+// Called when the time allowed for each password changes
+HRESULT OnSetPwdDeadline(PWPG_THREAD_PROPS, WPARAM, LPARAM);
 
 // Functions
 //
 
 WPG_H StartWPGGenerator(HWND hWnd, BYTE cchMax) {
+	return StartWPGGeneratorEx( hWnd, cchMax, 0 );
+}
+
+WPG_H StartWPGGeneratorEx(HWND hWnd, BYTE cchMax, DWORD dwPoolWorkers) {
 
 	// Allocate the structure
-	PWPG_INSTANCE pInstance = reinterpret_cast<PWPG_INSTANCE>(
-		PH_ALLOC( sizeof( WPG_INSTANCE ) )
-	);
-	if (pInstance == NULL){
+	LPVOID lpInstance = _aligned_malloc( sizeof( WPG_INSTANCE ), alignof( WPG_INSTANCE ) );
+	if (lpInstance == NULL){
+		return NULL;
+	}
+	PWPG_INSTANCE pInstance = new (lpInstance) WPG_INSTANCE( );
+	if (!pInstance->requestsWakeup || !pInstance->completionsWakeup){
+		pInstance->~WPG_INSTANCE( );
+		_aligned_free( lpInstance );
 		return NULL;
 	}
+	InitializeSRWLock( &(pInstance->srwLatest) );
 	pInstance->plStop = reinterpret_cast<LONG*>( _aligned_malloc( sizeof( LONG ), sizeof( LONG ) ) );
 	*(pInstance->plStop) = WPG_NON_STOP;
-
-	// Allocate the control structure
-	PWPG_THREAD_PROPS pThreadProps = reinterpret_cast<PWPG_THREAD_PROPS>(
-		PH_ALLOC( sizeof( WPG_THREAD_PROPS ) )
-	);
-	pThreadProps->plStop = pInstance->plStop;
-	pThreadProps->hWnd = hWnd;
-	pThreadProps->cchMax = cchMax;
+	pInstance->hWnd = hWnd;
+	pInstance->cchMax = cchMax;
+	pInstance->dwPoolWorkers = dwPoolWorkers;
 
 	// Spin the thread
 	pInstance->hThread = CreateThread(
 		NULL,
 		0,
 		WPGGeneratorThreadProc,
-		static_cast<LPVOID>( pThreadProps ),
+		static_cast<LPVOID>( pInstance ),
 		0,
 		&(pInstance->dwThreadId)
 	);
 	return reinterpret_cast<WPG_H>( pInstance );
 }
 
-VOID WPGPwdGenAsync(__in WPG_H wpgHandle, __in BYTE cchLength, __in WPGCaps wpgCaps) {
+// Indicates whether the given generator thread should stop
+static inline BOOL WPGGeneratorShouldStop(__in PWPG_INSTANCE pInstance) {
+	const LONG value = InterlockedCompareExchange( pInstance->plStop, WPG_NON_STOP, WPG_NON_STOP );
+	return (value > WPG_NON_STOP);
+}
+
+// Queues the given request for the generator thread, and wakes it; nothing (but the stop itself) is queued once the
+// generator's been stopped, since it may already have drained the queue for the last time
+static BOOL WPGPostRequest(__in WPG_H wpgHandle, __in UINT uMessage, __in WPARAM wParam, __in LPARAM lParam, __in LONG lGeneration = 0) {
+
+	PWPG_INSTANCE pInstance = reinterpret_cast<PWPG_INSTANCE>(
+		wpgHandle
+	);
+	if ((pInstance == NULL) || ((uMessage != AWM_WPG_STOP) && WPGGeneratorShouldStop( pInstance ))){
+		return FALSE;
+	}
+	const WPG_REQUEST request = { uMessage, wParam, lParam, lGeneration };
+	if (!pInstance->requests.try_push( request )){
+#if defined (_DEBUG)
+		OutputDebugString( TEXT( "Generator request queue is full\x0A" ) );
+#endif
+		return FALSE;
+	}
+	pInstance->requestsWakeup.signal( );
+	return TRUE;
+}
+
+// Hands the given completion back to the host, without waiting on it; the slots reserved for everything
+// but generated passwords (see c_cCompletionsReserved), and for batches, mean that only they could ever not fit.
+// Batches are completed (only) by the batch thread, everything else (only) by the generator thread
+static BOOL WPGPostCompletion(__in PWPG_INSTANCE pInstance, __in const WPG_COMPLETION& completion) {
+
+	// Generated passwords can't use the last few slots; if the host is that far behind, it only needs the
+	// latest of them anyway, so put it to one side, superseding (and counting) any which is already there.
+	// Once there's one there, the rest follow it, so that the host never gets them out of order
+	BOOL fLatest = FALSE;
+	if (completion.uMessage == AWM_WPG_GENERATED){
+		AcquireSRWLockExclusive( &(pInstance->srwLatest) );
+		if (pInstance->fLatest || (pInstance->completions.size( ) >= (c_cCompletionsMax - c_cCompletionsReserved))){
+			const DWORD cDiscarded = (pInstance->fLatest) ? (pInstance->latest.cDiscarded + 1U) : 0U;
+			pInstance->latest = completion;
+			pInstance->latest.cDiscarded = cDiscarded;
+			pInstance->fLatest = TRUE;
+			fLatest = TRUE;
+		}
+		ReleaseSRWLockExclusive( &(pInstance->srwLatest) );
+#if defined (_DEBUG)
+		if (fLatest){
+			OutputDebugString( TEXT( "Generator completion queue is full; holding back the latest password\x0A" ) );
+		}
+#endif
+	}
+	if (!fLatest){
+		const bool fPushed = (completion.uMessage == AWM_WPG_GENERATED_BATCH)
+			? pInstance->batches.try_push( completion )
+			: pInstance->completions.try_push( completion );
+		if (!fPushed){
+			return FALSE;
+		}
+	}
+	pInstance->completionsWakeup.signal( );
+
+	// Ring the host window's doorbell, unless it's already been rung since the host last drained
+	if (pInstance->hWnd && (InterlockedExchange( &(pInstance->lDoorbell), 1 ) == 0)){
+		PostMessage( pInstance->hWnd, AWM_WPG_COMPLETED, 0, 0 );
+	}
+	return TRUE;
+}
+
+BOOL WPGPwdGenAsync(__in WPG_H wpgHandle, __in BYTE cchLength, __in WPGCaps wpgCaps) {
 
-	// Post to the thread
 	PWPG_INSTANCE pInstance = reinterpret_cast<PWPG_INSTANCE>(
 		wpgHandle
 	);
+	if (pInstance == NULL){
+		return FALSE;
+	}
+
+	// Supersede any request still waiting, or in flight
+	const LONG lGeneration = InterlockedIncrement( &(pInstance->lGeneration) );
 	WPARAM wParam = static_cast<WPARAM>( cchLength );
 	LPARAM lParam = static_cast<LPARAM>( wpgCaps );
-	PostThreadMessage( pInstance->dwThreadId, AWM_WPG_GENERATE, wParam, lParam );
+	return WPGPostRequest( wpgHandle, AWM_WPG_GENERATE, wParam, lParam, lGeneration );
+}
+
+BOOL WPGPwdGenBatchAsync(__in WPG_H wpgHandle, __out LPTSTR pszBuffer, __in SIZE_T cPasswords, __in BYTE cchLength, __in WPGCaps wpgCaps) {
+
+	// Package up the arguments
+	PWPG_BATCH_REQUEST pRequest = static_cast<PWPG_BATCH_REQUEST>(
+		PH_ALLOC( sizeof( WPG_BATCH_REQUEST ) )
+	);
+	if (pRequest == NULL){
+		return FALSE;
+	}
+	pRequest->pszBuffer = pszBuffer;
+	pRequest->cPasswords = cPasswords;
+	pRequest->cchLength = cchLength;
+	pRequest->wpgCaps = wpgCaps;
+
+	// Post them to the thread, if there's room for the completion
+	PWPG_INSTANCE pInstance = reinterpret_cast<PWPG_INSTANCE>(
+		wpgHandle
+	);
+	if ((pInstance == NULL) || (InterlockedIncrement( &(pInstance->lBatches) ) > c_cBatchesMax)){
+		if (pInstance){
+			InterlockedDecrement( &(pInstance->lBatches) );
+		}
+		PH_FREE( pRequest );
+		return FALSE;
+	}
+	if (!WPGPostRequest( wpgHandle, AWM_WPG_GENERATE_BATCH, reinterpret_cast<WPARAM>( pRequest ), 0 )){
+		InterlockedDecrement( &(pInstance->lBatches) );
+		PH_FREE( pRequest );
+		return FALSE;
+	}
+	return TRUE;
 }
 
-VOID SetPwdAlphabetAsync(__in WPG_H wpgHandle, __in LPCTSTR pszAlphabet, __in BYTE cchAlphabet) {
+BOOL SetPwdAlphabetAsync(__in WPG_H wpgHandle, __in LPCTSTR pszAlphabet, __in DWORD cchAlphabet) {
 
 	// Take a (null-terminated) copy of the string
 	LPTSTR pszCopy = (cchAlphabet > 0)
-		? static_cast<LPTSTR>( PH_ALLOC( sizeof( TCHAR ) * (cchAlphabet + 1) ) )
+		? static_cast<LPTSTR>( PH_ALLOC( sizeof( TCHAR ) * (static_cast<SIZE_T>( cchAlphabet ) + 1U) ) )
 		: NULL;
 	if (pszCopy){
 		CopyMemory( pszCopy, pszAlphabet, sizeof( TCHAR ) * cchAlphabet );
 	}
 
 	// Post it to the thread
+	if (!WPGPostRequest( wpgHandle, AWM_WPG_ALPHABET, reinterpret_cast<WPARAM>( pszCopy ), static_cast<LPARAM>( cchAlphabet ) )){
+		if (pszCopy){
+			PH_FREE( pszCopy );
+		}
+		return FALSE;
+	}
+	return TRUE;
+}
+
+BOOL EnablePwdDuplicatesAsync(__in WPG_H wpgHandle, __in BOOL fEnabled) {
+	return WPGPostRequest( wpgHandle, AWM_WPG_DUPLICATES, static_cast<WPARAM>( fEnabled ), 0U );
+}
+
+BOOL SetPwdDeadlineAsync(__in WPG_H wpgHandle, __in DWORD dwMilliseconds, __in WPGCaps wpgCapsRequired) {
+	return WPGPostRequest( wpgHandle, AWM_WPG_DEADLINE, static_cast<WPARAM>( dwMilliseconds ), static_cast<LPARAM>( wpgCapsRequired ) );
+}
+
+// Takes the next completion from wherever it's waiting: batches first (they're all completed before the generator thread
+// says it's stopped, so the host has every buffer back by then), then the queue, then the password held back, if any
+static BOOL WPGTakeCompletion(__in PWPG_INSTANCE pInstance, __out PWPG_COMPLETION pCompletion) {
+
+	if (pInstance->batches.try_pop( *pCompletion ) || pInstance->completions.try_pop( *pCompletion )){
+		return TRUE;
+	}
+	BOOL fLatest = FALSE;
+	AcquireSRWLockExclusive( &(pInstance->srwLatest) );
+	if (pInstance->fLatest){
+		*pCompletion = pInstance->latest;
+		SecureZeroMemory( &(pInstance->latest), sizeof( pInstance->latest ) );
+		pInstance->fLatest = FALSE;
+		fLatest = TRUE;
+	}
+	ReleaseSRWLockExclusive( &(pInstance->srwLatest) );
+	return fLatest;
+}
+
+BOOL WPGPopCompletion(__in WPG_H wpgHandle, __out PWPG_COMPLETION pCompletion) {
+
 	PWPG_INSTANCE pInstance = reinterpret_cast<PWPG_INSTANCE>(
 		wpgHandle
 	);
-	PostThreadMessage(
-		pInstance->dwThreadId,
-		AWM_WPG_ALPHABET,
-		reinterpret_cast<WPARAM>( pszCopy ),
-		static_cast<LPARAM>( cchAlphabet )
-	);
+	if ((pInstance == NULL) || (pCompletion == NULL)){
+		return FALSE;
+	}
+	if (!WPGTakeCompletion( pInstance, pCompletion )){
+		// Re-arm the doorbell, and look again, in case the generator completed something in between
+		InterlockedExchange( &(pInstance->lDoorbell), 0 );
+		if (!WPGTakeCompletion( pInstance, pCompletion )){
+			return FALSE;
+		}
+	}
+
+	// Point generated passwords at the caller's copy, and free up the slot of any batch
+	if (pCompletion->uMessage == AWM_WPG_GENERATED){
+		pCompletion->wParam = reinterpret_cast<WPARAM>( pCompletion->szPassword );
+	}else if (pCompletion->uMessage == AWM_WPG_GENERATED_BATCH){
+		InterlockedDecrement( &(pInstance->lBatches) );
+	}
+	return TRUE;
 }
 
-VOID EnablePwdDuplicatesAsync(__in WPG_H wpgHandle, __in BOOL fEnabled) {
+HANDLE GetWPGCompletionEvent(__in WPG_H wpgHandle) {
 
-	// Post it to the thread
 	PWPG_INSTANCE pInstance = reinterpret_cast<PWPG_INSTANCE>(
 		wpgHandle
 	);
-	PostThreadMessage(
-		pInstance->dwThreadId,
-		AWM_WPG_DUPLICATES,
-		static_cast<WPARAM>( fEnabled ),
-		0U
-	);
+	return (pInstance) ? pInstance->completionsWakeup.native( ) : NULL;
 }
 
 VOID StopWPGGenerator(WPG_H wpgHandle) {
 
-	// Raise the stop sign
+	// Raise the stop sign; the thread looks at it whenever it wakes, so it'll be seen even if the queue is full
 	PWPG_INSTANCE pInstance = reinterpret_cast<PWPG_INSTANCE>(
 		wpgHandle
 	);
 	InterlockedIncrement( pInstance->plStop );
-	PostThreadMessage( pInstance->dwThreadId, AWM_WPG_STOP, 0, 0 );
+	if (!WPGPostRequest( wpgHandle, AWM_WPG_STOP, 0, 0 )){
+		pInstance->requestsWakeup.signal( );
+	}
 }
 
 VOID CleanupWPGGenerator(WPG_H wpgHandle) {
@@ -181,87 +445,274 @@ VOID CleanupWPGGenerator(WPG_H wpgHandle) {
 	PWPG_INSTANCE pInstance = reinterpret_cast<PWPG_INSTANCE>(
 		wpgHandle
 	);
+
+	// The queues are shared with the thread, so let it finish first
+	if (pInstance->hThread){
+		WaitForSingleObject( pInstance->hThread, INFINITE );
+		CloseHandle( pInstance->hThread );
+	}
 	if (pInstance->plStop){
 		_aligned_free( pInstance->plStop );
 		pInstance->plStop = NULL;
 	}
-	CloseHandle( pInstance->hThread );
-	PH_FREE( pInstance );
+
+	// Release anything still in the request queue; the thread completes everything queued before it stopped (see
+	// WPGDiscardRequest), so this is only what another thread managed to post while it was stopping
+	WPG_REQUEST request = { 0 };
+	while (pInstance->requests.try_pop( request )){
+		if ((request.uMessage == AWM_WPG_ALPHABET) || (request.uMessage == AWM_WPG_GENERATE_BATCH)){
+			if (request.wParam){
+				PH_FREE( reinterpret_cast<LPVOID>( request.wParam ) );
+			}
+		}
+	}
+	pInstance->~WPG_INSTANCE( );
+	_aligned_free( pInstance );
 }
 
-// Indicates whether the given generator thread should stop
-static inline BOOL WPGGeneratorShouldStop(__in PWPG_THREAD_PROPS pThreadProps) {
-	const LONG value = InterlockedCompareExchange( pThreadProps->plStop, WPG_NON_STOP, WPG_NON_STOP );
-	return (value > WPG_NON_STOP);
+// Generates the given batch across the given pool, unless it's to be cancelled, then completes it, and frees it
+static HRESULT WPGRunBatch(__in PWPG_INSTANCE pInstance, __in_opt WPG_POOL_H hPool, __in PWPG_BATCH_REQUEST pRequest, __in BOOL fCancel) {
+
+	// Compile the alphabet, if it's more than the generator can map, as the generator thread did
+	HRESULT hResult = S_OK;
+	DWORD dwAlphabetError = ERROR_SUCCESS;
+	WPG_ALPHABET_H hAlphabet = NULL;
+	if (!fCancel && pRequest->pszAlphabet && WPGAlphabetNeeded( pRequest->pszAlphabet, pRequest->cchAlphabet )){
+		hAlphabet = CompileWPGAlphabet( pRequest->pszAlphabet, pRequest->cchAlphabet );
+		if (hAlphabet == NULL){
+			dwAlphabetError = GetLastError( );
+		}
+	}
+
+	// Generate, if we can
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	const BOOL fEmpty = (pRequest->cchAlphabet < 1);
+	if (fCancel || fEmpty || (pRequest->pszAlphabet == NULL) || (hPool == NULL) || (dwAlphabetError != ERROR_SUCCESS)){
+		ZeroMemory( pRequest->pszBuffer, sizeof( TCHAR ) * pRequest->cPasswords * (static_cast<SIZE_T>( pRequest->cchLength ) + 1U) );
+		if (fCancel){
+			wpgCapsFailed = WPGCapCANCELLED;
+			hResult = E_ABORT;
+		}else if (dwAlphabetError != ERROR_SUCCESS){
+			wpgCapsFailed = WPGCapNOSOURCE;
+			hResult = HRESULT_FROM_WIN32( dwAlphabetError );
+		}else if (!fEmpty){
+			wpgCapsFailed = pRequest->wpgCaps;
+			hResult = E_OUTOFMEMORY;
+		}
+	}else{
+		WPG_BATCH batch = { 0 };
+		batch.pszBuffer = pRequest->pszBuffer;
+		batch.cPasswords = pRequest->cPasswords;
+		batch.cchLength = pRequest->cchLength;
+		batch.wpgCaps = pRequest->wpgCaps;
+		batch.pszAlphabet = pRequest->pszAlphabet;
+		batch.fDuplicatesAllowed = pRequest->fDuplicatesAllowed;
+		batch.hAlphabet = hAlphabet;
+		wpgCapsFailed = WPGPoolGenerate( hPool, &batch );
+	}
+	if (hAlphabet){
+		CloseWPGAlphabet( hAlphabet );
+	}
+
+	// Hand the buffer back to its owner
+	WPG_COMPLETION completion = { 0 };
+	completion.uMessage = AWM_WPG_GENERATED_BATCH;
+	completion.wParam = reinterpret_cast<WPARAM>( pRequest->pszBuffer );
+	completion.lParam = static_cast<LPARAM>( wpgCapsFailed );
+	WPGPostCompletion( pInstance, completion );
+	if (pRequest->pszAlphabet){
+		PH_FREE( pRequest->pszAlphabet );
+	}
+	PH_FREE( pRequest );
+	return hResult;
+}
+
+// Starts the batch thread, for the given generator instance, and with a pool of the given number of workers; returns NULL on failure
+static PWPG_BATCH_THREAD StartWPGBatchThread(__in PWPG_INSTANCE pInstance, __in DWORD dwPoolWorkers, __in const std::shared_ptr<wpg_t>& wpg) {
+
+	// Allocate the structure
+	LPVOID lpBatchThread = _aligned_malloc( sizeof( WPG_BATCH_THREAD ), alignof( WPG_BATCH_THREAD ) );
+	if (lpBatchThread == NULL){
+		return NULL;
+	}
+	PWPG_BATCH_THREAD pBatchThread = new (lpBatchThread) WPG_BATCH_THREAD( );
+	pBatchThread->pInstance = pInstance;
+	pBatchThread->dwPoolWorkers = dwPoolWorkers;
+	pBatchThread->wpg = wpg;
+
+	// Spin the thread
+	if (pBatchThread->requestsWakeup){
+		pBatchThread->hThread = CreateThread(
+			NULL,
+			0,
+			WPGBatchThreadProc,
+			static_cast<LPVOID>( pBatchThread ),
+			0,
+			NULL
+		);
+	}
+	if (pBatchThread->hThread == NULL){
+		pBatchThread->~WPG_BATCH_THREAD( );
+		_aligned_free( lpBatchThread );
+		return NULL;
+	}
+	return pBatchThread;
+}
+
+// Stops the given batch thread, once it's completed every batch handed to it (cancelling any yet to be started), and cleans up after it
+static VOID StopWPGBatchThread(__in PWPG_BATCH_THREAD pBatchThread) {
+
+	InterlockedIncrement( &(pBatchThread->lStop) );
+	pBatchThread->requestsWakeup.signal( );
+	WaitForSingleObject( pBatchThread->hThread, INFINITE );
+	CloseHandle( pBatchThread->hThread );
+	pBatchThread->~WPG_BATCH_THREAD( );
+	_aligned_free( pBatchThread );
+}
+
+// Indicates whether the given batch thread should stop
+static inline BOOL WPGBatchThreadShouldStop(__in PWPG_BATCH_THREAD pBatchThread) {
+	return (InterlockedCompareExchange( &(pBatchThread->lStop), 0, 0 ) > 0);
+}
+
+DWORD WINAPI WPGBatchThreadProc(__in LPVOID lpParameter) {
+
+	// Capture the parameters, and start the pool
+	PWPG_BATCH_THREAD pBatchThread = reinterpret_cast<PWPG_BATCH_THREAD>(
+		lpParameter
+	);
+	WPG_POOL_H hPool = CreateWPGPoolEx( pBatchThread->dwPoolWorkers, pBatchThread->wpg );
+
+	// Work through the batches as they're handed over; once the stop sign's been seen, the queue is still
+	// drained, since everything handed over before it was raised has to be completed (i.e. cancelled)
+	BOOL fStop = FALSE;
+	while (!fStop){
+		fStop = WPGBatchThreadShouldStop( pBatchThread );
+		PWPG_BATCH_REQUEST pRequest = NULL;
+		while (pBatchThread->requests.try_pop( pRequest )){
+			fStop = fStop || WPGBatchThreadShouldStop( pBatchThread );
+			WPGRunBatch( pBatchThread->pInstance, hPool, pRequest, fStop );
+		}
+		if (!fStop){
+			pBatchThread->requestsWakeup.wait( wakeup_t::infinite );
+		}
+	}
+
+	// Cleanup
+	if (hPool){
+		DestroyWPGPool( hPool );
+	}
+#if defined (_DEBUG)
+	OutputDebugString( TEXT( "Batch thread finishing..\x0A"  ) );
+#endif
+	return 0;
+}
+
+// Releases the given request, which was queued before the generator was stopped but won't now be carried out:
+// a batch is completed, as cancelled, so that the host gets its buffer back; a new alphabet is freed; and a password
+// is just dropped, as if superseded. Called once the batch thread has finished, so that batches have one producer
+static VOID WPGDiscardRequest(__in PWPG_INSTANCE pInstance, __in const WPG_REQUEST& request) {
+
+	switch (request.uMessage){
+		case AWM_WPG_ALPHABET:
+			if (request.wParam){
+				PH_FREE( reinterpret_cast<LPVOID>( request.wParam ) );
+			}
+			break;
+
+		case AWM_WPG_GENERATE_BATCH:
+			if (request.wParam){
+				WPGRunBatch( pInstance, NULL, reinterpret_cast<PWPG_BATCH_REQUEST>( request.wParam ), TRUE );
+			}
+			break;
+
+		default:
+			break;
+	}
 }
 
 DWORD WINAPI WPGGeneratorThreadProc(__in LPVOID lpParameter) {
 
 	// Capture the parameters
-	PWPG_THREAD_PROPS pThreadProps = reinterpret_cast<PWPG_THREAD_PROPS>(
+	PWPG_INSTANCE pInstance = reinterpret_cast<PWPG_INSTANCE>(
 		lpParameter
 	);
+	WPG_THREAD_PROPS threadProps = { };
+	PWPG_THREAD_PROPS pThreadProps = &threadProps;
+	pThreadProps->pInstance = pInstance;
+	pThreadProps->cchMax = pInstance->cchMax;
+	pThreadProps->dwPoolWorkers = pInstance->dwPoolWorkers;
+	pThreadProps->cchBuffer = (static_cast<SIZE_T>( pThreadProps->cchMax ) * WPG_ALPHABET_UNITS_MAX) + 1U;
 	pThreadProps->pszBuffer = static_cast<LPTSTR>(
-		PH_ALLOC( sizeof( TCHAR ) * (static_cast<SIZE_T>( pThreadProps->cchMax ) + 1U) )
+		PH_ALLOC( sizeof( TCHAR ) * pThreadProps->cchBuffer )
 	);
 	pThreadProps->wpg = wpg_t::New( );
-
-	// Create the message window
-	HINSTANCE hInstance = static_cast<HINSTANCE>( GetModuleHandle( NULL ) );
-	HWND hWnd = NULL;
-	WNDCLASSEX wcx = { 0 };
-	wcx.cbSize = sizeof( WNDCLASSEX );
-	wcx.lpfnWndProc = WPGGeneratorWindowProcedure;
-	wcx.hInstance = hInstance;
-	wcx.lpszClassName = c_pszWindowClass;
-	if (RegisterClassEx( &wcx )){
-		hWnd = CreateWindowEx(
-			0,
-			c_pszWindowClass,
-			c_pszWindowTitle,
-			0,
-			CW_USEDEFAULT,
-			CW_USEDEFAULT,
-			CW_USEDEFAULT,
-			CW_USEDEFAULT,
-			HWND_MESSAGE,
-			NULL,
-			hInstance,
-			lpParameter 
-		);
-	}
-	if (hWnd){
-		// Kick into the message loop
-		MSG msg = { 0L };
-		do {
-			// Get the next message
-			if (GetMessage( &msg, NULL, 0U, 0U )){
-				// Look for an early out
-				if (WPGGeneratorShouldStop( pThreadProps )){
+	pThreadProps->dwDeadline = c_dwDeadlineDefault;
+	pThreadProps->wpgCapsRequired = WPGCapNONE;
+
+	// Signal the spawning thread that we've started
+	WPG_COMPLETION completion = { 0 };
+	completion.uMessage = AWM_WPG_STARTED;
+	completion.wParam = static_cast<WPARAM>( pThreadProps->wpg->Caps( ) );
+	completion.lParam = static_cast<LPARAM>( pThreadProps->wpg->Vex( ) );
+	WPGPostCompletion( pInstance, completion );
+
+	// Work through the requests as they come in
+	BOOL fStop = FALSE;
+	while (!fStop){
+		WPG_REQUEST request = { 0 };
+		while (!fStop){
+			// Look for an early out, before taking the next request, which is then left for WPGDiscardRequest
+			if (WPGGeneratorShouldStop( pInstance )){
 #if defined (_DEBUG)
-					OutputDebugString( TEXT( "WPGGeneratorShouldStop\x0A"  ) );
+				OutputDebugString( TEXT( "WPGGeneratorShouldStop\x0A"  ) );
 #endif
+				fStop = TRUE;
+				break;
+			}
+			if (!pInstance->requests.try_pop( request )){
+				break;
+			}
+
+			switch (request.uMessage){
+				case AWM_WPG_ALPHABET:
+					OnSetPwdAlphabet( pThreadProps, request.wParam, request.lParam );
 					break;
-				}
 
-				// Route anything not bound for any window to the window..?
-				if (!msg.hwnd){
-					msg.hwnd = hWnd;
-				}
+				case AWM_WPG_DUPLICATES:
+					OnEnablePwdDuplicates( pThreadProps, request.wParam, request.lParam );
+					break;
+
+				case AWM_WPG_DEADLINE:
+					OnSetPwdDeadline( pThreadProps, request.wParam, request.lParam );
+					break;
+
+				case AWM_WPG_GENERATE:
+					OnGeneratePassword( pThreadProps, request.wParam, request.lParam, request.lGeneration );
+					break;
+
+				case AWM_WPG_GENERATE_BATCH:
+					OnGeneratePasswordBatch( pThreadProps, request.wParam, request.lParam );
+					break;
+
+				case AWM_WPG_STOP:
+#if defined (_DEBUG)
+					OutputDebugString( TEXT( "AWM_WPG_STOP\x0D" ) );
+#endif
+					fStop = TRUE;
+					break;
 
-				// Translate the message and dispatch it
-				TranslateMessage( &msg ); 
-				DispatchMessage( &msg );
+				default:
+					break;
 			}
-		} while (msg.message != AWM_WPG_STOP);
-		DestroyWindow( hWnd );		
-	}else{
-		// Signal failure
-		;
+		}
+		if (!fStop){
+			pInstance->requestsWakeup.wait( wakeup_t::infinite );
+			fStop = WPGGeneratorShouldStop( pInstance );
+		}
 	}
 
 	// Cleanup
-	HWND hWndHost = pThreadProps->hWnd;
 	if (pThreadProps->pszBuffer){
 		PH_FREE( pThreadProps->pszBuffer );
 		pThreadProps->pszBuffer = NULL;
@@ -270,104 +721,100 @@ DWORD WINAPI WPGGeneratorThreadProc(__in LPVOID lpParameter) {
 		PH_FREE( const_cast<LPTSTR>( pThreadProps->pszAlphabet ) );
 		pThreadProps->pszAlphabet = NULL;
 	}
-	pThreadProps->plStop = NULL;
+	if (pThreadProps->hAlphabet){
+		CloseWPGAlphabet( pThreadProps->hAlphabet );
+		pThreadProps->hAlphabet = NULL;
+	}
+	if (pThreadProps->pBatchThread){
+		StopWPGBatchThread( pThreadProps->pBatchThread );
+		pThreadProps->pBatchThread = NULL;
+	}
 	pThreadProps->wpg.reset( );
-	PH_FREE( lpParameter );
 
-	// Signal that we're done
-	PostMessage( hWndHost, AWM_WPG_STOPPED, 0, 0 );
+	// Release whatever was queued but not taken, completing any batches
+	WPG_REQUEST request = { 0 };
+	while (pInstance->requests.try_pop( request )){
+		WPGDiscardRequest( pInstance, request );
+	}
+
+	// Signal that we're done (the batch thread's finished, and the queue's drained, so every batch has been completed)
+	completion.uMessage = AWM_WPG_STOPPED;
+	completion.wParam = 0;
+	completion.lParam = 0;
+	WPGPostCompletion( pInstance, completion );
 #if defined (_DEBUG)
 	OutputDebugString( TEXT( "Generator thread finishing..\x0A"  ) );
 #endif
 	return 0;
 }
 
-LRESULT CALLBACK WPGGeneratorWindowProcedure(HWND hWnd, UINT uMessage, WPARAM wParam, LPARAM lParam) {
+HRESULT OnGeneratePassword(PWPG_THREAD_PROPS pThreadProps, WPARAM wParam, LPARAM lParam, LONG lGeneration) {
 
-	LRESULT lResult = 0;
-	switch (uMessage){
-		case WM_CREATE:
-		{
+	if (pThreadProps && pThreadProps->wpg){
+		// Drop the request if it's already been superseded, before it goes anywhere near a source
+		const WPG_CANCEL cancel = { &(pThreadProps->pInstance->lGeneration), lGeneration };
+		if (WPGCancelled( &cancel )){
 #if defined (_DEBUG)
-			OutputDebugString( TEXT( "WPGGenerator: WM_CREATE\x0D" ) );
+			OutputDebugString( TEXT( "Dropping superseded password request\x0A" ) );
 #endif
-			LPCREATESTRUCT lpCreate = reinterpret_cast<LPCREATESTRUCT>( lParam );
-			PWPG_THREAD_PROPS pThreadProps = reinterpret_cast<PWPG_THREAD_PROPS>(
-				lpCreate->lpCreateParams
-			);
-			if (pThreadProps){
-				// Attach the thread properties to the window
-				SetWindowLongPtr(
-					hWnd,
-					GWLP_USERDATA,
-					reinterpret_cast<LONG_PTR>( lpCreate->lpCreateParams )
-				);
-
-				// Signal the spawning thread that we've started
-				const auto caps = pThreadProps->wpg->Caps( );
-				const auto vex = pThreadProps->wpg->Vex( );
-				PostMessage(
-					pThreadProps->hWnd,
-					AWM_WPG_STARTED,
-					static_cast<WPARAM>( caps ),
-					static_cast<LPARAM>( vex )
-				);
-			}
+			return S_FALSE;
 		}
-			break;
 
-		case AWM_WPG_ALPHABET:
-			OnSetPwdAlphabet( hWnd, wParam, lParam );
-			break;
-
-		case AWM_WPG_DUPLICATES:
-			OnEnablePwdDuplicates( hWnd, wParam, lParam );
-			break;
-
-		case AWM_WPG_GENERATE:
-			OnGeneratePassword( hWnd, wParam, lParam );
-			break;
-
-		case AWM_WPG_STOP:
-#if defined (_DEBUG)
-			OutputDebugString( TEXT( "AWM_WPG_STOP\x0D" ) );
-#endif
-			break;
-
-		// All other messages
-		default:
-			// Pass onto the default handler
-			lResult = DefWindowProc( hWnd, uMessage, wParam, lParam );
-			break;
-	}
-	return lResult;
-}
-
-HRESULT OnGeneratePassword(HWND hWnd, WPARAM wParam, LPARAM lParam) {
-
-	// Unpack the arguments
-	PWPG_THREAD_PROPS pThreadProps = reinterpret_cast<PWPG_THREAD_PROPS>(
-		GetWindowLongPtr( hWnd, GWLP_USERDATA )
-	);
-	if (pThreadProps && pThreadProps->wpg){
 		// Setup
 		const BYTE cchLength = static_cast<BYTE>( wParam );
 		const WPGCaps wpgCaps = static_cast<WPGCaps>( lParam );
 		const BOOL fEmpty = (pThreadProps->pszAlphabet == NULL) || (pThreadProps->cchAlphabet < 1);
 		BYTE cch = fEmpty ? 0 : min( cchLength, pThreadProps->cchMax );
+		const WPG_DEADLINE deadline = {
+			(pThreadProps->dwDeadline) ? (GetTickCount64( ) + pThreadProps->dwDeadline) : 0,
+			pThreadProps->wpgCapsRequired
+		};
+
+		// Do the password generation; from a compiled alphabet, the length is in symbols, which the buffer has room for
+		WPGCaps wpgCapsFailed = WPGCapNONE;
+		SIZE_T cchWritten = 0;
+		if (pThreadProps->dwAlphabetError != ERROR_SUCCESS){
+			wpgCapsFailed = WPGCapNOSOURCE;
+		}else if (pThreadProps->hAlphabet){
+			wpgCapsFailed = WPGAlphabetGenerate(
+				pThreadProps->hAlphabet,
+				*(pThreadProps->wpg),
+				pThreadProps->pszBuffer,
+				cch,
+				pThreadProps->fDuplicatesAllowed,
+				&cchWritten,
+				wpgCaps,
+				&cancel,
+				&deadline
+			);
+		}else{
+			wpgCapsFailed = pThreadProps->wpg->Generate(
+				pThreadProps->pszBuffer,
+				cch,
+				wpgCaps,
+				&(cch),
+				pThreadProps->pszAlphabet,
+				pThreadProps->fDuplicatesAllowed,
+				&cancel,
+				&deadline
+			);
+			cchWritten = cch;
+		}
 
-		// Do the password generation
-		WPGCaps wpgCapsFailed = pThreadProps->wpg->Generate(
-			pThreadProps->pszBuffer,
-			cch,
-			wpgCaps,
-			&(cch),
-			pThreadProps->pszAlphabet,
-			pThreadProps->fDuplicatesAllowed
-		);
+		// Drop the result if the request was superseded while we were at it
+		if (wpgCapsFailed & WPGCapCANCELLED){
+#if defined (_DEBUG)
+			OutputDebugString( TEXT( "Cancelled superseded password request\x0A" ) );
+#endif
+			SecureZeroMemory( pThreadProps->pszBuffer, sizeof( TCHAR ) * pThreadProps->cchBuffer );
+			return S_FALSE;
+		}
 
 #if defined (_DEBUG)
-		if (wpgCapsFailed == WPGCapNONE){
+		if (wpgCapsFailed & WPGCapPARTIAL){
+			OutputDebugString( TEXT( "Skipped source(s) which missed the deadline, failed, or were out of rotation\x0A" ) );
+		}
+		if (WPGSucceeded( wpgCapsFailed )){
 			OutputDebugString( TEXT( "Generator thread generated password: " ) );
 			OutputDebugString( pThreadProps->pszBuffer );
 			OutputDebugString( TEXT( "\x0A" ) );
@@ -376,33 +823,85 @@ HRESULT OnGeneratePassword(HWND hWnd, WPARAM wParam, LPARAM lParam) {
 		}
 #endif
 
-		// Send to the target window (synchronously)
-		SendMessage(
-			pThreadProps->hWnd,
-			AWM_WPG_GENERATED,
-			reinterpret_cast<WPARAM>( pThreadProps->pszBuffer ),
-			static_cast<LPARAM>( wpgCapsFailed )
-		);
-		SecureZeroMemory( pThreadProps->pszBuffer, pThreadProps->cchMax );
+		// Hand a copy back to the host
+		WPG_COMPLETION completion = { 0 };
+		completion.uMessage = AWM_WPG_GENERATED;
+		completion.lParam = static_cast<LPARAM>( wpgCapsFailed );
+		CopyMemory( completion.szPassword, pThreadProps->pszBuffer, sizeof( TCHAR ) * cchWritten );
+		WPGPostCompletion( pThreadProps->pInstance, completion );
+		SecureZeroMemory( &completion, sizeof( completion ) );
+		SecureZeroMemory( pThreadProps->pszBuffer, sizeof( TCHAR ) * pThreadProps->cchBuffer );
 		return S_OK;
 	}
 	return E_POINTER;
 }
 
-HRESULT OnSetPwdAlphabet(HWND hWnd, WPARAM wParam, LPARAM lParam) {
+HRESULT OnGeneratePasswordBatch(PWPG_THREAD_PROPS pThreadProps, WPARAM wParam, LPARAM lParam) {
+
+	// Unpack the arguments
+	PWPG_BATCH_REQUEST pRequest = reinterpret_cast<PWPG_BATCH_REQUEST>( wParam );
+	if ((pThreadProps == NULL) || (pRequest == NULL)){
+		if (pRequest){
+			PH_FREE( pRequest );
+		}
+		return E_POINTER;
+	}
+
+	// Give the batch its own copy of the alphabet, since it may change (and be released) before the batch is
+	// done; if the copy can't be made, the batch thread says so (see WPGRunBatch)
+	pRequest->cchAlphabet = (pThreadProps->pszAlphabet) ? pThreadProps->cchAlphabet : 0U;
+	if (pRequest->cchAlphabet > 0){
+		pRequest->pszAlphabet = static_cast<LPTSTR>(
+			PH_ALLOC( sizeof( TCHAR ) * (static_cast<SIZE_T>( pRequest->cchAlphabet ) + 1U) )
+		);
+		if (pRequest->pszAlphabet){
+			CopyMemory( pRequest->pszAlphabet, pThreadProps->pszAlphabet, sizeof( TCHAR ) * pRequest->cchAlphabet );
+		}
+	}
+	pRequest->fDuplicatesAllowed = pThreadProps->fDuplicatesAllowed;
+
+	// Start the batch thread, if we haven't already, sharing our generator (and so its sources) with its pool
+	if (pThreadProps->pBatchThread == NULL){
+		pThreadProps->pBatchThread = StartWPGBatchThread( pThreadProps->pInstance, pThreadProps->dwPoolWorkers, pThreadProps->wpg );
+	}
+	if (pThreadProps->pBatchThread == NULL){
+		// There's no batch thread to complete it, so we can, without a pool (i.e. as a failure)
+		return WPGRunBatch( pThreadProps->pInstance, NULL, pRequest, FALSE );
+	}
+
+	// Hand it over
+	pThreadProps->pBatchThread->requests.try_push( pRequest );
+	pThreadProps->pBatchThread->requestsWakeup.signal( );
+	return S_OK;
+}
+
+HRESULT OnSetPwdAlphabet(PWPG_THREAD_PROPS pThreadProps, WPARAM wParam, LPARAM lParam) {
 
-	PWPG_THREAD_PROPS pThreadProps = reinterpret_cast<PWPG_THREAD_PROPS>(
-		GetWindowLongPtr( hWnd, GWLP_USERDATA )
-	);
 	if (pThreadProps){
 		// Release the existing alphabet, if any
 		if (pThreadProps->pszAlphabet){
 			PH_FREE( const_cast<LPTSTR>( pThreadProps->pszAlphabet ) );
 		}
 
-		// Just accept the pointer
+		if (pThreadProps->hAlphabet){
+			CloseWPGAlphabet( pThreadProps->hAlphabet );
+			pThreadProps->hAlphabet = NULL;
+		}
+
+		// Just accept the pointer, and compile it if it's more than the generator can map; if it won't compile, then
+		// we mustn't fall back on mapping it (truncated, and splitting any surrogate pairs), so remember why not
 		pThreadProps->pszAlphabet = reinterpret_cast<LPTSTR>( wParam );
-		pThreadProps->cchAlphabet = static_cast<BYTE>( lParam );
+		pThreadProps->cchAlphabet = static_cast<DWORD>( lParam );
+		pThreadProps->dwAlphabetError = ERROR_SUCCESS;
+		if (pThreadProps->pszAlphabet && WPGAlphabetNeeded( pThreadProps->pszAlphabet, pThreadProps->cchAlphabet )){
+			pThreadProps->hAlphabet = CompileWPGAlphabet( pThreadProps->pszAlphabet, pThreadProps->cchAlphabet );
+			if (pThreadProps->hAlphabet == NULL){
+				pThreadProps->dwAlphabetError = GetLastError( );
+#if defined (_DEBUG)
+				OutputDebugString( TEXT( "Failed to compile the password alphabet; refusing passwords until it's next set\x0A" ) );
+#endif
+			}
+		}
 #if defined (_DEBUG)
 		OutputDebugString( TEXT( "Password alphabet set to: " ) );
 		OutputDebugString( pThreadProps->pszAlphabet );
@@ -413,11 +912,8 @@ HRESULT OnSetPwdAlphabet(HWND hWnd, WPARAM wParam, LPARAM lParam) {
 	return S_FALSE;
 }
 
-HRESULT OnEnablePwdDuplicates(HWND hWnd, WPARAM wParam, LPARAM lParam) {
+HRESULT OnEnablePwdDuplicates(PWPG_THREAD_PROPS pThreadProps, WPARAM wParam, LPARAM lParam) {
 
-	PWPG_THREAD_PROPS pThreadProps = reinterpret_cast<PWPG_THREAD_PROPS>(
-		GetWindowLongPtr( hWnd, GWLP_USERDATA )
-	);
 	if (pThreadProps){
 		pThreadProps->fDuplicatesAllowed = static_cast<BOOL>( wParam );
 #if defined (_DEBUG)
@@ -433,3 +929,13 @@ HRESULT OnEnablePwdDuplicates(HWND hWnd, WPARAM wParam, LPARAM lParam) {
 	}
 	return S_FALSE;
 }
+
+HRESULT OnSetPwdDeadline(PWPG_THREAD_PROPS pThreadProps, WPARAM wParam, LPARAM lParam) {
+
+	if (pThreadProps){
+		pThreadProps->dwDeadline = static_cast<DWORD>( wParam );
+		pThreadProps->wpgCapsRequired = static_cast<WPGCaps>( lParam );
+		return S_OK;
+	}
+	return S_FALSE;
+}
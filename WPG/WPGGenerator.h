@@ -12,30 +12,83 @@
 
 // Local Project Headers
 #include "WPGGenerators.h"
+#include "WPGAlphabet.h"
 
 // Macros
 //
 
 DECLARE_HANDLE(WPG_H);
 
+// Identify the kinds of completion posted by the generator
 #define AWM_WPG_STARTED		(WM_APP+1)
 #define AWM_WPG_GENERATED	(AWM_WPG_STARTED+1)
 #define AWM_WPG_STOPPED		(AWM_WPG_GENERATED+1)
+#define AWM_WPG_GENERATED_BATCH	(AWM_WPG_STOPPED+1)
+
+// Posted (at most once until the completions are next drained) to the host window, if any, when there are completions waiting
+#define AWM_WPG_COMPLETED	(AWM_WPG_GENERATED_BATCH+1)
+
+// Types
+//
+
+// Describes one completion from the generator:
+// AWM_WPG_STARTED: wParam gives the WPGCaps available, lParam the XORVex in use
+// AWM_WPG_GENERATED: wParam points at szPassword, lParam gives the WPGCaps which failed, and cDiscarded the
+// number of (older) passwords which it superseded, and which were discarded, while the host was behind
+// AWM_WPG_GENERATED_BATCH: wParam gives the caller's buffer, lParam the WPGCaps which failed
+// AWM_WPG_STOPPED: no arguments
+typedef struct _WPG_COMPLETION {
+
+	UINT uMessage;
+	WPARAM wParam;
+	LPARAM lParam;
+	DWORD cDiscarded;
+
+	// Room for the longest password, each of whose symbols may be a surrogate pair (see WPGAlphabetGenerate)
+	TCHAR szPassword[WPG_ALPHABET_UNITS_MAX * 0x100];
+
+} WPG_COMPLETION, *PWPG_COMPLETION;
 
 // Functions
 //
 
-// Starts the thread
+// (The ..Async functions return FALSE, without waiting, if the generator's request queue is full)
+
+// Starts the thread; the host window (if any) is sent AWM_WPG_COMPLETED when there are completions to be drained
 WPG_H StartWPGGenerator(HWND, BYTE);
 
-// Generates a password in the given output buffer; returns an enumeration of the generators which failed
-VOID WPGPwdGenAsync(__in WPG_H, __in BYTE, __in WPGCaps);
+// Starts the thread, with the given number of pool workers for batches (zero for one per logical processor)
+WPG_H StartWPGGeneratorEx(HWND, BYTE, DWORD);
+
+// Requests a password of the given length from the given generators; AWM_WPG_GENERATED is completed when done
+BOOL WPGPwdGenAsync(__in WPG_H, __in BYTE, __in WPGCaps);
+
+// Generates a batch of passwords, as (cchLength+1)-character null-terminated records, in the given caller-owned
+// buffer across a pool, on a thread of its own (so that it doesn't hold up other requests), with the alphabet, etc,
+// as set before it; AWM_WPG_GENERATED_BATCH is completed when done, or with WPGCapCANCELLED (and the buffer zeroed)
+// if the generator is stopped before it starts (always before AWM_WPG_STOPPED). Also returns FALSE if two batches
+// are already outstanding, i.e. have yet to be taken by WPGPopCompletion, or if the generator's been stopped
+BOOL WPGPwdGenBatchAsync(__in WPG_H, __out LPTSTR, __in SIZE_T, __in BYTE, __in WPGCaps);
 
-// Sets the alphabet to be used for subsequently-generated passwords
-VOID SetPwdAlphabetAsync(__in WPG_H, __in LPCTSTR, __in BYTE);
+// Sets the alphabet to be used for subsequently-generated passwords; one of more than 255 characters, or with any beyond the
+// BMP, is compiled (see CompileWPGAlphabet), and then gives passwords of as many symbols as the length asked for (so of up to
+// twice as many characters), or, in batches, as many as fit in each record. If it won't compile (e.g. it has an unpaired
+// surrogate), every password is refused, with WPGCapNOSOURCE, until the alphabet is next set
+BOOL SetPwdAlphabetAsync(__in WPG_H, __in LPCTSTR, __in DWORD);
 
 // Enables/disables the use of duplicate characters in subsequently-genreated passwords
-VOID EnablePwdDuplicatesAsync(__in WPG_H, __in BOOL);
+BOOL EnablePwdDuplicatesAsync(__in WPG_H, __in BOOL);
+
+// Sets the time, in milliseconds (or zero for no limit), allowed for each subsequently-generated password, and
+// the sources which may not be skipped should they miss it; AWM_WPG_GENERATED gives WPGCapPARTIAL (and those
+// which were skipped) when the password was completed from the rest
+BOOL SetPwdDeadlineAsync(__in WPG_H, __in DWORD, __in WPGCaps);
+
+// Takes the next completion from the generator, if any; called from one (consuming) thread only
+BOOL WPGPopCompletion(__in WPG_H, __out PWPG_COMPLETION);
+
+// Returns the event which is signalled when there are completions waiting, for hosts without a window
+HANDLE GetWPGCompletionEvent(__in WPG_H);
 
 // Stops the thread
 VOID StopWPGGenerator(WPG_H);
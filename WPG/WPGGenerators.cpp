@@ -16,41 +16,41 @@
 #include <vector>
 #include <algorithm>
 
-// TPM Services Headers
-#include <tbs.h>
-
 // RDRAND Headers
 #include "ia_rdrand.h"
 
+// Local Project Headers
+#include "CpuFeatures.h"
+#include "WPGTpm.h"
+
 // Declarations
 #include "WPGGenerators.h"
 
-// Macros
+// Constants
 //
 
-#if defined (_M_IX86) || defined (_M_X64) || defined (_M_ARM64)
-#define le32_to_host(val) (val)
-#define be32_to_host(val) _byteswap_ulong(val)
-#define le16_to_host(val) (val)
-#define be16_to_host(val) _byteswap_ushort(val)
-#define host_to_le32(val) (val)
-#define host_to_be32(val) _byteswap_ulong(val)
-#define host_to_le16(val) (val)
-#define host_to_be16(val) _byteswap_ushort(val)
-#else
-#error Big/little endianess conversion macros not defined!
-#endif
+// The weight given to each new measurement of a source in its moving averages
+constexpr double c_dblMeterWeight = 0.125;
 
-// Constants
-//
+// The number of consecutive failures after which a source is taken out of rotation
+constexpr DWORD c_cFailuresToTrip = 3;
 
-enum {
-	TPM2_ST_NO_SESSIONS	= 0x8001,
-};
+// The intervals, in milliseconds, between probes of a source out of rotation: the first, and the
+// most it backs off to, doubling after each failed probe
+constexpr DWORD c_dwProbeFirst = 1000;
+constexpr DWORD c_dwProbeMost = 0x10000;
 
-enum {
-	TPM2_CC_GET_RANDOM	= 0x017B,
-};
+// The time, in milliseconds, allowed for a probe, and the number of bytes it draws
+constexpr DWORD c_dwProbeTimeout = 1000;
+constexpr BYTE c_cbProbe = 0x10;
+
+// The cutoffs for the continuous health tests (SP 800-90B, 4.4), for a false positive rate of 2^-20
+// per test, taking (very conservatively) one bit of min-entropy per byte of a source's output: the
+// run of one value which fails the repetition count test, and the count of one value within the
+// window which fails the adaptive proportion test
+constexpr DWORD c_cRepetitionCutoff = 21;
+constexpr DWORD c_cProportionWindow = 512;
+constexpr DWORD c_cProportionCutoff = 311;
 
 // Forward Declarations
 //
@@ -70,7 +70,9 @@ public:
 	virtual operator WPGCap(void) const = 0;
 	virtual operator bool(void) const = 0;
 
-	virtual size_type fill(void*, size_type) = 0;
+	// Fills the given buffer, giving up at the given deadline (against GetTickCount64, or zero for none)
+	// if the source can; returns the number of bytes filled, or zero on failure
+	virtual size_type fill(void*, size_type, ULONGLONG = 0) = 0;
 };
 
 template <WPGCap _cap>
@@ -88,7 +90,7 @@ public:
 		return cap;
 	}
 
-	virtual size_type fill(void*, size_type) {
+	virtual size_type fill(void*, size_type, ULONGLONG) {
 		return 0;
 	}
 };
@@ -96,175 +98,538 @@ public:
 class rdrand_rng_t: public cap_rng_t<WPGCapRDRAND> {
 public:
 	operator bool(void) const {
-		return ::rdrand_supported( );
+		// Use our (cached) detection, which doesn't filter on the CPU vendor
+		return get_cpu_features( ).rdrand;
 	}
 
-	size_type fill(void* buffer, rdrand_rng_t::size_type size) {
+	size_type fill(void* buffer, rdrand_rng_t::size_type size, ULONGLONG) {
 		return static_cast<size_type>( ::RdRandFill( buffer, size ) );
 	}
 };
 
-class tpm12_rng_t: public cap_rng_t<WPGCapTPM12> {
+// Draws from the process-wide pool for the given version of TPM, so constructing one is cheap once any generator has it open
+template <WPGCap _cap>
+class tpm_rng_t: public cap_rng_t<_cap> {
 public:
-	tpm12_rng_t(void);
-	virtual ~tpm12_rng_t(void);
+	tpm_rng_t(void): m_pool( tpm_pool_t::Get( _cap ) ) { }
 
 	operator bool(void) const {
-		return (m_hContext != NULL);
+		return m_pool && *m_pool;
 	}
 
-	size_type fill(void*, size_type);
+	rng_t::size_type fill(void* buffer, rng_t::size_type size, ULONGLONG ullDeadline) {
+		return m_pool->fill( buffer, size, ullDeadline );
+	}
+
+private:
+	::std::shared_ptr<tpm_pool_t> m_pool;
+};
+
+typedef tpm_rng_t<WPGCapTPM12> tpm12_rng_t;
+typedef tpm_rng_t<WPGCapTPM20> tpm20_rng_t;
+
+// Runs the continuous health tests over a source's output, a byte at a time, carrying their state
+// over from one fill to the next
+class health_t {
+public:
+	health_t(void): m_bLast( 0 ), m_cRepeats( 0 ), m_bFirst( 0 ), m_cWindow( 0 ), m_cMatches( 0 ) { }
+
+	// Returns false if the given output fails either test, after which both start over
+	bool test(const BYTE*, size_t);
 
 private:
-	TBS_HCONTEXT m_hContext;
+	// The repetition count test: the last value, and the length of its run
+	BYTE m_bLast;
+	DWORD m_cRepeats;
+
+	// The adaptive proportion test: the first value in the window, the number of values seen in
+	// the window so far, and the number of them which matched it
+	BYTE m_bFirst;
+	DWORD m_cWindow;
+	DWORD m_cMatches;
 };
 
-tpm12_rng_t::tpm12_rng_t(void): m_hContext( NULL ) {
+// Measures the latency and throughput of the source it wraps, as it's used, and records what
+// the schedule last decided for it. Also breaks the circuit to the source after repeated failures,
+// i.e. takes it out of rotation, and probes it in the background, backing off exponentially, until
+// it recovers
+class metered_rng_t: public rng_t {
+public:
+	explicit metered_rng_t(::std::unique_ptr<rng_t>&& rng);
+	~metered_rng_t(void);
+
+	metered_rng_t(const metered_rng_t&) = delete;
+	metered_rng_t& operator=(const metered_rng_t&) = delete;
+
+	operator WPGCap(void) const {
+		return static_cast<WPGCap>( *m_rng );
+	}
+
+	operator bool(void) const {
+		return static_cast<bool>( *m_rng );
+	}
+
+	size_type fill(void*, size_type, ULONGLONG);
+
+	// Fills the given buffer as fill does, then runs the health tests over what was filled; output
+	// which fails them is discarded (leaving the buffer zeroed), and counts as a failure of the source
+	size_type fill_tested(void*, size_type, ULONGLONG);
 
-	TBS_CONTEXT_PARAMS contextParams = { 0 };
-	contextParams.version = TBS_CONTEXT_VERSION_ONE;
-	HRESULT hResult = ::Tbsi_Context_Create( &contextParams, &m_hContext );
-	if (FAILED(hResult)){
-		m_hContext = NULL;
+	// Returns true if the source has been measured, and found slower than the given rate
+	bool slower_than(DWORD) const;
+
+	// Records the schedule's decision for the source
+	VOID decide(bool);
+
+	// Returns true if the source is out of rotation
+	bool tripped(void) const {
+		return (InterlockedCompareExchange( const_cast<volatile LONG*>( &m_lTripped ), 0, 0 ) != 0);
 	}
+
+	VOID stats(__out PWPG_SOURCE_STATS) const;
+
+private:
+	// Counts a failure of the source, and takes it out of rotation if it's failed too often in a row;
+	// called with the lock held
+	VOID fail(void);
+
+	// Fills and meters the given buffer, running the health tests over what was filled if asked to
+	size_type draw(void*, size_type, ULONGLONG, bool);
+
+	static VOID CALLBACK OnProbe(PTP_CALLBACK_INSTANCE, PVOID, PTP_TIMER);
+
+	// Schedules the next probe, after the given interval, unless the source is closing; called with the lock held
+	VOID arm(DWORD);
+
+	::std::unique_ptr<rng_t> m_rng;
+
+	mutable SRWLOCK m_srw;
+	ULONG64 m_ullCalls;
+	ULONG64 m_ullBytes;
+	ULONG64 m_ullFailures;
+	ULONG64 m_ullHealthFailures;
+	double m_dblBytesPerSecond;
+	double m_dblLatency;
+	volatile LONG m_lSlow;
+
+	// The health of the source: consecutive failures, whether it's been taken out of rotation, and
+	// the interval until it's next probed
+	DWORD m_cConsecutiveFailures;
+	volatile LONG m_lTripped;
+	DWORD m_dwProbe;
+	PTP_TIMER m_pProbeTimer;
+
+	// Set, under the lock, before the timer is stopped, so that a probe which is already running can't re-arm it
+	bool m_fClosing;
+
+	// Serialises the health tests, which run over the source's output as one stream
+	SRWLOCK m_srwHealth;
+	health_t m_health;
+};
+
+// Returns the frequency of the performance counter, which is fixed at boot
+static LONGLONG qpc_frequency(void) {
+
+	static const LONGLONG llFrequency = []() {
+		LARGE_INTEGER frequency = { 0 };
+		QueryPerformanceFrequency( &frequency );
+		return max( frequency.QuadPart, 1LL );
+	}( );
+	return llFrequency;
 }
 
-tpm12_rng_t::~tpm12_rng_t(void) {
+metered_rng_t::metered_rng_t(::std::unique_ptr<rng_t>&& rng):
+	m_rng( ::std::move( rng ) ), m_ullCalls( 0 ), m_ullBytes( 0 ), m_ullFailures( 0 ), m_ullHealthFailures( 0 ), m_dblBytesPerSecond( 0.0 ), m_dblLatency( 0.0 ), m_lSlow( 0 ),
+	m_cConsecutiveFailures( 0 ), m_lTripped( 0 ), m_dwProbe( c_dwProbeFirst ), m_pProbeTimer( NULL ), m_fClosing( false ) {
+
+	InitializeSRWLock( &m_srw );
+	InitializeSRWLock( &m_srwHealth );
+	m_pProbeTimer = CreateThreadpoolTimer( OnProbe, this, NULL );
+}
 
-	if (m_hContext){
-		::Tbsip_Context_Close( m_hContext );
+metered_rng_t::~metered_rng_t(void) {
+
+	// Make sure that no probe is pending, or running, before the source goes away; once closing,
+	// a probe which was already running when the timer was stopped won't set it again
+	if (m_pProbeTimer){
+		AcquireSRWLockExclusive( &m_srw );
+		m_fClosing = true;
+		ReleaseSRWLockExclusive( &m_srw );
+		SetThreadpoolTimer( m_pProbeTimer, NULL, 0, 0 );
+		WaitForThreadpoolTimerCallbacks( m_pProbeTimer, TRUE );
+		CloseThreadpoolTimer( m_pProbeTimer );
 	}
 }
 
-tpm12_rng_t::size_type tpm12_rng_t::fill(void* buffer, tpm12_rng_t::size_type size) {
-
-	BYTE bCmd[] = {
-		0x00, 0xc1,					// TPM_TAG_RQU_COMMAND
-		0x00, 0x00, 0x00, 0x0e,		// blob length in bytes
-		0x00, 0x00, 0x00, 0x46,		// TPM API code (TPM_ORD_GetRandom)
-		0x00, 0x00, 0x00, 0x00		// # Bytes (copied in below)
-	};
-	const UINT32 cbCmd = sizeof( bCmd );
-
-	// Allocate the buffer for the result
-	const UINT32 cbBuffer = cbCmd + static_cast<UINT32>( size );
-	PBYTE pBuffer = static_cast<PBYTE>( PH_ALLOC( cbBuffer ) );
-
-	size_type result = 0;
-	while (size > result){
-		const auto requested = size - result;
-		UINT32 uBe32 = host_to_be32( requested );
-		CopyMemory( bCmd + (cbCmd - sizeof( uBe32 )), &uBe32, sizeof( uBe32 ) );
-
-		// Submit the command
-		auto cbResult = cbBuffer;
-		HRESULT hResult = ::Tbsip_Submit_Command( m_hContext, TBS_COMMAND_LOCALITY_ZERO, TBS_COMMAND_PRIORITY_NORMAL, bCmd, cbCmd, pBuffer, &cbResult );
-		if (SUCCEEDED( hResult )){
-			// Get out the number of random bytes returned from the TPM
-			const SIZE_T cbSize = sizeof( uBe32 );
-			CopyMemory( &uBe32, pBuffer + (cbCmd - cbSize), cbSize );
-			const auto generated = be32_to_host( uBe32 );
-			if (generated){
-				// Copy the generated random data to the output buffer
-				CopyMemory( static_cast<unsigned char*>( buffer ) + result, pBuffer + cbCmd, generated );
-				result += static_cast<decltype(result)>( generated );
-				continue;
-			}
+metered_rng_t::size_type metered_rng_t::fill(void* buffer, size_type size, ULONGLONG ullDeadline) {
+
+	return draw( buffer, size, ullDeadline, false );
+}
+
+metered_rng_t::size_type metered_rng_t::fill_tested(void* buffer, size_type size, ULONGLONG ullDeadline) {
+
+	return draw( buffer, size, ullDeadline, true );
+}
+
+metered_rng_t::size_type metered_rng_t::draw(void* buffer, size_type size, ULONGLONG ullDeadline, bool fTested) {
+
+	LARGE_INTEGER before = { 0 }, after = { 0 };
+	QueryPerformanceCounter( &before );
+	const size_type filled = m_rng->fill( buffer, size, ullDeadline );
+	QueryPerformanceCounter( &after );
+
+	// Output which fails the health tests is discarded
+	bool fHealthy = true;
+	if (fTested && filled){
+		AcquireSRWLockExclusive( &m_srwHealth );
+		fHealthy = m_health.test( static_cast<const BYTE*>( buffer ), filled );
+		ReleaseSRWLockExclusive( &m_srwHealth );
+		if (!fHealthy){
+			SecureZeroMemory( buffer, filled );
 		}
-		result = 0;
-		break;
 	}
-	PH_FREE( pBuffer );
-	return result;
+
+	// Fold the call into the averages; failures count towards the latency, but not the throughput,
+	// and towards the source's health, unless they were only a missed deadline
+	const double dblSeconds = max( static_cast<double>( after.QuadPart - before.QuadPart ), 1.0 ) / static_cast<double>( qpc_frequency( ) );
+	const bool fMissed = (filled == 0) && ullDeadline && (GetTickCount64( ) >= ullDeadline);
+	AcquireSRWLockExclusive( &m_srw );
+	const double dblWeight = (m_ullCalls == 0) ? 1.0 : c_dblMeterWeight;
+	m_ullCalls++;
+	m_ullBytes += filled;
+	m_dblLatency += dblWeight * ((dblSeconds * 1e6) - m_dblLatency);
+	if (filled){
+		m_dblBytesPerSecond += dblWeight * ((filled / dblSeconds) - m_dblBytesPerSecond);
+	}
+	if (filled && fHealthy){
+		m_cConsecutiveFailures = 0;
+	}else if (!fHealthy){
+		m_ullHealthFailures++;
+		fail( );
+	}else if (!fMissed){
+		fail( );
+	}
+	ReleaseSRWLockExclusive( &m_srw );
+	return fHealthy ? filled : 0;
 }
 
-class tpm20_rng_t: public cap_rng_t<WPGCapTPM20> {
-public:
-	tpm20_rng_t(void);
-	~tpm20_rng_t(void);
+VOID metered_rng_t::fail(void) {
 
-	operator bool(void) const {
-		return (m_hContext != NULL);
+	m_ullFailures++;
+	m_cConsecutiveFailures++;
+	if ((m_cConsecutiveFailures >= c_cFailuresToTrip) && m_pProbeTimer && !tripped( )){
+		InterlockedExchange( &m_lTripped, 1 );
+		m_dwProbe = c_dwProbeFirst;
+		arm( m_dwProbe );
+#if defined (_DEBUG)
+		TCHAR szMessage[0x80] = { 0 };
+		StringCchPrintf( szMessage, _countof( szMessage ), TEXT( "Source %u taken out of rotation after %u failures\x0A" ),
+			static_cast<UINT>( static_cast<WPGCap>( *m_rng ) ), static_cast<UINT>( m_cConsecutiveFailures ) );
+		OutputDebugString( szMessage );
+#endif
 	}
+}
 
-	size_type fill(void*, size_type);
+VOID metered_rng_t::arm(DWORD dwMilliseconds) {
 
-private:
-	TBS_HCONTEXT m_hContext;
-};
+	if (m_fClosing){
+		return;
+	}
+
+	// A negative due time is relative, in 100ns units
+	ULARGE_INTEGER due = { 0 };
+	due.QuadPart = static_cast<ULONGLONG>( -(static_cast<LONGLONG>( dwMilliseconds ) * 10000) );
+	FILETIME ft = { due.LowPart, due.HighPart };
+	SetThreadpoolTimer( m_pProbeTimer, &ft, 0, 0 );
+}
+
+VOID CALLBACK metered_rng_t::OnProbe(PTP_CALLBACK_INSTANCE, PVOID pvContext, PTP_TIMER) {
+
+	// Draw a few bytes from the source, and restore it to rotation if it delivers them
+	metered_rng_t* pThis = static_cast<metered_rng_t*>( pvContext );
+	BYTE bProbe[c_cbProbe] = { 0 };
+	const size_type filled = pThis->m_rng->fill( bProbe, sizeof( bProbe ), GetTickCount64( ) + c_dwProbeTimeout );
+	SecureZeroMemory( bProbe, sizeof( bProbe ) );
+
+	AcquireSRWLockExclusive( &(pThis->m_srw) );
+	if (filled == sizeof( bProbe )){
+		pThis->m_cConsecutiveFailures = 0;
+		pThis->m_dwProbe = c_dwProbeFirst;
+		InterlockedExchange( &(pThis->m_lTripped), 0 );
+	}else{
+		pThis->m_ullFailures++;
+		pThis->m_dwProbe = min( pThis->m_dwProbe * 2, c_dwProbeMost );
+		pThis->arm( pThis->m_dwProbe );
+	}
+#if defined (_DEBUG)
+	TCHAR szMessage[0x80] = { 0 };
+	StringCchPrintf( szMessage, _countof( szMessage ), (filled == sizeof( bProbe )) ? TEXT( "Source %u restored to rotation\x0A" ) : TEXT( "Source %u failed probe; next in %ums\x0A" ),
+		static_cast<UINT>( static_cast<WPGCap>( *(pThis->m_rng) ) ), static_cast<UINT>( pThis->m_dwProbe ) );
+	OutputDebugString( szMessage );
+#endif
+	ReleaseSRWLockExclusive( &(pThis->m_srw) );
+}
+
+bool metered_rng_t::slower_than(DWORD dwBytesPerSecond) const {
+
+	AcquireSRWLockShared( &m_srw );
+	const bool fSlower = (m_ullBytes > 0) && (m_dblBytesPerSecond < dwBytesPerSecond);
+	ReleaseSRWLockShared( &m_srw );
+	return fSlower;
+}
 
-tpm20_rng_t::tpm20_rng_t(void): m_hContext( NULL ) {
+VOID metered_rng_t::decide(bool fSlow) {
 
-	TBS_CONTEXT_PARAMS2 contextParams = { 0 };
-	contextParams.version = TBS_CONTEXT_VERSION_TWO;
-	contextParams.includeTpm12 = 0;
-	contextParams.includeTpm20 = 1;
-	HRESULT hResult = ::Tbsi_Context_Create( reinterpret_cast<PCTBS_CONTEXT_PARAMS>( &contextParams ), &m_hContext );
-	if (FAILED( hResult )){
-		m_hContext = NULL;
+	const LONG lSlow = fSlow ? 1 : 0;
+	if (InterlockedExchange( &m_lSlow, lSlow ) != lSlow){
+#if defined (_DEBUG)
+		TCHAR szMessage[0x80] = { 0 };
+		StringCchPrintf( szMessage, _countof( szMessage ), TEXT( "Source %u scheduled to %s\x0A" ),
+			static_cast<UINT>( static_cast<WPGCap>( *m_rng ) ), (fSlow) ? TEXT( "contribute" ) : TEXT( "fill" ) );
+		OutputDebugString( szMessage );
+#endif
 	}
 }
 
-tpm20_rng_t::~tpm20_rng_t(void) {
+VOID metered_rng_t::stats(__out PWPG_SOURCE_STATS pStats) const {
+
+	AcquireSRWLockShared( &m_srw );
+	const DWORD dwProbe = m_dwProbe;
+	pStats->cap = static_cast<WPGCap>( *m_rng );
+	pStats->ullCalls = m_ullCalls;
+	pStats->ullBytes = m_ullBytes;
+	pStats->ullFailures = m_ullFailures;
+	pStats->ullHealthFailures = m_ullHealthFailures;
+	pStats->dwBytesPerSecond = static_cast<DWORD>( min( m_dblBytesPerSecond, static_cast<double>( MAXDWORD ) ) );
+	pStats->dwLatencyMicroseconds = static_cast<DWORD>( min( m_dblLatency, static_cast<double>( MAXDWORD ) ) );
+	ReleaseSRWLockShared( &m_srw );
+	pStats->fSlow = (InterlockedCompareExchange( const_cast<volatile LONG*>( &m_lSlow ), 0, 0 ) != 0);
+	pStats->fTripped = tripped( );
+	pStats->dwProbeMilliseconds = (pStats->fTripped) ? dwProbe : 0;
+}
+
+bool health_t::test(const BYTE* lpData, size_t cbData) {
 
-	if (m_hContext){
-		::Tbsip_Context_Close( m_hContext );
+	for (size_t i = 0; i < cbData; i++){
+		const BYTE b = lpData[i];
+		if ((m_cRepeats > 0) && (b == m_bLast)){
+			m_cRepeats++;
+		}else{
+			m_bLast = b;
+			m_cRepeats = 1;
+		}
+		if (m_cWindow == 0){
+			m_bFirst = b;
+			m_cMatches = 0;
+		}
+		if (b == m_bFirst){
+			m_cMatches++;
+		}
+		if (++m_cWindow == c_cProportionWindow){
+			m_cWindow = 0;
+		}
+		if ((m_cRepeats >= c_cRepetitionCutoff) || (m_cMatches >= c_cProportionCutoff)){
+			*this = health_t( );
+			return false;
+		}
 	}
+	return true;
 }
 
-tpm20_rng_t::size_type tpm20_rng_t::fill(void* buffer, tpm20_rng_t::size_type size) {
-
-#pragma pack(push,1)
-	typedef struct _tpm20_get_random_t {
-		unsigned short tag;
-		unsigned long size;
-		unsigned long code;
-		unsigned short param;
-	} tpm20_get_random_t;
-#pragma pack(pop,1)
-
-	// Allocate a buffer big enough for the command and the output
-	const UINT32 cbCmd = sizeof( tpm20_get_random_t );
-	UINT32 cbBuffer = cbCmd + static_cast<UINT32>( size );
-	auto pBuffer = static_cast<PBYTE>( PH_ALLOC( cbBuffer ) );
-
-	size_type result = 0;
-	for (unsigned long rc = 0; (rc == 0) && (size > result); ){
-		const size_type requested = size - result;
-
-		tpm20_get_random_t cmd = { 0 };
-		cmd.tag = host_to_be16( TPM2_ST_NO_SESSIONS );
-		cmd.size = host_to_be32( sizeof( cmd ) );
-		cmd.code = host_to_be32( TPM2_CC_GET_RANDOM );
-		cmd.param = host_to_be16( static_cast<unsigned short>( requested ) );
-		ZeroMemory( pBuffer, cbBuffer );
-		CopyMemory( pBuffer, &cmd, cbCmd );
-
-		// Submit the command
-		auto cbResult = cbBuffer;
-		HRESULT hResult = ::Tbsip_Submit_Command( m_hContext, TBS_COMMAND_LOCALITY_ZERO, TBS_COMMAND_PRIORITY_NORMAL, pBuffer, cbCmd, pBuffer, &cbResult );
-		if (SUCCEEDED( hResult )){
-			// Check the response code
-			UINT32 uBe32 = 0;
-			CopyMemory( &uBe32, pBuffer + offsetof( tpm20_get_random_t, code ), sizeof( uBe32 ) );
-			rc = be32_to_host( uBe32 ); // Yeah, not necessary..
-			if (rc == 0){
-				CopyMemory( &uBe32, pBuffer + offsetof( tpm20_get_random_t, size ), sizeof( uBe32 ) );
-				const auto generated = min( be32_to_host( uBe32 ) - cbCmd, requested );
-				CopyMemory( static_cast<unsigned char*>( buffer ) + result, pBuffer + cbCmd, generated );
-				result += static_cast<decltype(result)>( generated );
-				continue;
+// Gives the (invariant) arguments for a single call to Generate
+struct generate_args_t {
+	LPTSTR pszBuffer;
+	BYTE cchBuffer;
+	LPCTSTR pszAlphabet;
+	const map_t& map;
+	const xor_t& xor_op;
+	const emit_t& emit_op;
+	const dedupe_t& dedupe_op;
+	LPBYTE lpFront;
+	LPBYTE lpBack;
+	LPBYTE lpIndices;
+	metered_rng_t* const* rngs;
+	const WPGCap* caps;
+	PCWPG_CANCEL pCancel;
+	const BYTE* lpMix;
+	BYTE cbMix;
+	PCWPG_DEADLINE pDeadline;
+};
+
+// Returns true if the request may be completed without the given source, should it miss the deadline or fail;
+// only a request with a deadline (even one of zero, i.e. no time limit) opts in to being completed that way
+inline bool skippable(PCWPG_DEADLINE pDeadline, WPGCap cap) {
+	return (pDeadline != NULL) && ((pDeadline->wpgCapsRequired & cap) == 0);
+}
+
+// Emits generated characters straight into the password, i.e. duplicates are allowed
+class keep_duplicates_t {
+public:
+	keep_duplicates_t(const generate_args_t&) { }
+
+	BYTE emit(const generate_args_t& args, emit_t::size_type generated, BYTE cchFilled) {
+		return static_cast<BYTE>(
+			args.emit_op.apply( args.lpFront, args.lpBack, generated, args.map, args.pszBuffer + cchFilled, args.cchBuffer - cchFilled )
+		);
+	}
+};
+
+// Emits generated characters into the password, skipping those which are already there;
+// the record of which characters have been emitted lives on the stack, and is updated
+// without branching
+template <size_t _bits>
+class skip_duplicates_t {
+public:
+	skip_duplicates_t(const generate_args_t& args): m_bitset( args.map.size( ) ) { }
+
+	BYTE emit(const generate_args_t& args, emit_t::size_type generated, BYTE cchFilled) {
+
+		// N.B. the emitter yields at most the unfilled count, so the stores below stay in bounds
+		const auto count = args.emit_op.apply( args.lpFront, args.lpBack, generated, args.map, args.lpIndices, args.cchBuffer - cchFilled );
+		const auto fresh = test_and_set( args, m_bitset, count );
+		LPTSTR pszNext = args.pszBuffer + cchFilled;
+		for (size_t i = 0; i < fresh; i++){
+			*(pszNext + i) = *(args.pszAlphabet + *(args.lpIndices + i));
+		}
+		SecureZeroMemory( args.lpIndices, args.cchBuffer );
+		return static_cast<BYTE>( fresh );
+	}
+
+private:
+	// Alphabets which fit in a word or so don't benefit from the vector kernels
+	template <size_t _capacity>
+	static size_t test_and_set(const generate_args_t& args, bitset_t<_capacity>& bitset, size_t count) {
+		return bitset.test_and_set( args.lpIndices, count, args.lpIndices );
+	}
+
+	static size_t test_and_set(const generate_args_t& args, dedupe_t::bitset_type& bitset, size_t count) {
+		return args.dedupe_op.apply( bitset, args.lpIndices, count, args.lpIndices );
+	}
+
+	bitset_t<_bits> m_bitset;
+};
+
+// Fills the password from the given number of sources, applying the given policy for duplicates;
+// returns an enumeration of the sources which failed, or WPGCapPARTIAL with those which were skipped
+template <size_t _sources, typename _dedupe>
+static WPGCaps generate_impl(const generate_args_t& args, BYTE& cchFilled) {
+
+	static_assert( _sources > 0, "Need at least one source" );
+
+	_dedupe dedupe( args );
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	WPGCaps wpgCapsSkipped = WPGCapNONE;
+	size_t cbMixed = 0;
+	while ((cchFilled < args.cchBuffer) && (wpgCapsFailed == WPGCapNONE)){
+		const BYTE cchUnfilled = (args.cchBuffer - cchFilled);
+		auto generated = cchUnfilled;
+
+		// Generate some new random values; the first source fills the front buffer directly, any
+		// others are XOR'd into it, except for the last, whose output is combined by the emitter.
+		// Before each round trip to a source, check that the caller still wants the result.
+		// A source which misses the deadline, or fails, is skipped from then on (unless it's required),
+		// its buffer zeroed so that it drops out of the combination
+		bool fFilled = false;
+		for (size_t s = 0; s < _sources; s++){
+			if (WPGCancelled( args.pCancel )){
+				wpgCapsFailed |= WPGCapCANCELLED;
+				break;
+			}
+
+			const bool fFront = (s == 0) && (_sources > 1);
+			const LPBYTE lpFill = fFront ? args.lpFront : args.lpBack;
+			if ((wpgCapsSkipped & args.caps[s]) == 0){
+				const auto filled = args.rngs[s]->fill( lpFill, cchUnfilled, (args.pDeadline) ? args.pDeadline->ullDeadline : 0 );
+				if (filled > 0){
+					fFilled = true;
+					generated = min( generated, filled );
+					if (!fFront && (s + 1 < _sources)){
+						args.xor_op.apply( args.lpFront, args.lpBack, generated );
+					}
+					continue;
+				}
+				if (!skippable( args.pDeadline, args.caps[s] )){
+					wpgCapsFailed |= args.caps[s];
+					continue;
+				}
+				wpgCapsSkipped |= args.caps[s];
 			}
+			SecureZeroMemory( lpFill, cchUnfilled );
 		}
 
-		// Fail if we get here
-		result = 0;
-		break;
+		// Never emit a round which none of the sources filled
+		if (!fFilled && (wpgCapsFailed == WPGCapNONE)){
+			wpgCapsFailed |= wpgCapsSkipped;
+		}
+		if (wpgCapsFailed == WPGCapNONE){
+			// Spread the slower sources' contributions, if any, over the round (the emitter combines the front with the back)
+			for (size_t i = 0; (args.cbMix > 0) && (i < generated); i++, cbMixed++){
+				*(args.lpFront + i) ^= *(args.lpMix + (cbMixed % args.cbMix));
+			}
+			cchFilled += dedupe.emit( args, generated, cchFilled );
+		}
+
+		SecureZeroMemory( args.lpFront, args.cchBuffer );
+		SecureZeroMemory( args.lpBack, args.cchBuffer );
 	}
-	PH_FREE( pBuffer );
-	return result;
+
+	// The kernels' branchless stores run (by a character, or an index) past what they return, so clear
+	// anything left beyond the filled part of the password, should we have stopped short of filling it
+	SecureZeroMemory( args.pszBuffer + cchFilled, sizeof( TCHAR ) * (args.cchBuffer - cchFilled) );
+	if ((wpgCapsFailed == WPGCapNONE) && (wpgCapsSkipped != WPGCapNONE)){
+		return (wpgCapsSkipped | WPGCapPARTIAL);
+	}
+	return wpgCapsFailed;
 }
 
+// Classifies alphabets by the storage needed to record which of their characters have been emitted
+enum alphabet_class_t {
+	alphabet_class_keep = 0, // Duplicates allowed, so no storage needed
+	alphabet_class_16,
+	alphabet_class_64,
+	alphabet_class_256,
+	alphabet_class_count
+};
+
+// Gives the (pre-built) instantiations of generate_impl, indexed by the number of sources (less 1) and alphabet class
+typedef WPGCaps (*generate_fn)(const generate_args_t&, BYTE&);
+
+template <size_t _sources>
+struct generate_row_t {
+	static const generate_fn fns[alphabet_class_count];
+};
+
+template <size_t _sources>
+const generate_fn generate_row_t<_sources>::fns[alphabet_class_count] = {
+	generate_impl<_sources, keep_duplicates_t>,
+	generate_impl<_sources, skip_duplicates_t<16>>,
+	generate_impl<_sources, skip_duplicates_t<64>>,
+	generate_impl<_sources, skip_duplicates_t<256>>
+};
+
+static const generate_fn* const generate_fns[] = {
+	generate_row_t<1>::fns,
+	generate_row_t<2>::fns,
+	generate_row_t<3>::fns
+};
+
+// Gives the instantiation of generate_impl (and the sources it should use) selected for a configuration;
+// a generator builds one for every configuration up front, so they're read-only thereafter
+class generate_plan_t {
+public:
+	generate_plan_t(void): m_caps( WPGCapNONE ), m_class( alphabet_class_count ), m_sources( 0 ), m_fn( NULL ) { }
+
+	WPGCaps m_caps;
+	alphabet_class_t m_class;
+	size_t m_sources;
+	generate_fn m_fn;
+	metered_rng_t* m_rngs[_countof( generate_fns )];
+	WPGCap m_rngCaps[_countof( generate_fns )];
+};
+
+// Gives the mask of the capabilities which select a plan
+constexpr WPGCaps c_wpgCapsPlanned = (WPGCapRDRAND | WPGCapTPM12 | WPGCapTPM20);
+
 class wpg_impl_t : public wpg_t {
 public:
 	wpg_impl_t(void);
@@ -280,37 +645,88 @@ public:
 					 __in WPGCaps,
 					 __inout PBYTE,
 					 __in_z LPCTSTR,
-					 __in BOOL);
+					 __in BOOL,
+					 __in_opt PCWPG_CANCEL,
+					 __in_opt PCWPG_DEADLINE);
+
+	WPGCaps Entropy(__out_bcount(cbBuffer) LPBYTE,
+					__in BYTE cbBuffer,
+					__in WPGCaps,
+					__in_opt PCWPG_CANCEL,
+					__in_opt PCWPG_DEADLINE);
 
 	WPGCaps Caps(void) const;
 
+	// Gives the widest of the extensions in use across the kernels; on any one machine, they're either all
+	// x86 levels (which are ordered by width) or all NEON, so that's just the greatest of them
 	XORVex Vex(void) const {
-		return m_xor->vex( );
+		return (std::max)( { m_xor->vex( ), m_emit->vex( ), m_dedupe->vex( ) } );
 	}
 
+	VOID Schedule(__in PCWPG_SCHEDULE);
+
+	BOOL Stats(__in WPGCap, __out PWPG_SOURCE_STATS) const;
+
 private:
-	::std::vector<::std::unique_ptr<rng_t>> m_rngs;
+	// N.B. none of these change after construction, so concurrent calls to Generate share them
+	// without locking; the TPM sources serialise their own commands, and the meters lock their own
+	::std::vector<::std::unique_ptr<metered_rng_t>> m_rngs;
 	::std::unique_ptr<xor_t> m_xor;
+	::std::unique_ptr<emit_t> m_emit;
+	::std::unique_ptr<dedupe_t> m_dedupe;
+	generate_plan_t m_plans[c_wpgCapsPlanned + 1][alphabet_class_count];
+
+	// The policy for how much to draw from each source
+	mutable SRWLOCK m_srwSchedule;
+	WPG_SCHEDULE m_schedule;
+
+	// Splits the given sources into those which fill the request and those which contribute to it
+	WPGCaps Slow(WPGCaps, const WPG_SCHEDULE&);
+
+	// Returns those of the given sources which are out of rotation
+	WPGCaps Tripped(WPGCaps) const;
+
+	// Takes the sources which are out of rotation out of the given ones, and returns them; or else
+	// returns FALSE (with those which failed the request) if it can't do without them
+	BOOL Rotate(WPGCaps&, PCWPG_DEADLINE, WPGCaps&, WPGCaps&) const;
+
+	// Draws the contributions of the given (slow) sources, XOR'd together into the given buffer, and
+	// health-tested if asked; returns those which failed, and adds those which were skipped to the last argument
+	WPGCaps Contribute(WPGCaps, const WPG_SCHEDULE&, PCWPG_CANCEL, PCWPG_DEADLINE, bool, LPBYTE, WPGCaps&) const;
+
+	// Selects the instantiation of generate_impl for the given configuration
+	const generate_plan_t& Plan(WPGCaps caps, alphabet_class_t alphabetClass) const {
+		return m_plans[caps & c_wpgCapsPlanned][alphabetClass];
+	}
+
+	// Builds the plan for the given configuration from the sources which are available
+	void Build(WPGCaps, alphabet_class_t);
 };
 
-wpg_impl_t::wpg_impl_t(void): m_xor( get_vex_xor( ) ) {
+wpg_impl_t::wpg_impl_t(void): m_xor( get_vex_xor( ) ), m_emit( get_vex_emit( ) ), m_dedupe( get_vex_dedupe( ) ), m_schedule( WPGDefaultSchedule( ) ) {
+
+	InitializeSRWLock( &m_srwSchedule );
 
 	auto rdrand = std::make_unique<rdrand_rng_t>( );
 	if (rdrand && *rdrand){
-		m_rngs.push_back( std::move( rdrand ) );
+		m_rngs.push_back( std::make_unique<metered_rng_t>( std::move( rdrand ) ) );
 	}
 	auto tpm20 = std::make_unique<tpm20_rng_t>( );
 	if (tpm20 && *tpm20){
-		m_rngs.push_back( std::move( tpm20 ) );
-
-		// If we have TPM 2.0, then we don't need TPM 1.2 (below)
-		// So we stop here
-		return;
+		m_rngs.push_back( std::make_unique<metered_rng_t>( std::move( tpm20 ) ) );
+	}else{
+		// If we have TPM 2.0, then we don't need TPM 1.2
+		auto tpm12 = std::make_unique<tpm12_rng_t>( );
+		if (tpm12 && *tpm12){
+			m_rngs.push_back( std::make_unique<metered_rng_t>( std::move( tpm12 ) ) );
+		}
 	}
 
-	auto tpm12 = std::make_unique<tpm12_rng_t>( );
-	if (tpm12 && *tpm12){
-		m_rngs.push_back( std::move( tpm12 ) );
+	// Plan for every configuration now, rather than on demand (and under a lock) later
+	for (WPGCaps caps = WPGCapNONE; caps <= c_wpgCapsPlanned; caps++){
+		for (int c = alphabet_class_keep; c < alphabet_class_count; c++){
+			Build( caps, static_cast<alphabet_class_t>( c ) );
+		}
 	}
 }
 
@@ -319,76 +735,246 @@ WPGCaps wpg_impl_t::Generate(__out_ecount(cchBuffer) LPTSTR pszBuffer,
 							 __in WPGCaps caps,
 							 __inout PBYTE cchLength,
 							 __in_z LPCTSTR pszAlphabet,
-							 __in BOOL fDuplicatesAllowed) {
+							 __in BOOL fDuplicatesAllowed,
+							 __in_opt PCWPG_CANCEL pCancel,
+							 __in_opt PCWPG_DEADLINE pDeadline) {
 
 	// Setup
 	size_t cchAlphabet = 0;
 	StringCchLength( pszAlphabet, STRSAFE_MAX_CCH, &cchAlphabet );
-	std::unique_ptr<empty_bitset_t> bitset = (fDuplicatesAllowed)
-		? std::make_unique<empty_bitset_t>( cchAlphabet )
-		: std::make_unique<bitset_t>( cchAlphabet );
+	const map_t map( pszAlphabet, cchAlphabet );
+	const alphabet_class_t alphabetClass = (fDuplicatesAllowed)
+		? alphabet_class_keep
+		: ((map.size( ) <= 16) ? alphabet_class_16 : ((map.size( ) <= 64) ? alphabet_class_64 : alphabet_class_256));
+
+	// Leave out the sources which are out of rotation, failing straight away if the request can't do without them
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	WPGCaps wpgCapsSkipped = WPGCapNONE;
+	if (!Rotate( caps, pDeadline, wpgCapsSkipped, wpgCapsFailed )){
+		if (cchLength){
+			*cchLength = 0;
+		}
+		return wpgCapsFailed;
+	}
+
+	// Decide which of the sources fill the request, and draw the contributions of the others up front
+	AcquireSRWLockShared( &m_srwSchedule );
+	const WPG_SCHEDULE schedule = m_schedule;
+	ReleaseSRWLockShared( &m_srwSchedule );
+	const WPGCaps slow = Slow( caps, schedule );
+	const generate_plan_t& plan = Plan( caps & ~slow, alphabetClass );
+	BYTE bMix[0x100] = { 0 };
+	wpgCapsFailed = Contribute( slow, schedule, pCancel, pDeadline, false, bMix, wpgCapsSkipped );
+
+	// Use a pair of buffers, and one for the indices when we have to check for duplicates; they're
+	// on the stack, so that concurrent calls don't share (or contend for the heap over) any scratch
+	alignas(32) BYTE bFront[0x100] = { 0 };
+	alignas(32) BYTE bBack[0x100] = { 0 };
+	alignas(32) BYTE bIndices[0x100] = { 0 };
+	LPBYTE lpFront = bFront;
+	LPBYTE lpBack = bBack;
+	LPBYTE lpIndices = (fDuplicatesAllowed) ? NULL : bIndices;
+
+	// Fill the output buffer; with none of the sources asked for to fill it, there's nothing to fill it from
+	BYTE cchFilled = 0;
+	if ((plan.m_fn == NULL) && (wpgCapsFailed == WPGCapNONE)){
+		wpgCapsFailed = WPGCapNOSOURCE;
+	}
+	if (plan.m_fn && (map.size( ) > 0) && (wpgCapsFailed == WPGCapNONE)){
+		const generate_args_t args = {
+			pszBuffer, cchBuffer, pszAlphabet, map, *m_xor, *m_emit, *m_dedupe, lpFront, lpBack, lpIndices, plan.m_rngs, plan.m_rngCaps, pCancel,
+			bMix, static_cast<BYTE>( (slow != WPGCapNONE) ? schedule.cbContribution : 0 ), pDeadline
+		};
+		wpgCapsFailed = plan.m_fn( args, cchFilled );
+	}
+	if (cchLength){
+		*cchLength = cchFilled;
+	}
+
+	// Report any sources which were out of rotation, or whose contributions were skipped, along with
+	// those of the filling sources
+	SecureZeroMemory( bMix, sizeof( bMix ) );
+	if (WPGSucceeded( wpgCapsFailed ) && (wpgCapsSkipped != WPGCapNONE)){
+		wpgCapsFailed |= (wpgCapsSkipped | WPGCapPARTIAL);
+	}
+	return wpgCapsFailed;
+}
 
-	// Allocate a pair of buffers 
-	LPBYTE lpFront = static_cast<LPBYTE>( PH_ALLOC( cchBuffer ) );
-	LPBYTE lpBack = static_cast<LPBYTE>( PH_ALLOC( cchBuffer ) );
+WPGCaps wpg_impl_t::Entropy(__out_bcount(cbBuffer) LPBYTE lpBuffer,
+							__in BYTE cbBuffer,
+							__in WPGCaps caps,
+							__in_opt PCWPG_CANCEL pCancel,
+							__in_opt PCWPG_DEADLINE pDeadline) {
 
-	// Loop until the output buffer is filled
-	decltype(cchBuffer) cchFilled = 0;
+	// Schedule the sources as Generate does
 	WPGCaps wpgCapsFailed = WPGCapNONE;
-	while ((cchFilled < cchBuffer) && (wpgCapsFailed == WPGCapNONE)){
-		const decltype(cchBuffer) cchUnfilled = (cchBuffer - cchFilled);
-		auto generated = cchUnfilled;
+	WPGCaps wpgCapsSkipped = WPGCapNONE;
+	ZeroMemory( lpBuffer, cbBuffer );
+	if (caps == WPGCapNONE){
+		return WPGCapNOSOURCE;
+	}
+	if (!Rotate( caps, pDeadline, wpgCapsSkipped, wpgCapsFailed )){
+		return wpgCapsFailed;
+	}
+	AcquireSRWLockShared( &m_srwSchedule );
+	const WPG_SCHEDULE schedule = m_schedule;
+	ReleaseSRWLockShared( &m_srwSchedule );
+	const WPGCaps slow = Slow( caps, schedule );
+	const generate_plan_t& plan = Plan( caps & ~slow, alphabet_class_keep );
+	BYTE bMix[0x100] = { 0 };
+	wpgCapsFailed = Contribute( slow, schedule, pCancel, pDeadline, true, bMix, wpgCapsSkipped );
+
+	// XOR each of the filling sources' (health-tested) output into the (zeroed) buffer in turn; any
+	// which miss the deadline, or fail, drop out if they can
+	alignas(32) BYTE bBack[0x100] = { 0 };
+	bool fFilled = false;
+	for (size_t s = 0; (s < plan.m_sources) && (wpgCapsFailed == WPGCapNONE); s++){
+		if (WPGCancelled( pCancel )){
+			wpgCapsFailed |= WPGCapCANCELLED;
+			break;
+		}
+		metered_rng_t* pRng = plan.m_rngs[s];
+		if (pRng->fill_tested( bBack, cbBuffer, (pDeadline) ? pDeadline->ullDeadline : 0 ) == cbBuffer){
+			m_xor->apply( lpBuffer, bBack, cbBuffer );
+			fFilled = true;
+		}else if (skippable( pDeadline, plan.m_rngCaps[s] )){
+			wpgCapsSkipped |= plan.m_rngCaps[s];
+		}else{
+			wpgCapsFailed |= plan.m_rngCaps[s];
+		}
+	}
+	if (!fFilled && (wpgCapsFailed == WPGCapNONE)){
+		wpgCapsFailed = (wpgCapsSkipped != WPGCapNONE) ? wpgCapsSkipped : ((caps != WPGCapNONE) ? caps : WPGCapNOSOURCE);
+	}
+	if ((wpgCapsFailed == WPGCapNONE) && (slow != WPGCapNONE)){
+		for (size_t i = 0; i < cbBuffer; i++){
+			lpBuffer[i] ^= bMix[i % schedule.cbContribution];
+		}
+	}
 
-		// Generate some new random values
-		using rng_type = decltype(m_rngs)::value_type;
-		using size_type = rng_type::element_type::size_type;
-		::std::for_each( m_rngs.cbegin( ), m_rngs.cend( ), [&](const rng_type& rng) {
-			const auto cap = static_cast<WPGCap>( *rng );
-			if ((caps & cap) == 0){
-				// The caller hasn't asked to use the current RNG, so just skip over it
-				return;
-			}
+	SecureZeroMemory( bBack, sizeof( bBack ) );
+	SecureZeroMemory( bMix, sizeof( bMix ) );
+	if (wpgCapsFailed != WPGCapNONE){
+		SecureZeroMemory( lpBuffer, cbBuffer );
+		return wpgCapsFailed;
+	}
+	return (wpgCapsSkipped != WPGCapNONE) ? (wpgCapsSkipped | WPGCapPARTIAL) : WPGCapNONE;
+}
 
-			const auto filled = rng->fill( lpBack, static_cast<size_type>( cchUnfilled ) );
-			if (filled){
-				// Xor with previously-generated values (if any)
-				generated = min( generated, filled );
-				m_xor->apply( lpFront, lpBack, generated );
+BOOL wpg_impl_t::Rotate(WPGCaps& caps, PCWPG_DEADLINE pDeadline, WPGCaps& tripped, WPGCaps& failed) const {
+
+	tripped = Tripped( caps );
+	if (tripped != WPGCapNONE){
+		const WPGCaps required = tripped & ((pDeadline) ? pDeadline->wpgCapsRequired : tripped);
+		if ((required != WPGCapNONE) || (Plan( caps & ~tripped, alphabet_class_keep ).m_sources == 0)){
+			failed = (required != WPGCapNONE) ? required : tripped;
+			return FALSE;
+		}
+		caps &= ~tripped;
+	}
+	return TRUE;
+}
+
+WPGCaps wpg_impl_t::Contribute(WPGCaps slow, const WPG_SCHEDULE& schedule, PCWPG_CANCEL pCancel, PCWPG_DEADLINE pDeadline, bool fTested, LPBYTE lpMix, WPGCaps& skipped) const {
+
+	WPGCaps failed = WPGCapNONE;
+	::std::for_each( m_rngs.cbegin( ), m_rngs.cend( ), [&](const decltype(m_rngs)::value_type& rng) {
+		BYTE bContribution[0x100] = { 0 };
+		const auto cap = static_cast<WPGCap>( *rng );
+		if ((slow & cap) && (failed == WPGCapNONE) && !WPGCancelled( pCancel )){
+			const ULONGLONG ullDeadline = (pDeadline) ? pDeadline->ullDeadline : 0;
+			const rng_t::size_type filled = (fTested)
+				? rng->fill_tested( bContribution, schedule.cbContribution, ullDeadline )
+				: rng->fill( bContribution, schedule.cbContribution, ullDeadline );
+			if (filled == schedule.cbContribution){
+				m_xor->apply( lpMix, bContribution, schedule.cbContribution );
+			}else if (skippable( pDeadline, cap )){
+				skipped |= cap;
 			}else{
-				wpgCapsFailed |= cap;
+				failed |= cap;
 			}
-		} );
-		if (wpgCapsFailed == WPGCapNONE){
-			// Use the contents of the front buffer as an index into the alphabet, to generate the password
-			for (decltype(generated) i = 0; i < generated; i++ ){
-				const auto rand = static_cast<decltype(cchAlphabet)>( *(lpFront + i) );
-				const auto index = rand % cchAlphabet;
-				if (bitset->is_set( index )){
-#if defined (_DEBUG)
-					TCHAR szBuf[2] = { *(pszAlphabet + index), NULL };
-					OutputDebugString( TEXT( "Already have: " ) );
-					OutputDebugString( szBuf );
-					OutputDebugString( TEXT( ". Skipping..\x0A" ) );
-#endif
-					continue;
-				}
+			SecureZeroMemory( bContribution, sizeof( bContribution ) );
+		}
+	} );
+	return failed;
+}
 
-				*(pszBuffer + (cchFilled++)) = *(pszAlphabet + index);
-				bitset->set( index );
+WPGCaps wpg_impl_t::Slow(WPGCaps caps, const WPG_SCHEDULE& schedule) {
+
+	// Find the sources which have been measured as slow
+	WPGCaps slow = WPGCapNONE;
+	if ((schedule.schedule == WPGScheduleADAPTIVE) && (schedule.cbContribution > 0)){
+		::std::for_each( m_rngs.cbegin( ), m_rngs.cend( ), [&](const decltype(m_rngs)::value_type& rng) {
+			const auto cap = static_cast<WPGCap>( *rng );
+			if ((caps & cap) && rng->slower_than( schedule.dwSlowBelow )){
+				slow |= cap;
 			}
+		} );
+	}
+
+	// ..but only let them contribute if there's a faster one left to fill; record the decisions
+	if (Plan( caps & ~slow, alphabet_class_keep ).m_sources == 0){
+		slow = WPGCapNONE;
+	}
+	::std::for_each( m_rngs.cbegin( ), m_rngs.cend( ), [&](const decltype(m_rngs)::value_type& rng) {
+		const auto cap = static_cast<WPGCap>( *rng );
+		if (caps & cap){
+			rng->decide( (slow & cap) != 0 );
+		}
+	} );
+	return slow;
+}
+
+WPGCaps wpg_impl_t::Tripped(WPGCaps caps) const {
+
+	WPGCaps tripped = WPGCapNONE;
+	::std::for_each( m_rngs.cbegin( ), m_rngs.cend( ), [&](const decltype(m_rngs)::value_type& rng) {
+		const auto cap = static_cast<WPGCap>( *rng );
+		if ((caps & cap) && rng->tripped( )){
+			tripped |= cap;
 		}
+	} );
+	return tripped;
+}
+
+VOID wpg_impl_t::Schedule(__in PCWPG_SCHEDULE pSchedule) {
 
-		SecureZeroMemory( lpFront, cchBuffer );
-		SecureZeroMemory( lpBack, cchBuffer );
+	if (pSchedule){
+		AcquireSRWLockExclusive( &m_srwSchedule );
+		m_schedule = *pSchedule;
+		ReleaseSRWLockExclusive( &m_srwSchedule );
 	}
-	if (cchLength){
-		*cchLength = cchFilled;
+}
+
+BOOL wpg_impl_t::Stats(__in WPGCap cap, __out PWPG_SOURCE_STATS pStats) const {
+
+	const auto it = ::std::find_if( m_rngs.cbegin( ), m_rngs.cend( ), [&](const decltype(m_rngs)::value_type& rng) {
+		return (static_cast<WPGCap>( *rng ) == cap);
+	} );
+	if ((it == m_rngs.cend( )) || (pStats == NULL)){
+		return FALSE;
 	}
+	(*it)->stats( pStats );
+	return TRUE;
+}
 
-	// Cleanup, return
-	PH_FREE( lpFront );
-	PH_FREE( lpBack );
-	return wpgCapsFailed;
+void wpg_impl_t::Build(WPGCaps caps, alphabet_class_t alphabetClass) {
+
+	// Resolve the sources which the caller has asked for, in order
+	generate_plan_t& plan = m_plans[caps][alphabetClass];
+	plan.m_caps = caps;
+	plan.m_class = alphabetClass;
+	::std::for_each( m_rngs.cbegin( ), m_rngs.cend( ), [&](const decltype(m_rngs)::value_type& rng) {
+		const auto cap = static_cast<WPGCap>( *rng );
+		if ((caps & cap) && (plan.m_sources < _countof( plan.m_rngs ))){
+			plan.m_rngs[plan.m_sources] = rng.get( );
+			plan.m_rngCaps[plan.m_sources] = cap;
+			plan.m_sources++;
+		}
+	} );
+	if (plan.m_sources > 0){
+		plan.m_fn = generate_fns[plan.m_sources - 1][alphabetClass];
+	}
 }
 
 WPGCaps wpg_impl_t::Caps(void) const {
@@ -451,6 +1037,13 @@ static SIZE_T RdRandFill(PVOID buffer, const SIZE_T size) {
 	return filled;
 }
 
+WPG_SCHEDULE WPGDefaultSchedule(void) {
+
+	// Anything below a megabyte a second is a TPM, or worse, and contributes 256 bits per password
+	WPG_SCHEDULE schedule = { WPGScheduleADAPTIVE, 0x100000, 0x20 };
+	return schedule;
+}
+
 WPGCap WPGCapsFirst(WPGCaps caps) {
 
 	DWORD dw = 1;
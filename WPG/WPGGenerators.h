@@ -30,22 +30,129 @@ typedef enum _WPGCap {
 	WPGCapTPM12 = 2,
 	WPGCapTPM20 = 4,
 
+	// Not a generator; set when a request was given no sources which could fill it (or nothing to fill), so
+	// that it fails rather than giving back the zeroed (or empty) buffer as though it were filled
+	WPGCapNOSOURCE = 0x20000000,
+
+	// Not a generator; set (with the sources which were skipped) when a request was completed without
+	// some of its sources, because they missed its deadline, failed, or were out of rotation
+	WPGCapPARTIAL = 0x40000000,
+
+	// Not a generator; set when a request was superseded before it could be completed
+	WPGCapCANCELLED = 0x80000000,
+
 } WPGCap;
 
 typedef DWORD WPGCaps;
 
+// Identifies a request which may be superseded (by a later generation) while it's being generated
+typedef struct _WPG_CANCEL {
+
+	const volatile LONG* plLatest;
+	LONG lGeneration;
+
+} WPG_CANCEL, *PWPG_CANCEL;
+
+typedef const WPG_CANCEL* PCWPG_CANCEL;
+
+// Bounds the time a request may take: sources which can't deliver by the deadline (or which fail) are
+// skipped, and the request completed from the rest, so long as they include the required ones. Without
+// one, no source is ever skipped: the request fails if any fails, or is out of rotation
+typedef struct _WPG_DEADLINE {
+
+	// The deadline, against GetTickCount64; zero for none
+	ULONGLONG ullDeadline;
+
+	// The sources which may not be skipped, i.e. the request fails if any of them misses the deadline,
+	// fails, or is out of rotation
+	WPGCaps wpgCapsRequired;
+
+} WPG_DEADLINE, *PWPG_DEADLINE;
+
+typedef const WPG_DEADLINE* PCWPG_DEADLINE;
+
+// Identifies the policies for how much to draw from each source per request
+typedef enum _WPGSchedule {
+
+	// Every source fills the whole of every request
+	WPGScheduleFULL = 0,
+
+	// Sources measured to be slower than a threshold contribute a fixed number of bytes to each request,
+	// which are mixed across the output of the faster sources; if none are faster, all of them fill
+	WPGScheduleADAPTIVE = 1,
+
+} WPGSchedule;
+
+// Configures the scheduling of the sources
+typedef struct _WPG_SCHEDULE {
+
+	WPGSchedule schedule;
+
+	// The throughput, in bytes per second, below which a source is considered slow
+	DWORD dwSlowBelow;
+
+	// The number of bytes drawn from each slow source per request
+	BYTE cbContribution;
+
+} WPG_SCHEDULE, *PWPG_SCHEDULE;
+
+typedef const WPG_SCHEDULE* PCWPG_SCHEDULE;
+
+// Reports what's been measured of a source, what the schedule last decided for it, and its health
+typedef struct _WPG_SOURCE_STATS {
+
+	WPGCap cap;
+	ULONG64 ullCalls;
+	ULONG64 ullBytes;
+	ULONG64 ullFailures;
+
+	// The fills of raw output (see Entropy) discarded for failing the health tests; these count
+	// among the failures too
+	ULONG64 ullHealthFailures;
+
+	// Exponentially-weighted moving averages, over recent calls
+	DWORD dwBytesPerSecond;
+	DWORD dwLatencyMicroseconds;
+
+	// TRUE if the source was last scheduled to contribute, rather than fill
+	BOOL fSlow;
+
+	// TRUE if the source has been taken out of rotation after failing repeatedly; it's probed in
+	// the background, at the given interval (in milliseconds), until it recovers
+	BOOL fTripped;
+	DWORD dwProbeMilliseconds;
+
+} WPG_SOURCE_STATS, *PWPG_SOURCE_STATS;
+
 // Class(es)
 //
 
 class wpg_t {
 public:
-	// Generates a password in the given output buffer; returns an enumeration of the generators which failed
+	// Generates a password in the given output buffer; returns an enumeration of the generators which failed,
+	// or WPGCapCANCELLED if the given request was superseded between rounds of filling from the sources,
+	// or WPGCapPARTIAL with those skipped for missing the given deadline, failing or being out of rotation
+	// (see WPGSucceeded), or WPGCapNOSOURCE if none of the given sources is there to fill it.
+	// Safe to call concurrently, from any number of threads, on the one instance
 	virtual WPGCaps Generate(__out_ecount(cchBuffer) LPTSTR pszBuffer,
 							 __in BYTE cchBuffer,
 							 __in WPGCaps,
 							 __inout PBYTE,
 							 __in_z LPCTSTR,
-							 __in BOOL) = 0;
+							 __in BOOL,
+							 __in_opt PCWPG_CANCEL = NULL,
+							 __in_opt PCWPG_DEADLINE = NULL) = 0;
+
+	// Fills the given buffer with the output of the given sources XOR'd together, rather than mapping
+	// it onto an alphabet; returns as Generate does (and the given sources, if it isn't supported).
+	// Safe to call concurrently
+	virtual WPGCaps Entropy(__out_bcount(cbBuffer) LPBYTE lpBuffer,
+							__in BYTE cbBuffer,
+							__in WPGCaps wpgCaps,
+							__in_opt PCWPG_CANCEL = NULL,
+							__in_opt PCWPG_DEADLINE = NULL) {
+		return wpgCaps;
+	}
 
 	// Return a token indicating the vector extensions being used by the generator
 	virtual XORVex Vex(void) const {
@@ -57,6 +164,14 @@ public:
 		return WPGCapNONE;
 	}
 
+	// Sets the policy for how much to draw from each source
+	virtual VOID Schedule(__in PCWPG_SCHEDULE) { }
+
+	// Retrieves what's been measured of the given source, and what was last decided for it; returns FALSE if there's no such source
+	virtual BOOL Stats(__in WPGCap, __out PWPG_SOURCE_STATS) const {
+		return FALSE;
+	}
+
 	// Instantiates a new generator
 	static std::shared_ptr<wpg_t> New(void);
 };
@@ -69,4 +184,22 @@ typedef wpg_t* wpg_ptr;
 // Returns the first set capability of the given collection of capabilities
 WPGCap WPGCapsFirst(WPGCaps);
 
+// Returns the schedule used by generators unless they're told otherwise
+WPG_SCHEDULE WPGDefaultSchedule(void);
+
+// Returns TRUE if the given result of Generate gives a password, i.e. none of the sources failed (though some may have been skipped)
+inline BOOL WPGSucceeded(__in WPGCaps wpgCapsFailed) {
+	return (wpgCapsFailed == WPGCapNONE) || ((wpgCapsFailed & (WPGCapPARTIAL | WPGCapCANCELLED)) == WPGCapPARTIAL);
+}
+
+// Returns TRUE if the given deadline has passed
+inline BOOL WPGDeadlinePassed(__in_opt PCWPG_DEADLINE pDeadline) {
+	return (pDeadline && pDeadline->ullDeadline && (GetTickCount64( ) >= pDeadline->ullDeadline));
+}
+
+// Returns TRUE if the given request has been superseded
+inline BOOL WPGCancelled(__in_opt PCWPG_CANCEL pCancel) {
+	return (pCancel && pCancel->plLatest && (*(pCancel->plLatest) != pCancel->lGeneration));
+}
+
 #endif // !defined(__WPG_GENERATORS_H__)
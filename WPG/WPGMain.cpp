@@ -12,13 +12,15 @@
 
 // Local Project Headers
 #include "WPGAboutEtc.h"
+#include "WPGAlphabet.h"
 #include "WPGRegistry.h"
+#include "CpuFeatures.h"
 
 // Macros
 //
 
 // Custom Windows messages we post to ourselves
-#define UWM_REFRESH				(AWM_WPG_STOPPED+1L)
+#define UWM_REFRESH				(AWM_WPG_COMPLETED+1L)
 #define UWM_COPY				(UWM_REFRESH+1L)
 
 // Constants
@@ -39,6 +41,9 @@ const BYTE c_cchMinLength = 0x01;
 const BYTE c_cchMaxLength = 0xFF;
 const BYTE c_cchDefaultLength = 0x10;
 
+// Specifies the longest input alphabet, in characters: enough for the most symbols, all beyond the BMP
+const DWORD c_cchMaxAlphabet = WPG_ALPHABET_UNITS_MAX * WPG_ALPHABET_MAX;
+
 const DWORD c_dwRDRANDCheck = 0x80000000;
 const DWORD c_dwTPMCheck = 0x00800000;
 const DWORD c_dwAutoCopyCheck = 0x00008000;
@@ -69,6 +74,9 @@ HRESULT OnReset(HWND);
 // Called when the user selects to copy the generated password to the clipboard
 HRESULT OnCopy(HWND);
 
+// Posts a request to refresh the generated password, unless there's one waiting already
+VOID PostRefresh(HWND);
+
 // Called when a new password is to be generated
 HRESULT OnRefresh(HWND);
 
@@ -81,6 +89,9 @@ HRESULT OnClose(HWND);
 // Called when the timer for the clipboard fires
 HRESULT OnClipboardTimerElapsed(HWND);
 
+// Called when the generator has completions waiting for us
+HRESULT OnGeneratorCompleted(HWND);
+
 // Called when the generator thread has started
 HRESULT OnGeneratorStarted(HWND, WPARAM, LPARAM);
 
@@ -114,6 +125,9 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 	UNREFERENCED_PARAMETER( hPrevInstance );
 	UNREFERENCED_PARAMETER( nCmdShow );
 
+	// Detect the CPU's features up front, so that every later dispatch sees the same answer
+	get_cpu_features( );
+
 	// Initialise the Common Controls Library; ensure that the progress control is available
 	INITCOMMONCONTROLSEX icex = { 0L };
 	icex.dwICC = ICC_BAR_CLASSES | ICC_LINK_CLASS;
@@ -203,7 +217,7 @@ INT_PTR CALLBACK MainDialogProc(HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
 					break;
 
 				case IDC_BUTTON_REFRESH:
-					PostMessage( hDlg, UWM_REFRESH, 0, 0 );
+					PostRefresh( hDlg );
 					break;
 
 				case IDC_BUTTON_COPY:
@@ -221,7 +235,7 @@ INT_PTR CALLBACK MainDialogProc(HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
 				case IDC_CHECK_RDRAND:
 				case IDC_CHECK_TPM:
 					if (HIWORD( wParam ) == BN_CLICKED){
-						PostMessage( hDlg, UWM_REFRESH, 0, 0 );
+						PostRefresh( hDlg );
 					}
 					break;
 
@@ -296,6 +310,10 @@ INT_PTR CALLBACK MainDialogProc(HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
 		}
 			break;
 
+		case AWM_WPG_COMPLETED:
+			OnGeneratorCompleted( hDlg );
+			break;
+
 		case AWM_WPG_STARTED:
 			OnGeneratorStarted( hDlg, wParam, lParam );
 			break;
@@ -411,6 +429,7 @@ HRESULT OnInitDialog(HWND hDlg) {
 	SendMessage( hSlider, TBM_SETPOS, TRUE, dwLength );
 
 	// Seed the input from registry, above, (or resources) and do the initial 'refresh'
+	SendDlgItemMessage( hDlg, IDC_EDIT_INPUT, EM_SETLIMITTEXT, c_cchMaxAlphabet, 0 );
 	if (pszAlphabet){
 		HWND hInput = GetDlgItem( hDlg, IDC_EDIT_INPUT );
 		SetWindowText( hInput, pszAlphabet );
@@ -504,6 +523,20 @@ HRESULT OnCopy(HWND hDlg) {
 	return hResult;
 }
 
+VOID PostRefresh(HWND hDlg) {
+
+	// Coalesce bursts (e.g. from dragging the slider, or typing) into one refresh; the
+	// generator drops anything superseded which does get through
+	UIStatePtr uiStatePtr = reinterpret_cast<UIStatePtr>( GetWindowLongPtr( hDlg, GWLP_USERDATA ) );
+	if (uiStatePtr){
+		if (uiStatePtr->fRefreshPending){
+			return;
+		}
+		uiStatePtr->fRefreshPending = TRUE;
+	}
+	PostMessage( hDlg, UWM_REFRESH, 0, 0 );
+}
+
 HRESULT OnRefresh(HWND hDlg) {
 
 	// Find the intersection between the available generators and the ones the user has selected
@@ -511,6 +544,7 @@ HRESULT OnRefresh(HWND hDlg) {
 	if (uiStatePtr == NULL){
 		return E_POINTER;
 	}
+	uiStatePtr->fRefreshPending = FALSE;
 
 	WPGCaps caps = uiStatePtr->wpgCaps;
 	if (!IsDlgButtonChecked( hDlg, IDC_CHECK_RDRAND )){
@@ -527,11 +561,9 @@ HRESULT OnRefresh(HWND hDlg) {
 		return S_OK;
 	}
 
-	// Allocate a buffer for the output
+	// Read the length of the output
 	HWND hSlider = GetDlgItem( hDlg, IDC_SLIDER_OUTPUT );
 	BYTE cchPwd = static_cast<BYTE>( SendMessage( hSlider, TBM_GETPOS, 0, 0 ) );
-	HANDLE hProcessHeap = GetProcessHeap( );
-	LPTSTR pszPwd = static_cast<LPTSTR>( HeapAlloc( hProcessHeap, HEAP_ZERO_MEMORY, sizeof( TCHAR ) * (cchPwd+1) ) );
 
 	// Send to the generator thread
 	WPG_H wpgHandle = (uiStatePtr) ? uiStatePtr->wpgHandle : NULL;
@@ -545,15 +577,37 @@ HRESULT OnRefresh(HWND hDlg) {
 HRESULT OnPwdGenerated(HWND hDlg, WPARAM wParam, LPARAM lParam) {
 
 	const WPGCaps wpgCapsFailed = static_cast<WPGCaps>( lParam );
-	HRESULT hResult = (wpgCapsFailed == WPGCapNONE) ? S_OK : E_FAIL;
+	HRESULT hResult = WPGSucceeded( wpgCapsFailed ) ? S_OK : E_FAIL;
 	if (SUCCEEDED( hResult )){
 		LPCTSTR pszPwd = reinterpret_cast<LPCTSTR>( wParam );
 
 		// Set the output
-		SetWindowText( GetDlgItem( hDlg, IDC_EDIT_OUTPUT ), pszPwd );
+		HWND hOutput = GetDlgItem( hDlg, IDC_EDIT_OUTPUT );
+		SetWindowText( hOutput, pszPwd );
 		if (IsDlgButtonChecked( hDlg, IDC_CHECK_AUTO_COPY )){
 			PostMessage( hDlg, UWM_COPY, 0U, 0U );
 		}
+
+		// Point out if it was completed without some of the sources
+		if (wpgCapsFailed & WPGCapPARTIAL){
+			HINSTANCE hInstance = reinterpret_cast<HINSTANCE>( GetWindowLongPtr( hDlg, GWLP_HINSTANCE ) );
+			LPTSTR pszTitle = LoadStringProcessHeap( hInstance, IDS_PARTIAL_TITLE );
+			LPTSTR pszText = LoadStringProcessHeap( hInstance, IDS_PARTIAL_TEXT );
+			if (pszTitle && pszText){
+				EDITBALLOONTIP balloon = { 0 };
+				balloon.cbStruct = sizeof( balloon );
+				balloon.pszTitle = pszTitle;
+				balloon.pszText = pszText;
+				balloon.ttiIcon = TTI_WARNING;
+				Edit_ShowBalloonTip( hOutput, &balloon );
+			}
+			if (pszTitle){
+				PH_FREE( pszTitle );
+			}
+			if (pszText){
+				PH_FREE( pszText );
+			}
+		}
 	}else{
 		SetErrorMsg( hDlg, wpgCapsFailed );
 	}
@@ -589,7 +643,7 @@ HRESULT OnPwdAlphabetChanged(HWND hDlg) {
 		GetWindowText( hInput, pszAlphabet, (cchAlphabet+1) );
 
 		// Set it at the generator thread
-		SetPwdAlphabetAsync( wpgHandle, pszAlphabet, static_cast<BYTE>( cchAlphabet ) );
+		SetPwdAlphabetAsync( wpgHandle, pszAlphabet, static_cast<DWORD>( cchAlphabet ) );
 		PH_FREE( pszAlphabet );
 	}
 	AutoCheckDuplicatesAndRefresh( hDlg );
@@ -621,6 +675,29 @@ HRESULT OnClipboardTimerElapsed(HWND hDlg) {
 	return S_OK;
 }
 
+HRESULT OnGeneratorCompleted(HWND hDlg) {
+
+	UIStatePtr uiStatePtr = reinterpret_cast<UIStatePtr>( GetWindowLongPtr( hDlg, GWLP_USERDATA ) );
+	WPG_H wpgHandle = (uiStatePtr) ? uiStatePtr->wpgHandle : NULL;
+	if (wpgHandle == NULL){
+		return S_FALSE;
+	}
+
+	// Drain the completions, handing each to the dialog procedure as the message it names
+	WPG_COMPLETION completion = { 0 };
+	while (WPGPopCompletion( wpgHandle, &completion )){
+		const UINT uMessage = completion.uMessage;
+		SendMessage( hDlg, uMessage, completion.wParam, completion.lParam );
+		SecureZeroMemory( &completion, sizeof( completion ) );
+
+		// The generator (and with it, the handle) is cleaned up once it has stopped
+		if (uMessage == AWM_WPG_STOPPED){
+			break;
+		}
+	}
+	return S_OK;
+}
+
 HRESULT OnGeneratorStarted(HWND hDlg, WPARAM wParam, LPARAM lParam) {
 
 	OutputDebugString( TEXT( "AWM_WPG_STARTED\x0D" ) );
@@ -718,6 +795,7 @@ HRESULT OnGeneratorStopped(HWND hDlg) {
 		for (DWORD dw = 0; dw < uiStatePtr->dwTooltips; ++dw){
 			DestroyWindow( *(uiStatePtr->phTooltips + dw) );
 		}
+		SetWindowLongPtr( hDlg, GWLP_USERDATA, 0 );
 		PH_FREE( uiStatePtr );
 	}
 	return S_OK;
@@ -749,7 +827,7 @@ LPTSTR NonDefaultAlphabet(HWND hDlg) {
 
 VOID SetErrorMsg(HWND hDlg, WPGCaps caps){
 
-	UINT u = IDS_ERROR_UNKNOWN;
+	UINT u = (caps & WPGCapNOSOURCE) ? IDS_ERROR_ALPHABET : IDS_ERROR_UNKNOWN;
 	switch (WPGCapsFirst( caps )){
 		case WPGCapRDRAND:
 			u = IDS_ERROR_RDRAND;
@@ -806,5 +884,5 @@ VOID AutoCheckDuplicatesAndRefresh(HWND hDlg) {
 	EnableWindow( GetDlgItem( hDlg, IDC_CHECK_ALLOW_DUPLICATES ), fEnabled );
 
 	// Refresh the generated password with the new configuration
-	PostMessage( hDlg, UWM_REFRESH, 0, 0 );
+	PostRefresh( hDlg );
 }
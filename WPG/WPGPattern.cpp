@@ -0,0 +1,359 @@
+// WPGPattern.cpp: gives the implementation for generating passwords from patterns.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// A pattern is compiled once into a plan: the (distinct) classes it uses, each mapped (as for an
+// alphabet) onto the byte range with the remainder at the top of it rejected, the class (or literal
+// character) for each position, and the number of bytes to draw for each password. Every random
+// position takes one byte, and so needs more only when that byte is rejected; the plan draws as
+// many bytes as cover the rejections of all but one in a few billion passwords, so that each is
+// generated from a single fill of the sources' output, drawing again only when that runs out.
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// C Standard Library Headers
+#include <math.h>
+
+// C++ Standard Library Headers
+#include <new>
+
+// Declarations
+#include "WPGPattern.h"
+
+// Constants
+//
+
+// The most characters in a password (or class), and the most distinct classes in a pattern
+constexpr SIZE_T c_cchMaxPattern = 0xFF;
+constexpr SIZE_T c_cMaxPatternClasses = 16;
+
+// Marks a position which is given a literal character, rather than drawn from a class
+constexpr BYTE c_bPatternLiteral = 0xFF;
+
+// The probability, at most, that a password needs more than the bytes drawn for it
+const double c_dPatternShortfall = (1.0 / 4294967296.0);
+
+// Gives the built-in classes
+static const struct {
+	TCHAR chToken;
+	LPCTSTR pszChars;
+} c_patternClasses[] = {
+	{ TEXT( '9' ), TEXT( "0123456789" ) },
+	{ TEXT( 'a' ), TEXT( "abcdefghijklmnopqrstuvwxyz" ) },
+	{ TEXT( 'A' ), TEXT( "ABCDEFGHIJKLMNOPQRSTUVWXYZ" ) },
+	{ TEXT( 'c' ), TEXT( "bcdfghjklmnpqrstvwxyz" ) },
+	{ TEXT( 'C' ), TEXT( "BCDFGHJKLMNPQRSTVWXYZ" ) },
+	{ TEXT( 'v' ), TEXT( "aeiou" ) },
+	{ TEXT( 'V' ), TEXT( "AEIOU" ) },
+	{ TEXT( 'x' ), TEXT( "abcdefghijklmnopqrstuvwxyz0123456789" ) },
+	{ TEXT( 'X' ), TEXT( "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789" ) },
+	{ TEXT( 'h' ), TEXT( "0123456789abcdef" ) },
+	{ TEXT( 'H' ), TEXT( "0123456789ABCDEF" ) },
+	{ TEXT( 's' ), TEXT( "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~" ) },
+	{ TEXT( '*' ), TEXT( "!\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~" ) }
+};
+
+// Types
+//
+
+typedef struct _WPG_PATTERN_INSTANCE {
+
+	// The length of the passwords, and their entropy
+	BYTE cchLength;
+	double dBits;
+
+	// The bytes drawn for each password
+	BYTE cbDraw;
+
+	// The class (or literal character) for each position
+	BYTE bClasses[c_cchMaxPattern];
+	TCHAR chLiterals[c_cchMaxPattern];
+
+	// The characters of each class, and the map of the byte range onto them
+	BYTE cClasses;
+	TCHAR szClasses[c_cMaxPatternClasses][c_cchMaxPattern + 1];
+	map_t maps[c_cMaxPatternClasses];
+
+} WPG_PATTERN_INSTANCE, *PWPG_PATTERN_INSTANCE;
+
+// Functions
+//
+
+// Appends the given character to the given class, unless it's already in it; returns FALSE if the class is full
+static BOOL WPGPatternAppend(__inout LPTSTR pszClass, __inout SIZE_T& cchClass, __in TCHAR ch) {
+
+	for (SIZE_T i = 0; i < cchClass; i++){
+		if (pszClass[i] == ch){
+			return TRUE;
+		}
+	}
+	if (cchClass == c_cchMaxPattern){
+		return FALSE;
+	}
+	pszClass[cchClass++] = ch;
+	pszClass[cchClass] = TEXT( '\0' );
+	return TRUE;
+}
+
+// Parses the set (e.g. "[a-f0-9]") at the given position in the pattern, into the given class; returns the
+// position which follows it, or NULL if it's malformed
+static LPCTSTR WPGPatternParseSet(__in_z LPCTSTR psz, __out_ecount(c_cchMaxPattern + 1) LPTSTR pszClass) {
+
+	SIZE_T cchClass = 0;
+	pszClass[0] = TEXT( '\0' );
+	for (psz++; *psz != TEXT( ']' ); ){
+		if (*psz == TEXT( '\\' )){
+			psz++;
+		}
+		if (*psz == TEXT( '\0' )){
+			return NULL;
+		}
+		TCHAR chFirst = *psz++, chLast = chFirst;
+		if ((*psz == TEXT( '-' )) && (*(psz + 1) != TEXT( ']' )) && (*(psz + 1) != TEXT( '\0' ))){
+			psz++;
+			if (*psz == TEXT( '\\' )){
+				psz++;
+			}
+			if ((*psz == TEXT( '\0' )) || (*psz < chFirst)){
+				return NULL;
+			}
+			chLast = *psz++;
+		}
+		for (TCHAR ch = chFirst; ; ch++){
+			if (!WPGPatternAppend( pszClass, cchClass, ch )){
+				return NULL;
+			}
+			if (ch == chLast){
+				break;
+			}
+		}
+	}
+	return (cchClass > 0) ? (psz + 1) : NULL;
+}
+
+// Returns the index of the given class in the pattern, adding it if it's new; or c_bPatternLiteral if there's no room for it
+static BYTE WPGPatternClass(__inout PWPG_PATTERN_INSTANCE pPattern, __in_z LPCTSTR pszClass) {
+
+	for (BYTE b = 0; b < pPattern->cClasses; b++){
+		if (lstrcmp( pPattern->szClasses[b], pszClass ) == 0){
+			return b;
+		}
+	}
+	if (pPattern->cClasses == c_cMaxPatternClasses){
+		return c_bPatternLiteral;
+	}
+	const BYTE b = pPattern->cClasses++;
+	size_t cchClass = 0;
+	StringCchCopy( pPattern->szClasses[b], _countof( pPattern->szClasses[b] ), pszClass );
+	StringCchLength( pszClass, _countof( pPattern->szClasses[b] ), &cchClass );
+	pPattern->maps[b] = map_t( pPattern->szClasses[b], cchClass );
+	return b;
+}
+
+BYTE WPGPatternBytes(__in_ecount(cPositions) const double* pdAccept, __in SIZE_T cPositions) {
+
+	// The bytes taken by each position are geometrically distributed, so the distribution of those
+	// taken by the password is built up a position at a time
+	double dTaken[0x100] = { 1.0 };
+	const SIZE_T cRandom = min( cPositions, _countof( dTaken ) - 1 );
+	for (SIZE_T p = 0; p < cRandom; p++){
+		double dPrevious = dTaken[p];
+		dTaken[p] = 0.0;
+		for (SIZE_T cb = p + 1; cb < _countof( dTaken ); cb++){
+			const double dThis = dTaken[cb];
+			dTaken[cb] = (pdAccept[p] * dPrevious) + ((1.0 - pdAccept[p]) * dTaken[cb - 1]);
+			dPrevious = dThis;
+		}
+	}
+
+	double dCovered = 0.0;
+	for (SIZE_T cb = 0; cb < _countof( dTaken ) - 1; cb++){
+		dCovered += dTaken[cb];
+		if ((cb >= cRandom) && ((1.0 - dCovered) < c_dPatternShortfall)){
+			return static_cast<BYTE>( max( cb, static_cast<SIZE_T>( 1 ) ) );
+		}
+	}
+	return 0xFF;
+}
+
+WPG_PATTERN_H CompileWPGPattern(__in_z LPCTSTR pszPattern, __out_opt SIZE_T* pcchError) {
+
+	if (pcchError){
+		*pcchError = 0;
+	}
+	if (pszPattern == NULL){
+		SetLastError( ERROR_INVALID_PARAMETER );
+		return NULL;
+	}
+	PWPG_PATTERN_INSTANCE pPattern = static_cast<PWPG_PATTERN_INSTANCE>(
+		PH_ALLOC( sizeof( WPG_PATTERN_INSTANCE ) )
+	);
+	if (pPattern == NULL){
+		SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+		return NULL;
+	}
+	new (pPattern) WPG_PATTERN_INSTANCE( );
+
+	TCHAR szClass[c_cchMaxPattern + 1] = { 0 };
+	BYTE bLast = c_bPatternLiteral;
+	TCHAR chLast = TEXT( '\0' );
+	LPCTSTR psz = pszPattern;
+	DWORD dwError = ERROR_SUCCESS;
+	while ((*psz != TEXT( '\0' )) && (dwError == ERROR_SUCCESS)){
+		const LPCTSTR pszToken = psz;
+		SIZE_T cRepeats = 1;
+		BYTE bClass = c_bPatternLiteral;
+		TCHAR chLiteral = TEXT( '\0' );
+		if (*psz == TEXT( '{' )){
+			// Repeat the last position
+			LPCTSTR pszEnd = psz + 1;
+			for (cRepeats = 0; (*pszEnd >= TEXT( '0' )) && (*pszEnd <= TEXT( '9' )) && (cRepeats <= c_cchMaxPattern); pszEnd++){
+				cRepeats = (cRepeats * 10) + (*pszEnd - TEXT( '0' ));
+			}
+			if ((pszEnd == (psz + 1)) || (*pszEnd != TEXT( '}' )) || (psz == pszPattern) || (cRepeats == 0) || (cRepeats > c_cchMaxPattern)){
+				dwError = ERROR_INVALID_DATA;
+				break;
+			}
+			psz = pszEnd + 1;
+			cRepeats--;
+			bClass = bLast;
+			chLiteral = chLast;
+		}else if (*psz == TEXT( '[' )){
+			psz = WPGPatternParseSet( psz, szClass );
+			if (psz == NULL){
+				psz = pszToken;
+				dwError = ERROR_INVALID_DATA;
+				break;
+			}
+			bClass = WPGPatternClass( pPattern, szClass );
+			if (bClass == c_bPatternLiteral){
+				dwError = ERROR_INVALID_DATA;
+				break;
+			}
+		}else{
+			if ((*psz == TEXT( '\\' )) && (*(psz + 1) != TEXT( '\0' ))){
+				chLiteral = *(++psz);
+			}else{
+				for (SIZE_T c = 0; c < _countof( c_patternClasses ); c++){
+					if (c_patternClasses[c].chToken == *psz){
+						bClass = WPGPatternClass( pPattern, c_patternClasses[c].pszChars );
+						if (bClass == c_bPatternLiteral){
+							dwError = ERROR_INVALID_DATA;
+						}
+						break;
+					}
+				}
+				chLiteral = *psz;
+			}
+			if (dwError != ERROR_SUCCESS){
+				break;
+			}
+			psz++;
+		}
+
+		if ((pPattern->cchLength + cRepeats) > c_cchMaxPattern){
+			dwError = ERROR_INVALID_DATA;
+			psz = pszToken;
+			break;
+		}
+		for (SIZE_T r = 0; r < cRepeats; r++){
+			pPattern->bClasses[pPattern->cchLength] = bClass;
+			pPattern->chLiterals[pPattern->cchLength] = (bClass == c_bPatternLiteral) ? chLiteral : TEXT( '\0' );
+			pPattern->cchLength++;
+		}
+		bLast = bClass;
+		chLast = chLiteral;
+	}
+	if ((dwError == ERROR_SUCCESS) && (pPattern->cchLength == 0)){
+		dwError = ERROR_INVALID_DATA;
+	}
+	SecureZeroMemory( szClass, sizeof( szClass ) );
+	if (dwError != ERROR_SUCCESS){
+		if (pcchError){
+			*pcchError = static_cast<SIZE_T>( psz - pszPattern );
+		}
+		CloseWPGPattern( reinterpret_cast<WPG_PATTERN_H>( pPattern ) );
+		SetLastError( dwError );
+		return NULL;
+	}
+
+	// Budget for the entropy, and the bytes to draw
+	double dAccept[c_cchMaxPattern] = { 0 };
+	SIZE_T cRandom = 0;
+	for (BYTE b = 0; b < pPattern->cchLength; b++){
+		if (pPattern->bClasses[b] != c_bPatternLiteral){
+			const map_t& map = pPattern->maps[pPattern->bClasses[b]];
+			pPattern->dBits += log( static_cast<double>( map.size( ) ) ) / log( 2.0 );
+			dAccept[cRandom++] = static_cast<double>( map.limit( ) ) / 256.0;
+		}
+	}
+	pPattern->cbDraw = WPGPatternBytes( dAccept, cRandom );
+	return reinterpret_cast<WPG_PATTERN_H>( pPattern );
+}
+
+BYTE GetWPGPatternLength(__in WPG_PATTERN_H wpgPatternHandle) {
+
+	return reinterpret_cast<PWPG_PATTERN_INSTANCE>( wpgPatternHandle )->cchLength;
+}
+
+double GetWPGPatternBits(__in WPG_PATTERN_H wpgPatternHandle) {
+
+	return reinterpret_cast<PWPG_PATTERN_INSTANCE>( wpgPatternHandle )->dBits;
+}
+
+WPGCaps WPGPatternGenerate(__in WPG_PATTERN_H wpgPatternHandle, __in wpg_t& wpg, __out LPTSTR pszBuffer, __in WPGCaps wpgCaps, __in_opt PCWPG_CANCEL pCancel, __in_opt PCWPG_DEADLINE pDeadline) {
+
+	const PWPG_PATTERN_INSTANCE pPattern = reinterpret_cast<PWPG_PATTERN_INSTANCE>( wpgPatternHandle );
+
+	// Walk the positions, taking a byte for each random one (and another, for as long as it's rejected);
+	// the bytes are drawn on the stack, so that concurrent calls share no scratch
+	alignas(32) BYTE bEntropy[0x100] = { 0 };
+	BYTE cbDrawn = 0, cbTaken = 0;
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	for (BYTE b = 0; (b < pPattern->cchLength) && WPGSucceeded( wpgCapsFailed ); b++){
+		const BYTE bClass = pPattern->bClasses[b];
+		if (bClass == c_bPatternLiteral){
+			pszBuffer[b] = pPattern->chLiterals[b];
+			continue;
+		}
+		const map_t::char_type* chars = pPattern->maps[bClass].chars( );
+		map_t::char_type ch = map_t::reject_char;
+		while (ch == map_t::reject_char){
+			if (cbTaken == cbDrawn){
+				wpgCapsFailed |= wpg.Entropy( bEntropy, pPattern->cbDraw, wpgCaps, pCancel, pDeadline );
+				if (!WPGSucceeded( wpgCapsFailed )){
+					break;
+				}
+				cbDrawn = pPattern->cbDraw;
+				cbTaken = 0;
+			}
+			ch = chars[bEntropy[cbTaken++]];
+		}
+		pszBuffer[b] = ch;
+	}
+	SecureZeroMemory( bEntropy, sizeof( bEntropy ) );
+
+	if (!WPGSucceeded( wpgCapsFailed )){
+		SecureZeroMemory( pszBuffer, sizeof( TCHAR ) * (static_cast<SIZE_T>( pPattern->cchLength ) + 1U) );
+		return wpgCapsFailed;
+	}
+	pszBuffer[pPattern->cchLength] = TEXT( '\0' );
+	return wpgCapsFailed;
+}
+
+VOID CloseWPGPattern(__in WPG_PATTERN_H wpgPatternHandle) {
+
+	PWPG_PATTERN_INSTANCE pPattern = reinterpret_cast<PWPG_PATTERN_INSTANCE>( wpgPatternHandle );
+	if (pPattern == NULL){
+		return;
+	}
+	pPattern->~WPG_PATTERN_INSTANCE( );
+	SecureZeroMemory( pPattern, sizeof( WPG_PATTERN_INSTANCE ) );
+	PH_FREE( pPattern );
+}
@@ -0,0 +1,58 @@
+// WPGPattern.h: declares the interface for generating passwords from patterns, i.e. with a class of characters per position
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_PATTERN_H__)
+#define __WPG_PATTERN_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGGenerators.h"
+
+// Macros
+//
+
+DECLARE_HANDLE(WPG_PATTERN_H);
+
+// Functions
+//
+
+// Compiles the given pattern into a plan for generating passwords from it, e.g. "Cvcc-9999-XXXX", where each character
+// stands for a class to draw a character from:
+//
+//   9  a digit                      a / A  a lower / upper case letter
+//   c  a lower case consonant       C      an upper case consonant
+//   v  a lower case vowel           V      an upper case vowel
+//   x  a lower case letter or digit X      an upper case letter or digit
+//   h  a lower case hex digit       H      an upper case hex digit
+//   s  a symbol                     *      any printable ASCII character, but space
+//   [...]  one of the given characters, or ranges of them, e.g. [a-f0-9]
+//
+// or else for itself; a backslash escapes the next character, and {n} repeats the preceding class (or character)
+// n times. Returns NULL (with the last error set, and the offset of the error in the pattern, if asked for) if
+// the pattern is malformed, or gives a password longer than 255 characters
+WPG_PATTERN_H CompileWPGPattern(__in_z LPCTSTR, __out_opt SIZE_T*);
+
+// Returns the length of the passwords generated from the given pattern
+BYTE GetWPGPatternLength(__in WPG_PATTERN_H);
+
+// Returns the entropy, in bits, of each password generated from the given pattern
+double GetWPGPatternBits(__in WPG_PATTERN_H);
+
+// Generates a password from the given pattern, into the given buffer (which must have room for the length of the pattern
+// plus a terminator), with a single fill of the raw output of the given generator's sources (see wpg_t::Entropy), in all
+// but the rarest of cases; returns as wpg_t::Generate does, in which case the buffer is zeroed
+WPGCaps WPGPatternGenerate(__in WPG_PATTERN_H, __in wpg_t&, __out LPTSTR, __in WPGCaps, __in_opt PCWPG_CANCEL = NULL, __in_opt PCWPG_DEADLINE = NULL);
+
+// Returns the fewest bytes which give each of the given number of positions, accepting a byte with the given probability
+// (i.e. by rejection sampling), an accepted byte in all but one in a few billion draws; or 255, if that's fewer
+BYTE WPGPatternBytes(__in_ecount(cPositions) const double*, __in SIZE_T cPositions);
+
+// Cleans up after the given pattern
+VOID CloseWPGPattern(__in WPG_PATTERN_H);
+
+#endif // !defined(__WPG_PATTERN_H__)
@@ -0,0 +1,277 @@
+// WPGPolicy.cpp: gives the implementation for generating passwords which satisfy a policy.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// A policy is compiled, with its alphabet, into a plan: the alphabet (less the exclusions), a
+// bitmask of the class of each of its characters, the indices of each class's characters, and
+// a label for each position, i.e. the class it must be drawn from, or any. The labels of the
+// required characters come first, so generating a password shuffles them (Fisher-Yates), then
+// draws each position from its class. A position which would otherwise extend a run past the
+// limit is drawn from its class less the character being repeated. Every draw is by rejection
+// sampling against thresholds computed up front, so a password costs the same expected number
+// of bytes, and the plan draws as many as cover all but one in a few billion passwords.
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// C++ Standard Library Headers
+#include <new>
+
+// Declarations
+#include "WPGPolicy.h"
+#include "WPGPattern.h"
+
+// Constants
+//
+
+// The most characters in an alphabet, or a password
+constexpr SIZE_T c_cchMaxPolicy = 0xFF;
+
+// Labels a position which may be drawn from the whole alphabet
+constexpr BYTE c_bPolicyAny = WPGPolicyCLASSES;
+
+// Types
+//
+
+typedef struct _WPG_POLICY_INSTANCE {
+
+	BYTE cchLength;
+
+	// The longest run allowed, if any
+	BYTE cchMaxRun;
+
+	// The bytes drawn for each password, and whether its labels need to be shuffled
+	BYTE cbDraw;
+	BOOL fShuffle;
+
+	// The alphabet, less the exclusions (and any duplicates), and the class of each of its characters, as a bitmask
+	TCHAR szAlphabet[c_cchMaxPolicy + 1];
+	BYTE cchAlphabet;
+	BYTE bMasks[c_cchMaxPolicy];
+
+	// The indices of the characters in each class, and then of the whole alphabet
+	BYTE bMembers[WPGPolicyCLASSES + 1][c_cchMaxPolicy];
+	BYTE cMembers[WPGPolicyCLASSES + 1];
+
+	// The label of each position, before they're shuffled
+	BYTE bLabels[c_cchMaxPolicy];
+
+	// The (exclusive) upper bound on the bytes accepted for drawing an index below n, i.e. 256 - (256 % n)
+	WORD wLimits[c_cchMaxPolicy + 1];
+
+} WPG_POLICY_INSTANCE, *PWPG_POLICY_INSTANCE;
+
+// Gives the raw output from which indices are drawn, and how much of it has been taken
+typedef struct _WPG_POLICY_DRAW {
+
+	BYTE bEntropy[0x100];
+	BYTE cbDrawn;
+	BYTE cbTaken;
+
+} WPG_POLICY_DRAW, *PWPG_POLICY_DRAW;
+
+// Functions
+//
+
+// Returns the class of the given character, from its character type (see GetStringTypeW)
+static inline WPGPolicyClass WPGPolicyClassOf(__in WORD wType) {
+
+	if (wType & C1_UPPER){
+		return WPGPolicyUPPER;
+	}
+	if (wType & C1_LOWER){
+		return WPGPolicyLOWER;
+	}
+	return (wType & C1_DIGIT) ? WPGPolicyDIGIT : WPGPolicySYMBOL;
+}
+
+WPG_POLICY_H CompileWPGPolicy(__in_z LPCTSTR pszAlphabet, __in BYTE cchLength, __in PCWPG_POLICY pPolicy) {
+
+	if ((pszAlphabet == NULL) || (cchLength == 0) || (pPolicy == NULL)){
+		SetLastError( ERROR_INVALID_PARAMETER );
+		return NULL;
+	}
+	PWPG_POLICY_INSTANCE pInstance = static_cast<PWPG_POLICY_INSTANCE>(
+		PH_ALLOC( sizeof( WPG_POLICY_INSTANCE ) )
+	);
+	if (pInstance == NULL){
+		SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+		return NULL;
+	}
+	new (pInstance) WPG_POLICY_INSTANCE( );
+	pInstance->cchLength = cchLength;
+	pInstance->cchMaxRun = pPolicy->cchMaxRun;
+
+	// Take the exclusions (and duplicates) out of the alphabet
+	BOOL fValid = TRUE;
+	for (LPCTSTR psz = pszAlphabet; (*psz != TEXT( '\0' )) && fValid; psz++){
+		BOOL fKeep = TRUE;
+		for (LPCTSTR pszExclude = pPolicy->pszExclude; pszExclude && (*pszExclude != TEXT( '\0' )) && fKeep; pszExclude++){
+			fKeep = (*pszExclude != *psz);
+		}
+		for (BYTE b = 0; (b < pInstance->cchAlphabet) && fKeep; b++){
+			fKeep = (pInstance->szAlphabet[b] != *psz);
+		}
+		if (fKeep){
+			fValid = (pInstance->cchAlphabet < c_cchMaxPolicy);
+			if (fValid){
+				pInstance->szAlphabet[pInstance->cchAlphabet++] = *psz;
+			}
+		}
+	}
+
+	// Classify what's left, and index the characters in each class
+	WORD wTypes[c_cchMaxPolicy] = { 0 };
+	fValid = fValid && (pInstance->cchAlphabet > 0) && GetStringTypeW( CT_CTYPE1, pInstance->szAlphabet, pInstance->cchAlphabet, wTypes );
+	for (BYTE b = 0; (b < pInstance->cchAlphabet) && fValid; b++){
+		const WPGPolicyClass policyClass = WPGPolicyClassOf( wTypes[b] );
+		pInstance->bMasks[b] = static_cast<BYTE>( 1 << policyClass );
+		pInstance->bMembers[policyClass][pInstance->cMembers[policyClass]++] = b;
+		pInstance->bMembers[c_bPolicyAny][pInstance->cMembers[c_bPolicyAny]++] = b;
+	}
+
+	// Label the positions: the required classes first, then any. Each class drawn from must have a
+	// character to spare, if a run has to be broken
+	const BYTE cMinimumMembers = (pPolicy->cchMaxRun > 0) ? 2 : 1;
+	SIZE_T cRequired = 0;
+	for (BYTE c = 0; (c < WPGPolicyCLASSES) && fValid; c++){
+		fValid = (pPolicy->cMinimum[c] == 0) || (pInstance->cMembers[c] >= cMinimumMembers);
+		for (BYTE n = 0; (n < pPolicy->cMinimum[c]) && fValid; n++){
+			fValid = (cRequired < cchLength);
+			if (fValid){
+				pInstance->bLabels[cRequired++] = c;
+			}
+		}
+	}
+	fValid = fValid && ((cRequired == cchLength) || (pInstance->cMembers[c_bPolicyAny] >= cMinimumMembers));
+	if (!fValid){
+		CloseWPGPolicy( reinterpret_cast<WPG_POLICY_H>( pInstance ) );
+		SetLastError( ERROR_INVALID_DATA );
+		return NULL;
+	}
+	for (SIZE_T n = cRequired; n < cchLength; n++){
+		pInstance->bLabels[n] = c_bPolicyAny;
+	}
+	pInstance->fShuffle = (cRequired > 0);
+
+	// Compute the thresholds, and then budget for the bytes each password takes: those to shuffle the labels,
+	// and those to draw each position (less one character, at worst)
+	for (SIZE_T n = 1; n < _countof( pInstance->wLimits ); n++){
+		pInstance->wLimits[n] = static_cast<WORD>( 256 - (256 % n) );
+	}
+	double dAccept[2 * c_cchMaxPolicy] = { 0 };
+	SIZE_T cDraws = 0;
+	for (SIZE_T n = cchLength; pInstance->fShuffle && (n > 1); n--){
+		dAccept[cDraws++] = static_cast<double>( pInstance->wLimits[n] ) / 256.0;
+	}
+	for (SIZE_T n = 0; n < cchLength; n++){
+		const BYTE cMembers = pInstance->cMembers[pInstance->bLabels[n]];
+		WORD wLimit = pInstance->wLimits[cMembers];
+		if ((pInstance->cchMaxRun > 0) && (cMembers > 2)){
+			wLimit = min( wLimit, pInstance->wLimits[cMembers - 1] );
+		}
+		if (cMembers > 1){
+			dAccept[cDraws++] = static_cast<double>( wLimit ) / 256.0;
+		}
+	}
+	pInstance->cbDraw = WPGPatternBytes( dAccept, cDraws );
+	return reinterpret_cast<WPG_POLICY_H>( pInstance );
+}
+
+BYTE GetWPGPolicyLength(__in WPG_POLICY_H wpgPolicyHandle) {
+
+	return reinterpret_cast<PWPG_POLICY_INSTANCE>( wpgPolicyHandle )->cchLength;
+}
+
+// Draws an index below the given bound, from the given raw output, filling it from the given generator's sources as
+// needed; returns FALSE if they failed
+static BOOL WPGPolicyIndex(__in const WPG_POLICY_INSTANCE* pInstance, __inout PWPG_POLICY_DRAW pDraw, __in BYTE n, __in wpg_t& wpg, __in WPGCaps wpgCaps, __in_opt PCWPG_CANCEL pCancel, __in_opt PCWPG_DEADLINE pDeadline, __out BYTE* pbIndex, __inout WPGCaps* pwpgCapsFailed) {
+
+	*pbIndex = 0;
+	if (n < 2){
+		return TRUE;
+	}
+	const WORD wLimit = pInstance->wLimits[n];
+	for (;;){
+		if (pDraw->cbTaken == pDraw->cbDrawn){
+			*pwpgCapsFailed |= wpg.Entropy( pDraw->bEntropy, pInstance->cbDraw, wpgCaps, pCancel, pDeadline );
+			if (!WPGSucceeded( *pwpgCapsFailed )){
+				return FALSE;
+			}
+			pDraw->cbDrawn = pInstance->cbDraw;
+			pDraw->cbTaken = 0;
+		}
+		const BYTE b = pDraw->bEntropy[pDraw->cbTaken++];
+		if (b < wLimit){
+			*pbIndex = static_cast<BYTE>( b % n );
+			return TRUE;
+		}
+	}
+}
+
+WPGCaps WPGPolicyGenerate(__in WPG_POLICY_H wpgPolicyHandle, __in wpg_t& wpg, __out LPTSTR pszBuffer, __in WPGCaps wpgCaps, __in_opt PCWPG_CANCEL pCancel, __in_opt PCWPG_DEADLINE pDeadline) {
+
+	const PWPG_POLICY_INSTANCE pInstance = reinterpret_cast<PWPG_POLICY_INSTANCE>( wpgPolicyHandle );
+	const BYTE cchLength = pInstance->cchLength;
+
+	// Everything is on the stack, so that concurrent calls share no scratch
+	WPG_POLICY_DRAW draw = { 0 };
+	BYTE bLabels[c_cchMaxPolicy] = { 0 };
+	CopyMemory( bLabels, pInstance->bLabels, cchLength );
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	BOOL fDrawn = TRUE;
+
+	// Shuffle the required positions into place
+	for (BYTE n = cchLength - 1; pInstance->fShuffle && fDrawn && (n > 0); n--){
+		BYTE bIndex = 0;
+		fDrawn = WPGPolicyIndex( pInstance, &draw, n + 1, wpg, wpgCaps, pCancel, pDeadline, &bIndex, &wpgCapsFailed );
+		const BYTE bLabel = bLabels[n];
+		bLabels[n] = bLabels[bIndex];
+		bLabels[bIndex] = bLabel;
+	}
+
+	// Then draw each position from its class, leaving out the last character if it's already run as long as it may
+	BYTE bLast = 0, cchRun = 0;
+	for (BYTE b = 0; (b < cchLength) && fDrawn; b++){
+		const BYTE bLabel = bLabels[b];
+		const BYTE* bMembers = pInstance->bMembers[bLabel];
+		const BYTE cMembers = pInstance->cMembers[bLabel];
+		const BOOL fBreak = (pInstance->cchMaxRun > 0) && (cchRun >= pInstance->cchMaxRun) &&
+			((bLabel == c_bPolicyAny) || (pInstance->bMasks[bLast] & (1 << bLabel)));
+
+		BYTE bIndex = 0;
+		fDrawn = WPGPolicyIndex( pInstance, &draw, (fBreak) ? (cMembers - 1) : cMembers, wpg, wpgCaps, pCancel, pDeadline, &bIndex, &wpgCapsFailed );
+		BYTE bChar = bMembers[bIndex];
+		if (fBreak && (bChar == bLast)){
+			bChar = bMembers[cMembers - 1];
+		}
+		pszBuffer[b] = pInstance->szAlphabet[bChar];
+		cchRun = ((b > 0) && (bChar == bLast)) ? (cchRun + 1) : 1;
+		bLast = bChar;
+	}
+	SecureZeroMemory( &draw, sizeof( draw ) );
+	SecureZeroMemory( bLabels, sizeof( bLabels ) );
+
+	if (!fDrawn){
+		SecureZeroMemory( pszBuffer, sizeof( TCHAR ) * (static_cast<SIZE_T>( cchLength ) + 1U) );
+		return wpgCapsFailed;
+	}
+	pszBuffer[cchLength] = TEXT( '\0' );
+	return wpgCapsFailed;
+}
+
+VOID CloseWPGPolicy(__in WPG_POLICY_H wpgPolicyHandle) {
+
+	PWPG_POLICY_INSTANCE pInstance = reinterpret_cast<PWPG_POLICY_INSTANCE>( wpgPolicyHandle );
+	if (pInstance == NULL){
+		return;
+	}
+	pInstance->~WPG_POLICY_INSTANCE( );
+	SecureZeroMemory( pInstance, sizeof( WPG_POLICY_INSTANCE ) );
+	PH_FREE( pInstance );
+}
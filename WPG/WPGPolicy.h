@@ -0,0 +1,74 @@
+// WPGPolicy.h: declares the interface for generating passwords which satisfy a policy, in a single pass
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_POLICY_H__)
+#define __WPG_POLICY_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGGenerators.h"
+
+// Macros
+//
+
+DECLARE_HANDLE(WPG_POLICY_H);
+
+// Types
+//
+
+// Identifies the classes of characters a policy can require (see GetStringTypeW)
+typedef enum _WPGPolicyClass {
+
+	WPGPolicyUPPER = 0,
+	WPGPolicyLOWER = 1,
+	WPGPolicyDIGIT = 2,
+
+	// Anything else
+	WPGPolicySYMBOL = 3,
+
+	WPGPolicyCLASSES = 4,
+
+} WPGPolicyClass;
+
+// Describes the rules which every password must satisfy
+typedef struct _WPG_POLICY {
+
+	// The least number of characters from each class, indexed by WPGPolicyClass
+	BYTE cMinimum[WPGPolicyCLASSES];
+
+	// The longest run of any one character allowed; zero for no limit
+	BYTE cchMaxRun;
+
+	// The characters to leave out of the alphabet (e.g. those which are easily confused); optional
+	LPCTSTR pszExclude;
+
+} WPG_POLICY, *PWPG_POLICY;
+
+typedef const WPG_POLICY* PCWPG_POLICY;
+
+// Functions
+//
+
+// Compiles the given policy, over the given alphabet (of up to 255 distinct characters), into a plan for generating
+// passwords of the given length which satisfy it. Returns NULL (with the last error set) if no password could
+WPG_POLICY_H CompileWPGPolicy(__in_z LPCTSTR, __in BYTE, __in PCWPG_POLICY);
+
+// Returns the length of the passwords generated for the given policy
+BYTE GetWPGPolicyLength(__in WPG_POLICY_H);
+
+// Generates a password which satisfies the given policy, into the given buffer (which must have room for its length plus
+// a terminator), without retrying: the positions of the required characters are shuffled into place, and each position is
+// then drawn from its class, leaving out the character which would make a run too long. Uses a single fill of the raw
+// output of the given generator's sources (see wpg_t::Entropy), in all but the rarest of cases; returns as
+// wpg_t::Generate does, in which case the buffer is zeroed
+WPGCaps WPGPolicyGenerate(__in WPG_POLICY_H, __in wpg_t&, __out LPTSTR, __in WPGCaps, __in_opt PCWPG_CANCEL = NULL, __in_opt PCWPG_DEADLINE = NULL);
+
+// Cleans up after the given policy
+VOID CloseWPGPolicy(__in WPG_POLICY_H);
+
+#endif // !defined(__WPG_POLICY_H__)
@@ -0,0 +1,500 @@
+// WPGPool.cpp: gives the implementation of a pool of password-generating worker threads.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// C++ Standard Library Headers
+#include <new>
+
+// Declarations
+#include "WPGPool.h"
+
+// Constants
+//
+
+// The number of chunks to aim to give each worker per batch, so that there's something left to steal
+constexpr SIZE_T c_cChunksPerWorker = 8;
+
+// The most passwords (or blocks of raw bytes) to generate in a single chunk
+constexpr SIZE_T c_cMaxChunkSize = 256;
+
+// The number of raw bytes generated in each call to the generator, when filling a buffer with them
+constexpr SIZE_T c_cbEntropyBlock = 0xF0;
+
+// Types
+//
+
+// Gives a range of chunk indices, [begin, end), packed into one (atomically-updated) 64-bit value
+class chunk_range_t {
+public:
+	chunk_range_t(LONG64 packed): m_begin( static_cast<DWORD>( static_cast<ULONG64>( packed ) >> 32 ) ), m_end( static_cast<DWORD>( packed ) ) { }
+	chunk_range_t(DWORD begin, DWORD end): m_begin( begin ), m_end( end ) { }
+
+	LONG64 packed(void) const {
+		return static_cast<LONG64>( (static_cast<ULONG64>( m_begin ) << 32) | m_end );
+	}
+
+	DWORD size(void) const {
+		return (m_end > m_begin) ? (m_end - m_begin) : 0;
+	}
+
+	DWORD m_begin;
+	DWORD m_end;
+};
+
+typedef struct _WPG_POOL_INSTANCE WPG_POOL_INSTANCE, *PWPG_POOL_INSTANCE;
+
+typedef struct alignas(64) _WPG_POOL_WORKER {
+
+	// The chunks left to this worker; the worker takes from the front, thieves take from the back
+	volatile LONG64 llRange;
+
+	PWPG_POOL_INSTANCE pPool;
+	HANDLE hThread;
+	HANDLE hWake;
+
+	// The generator, which is shared with (and so opens its sources once for) the rest of the pool
+	std::shared_ptr<wpg_t> wpg;
+
+} WPG_POOL_WORKER, *PWPG_POOL_WORKER;
+
+struct _WPG_POOL_INSTANCE {
+
+	DWORD dwWorkers;
+	PWPG_POOL_WORKER pWorkers;
+
+	// Serialises callers of WPGPoolGenerate
+	SRWLOCK srwBatch;
+
+	// Describes the batch in progress: passwords, or else raw bytes (in blocks of c_cbEntropyBlock)
+	PCWPG_BATCH pBatch;
+	LPBYTE lpEntropy;
+	SIZE_T cbEntropy;
+	WPGCaps wpgEntropyCaps;
+	SIZE_T cItems;
+	SIZE_T cChunkSize;
+	volatile LONG lPending;
+	volatile LONG lCapsFailed;
+
+	// Set if any item failed outright; otherwise its failure, OR'd with the sources skipped by
+	// another (i.e. with WPGCapPARTIAL), would read as a success
+	volatile LONG lFailed;
+	HANDLE hDone;
+
+	// Gives the jobs waiting for a worker, first-in first-out; the semaphore counts them
+	SRWLOCK srwJobs;
+	PWPG_POOL_JOB pJobsHead;
+	PWPG_POOL_JOB pJobsTail;
+	HANDLE hJobs;
+
+	volatile LONG lStop;
+};
+
+// Prototypes
+//
+
+// Gives the starting address for each worker thread
+static DWORD WINAPI WPGPoolWorkerThreadProc(__in LPVOID);
+
+// Functions
+//
+
+WPG_POOL_H CreateWPGPool(__in DWORD dwWorkers) {
+
+	return CreateWPGPoolEx( dwWorkers, wpg_t::New( ) );
+}
+
+WPG_POOL_H CreateWPGPoolEx(__in DWORD dwWorkers, __in const std::shared_ptr<wpg_t>& wpg) {
+
+	if (!wpg){
+		return NULL;
+	}
+	if (dwWorkers == 0){
+		dwWorkers = max( GetActiveProcessorCount( ALL_PROCESSOR_GROUPS ), 1UL );
+	}
+
+	// Allocate the structures
+	PWPG_POOL_INSTANCE pPool = static_cast<PWPG_POOL_INSTANCE>(
+		PH_ALLOC( sizeof( WPG_POOL_INSTANCE ) )
+	);
+	if (pPool == NULL){
+		return NULL;
+	}
+	pPool->pWorkers = static_cast<PWPG_POOL_WORKER>(
+		_aligned_malloc( sizeof( WPG_POOL_WORKER ) * dwWorkers, alignof( WPG_POOL_WORKER ) )
+	);
+	if (pPool->pWorkers == NULL){
+		PH_FREE( pPool );
+		return NULL;
+	}
+	InitializeSRWLock( &(pPool->srwBatch) );
+	InitializeSRWLock( &(pPool->srwJobs) );
+	pPool->hDone = CreateEvent( NULL, FALSE, FALSE, NULL );
+	pPool->hJobs = CreateSemaphore( NULL, 0, MAXLONG, NULL );
+	if ((pPool->hDone == NULL) || (pPool->hJobs == NULL)){
+		DestroyWPGPool( reinterpret_cast<WPG_POOL_H>( pPool ) );
+		return NULL;
+	}
+
+	// Spin the workers, all sharing the one generator
+	for (DWORD dw = 0; dw < dwWorkers; dw++){
+		PWPG_POOL_WORKER pWorker = new (pPool->pWorkers + dw) WPG_POOL_WORKER( );
+		pWorker->pPool = pPool;
+		pWorker->wpg = wpg;
+		pWorker->hWake = CreateEvent( NULL, FALSE, FALSE, NULL );
+		pWorker->hThread = CreateThread( NULL, 0, WPGPoolWorkerThreadProc, static_cast<LPVOID>( pWorker ), 0, NULL );
+		if (pWorker->hThread == NULL){
+			pWorker->wpg.reset( );
+			CloseHandle( pWorker->hWake );
+			pWorker->~WPG_POOL_WORKER( );
+			break;
+		}
+		pPool->dwWorkers++;
+	}
+	if (pPool->dwWorkers == 0){
+		DestroyWPGPool( reinterpret_cast<WPG_POOL_H>( pPool ) );
+		return NULL;
+	}
+	return reinterpret_cast<WPG_POOL_H>( pPool );
+}
+
+DWORD GetWPGPoolSize(__in WPG_POOL_H wpgPoolHandle) {
+
+	PWPG_POOL_INSTANCE pPool = reinterpret_cast<PWPG_POOL_INSTANCE>( wpgPoolHandle );
+	return (pPool) ? pPool->dwWorkers : 0;
+}
+
+// Reads the given range atomically (which a plain read of a 64-bit value isn't, on 32-bit x86)
+static inline LONG64 WPGPoolReadRange(__in volatile LONG64* pllRange) {
+	return InterlockedCompareExchange64( pllRange, 0, 0 );
+}
+
+// Deals the given number of items of the batch just published out across the workers, and waits for them; called
+// with the batch lock held
+static WPGCaps WPGPoolRun(__in PWPG_POOL_INSTANCE pPool, __in SIZE_T cItems) {
+
+	// Size the chunks so that each worker starts with a few of them, and so that the count fits in a range
+	SIZE_T cChunkSize = cItems / (static_cast<SIZE_T>( pPool->dwWorkers ) * c_cChunksPerWorker);
+	cChunkSize = max( min( cChunkSize, c_cMaxChunkSize ), static_cast<SIZE_T>( 1 ) );
+	cChunkSize = max( cChunkSize, (cItems / MAXDWORD) + 1 );
+	const DWORD dwChunks = static_cast<DWORD>( (cItems + cChunkSize - 1) / cChunkSize );
+
+	// Deal the chunks out in contiguous ranges
+	pPool->cItems = cItems;
+	pPool->cChunkSize = cChunkSize;
+	pPool->lCapsFailed = WPGCapNONE;
+	pPool->lFailed = FALSE;
+	InterlockedExchange( &(pPool->lPending), static_cast<LONG>( dwChunks ) );
+	for (DWORD dw = 0; dw < pPool->dwWorkers; dw++){
+		const chunk_range_t range(
+			static_cast<DWORD>( (static_cast<ULONG64>( dwChunks ) * dw) / pPool->dwWorkers ),
+			static_cast<DWORD>( (static_cast<ULONG64>( dwChunks ) * (dw + 1)) / pPool->dwWorkers )
+		);
+		InterlockedExchange64( &(pPool->pWorkers[dw].llRange), range.packed( ) );
+	}
+	// (Every chunk is in some worker's range, so those with none needn't be woken; a small fill wakes just the one)
+	for (DWORD dw = 0; dw < pPool->dwWorkers; dw++){
+		if (chunk_range_t( WPGPoolReadRange( &(pPool->pWorkers[dw].llRange) ) ).size( ) > 0){
+			SetEvent( pPool->pWorkers[dw].hWake );
+		}
+	}
+
+	// Wait for the last chunk to be finished
+	WaitForSingleObject( pPool->hDone, INFINITE );
+	const WPGCaps wpgCapsFailed = static_cast<WPGCaps>( pPool->lCapsFailed );
+	return (pPool->lFailed) ? (wpgCapsFailed & ~WPGCapPARTIAL) : wpgCapsFailed;
+}
+
+WPGCaps WPGPoolGenerate(__in WPG_POOL_H wpgPoolHandle, __in PCWPG_BATCH pBatch) {
+
+	PWPG_POOL_INSTANCE pPool = reinterpret_cast<PWPG_POOL_INSTANCE>( wpgPoolHandle );
+	if ((pPool == NULL) || (pBatch == NULL) || (pBatch->cPasswords == 0)){
+		return WPGCapNONE;
+	}
+
+	AcquireSRWLockExclusive( &(pPool->srwBatch) );
+	pPool->pBatch = pBatch;
+	const WPGCaps wpgCapsFailed = WPGPoolRun( pPool, pBatch->cPasswords );
+	pPool->pBatch = NULL;
+	ReleaseSRWLockExclusive( &(pPool->srwBatch) );
+	return wpgCapsFailed;
+}
+
+WPGCaps WPGPoolEntropy(__in WPG_POOL_H wpgPoolHandle, __out_bcount(cbBuffer) PVOID pvBuffer, __in SIZE_T cbBuffer, __in WPGCaps wpgCaps) {
+
+	PWPG_POOL_INSTANCE pPool = reinterpret_cast<PWPG_POOL_INSTANCE>( wpgPoolHandle );
+	if ((pPool == NULL) || (pvBuffer == NULL) || (cbBuffer == 0)){
+		return WPGCapNONE;
+	}
+
+	AcquireSRWLockExclusive( &(pPool->srwBatch) );
+	pPool->lpEntropy = static_cast<LPBYTE>( pvBuffer );
+	pPool->cbEntropy = cbBuffer;
+	pPool->wpgEntropyCaps = wpgCaps;
+	const WPGCaps wpgCapsFailed = WPGPoolRun( pPool, (cbBuffer + c_cbEntropyBlock - 1) / c_cbEntropyBlock );
+	pPool->lpEntropy = NULL;
+	ReleaseSRWLockExclusive( &(pPool->srwBatch) );
+
+	// Leave nothing behind if the buffer couldn't be filled
+	if (!WPGSucceeded( wpgCapsFailed )){
+		SecureZeroMemory( pvBuffer, cbBuffer );
+	}
+	return wpgCapsFailed;
+}
+
+// Takes the job at the front of the queue, if any
+static PWPG_POOL_JOB WPGPoolPopJob(__in PWPG_POOL_INSTANCE pPool) {
+
+	AcquireSRWLockExclusive( &(pPool->srwJobs) );
+	PWPG_POOL_JOB pJob = pPool->pJobsHead;
+	if (pJob){
+		pPool->pJobsHead = pJob->pNext;
+		if (pPool->pJobsHead == NULL){
+			pPool->pJobsTail = NULL;
+		}
+		pJob->pNext = NULL;
+	}
+	ReleaseSRWLockExclusive( &(pPool->srwJobs) );
+	return pJob;
+}
+
+BOOL WPGPoolSubmit(__in WPG_POOL_H wpgPoolHandle, __in PWPG_POOL_JOB pJob) {
+
+	PWPG_POOL_INSTANCE pPool = reinterpret_cast<PWPG_POOL_INSTANCE>( wpgPoolHandle );
+	if ((pPool == NULL) || (pJob == NULL) || (pJob->pfnCallback == NULL)){
+		return FALSE;
+	}
+	if (InterlockedCompareExchange( &(pPool->lStop), 0, 0 ) > 0){
+		return FALSE;
+	}
+
+	// Append it, and then wake one worker for it
+	pJob->pNext = NULL;
+	AcquireSRWLockExclusive( &(pPool->srwJobs) );
+	if (pPool->pJobsTail){
+		pPool->pJobsTail->pNext = pJob;
+	}else{
+		pPool->pJobsHead = pJob;
+	}
+	pPool->pJobsTail = pJob;
+	ReleaseSRWLockExclusive( &(pPool->srwJobs) );
+	ReleaseSemaphore( pPool->hJobs, 1, NULL );
+	return TRUE;
+}
+
+VOID DestroyWPGPool(__in WPG_POOL_H wpgPoolHandle) {
+
+	PWPG_POOL_INSTANCE pPool = reinterpret_cast<PWPG_POOL_INSTANCE>( wpgPoolHandle );
+	if (pPool == NULL){
+		return;
+	}
+
+	// Raise the stop sign, and wait for the workers to see it
+	InterlockedIncrement( &(pPool->lStop) );
+	for (DWORD dw = 0; dw < pPool->dwWorkers; dw++){
+		SetEvent( pPool->pWorkers[dw].hWake );
+	}
+	for (DWORD dw = 0; dw < pPool->dwWorkers; dw++){
+		PWPG_POOL_WORKER pWorker = pPool->pWorkers + dw;
+		WaitForSingleObject( pWorker->hThread, INFINITE );
+		CloseHandle( pWorker->hThread );
+		CloseHandle( pWorker->hWake );
+		pWorker->~WPG_POOL_WORKER( );
+	}
+
+	// Complete anything left in the queue, so that no-one waits on it forever
+	PWPG_POOL_JOB pJob = NULL;
+	while ((pJob = WPGPoolPopJob( pPool )) != NULL){
+		pJob->cchGenerated = 0;
+		pJob->pszBuffer[0] = TEXT( '\0' );
+		pJob->pfnCallback( pJob, WPGCapCANCELLED );
+	}
+
+	// Cleanup
+	if (pPool->pWorkers){
+		_aligned_free( pPool->pWorkers );
+	}
+	if (pPool->hDone){
+		CloseHandle( pPool->hDone );
+	}
+	if (pPool->hJobs){
+		CloseHandle( pPool->hJobs );
+	}
+	PH_FREE( pPool );
+}
+
+// Takes the next chunk from the front of the given worker's own range
+static BOOL WPGPoolWorkerPop(__in PWPG_POOL_WORKER pWorker, __out DWORD* pdwChunk) {
+
+	LONG64 llExpected = WPGPoolReadRange( &(pWorker->llRange) );
+	for (;;){
+		const chunk_range_t range( llExpected );
+		if (range.size( ) == 0){
+			return FALSE;
+		}
+		const chunk_range_t next( range.m_begin + 1, range.m_end );
+		const LONG64 llActual = InterlockedCompareExchange64( &(pWorker->llRange), next.packed( ), llExpected );
+		if (llActual == llExpected){
+			*pdwChunk = range.m_begin;
+			return TRUE;
+		}
+		llExpected = llActual;
+	}
+}
+
+// Steals the back half of some other worker's range, keeping one chunk and leaving the rest in the thief's own range
+static BOOL WPGPoolWorkerSteal(__in PWPG_POOL_WORKER pThief, __out DWORD* pdwChunk) {
+
+	PWPG_POOL_INSTANCE pPool = pThief->pPool;
+	const DWORD dwThief = static_cast<DWORD>( pThief - pPool->pWorkers );
+	for (DWORD dw = 1; dw < pPool->dwWorkers; dw++){
+		PWPG_POOL_WORKER pVictim = pPool->pWorkers + ((dwThief + dw) % pPool->dwWorkers);
+		LONG64 llExpected = WPGPoolReadRange( &(pVictim->llRange) );
+		for (;;){
+			const chunk_range_t range( llExpected );
+			const DWORD dwSize = range.size( );
+			if (dwSize == 0){
+				break;
+			}
+			const DWORD dwMid = range.m_end - ((dwSize + 1) / 2);
+			const chunk_range_t left( range.m_begin, dwMid );
+			const LONG64 llActual = InterlockedCompareExchange64( &(pVictim->llRange), left.packed( ), llExpected );
+			if (llActual == llExpected){
+				// Only the owner pops from its own range, and no-one steals from an empty one, so a plain exchange will do
+				const chunk_range_t loot( dwMid + 1, range.m_end );
+				InterlockedExchange64( &(pThief->llRange), loot.packed( ) );
+				*pdwChunk = dwMid;
+				return TRUE;
+			}
+			llExpected = llActual;
+		}
+	}
+	return FALSE;
+}
+
+// Generates the passwords (or raw bytes) in the given chunk of the current batch
+static VOID WPGPoolWorkerGenerate(__in PWPG_POOL_WORKER pWorker, __in DWORD dwChunk) {
+
+	PWPG_POOL_INSTANCE pPool = pWorker->pPool;
+	PCWPG_BATCH pBatch = pPool->pBatch;
+	const SIZE_T first = static_cast<SIZE_T>( dwChunk ) * pPool->cChunkSize;
+	const SIZE_T last = min( first + pPool->cChunkSize, pPool->cItems );
+
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	BOOL fFailed = FALSE;
+	if (pBatch){
+		const SIZE_T cchStride = static_cast<SIZE_T>( pBatch->cchLength ) + 1U;
+		for (SIZE_T n = first; n < last; n++){
+			LPTSTR pszPassword = pBatch->pszBuffer + (n * cchStride);
+			WPGCaps wpgCaps = WPGCapNONE;
+			if (pBatch->hPattern){
+				wpgCaps = WPGPatternGenerate( pBatch->hPattern, *(pWorker->wpg), pszPassword, pBatch->wpgCaps );
+			}else if (pBatch->hPolicy){
+				wpgCaps = WPGPolicyGenerate( pBatch->hPolicy, *(pWorker->wpg), pszPassword, pBatch->wpgCaps );
+			}else if (pBatch->hAlphabet){
+				wpgCaps = WPGAlphabetGenerate(
+					pBatch->hAlphabet,
+					*(pWorker->wpg),
+					pszPassword,
+					WPGAlphabetSymbols( pBatch->hAlphabet, pBatch->cchLength ),
+					pBatch->fDuplicatesAllowed,
+					NULL,
+					pBatch->wpgCaps
+				);
+			}else{
+				BYTE cch = 0;
+				wpgCaps = pWorker->wpg->Generate(
+					pszPassword,
+					pBatch->cchLength,
+					pBatch->wpgCaps,
+					&cch,
+					pBatch->pszAlphabet,
+					pBatch->fDuplicatesAllowed
+				);
+				pszPassword[cch] = TEXT( '\0' );
+			}
+			wpgCapsFailed |= wpgCaps;
+			fFailed |= !WPGSucceeded( wpgCaps );
+		}
+	}else{
+		// Stop at the first failure, since the whole buffer is discarded
+		for (SIZE_T n = first; (n < last) && !fFailed; n++){
+			const SIZE_T cbOffset = n * c_cbEntropyBlock;
+			const SIZE_T cbBlock = min( c_cbEntropyBlock, pPool->cbEntropy - cbOffset );
+			const WPGCaps wpgCaps = pWorker->wpg->Entropy( pPool->lpEntropy + cbOffset, static_cast<BYTE>( cbBlock ), pPool->wpgEntropyCaps );
+			wpgCapsFailed |= wpgCaps;
+			fFailed = !WPGSucceeded( wpgCaps );
+		}
+	}
+	if (wpgCapsFailed != WPGCapNONE){
+		InterlockedOr( &(pPool->lCapsFailed), static_cast<LONG>( wpgCapsFailed ) );
+	}
+	if (fFailed){
+		InterlockedExchange( &(pPool->lFailed), TRUE );
+	}
+
+	// Signal the caller if that was the last of them
+	if (InterlockedDecrement( &(pPool->lPending) ) == 0){
+		SetEvent( pPool->hDone );
+	}
+}
+
+// Generates the password for the given job, and hands it back
+static VOID WPGPoolWorkerRunJob(__in PWPG_POOL_WORKER pWorker, __in PWPG_POOL_JOB pJob) {
+
+	BYTE cch = 0;
+	WPGCaps wpgCapsFailed = WPGCapCANCELLED;
+	if (!WPGCancelled( &(pJob->cancel) )){
+		wpgCapsFailed = pWorker->wpg->Generate(
+			pJob->pszBuffer,
+			pJob->cchLength,
+			pJob->wpgCaps,
+			&cch,
+			pJob->pszAlphabet,
+			pJob->fDuplicatesAllowed,
+			&(pJob->cancel),
+			&(pJob->deadline)
+		);
+	}
+	pJob->pszBuffer[cch] = TEXT( '\0' );
+	pJob->cchGenerated = cch;
+	pJob->pfnCallback( pJob, wpgCapsFailed );
+}
+
+static DWORD WINAPI WPGPoolWorkerThreadProc(__in LPVOID lpParameter) {
+
+	PWPG_POOL_WORKER pWorker = static_cast<PWPG_POOL_WORKER>( lpParameter );
+	PWPG_POOL_INSTANCE pPool = pWorker->pPool;
+	const HANDLE handles[] = { pWorker->hWake, pPool->hJobs };
+	for (;;){
+		// Batches (and stopping) take priority over jobs
+		const DWORD dwWait = WaitForMultipleObjects( _countof( handles ), handles, FALSE, INFINITE );
+		if (InterlockedCompareExchange( &(pPool->lStop), 0, 0 ) > 0){
+			break;
+		}
+		if (dwWait == (WAIT_OBJECT_0 + 1)){
+			PWPG_POOL_JOB pJob = WPGPoolPopJob( pPool );
+			if (pJob){
+				WPGPoolWorkerRunJob( pWorker, pJob );
+			}
+			continue;
+		}
+
+		// Work through our own chunks, and then through anyone else's
+		DWORD dwChunk = 0;
+		while (WPGPoolWorkerPop( pWorker, &dwChunk ) || WPGPoolWorkerSteal( pWorker, &dwChunk )){
+			WPGPoolWorkerGenerate( pWorker, dwChunk );
+		}
+	}
+#if defined (_DEBUG)
+	OutputDebugString( TEXT( "Pool worker thread finishing..\x0A" ) );
+#endif
+	return 0;
+}
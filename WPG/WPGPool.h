@@ -0,0 +1,113 @@
+// WPGPool.h: declares the interface to a pool of password-generating worker threads
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_POOL_H__)
+#define __WPG_POOL_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGGenerators.h"
+#include "WPGAlphabet.h"
+#include "WPGPattern.h"
+#include "WPGPolicy.h"
+
+// Macros
+//
+
+DECLARE_HANDLE(WPG_POOL_H);
+
+// Types
+//
+
+// Describes a batch of passwords to be generated across a pool
+typedef struct _WPG_BATCH {
+
+	// Receives cPasswords null-terminated records, each (cchLength+1) characters long
+	LPTSTR pszBuffer;
+	SIZE_T cPasswords;
+	BYTE cchLength;
+
+	WPGCaps wpgCaps;
+	LPCTSTR pszAlphabet;
+	BOOL fDuplicatesAllowed;
+
+	// Generates the passwords from the given (compiled) pattern, rather than the alphabet, if given; the
+	// length must then be the pattern's (see GetWPGPatternLength). Optional
+	WPG_PATTERN_H hPattern;
+
+	// Generates the passwords to satisfy the given (compiled) policy, rather than from the alphabet, if given;
+	// the length must then be the policy's (see GetWPGPolicyLength). Optional
+	WPG_POLICY_H hPolicy;
+
+	// Generates the passwords from the given (compiled) alphabet, rather than pszAlphabet, if given: each then has as many
+	// symbols as fit in the length (see WPGAlphabetSymbols), so is null-terminated short of it if some take fewer. Optional
+	WPG_ALPHABET_H hAlphabet;
+
+} WPG_BATCH, *PWPG_BATCH;
+
+typedef const WPG_BATCH* PCWPG_BATCH;
+
+typedef struct _WPG_POOL_JOB WPG_POOL_JOB, *PWPG_POOL_JOB;
+
+// Called on a worker thread when a job is done, with an enumeration of the generators which failed
+// (or WPGCapCANCELLED); the pool doesn't touch the job again after calling it
+typedef VOID (CALLBACK* PWPG_POOL_JOB_CALLBACK)(__in PWPG_POOL_JOB, __in WPGCaps);
+
+// Describes a single password to be generated, asynchronously, by a pool
+struct _WPG_POOL_JOB {
+
+	// Receives the (null-terminated) password, so must have room for cchLength+1 characters
+	LPTSTR pszBuffer;
+	BYTE cchLength;
+	BYTE cchGenerated;
+
+	WPGCaps wpgCaps;
+	LPCTSTR pszAlphabet;
+	BOOL fDuplicatesAllowed;
+
+	// Lets the caller abandon the job, before or during its generation; optional
+	WPG_CANCEL cancel;
+
+	// Bounds the time the job may take, and gives the sources it can't do without; optional
+	WPG_DEADLINE deadline;
+
+	PWPG_POOL_JOB_CALLBACK pfnCallback;
+	LPVOID lpContext;
+
+	// Reserved for the pool
+	PWPG_POOL_JOB pNext;
+};
+
+// Functions
+//
+
+// Starts a pool with the given number of workers, or one per (active) logical processor if zero
+WPG_POOL_H CreateWPGPool(__in DWORD);
+
+// Starts a pool whose workers all share the given generator, rather than opening a new one
+WPG_POOL_H CreateWPGPoolEx(__in DWORD, __in const std::shared_ptr<wpg_t>&);
+
+// Returns the number of workers in the pool
+DWORD GetWPGPoolSize(__in WPG_POOL_H);
+
+// Generates the given batch across the pool, blocking until it is complete; returns an enumeration of the generators which failed
+WPGCaps WPGPoolGenerate(__in WPG_POOL_H, __in PCWPG_BATCH);
+
+// Fills the given buffer with raw output from the given sources (see wpg_t::Entropy) across the pool, blocking until
+// it's full; returns an enumeration of the generators which failed, in which case the buffer is zeroed
+WPGCaps WPGPoolEntropy(__in WPG_POOL_H, __out_bcount(cbBuffer) PVOID, __in SIZE_T cbBuffer, __in WPGCaps);
+
+// Queues the given job for the next free worker, without waiting; any jobs still queued when the
+// pool is destroyed are completed with WPGCapCANCELLED. Returns FALSE (without queuing it) once
+// the pool is being destroyed, e.g. if the job is resubmitted from its callback as it drains
+BOOL WPGPoolSubmit(__in WPG_POOL_H, __in PWPG_POOL_JOB);
+
+// Stops the pool's workers, and cleans up after them
+VOID DestroyWPGPool(__in WPG_POOL_H);
+
+#endif // !defined(__WPG_POOL_H__)
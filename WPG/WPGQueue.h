@@ -0,0 +1,238 @@
+// WPGQueue.h: declares the bounded, lock-free queues used to pass requests to, and results from, the generator
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_QUEUE_H__)
+#define __WPG_QUEUE_H__
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Platform Headers
+#if defined (_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Constants
+//
+
+// Gives the size of a cache line, to keep producers and consumers off each other's lines
+constexpr size_t queue_line_size = 64;
+
+// Classes
+//
+
+// Wakes a waiting consumer; wraps an auto-reset event on Windows, and an eventfd elsewhere
+class wakeup_t {
+public:
+#if defined (_WIN32)
+	typedef HANDLE native_type;
+#else
+	typedef int native_type;
+#endif
+
+	// Passed to wait to wait without a timeout
+	static constexpr unsigned long infinite = 0xFFFFFFFFUL;
+
+#if defined (_WIN32)
+	wakeup_t(void): m_native( ::CreateEvent( NULL, FALSE, FALSE, NULL ) ) { }
+	~wakeup_t(void) {
+		if (m_native){
+			::CloseHandle( m_native );
+		}
+	}
+
+	operator bool() const {
+		return (m_native != NULL);
+	}
+
+	void signal(void) {
+		::SetEvent( m_native );
+	}
+
+	// Waits up to the given number of milliseconds; returns true if signalled
+	bool wait(unsigned long ms) {
+		return (::WaitForSingleObject( m_native, ms ) == WAIT_OBJECT_0);
+	}
+#else
+	wakeup_t(void): m_native( ::eventfd( 0, EFD_CLOEXEC ) ) { }
+	~wakeup_t(void) {
+		if (m_native >= 0){
+			::close( m_native );
+		}
+	}
+
+	operator bool() const {
+		return (m_native >= 0);
+	}
+
+	void signal(void) {
+		const uint64_t one = 1;
+		(void) ::write( m_native, &one, sizeof( one ) );
+	}
+
+	// Waits up to the given number of milliseconds; returns true if signalled
+	bool wait(unsigned long ms) {
+		pollfd pfd = { m_native, POLLIN, 0 };
+		const int timeout = (ms == infinite) ? -1 : static_cast<int>( ms );
+		if (::poll( &pfd, 1, timeout ) <= 0){
+			return false;
+		}
+
+		// Reading resets the counter, which makes it behave like an auto-reset event
+		uint64_t count = 0;
+		return (::read( m_native, &count, sizeof( count ) ) == sizeof( count ));
+	}
+#endif
+
+	// Returns the underlying handle or descriptor, e.g. to wait on alongside others
+	native_type native(void) const {
+		return m_native;
+	}
+
+	wakeup_t(const wakeup_t&) = delete;
+	wakeup_t& operator=(const wakeup_t&) = delete;
+
+private:
+	native_type m_native;
+};
+
+// A bounded queue with any number of producers and exactly one consumer; each cell carries a sequence
+// number which says whether it's ready to be written (== position) or read (== position + 1)
+template <typename _T, size_t _capacity>
+class mpsc_queue_t {
+	static_assert( (_capacity >= 2) && ((_capacity & (_capacity - 1)) == 0), "Capacity must be a power of two" );
+	static_assert( ::std::is_trivially_copyable<_T>::value, "Elements must be trivially copyable" );
+
+public:
+	mpsc_queue_t(void): m_head( 0 ) {
+		for (size_t i = 0; i < _capacity; i++){
+			m_cells[i].sequence.store( i, ::std::memory_order_relaxed );
+		}
+		m_tail.store( 0, ::std::memory_order_relaxed );
+	}
+
+	// Appends the given value, from any thread; returns false (without waiting) if the queue is full
+	bool try_push(const _T& value) {
+
+		size_t pos = m_tail.load( ::std::memory_order_relaxed );
+		cell_t* cell = nullptr;
+		for (;;){
+			cell = &(m_cells[pos & mask]);
+			const size_t sequence = cell->sequence.load( ::std::memory_order_acquire );
+			const ptrdiff_t diff = static_cast<ptrdiff_t>( sequence ) - static_cast<ptrdiff_t>( pos );
+			if (diff == 0){
+				if (m_tail.compare_exchange_weak( pos, pos + 1, ::std::memory_order_relaxed )){
+					break;
+				}
+			}else if (diff < 0){
+				return false;
+			}else{
+				pos = m_tail.load( ::std::memory_order_relaxed );
+			}
+		}
+		cell->value = value;
+		cell->sequence.store( pos + 1, ::std::memory_order_release );
+		return true;
+	}
+
+	// Removes the value at the front, from the consumer thread only; returns false if the queue is empty
+	bool try_pop(_T& value) {
+
+		cell_t& cell = m_cells[m_head & mask];
+		const size_t sequence = cell.sequence.load( ::std::memory_order_acquire );
+		if (sequence != (m_head + 1)){
+			return false;
+		}
+		value = cell.value;
+		cell.sequence.store( m_head + _capacity, ::std::memory_order_release );
+		m_head++;
+		return true;
+	}
+
+	static constexpr size_t capacity(void) {
+		return _capacity;
+	}
+
+private:
+	static constexpr size_t mask = _capacity - 1;
+
+	struct cell_t {
+		::std::atomic<size_t> sequence;
+		_T value;
+	};
+
+	alignas(queue_line_size) cell_t m_cells[_capacity];
+	alignas(queue_line_size) ::std::atomic<size_t> m_tail;
+	alignas(queue_line_size) size_t m_head;
+};
+
+// A bounded ring with exactly one producer and one consumer
+template <typename _T, size_t _capacity>
+class spsc_queue_t {
+	static_assert( (_capacity >= 2) && ((_capacity & (_capacity - 1)) == 0), "Capacity must be a power of two" );
+	static_assert( ::std::is_trivially_copyable<_T>::value, "Elements must be trivially copyable" );
+
+public:
+	spsc_queue_t(void) {
+		m_head.store( 0, ::std::memory_order_relaxed );
+		m_tail.store( 0, ::std::memory_order_relaxed );
+	}
+
+	// Appends the given value, from the producer thread only; returns false (without waiting) if the ring is full
+	bool try_push(const _T& value) {
+
+		const size_t tail = m_tail.load( ::std::memory_order_relaxed );
+		if ((tail - m_head.load( ::std::memory_order_acquire )) == _capacity){
+			return false;
+		}
+		m_items[tail & mask] = value;
+		m_tail.store( tail + 1, ::std::memory_order_release );
+		return true;
+	}
+
+	// Removes the value at the front, from the consumer thread only; returns false if the ring is empty.
+	// The slot is cleared on the way out, so that nothing (e.g. a password) lingers in the ring
+	bool try_pop(_T& value) {
+
+		const size_t head = m_head.load( ::std::memory_order_relaxed );
+		if (head == m_tail.load( ::std::memory_order_acquire )){
+			return false;
+		}
+		value = m_items[head & mask];
+		m_items[head & mask] = _T( );
+		m_head.store( head + 1, ::std::memory_order_release );
+		return true;
+	}
+
+	// Returns the number of values in the ring; from the producer's side, this can only overstate it
+	size_t size(void) const {
+		return m_tail.load( ::std::memory_order_acquire ) - m_head.load( ::std::memory_order_acquire );
+	}
+
+	static constexpr size_t capacity(void) {
+		return _capacity;
+	}
+
+private:
+	static constexpr size_t mask = _capacity - 1;
+
+	alignas(queue_line_size) _T m_items[_capacity];
+	alignas(queue_line_size) ::std::atomic<size_t> m_head;
+	alignas(queue_line_size) ::std::atomic<size_t> m_tail;
+};
+
+#endif // !defined(__WPG_QUEUE_H__)
@@ -0,0 +1,412 @@
+// WPGRing.cpp: gives the implementation of a ring of entropy, shared between processes through named shared memory.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// The ring is a bounded multi-producer, multi-consumer queue of fixed-size slots, each with its own
+// sequence number (after Vyukov): a slot at position p is free to fill when its sequence is p, and
+// free to take when it's p+1; taking it sets its sequence to p plus the size of the ring, which
+// frees it for the next lap. Positions only ever grow, so (at 64 bits) they never wrap.
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// C++ Standard Library Headers
+#include <new>
+
+// Declarations
+#include "WPGRing.h"
+
+// Constants
+//
+
+// Identifies the ring's shared memory, and the layout of it
+constexpr DWORD c_dwRingMagic = 0x52475057; // "WPGR"
+constexpr DWORD c_dwRingVersion = 1;
+
+// The fewest and the most slots in a ring
+constexpr DWORD c_cMinSlots = 0x10;
+constexpr DWORD c_cMaxSlots = 0x100000;
+
+// The number of slots filled with each draw from the sources (which can give at most 255 bytes at a time)
+constexpr DWORD c_cSlotsPerDraw = (0xFF / WPG_RING_SLOT_SIZE);
+
+// The time, in milliseconds, after which the producer tops the ring up without being asked, and
+// after which it tries again when the sources came up short
+constexpr DWORD c_dwRefillPoll = 1000;
+constexpr DWORD c_dwRefillBackoff = 250;
+
+// Types
+//
+
+// Heads the shared memory; the positions, and the flag, each get a cache line to themselves so
+// that the producer and the consumers don't contend for them needlessly
+typedef struct _WPG_RING_HEADER {
+
+	DWORD dwMagic;
+	DWORD dwVersion;
+	DWORD cSlots;
+	DWORD cbSlot;
+
+	// Consumers ask for a refill when fewer slots than this are filled
+	DWORD cLowWatermark;
+
+	// The position of the next slot to fill
+	alignas(64) volatile LONG64 llHead;
+
+	// The position of the next slot to take
+	alignas(64) volatile LONG64 llTail;
+
+	// Set by the consumer which signals the refill event, and cleared by the producer as it
+	// refills, so that the event is signalled once per refill rather than once per read
+	alignas(64) volatile LONG lRefill;
+
+} WPG_RING_HEADER, *PWPG_RING_HEADER;
+
+typedef struct alignas(64) _WPG_RING_SLOT {
+
+	volatile LONG64 llSequence;
+	BYTE bData[WPG_RING_SLOT_SIZE];
+
+} WPG_RING_SLOT, *PWPG_RING_SLOT;
+
+static_assert( sizeof( WPG_RING_SLOT ) == 64, "A slot should fill one cache line" );
+static_assert( (c_cSlotsPerDraw * WPG_RING_SLOT_SIZE) <= 0xFF, "A draw should fit into one call to Entropy" );
+
+typedef struct _WPG_RING_INSTANCE {
+
+	// The view of the shared memory, and the event on which to ask for a refill
+	HANDLE hMapping;
+	PWPG_RING_HEADER pHeader;
+	PWPG_RING_SLOT pSlots;
+	HANDLE hRefill;
+
+	// The number of slots, as laid out (or validated) by this instance; never read back from the shared
+	// memory, which anyone who can open the ring can write to
+	DWORD cSlots;
+
+	// The producer's state; NULL/empty for consumers
+	std::shared_ptr<wpg_t> wpg;
+	WPGCaps wpgCaps;
+	HANDLE hStop;
+	HANDLE hThread;
+	volatile LONG64 llProduced;
+	volatile LONG64 llShortfalls;
+
+} WPG_RING_INSTANCE, *PWPG_RING_INSTANCE;
+
+// Prototypes
+//
+
+static DWORD WINAPI WPGRingProducerThreadProc(__in LPVOID);
+
+// Functions
+//
+
+// Reads the given position atomically (which a plain read of a 64-bit value isn't, on 32-bit x86), with acquire
+// semantics, but without the locked read-modify-write of an interlocked operation
+static inline LONG64 WPGRingReadPosition(__in volatile LONG64* pllPosition) {
+
+	return ReadAcquire64( pllPosition );
+}
+
+static inline SIZE_T WPGRingSize(__in DWORD cSlots) {
+
+	return sizeof( WPG_RING_HEADER ) + (sizeof( WPG_RING_SLOT ) * static_cast<SIZE_T>( cSlots ));
+}
+
+static DWORD WPGRingFilled(__in PWPG_RING_HEADER pHeader, __in DWORD cSlots) {
+
+	// Read the tail first, so that the difference is never negative
+	const LONG64 llTail = WPGRingReadPosition( &(pHeader->llTail) );
+	const LONG64 llHead = WPGRingReadPosition( &(pHeader->llHead) );
+	return static_cast<DWORD>( min( static_cast<ULONG64>( llHead - llTail ), static_cast<ULONG64>( cSlots ) ) );
+}
+
+// Fills the next slot with the given bytes; returns FALSE if the ring is full
+static BOOL WPGRingPush(__in PWPG_RING_HEADER pHeader, __in PWPG_RING_SLOT pSlots, __in DWORD cSlots, __in_bcount(WPG_RING_SLOT_SIZE) const BYTE* lpData) {
+
+	const LONG64 llMask = static_cast<LONG64>( cSlots - 1 );
+	LONG64 llPosition = WPGRingReadPosition( &(pHeader->llHead) );
+	for (;;){
+		PWPG_RING_SLOT pSlot = pSlots + (llPosition & llMask);
+		const LONG64 llDiff = WPGRingReadPosition( &(pSlot->llSequence) ) - llPosition;
+		if (llDiff == 0){
+			const LONG64 llSeen = InterlockedCompareExchange64( &(pHeader->llHead), llPosition + 1, llPosition );
+			if (llSeen == llPosition){
+				CopyMemory( pSlot->bData, lpData, WPG_RING_SLOT_SIZE );
+				InterlockedExchange64( &(pSlot->llSequence), llPosition + 1 );
+				return TRUE;
+			}
+			llPosition = llSeen;
+		}else if (llDiff < 0){
+			return FALSE;
+		}else{
+			llPosition = WPGRingReadPosition( &(pHeader->llHead) );
+		}
+	}
+}
+
+// Takes the next slot, copying (up to) the given number of bytes of it out, and zeroing it; returns FALSE if the ring is empty
+static BOOL WPGRingPop(__in PWPG_RING_HEADER pHeader, __in PWPG_RING_SLOT pSlots, __in DWORD cSlots, __out_bcount(cbData) LPBYTE lpData, __in SIZE_T cbData) {
+
+	const LONG64 llMask = static_cast<LONG64>( cSlots - 1 );
+	LONG64 llPosition = WPGRingReadPosition( &(pHeader->llTail) );
+	for (;;){
+		PWPG_RING_SLOT pSlot = pSlots + (llPosition & llMask);
+		const LONG64 llDiff = WPGRingReadPosition( &(pSlot->llSequence) ) - (llPosition + 1);
+		if (llDiff == 0){
+			const LONG64 llSeen = InterlockedCompareExchange64( &(pHeader->llTail), llPosition + 1, llPosition );
+			if (llSeen == llPosition){
+				CopyMemory( lpData, pSlot->bData, min( cbData, static_cast<SIZE_T>( WPG_RING_SLOT_SIZE ) ) );
+				SecureZeroMemory( const_cast<LPBYTE>( pSlot->bData ), WPG_RING_SLOT_SIZE );
+				InterlockedExchange64( &(pSlot->llSequence), llPosition + cSlots );
+				return TRUE;
+			}
+			llPosition = llSeen;
+		}else if (llDiff < 0){
+			return FALSE;
+		}else{
+			llPosition = WPGRingReadPosition( &(pHeader->llTail) );
+		}
+	}
+}
+
+// Tops the ring up from the sources; returns FALSE if they came up short
+static BOOL WPGRingRefill(__in PWPG_RING_INSTANCE pRing) {
+
+	BYTE bDraw[c_cSlotsPerDraw * WPG_RING_SLOT_SIZE] = { 0 };
+	BOOL fResult = TRUE;
+	for (;;){
+		const DWORD cFree = pRing->cSlots - WPGRingFilled( pRing->pHeader, pRing->cSlots );
+		if ((cFree == 0) || (WaitForSingleObject( pRing->hStop, 0 ) == WAIT_OBJECT_0)){
+			break;
+		}
+
+		// Draw enough for (up to) a handful of slots at a time
+		const DWORD cSlots = min( cFree, c_cSlotsPerDraw );
+		const BYTE cbDraw = static_cast<BYTE>( cSlots * WPG_RING_SLOT_SIZE );
+		if (!WPGSucceeded( pRing->wpg->Entropy( bDraw, cbDraw, pRing->wpgCaps ) )){
+			InterlockedIncrement64( &(pRing->llShortfalls) );
+			fResult = FALSE;
+			break;
+		}
+		DWORD cPushed = 0;
+		while ((cPushed < cSlots) && WPGRingPush( pRing->pHeader, pRing->pSlots, pRing->cSlots, bDraw + (cPushed * WPG_RING_SLOT_SIZE) )){
+			cPushed++;
+		}
+		InterlockedExchangeAdd64( &(pRing->llProduced), static_cast<LONG64>( cPushed * WPG_RING_SLOT_SIZE ) );
+		if (cPushed < cSlots){
+			break;
+		}
+	}
+	SecureZeroMemory( bDraw, sizeof( bDraw ) );
+	return fResult;
+}
+
+// Releases whatever the given instance holds, and the instance itself
+static VOID WPGRingFree(__in PWPG_RING_INSTANCE pRing) {
+
+	if (pRing->hThread){
+		WaitForSingleObject( pRing->hThread, INFINITE );
+		CloseHandle( pRing->hThread );
+	}
+	if (pRing->hStop){
+		CloseHandle( pRing->hStop );
+	}
+	if (pRing->hRefill){
+		CloseHandle( pRing->hRefill );
+	}
+	if (pRing->pHeader){
+		UnmapViewOfFile( pRing->pHeader );
+	}
+	if (pRing->hMapping){
+		CloseHandle( pRing->hMapping );
+	}
+	pRing->~WPG_RING_INSTANCE( );
+	PH_FREE( pRing );
+}
+
+static PWPG_RING_INSTANCE WPGRingAlloc(void) {
+
+	PWPG_RING_INSTANCE pRing = static_cast<PWPG_RING_INSTANCE>(
+		PH_ALLOC( sizeof( WPG_RING_INSTANCE ) )
+	);
+	return (pRing) ? new (pRing) WPG_RING_INSTANCE( ) : NULL;
+}
+
+WPG_RING_H CreateWPGRing(__in const std::shared_ptr<wpg_t>& wpg, __in WPGCaps wpgCaps, __in DWORD cSlots) {
+
+	if (!wpg || (wpgCaps == WPGCapNONE)){
+		SetLastError( ERROR_INVALID_PARAMETER );
+		return NULL;
+	}
+
+	// Round the size up to a power of two, so that positions map onto slots with a mask
+	DWORD cRounded = c_cMinSlots;
+	while ((cRounded < cSlots) && (cRounded < c_cMaxSlots)){
+		cRounded <<= 1;
+	}
+	const ULONG64 ullSize = static_cast<ULONG64>( WPGRingSize( cRounded ) );
+
+	PWPG_RING_INSTANCE pRing = WPGRingAlloc( );
+	if (pRing == NULL){
+		SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+		return NULL;
+	}
+	pRing->hMapping = CreateFileMappingW( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, static_cast<DWORD>( ullSize >> 32 ), static_cast<DWORD>( ullSize ), WPG_RING_NAME );
+	if ((pRing->hMapping != NULL) && (GetLastError( ) == ERROR_ALREADY_EXISTS)){
+		// Someone else is producing already
+		WPGRingFree( pRing );
+		SetLastError( ERROR_ALREADY_EXISTS );
+		return NULL;
+	}
+	if (pRing->hMapping){
+		pRing->pHeader = static_cast<PWPG_RING_HEADER>( MapViewOfFile( pRing->hMapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0 ) );
+	}
+	pRing->hRefill = CreateEventW( NULL, FALSE, FALSE, WPG_RING_REFILL_NAME );
+	pRing->hStop = CreateEvent( NULL, TRUE, FALSE, NULL );
+	if ((pRing->pHeader == NULL) || (pRing->hRefill == NULL) || (pRing->hStop == NULL)){
+		const DWORD dwError = GetLastError( );
+		WPGRingFree( pRing );
+		SetLastError( dwError );
+		return NULL;
+	}
+
+	// Lay the ring out (the memory comes zeroed), with every slot free to fill on the first lap;
+	// the magic goes last, so that no-one opens the ring before it's ready
+	PWPG_RING_HEADER pHeader = pRing->pHeader;
+	pRing->pSlots = reinterpret_cast<PWPG_RING_SLOT>( pHeader + 1 );
+	pHeader->dwVersion = c_dwRingVersion;
+	pHeader->cSlots = cRounded;
+	pRing->cSlots = cRounded;
+	pHeader->cbSlot = WPG_RING_SLOT_SIZE;
+	pHeader->cLowWatermark = (cRounded / 4);
+	for (DWORD dw = 0; dw < cRounded; dw++){
+		pRing->pSlots[dw].llSequence = static_cast<LONG64>( dw );
+	}
+	InterlockedExchange( reinterpret_cast<volatile LONG*>( &(pHeader->dwMagic) ), static_cast<LONG>( c_dwRingMagic ) );
+
+	// Start filling it
+	pRing->wpg = wpg;
+	pRing->wpgCaps = wpgCaps;
+	pRing->hThread = CreateThread( NULL, 0, WPGRingProducerThreadProc, static_cast<LPVOID>( pRing ), 0, NULL );
+	if (pRing->hThread == NULL){
+		const DWORD dwError = GetLastError( );
+		WPGRingFree( pRing );
+		SetLastError( dwError );
+		return NULL;
+	}
+	return reinterpret_cast<WPG_RING_H>( pRing );
+}
+
+BOOL GetWPGRingStats(__in WPG_RING_H wpgRingHandle, __out PWPG_RING_STATS pStats) {
+
+	PWPG_RING_INSTANCE pRing = reinterpret_cast<PWPG_RING_INSTANCE>( wpgRingHandle );
+	if ((pRing == NULL) || !pRing->wpg || (pStats == NULL)){
+		return FALSE;
+	}
+	pStats->cSlots = pRing->cSlots;
+	pStats->cFilled = WPGRingFilled( pRing->pHeader, pRing->cSlots );
+	pStats->ullProduced = static_cast<ULONG64>( WPGRingReadPosition( &(pRing->llProduced) ) );
+	pStats->ullShortfalls = static_cast<ULONG64>( WPGRingReadPosition( &(pRing->llShortfalls) ) );
+	return TRUE;
+}
+
+VOID DestroyWPGRing(__in WPG_RING_H wpgRingHandle) {
+
+	PWPG_RING_INSTANCE pRing = reinterpret_cast<PWPG_RING_INSTANCE>( wpgRingHandle );
+	if (pRing == NULL){
+		return;
+	}
+	if (pRing->hStop){
+		SetEvent( pRing->hStop );
+	}
+	WPGRingFree( pRing );
+}
+
+WPG_RING_H OpenWPGRing(void) {
+
+	PWPG_RING_INSTANCE pRing = WPGRingAlloc( );
+	if (pRing == NULL){
+		return NULL;
+	}
+	pRing->hMapping = OpenFileMappingW( FILE_MAP_READ | FILE_MAP_WRITE, FALSE, WPG_RING_NAME );
+	if (pRing->hMapping){
+		pRing->pHeader = static_cast<PWPG_RING_HEADER>( MapViewOfFile( pRing->hMapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0 ) );
+	}
+	pRing->hRefill = OpenEventW( EVENT_MODIFY_STATE, FALSE, WPG_RING_REFILL_NAME );
+	if ((pRing->pHeader == NULL) || (pRing->hRefill == NULL)){
+		WPGRingFree( pRing );
+		return NULL;
+	}
+
+	// Check that the ring is laid out as we expect, and that it fits in the view
+	MEMORY_BASIC_INFORMATION mbi = { 0 };
+	const PWPG_RING_HEADER pHeader = pRing->pHeader;
+	const DWORD cSlots = *static_cast<volatile DWORD*>( &(pHeader->cSlots) );
+	if ((VirtualQuery( pHeader, &mbi, sizeof( mbi ) ) == 0) ||
+		(static_cast<DWORD>( InterlockedCompareExchange( reinterpret_cast<volatile LONG*>( &(pHeader->dwMagic) ), 0, 0 ) ) != c_dwRingMagic) ||
+		(pHeader->dwVersion != c_dwRingVersion) || (pHeader->cbSlot != WPG_RING_SLOT_SIZE) ||
+		(cSlots < c_cMinSlots) || (cSlots > c_cMaxSlots) || ((cSlots & (cSlots - 1)) != 0) ||
+		(WPGRingSize( cSlots ) > mbi.RegionSize)){
+		WPGRingFree( pRing );
+		SetLastError( ERROR_INVALID_DATA );
+		return NULL;
+	}
+	pRing->pSlots = reinterpret_cast<PWPG_RING_SLOT>( pHeader + 1 );
+	pRing->cSlots = cSlots;
+	return reinterpret_cast<WPG_RING_H>( pRing );
+}
+
+SIZE_T WPGRingRead(__in WPG_RING_H wpgRingHandle, __out_bcount(cbBuffer) PVOID pvBuffer, __in SIZE_T cbBuffer) {
+
+	PWPG_RING_INSTANCE pRing = reinterpret_cast<PWPG_RING_INSTANCE>( wpgRingHandle );
+	if ((pRing == NULL) || (pvBuffer == NULL)){
+		return 0;
+	}
+
+	// Take whole slots, straight into the caller's buffer; any of the last one which doesn't fit is discarded
+	LPBYTE lpBuffer = static_cast<LPBYTE>( pvBuffer );
+	SIZE_T cbRead = 0;
+	while ((cbRead < cbBuffer) && WPGRingPop( pRing->pHeader, pRing->pSlots, pRing->cSlots, lpBuffer + cbRead, cbBuffer - cbRead )){
+		cbRead += min( cbBuffer - cbRead, static_cast<SIZE_T>( WPG_RING_SLOT_SIZE ) );
+	}
+
+	// Ask for a refill once the ring drops below its low watermark, unless someone else has already
+	PWPG_RING_HEADER pHeader = pRing->pHeader;
+	if ((WPGRingFilled( pHeader, pRing->cSlots ) < pHeader->cLowWatermark) && (InterlockedCompareExchange( &(pHeader->lRefill), 1, 0 ) == 0)){
+		SetEvent( pRing->hRefill );
+	}
+	return cbRead;
+}
+
+VOID CloseWPGRing(__in WPG_RING_H wpgRingHandle) {
+
+	PWPG_RING_INSTANCE pRing = reinterpret_cast<PWPG_RING_INSTANCE>( wpgRingHandle );
+	if (pRing){
+		WPGRingFree( pRing );
+	}
+}
+
+static DWORD WINAPI WPGRingProducerThreadProc(__in LPVOID lpParameter) {
+
+	PWPG_RING_INSTANCE pRing = static_cast<PWPG_RING_INSTANCE>( lpParameter );
+	const HANDLE handles[] = { pRing->hStop, pRing->hRefill };
+	for (;;){
+		// Let the consumers ask again, then top the ring up; when the sources come up short, give
+		// them a while before trying again, however often we're asked
+		InterlockedExchange( &(pRing->pHeader->lRefill), 0 );
+		const DWORD dwWait = WPGRingRefill( pRing )
+			? WaitForMultipleObjects( _countof( handles ), handles, FALSE, c_dwRefillPoll )
+			: WaitForSingleObject( pRing->hStop, c_dwRefillBackoff );
+		if (dwWait == WAIT_OBJECT_0){
+			break;
+		}
+	}
+	return 0;
+}
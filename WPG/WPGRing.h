@@ -0,0 +1,76 @@
+// WPGRing.h: declares the interface to a ring of entropy, shared between processes through named shared memory
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// One process (the producer) creates the ring, and keeps it topped up from a generator's sources,
+// XOR'd together; any number of consumers, in any number of processes (in the same session), open
+// it and take bytes from it without locks. Every slot is handed out once only, and is zeroed as it
+// is taken. Whoever can open the ring can read, and write, all of it, so it's only as private as
+// the default security of the session's namespace.
+//
+
+#if !defined(__WPG_RING_H__)
+#define __WPG_RING_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGGenerators.h"
+
+// Macros
+//
+
+DECLARE_HANDLE(WPG_RING_H);
+
+// The name of the ring's shared memory, and of the event on which consumers ask for it to be refilled
+#define WPG_RING_NAME				L"Local\\WavesonEntropyRing"
+#define WPG_RING_REFILL_NAME		L"Local\\WavesonEntropyRingRefill"
+
+// The number of bytes in each slot of the ring
+#define WPG_RING_SLOT_SIZE			56
+
+// Types
+//
+
+// Gives the state of the ring, as seen by the producer
+typedef struct _WPG_RING_STATS {
+
+	DWORD cSlots;
+
+	// The number of slots filled, but not yet taken
+	DWORD cFilled;
+
+	// The number of bytes put into the ring, and the number of refills which came up short for want of entropy
+	ULONG64 ullProduced;
+	ULONG64 ullShortfalls;
+
+} WPG_RING_STATS, *PWPG_RING_STATS;
+
+// Functions
+//
+
+// Creates the ring, with (at least) the given number of slots, and starts filling it from the given
+// generator's sources; returns NULL (with the last error set) if it couldn't, e.g. if there's a
+// ring already
+WPG_RING_H CreateWPGRing(__in const std::shared_ptr<wpg_t>&, __in WPGCaps, __in DWORD);
+
+// Retrieves the state of the (producer's) ring
+BOOL GetWPGRingStats(__in WPG_RING_H, __out PWPG_RING_STATS);
+
+// Stops filling the ring, and closes it; consumers keep what they have open, but it's never refilled
+VOID DestroyWPGRing(__in WPG_RING_H);
+
+// Opens the ring created by another process (or this one), for taking from; returns NULL if there isn't one
+WPG_RING_H OpenWPGRing(void);
+
+// Takes up to the given number of bytes from the ring, without waiting; returns the number taken,
+// which falls short when the ring runs dry (in which case it is asked to refill). Safe to call
+// concurrently, from any number of threads and processes
+SIZE_T WPGRingRead(__in WPG_RING_H, __out_bcount(cbBuffer) PVOID, __in SIZE_T cbBuffer);
+
+// Closes the given consumer's view of the ring
+VOID CloseWPGRing(__in WPG_RING_H);
+
+#endif // !defined(__WPG_RING_H__)
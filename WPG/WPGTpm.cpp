@@ -0,0 +1,303 @@
+// WPGTpm.cpp: gives the implementation of the process-wide pool of TPM contexts.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// Declarations
+#include "WPGTpm.h"
+
+// Macros
+//
+
+#if defined (_M_IX86) || defined (_M_X64) || defined (_M_ARM64)
+#define le32_to_host(val) (val)
+#define be32_to_host(val) _byteswap_ulong(val)
+#define le16_to_host(val) (val)
+#define be16_to_host(val) _byteswap_ushort(val)
+#define host_to_le32(val) (val)
+#define host_to_be32(val) _byteswap_ulong(val)
+#define host_to_le16(val) (val)
+#define host_to_be16(val) _byteswap_ushort(val)
+#else
+#error Big/little endianess conversion macros not defined!
+#endif
+
+// Constants
+//
+
+enum {
+	TPM2_ST_NO_SESSIONS	= 0x8001,
+};
+
+enum {
+	TPM2_CC_GET_RANDOM	= 0x017B,
+};
+
+// Types
+//
+
+#pragma pack(push,1)
+typedef struct _tpm20_get_random_t {
+	unsigned short tag;
+	unsigned long size;
+	unsigned long code;
+	unsigned short param;
+} tpm20_get_random_t;
+#pragma pack(pop,1)
+
+// Functions
+//
+
+::std::shared_ptr<tpm_pool_t> tpm_pool_t::Get(WPGCap cap) {
+
+	static SRWLOCK srw = SRWLOCK_INIT;
+	static ::std::weak_ptr<tpm_pool_t> pools[2];
+
+	// Hand out the pool if it's already open, otherwise open it
+	::std::weak_ptr<tpm_pool_t>& weak = pools[(cap == WPGCapTPM20) ? 1 : 0];
+	AcquireSRWLockExclusive( &srw );
+	::std::shared_ptr<tpm_pool_t> pool = weak.lock( );
+	if (!pool){
+		pool = ::std::make_shared<tpm_pool_t>( cap );
+		weak = pool;
+	}
+	ReleaseSRWLockExclusive( &srw );
+	return pool;
+}
+
+tpm_pool_t::tpm_pool_t(WPGCap cap): m_cap( cap ), m_fAvailable( FALSE ), m_contexts{ }, m_cContexts( 0 ), m_cMaxContexts( c_cMaxContexts ), m_idle{ NULL }, m_cIdle( 0 ), m_pWaitersHead( NULL ), m_pWaitersTail( NULL ) {
+
+	InitializeSRWLock( &m_srw );
+	InitializeConditionVariable( &m_cv );
+
+	// Open the first context now, to find out whether there's a TPM to be had
+	if (Open( m_contexts[m_cContexts] )){
+		m_idle[m_cIdle++] = &(m_contexts[m_cContexts++]);
+		m_fAvailable = TRUE;
+	}
+}
+
+tpm_pool_t::~tpm_pool_t(void) {
+
+	for (DWORD dw = 0; dw < m_cContexts; dw++){
+		SetThreadpoolTimer( m_contexts[dw].pTimer, NULL, 0, 0 );
+		WaitForThreadpoolTimerCallbacks( m_contexts[dw].pTimer, TRUE );
+		CloseThreadpoolTimer( m_contexts[dw].pTimer );
+		::Tbsip_Context_Close( m_contexts[dw].hContext );
+	}
+}
+
+BYTE tpm_pool_t::fill(__out_bcount(cbBuffer) LPVOID buffer, __in BYTE cbBuffer, __in ULONGLONG ullDeadline) {
+
+	if (!m_fAvailable){
+		return 0;
+	}
+
+	BYTE result = 0;
+	while (result < cbBuffer){
+		context_t* pContext = Acquire( ullDeadline );
+		if (pContext == NULL){
+			return 0;
+		}
+		const BYTE generated = Submit( pContext, static_cast<PBYTE>( buffer ) + result, min( static_cast<BYTE>( cbBuffer - result ), c_cbPerTurn ), ullDeadline );
+		Release( pContext );
+		if (generated == 0){
+			return 0;
+		}
+		result += generated;
+	}
+	return result;
+}
+
+tpm_pool_t::context_t* tpm_pool_t::Acquire(ULONGLONG ullDeadline) {
+
+	AcquireSRWLockExclusive( &m_srw );
+
+	// Take an idle context if there's no-one ahead of us; open another if they're all busy and we're
+	// allowed, which happens at most a couple of times per pool, so it's done under the lock
+	context_t* pContext = NULL;
+	if (m_pWaitersHead == NULL){
+		if ((m_cIdle == 0) && (m_cContexts < m_cMaxContexts)){
+			if (Open( m_contexts[m_cContexts] )){
+				m_idle[m_cIdle++] = &(m_contexts[m_cContexts++]);
+			}else{
+				m_cMaxContexts = m_cContexts;
+			}
+		}
+		if (m_cIdle > 0){
+			pContext = m_idle[--m_cIdle];
+		}
+	}
+
+	// Otherwise, join the back of the line, and wait to be handed one
+	if (pContext == NULL){
+		waiter_t waiter = { NULL, NULL };
+		if (m_pWaitersTail){
+			m_pWaitersTail->pNext = &waiter;
+		}else{
+			m_pWaitersHead = &waiter;
+		}
+		m_pWaitersTail = &waiter;
+		while (waiter.pContext == NULL){
+			DWORD dwTimeout = INFINITE;
+			if (ullDeadline){
+				const ULONGLONG ullNow = GetTickCount64( );
+				if (ullNow >= ullDeadline){
+					break;
+				}
+				dwTimeout = static_cast<DWORD>( min( ullDeadline - ullNow, static_cast<ULONGLONG>( INFINITE - 1 ) ) );
+			}
+			SleepConditionVariableSRW( &m_cv, &m_srw, dwTimeout, 0 );
+		}
+
+		// Step out of the line if we ran out of time before our turn came
+		pContext = waiter.pContext;
+		if (pContext == NULL){
+			waiter_t* pPrevious = NULL;
+			for (waiter_t* pWaiter = m_pWaitersHead; pWaiter != &waiter; pWaiter = pWaiter->pNext){
+				pPrevious = pWaiter;
+			}
+			if (pPrevious){
+				pPrevious->pNext = waiter.pNext;
+			}else{
+				m_pWaitersHead = waiter.pNext;
+			}
+			if (m_pWaitersTail == &waiter){
+				m_pWaitersTail = pPrevious;
+			}
+		}
+	}
+	ReleaseSRWLockExclusive( &m_srw );
+	return pContext;
+}
+
+VOID tpm_pool_t::Release(context_t* pContext) {
+
+	AcquireSRWLockExclusive( &m_srw );
+	waiter_t* pWaiter = m_pWaitersHead;
+	if (pWaiter){
+		m_pWaitersHead = pWaiter->pNext;
+		if (m_pWaitersHead == NULL){
+			m_pWaitersTail = NULL;
+		}
+		pWaiter->pContext = pContext;
+	}else{
+		m_idle[m_cIdle++] = pContext;
+	}
+	ReleaseSRWLockExclusive( &m_srw );
+	if (pWaiter){
+		WakeAllConditionVariable( &m_cv );
+	}
+}
+
+BOOL tpm_pool_t::Open(context_t& context) const {
+
+	TBS_HCONTEXT hContext = NULL;
+	HRESULT hResult = E_FAIL;
+	if (m_cap == WPGCapTPM20){
+		TBS_CONTEXT_PARAMS2 contextParams = { 0 };
+		contextParams.version = TBS_CONTEXT_VERSION_TWO;
+		contextParams.includeTpm12 = 0;
+		contextParams.includeTpm20 = 1;
+		hResult = ::Tbsi_Context_Create( reinterpret_cast<PCTBS_CONTEXT_PARAMS>( &contextParams ), &hContext );
+	}else{
+		TBS_CONTEXT_PARAMS contextParams = { 0 };
+		contextParams.version = TBS_CONTEXT_VERSION_ONE;
+		hResult = ::Tbsi_Context_Create( &contextParams, &hContext );
+	}
+	if (FAILED( hResult )){
+		return FALSE;
+	}
+
+	// Give the context a timer, with which to cancel commands that run past their deadlines
+	PTP_TIMER pTimer = CreateThreadpoolTimer( OnDeadline, hContext, NULL );
+	if (pTimer == NULL){
+		::Tbsip_Context_Close( hContext );
+		return FALSE;
+	}
+	context.hContext = hContext;
+	context.pTimer = pTimer;
+	return TRUE;
+}
+
+VOID CALLBACK tpm_pool_t::OnDeadline(PTP_CALLBACK_INSTANCE, PVOID pvContext, PTP_TIMER) {
+
+	::Tbsip_Cancel_Commands( static_cast<TBS_HCONTEXT>( pvContext ) );
+}
+
+BYTE tpm_pool_t::Submit(context_t* pContext, PBYTE buffer, BYTE requested, ULONGLONG ullDeadline) const {
+
+	// Arm the context's timer to cancel the command, should it still be running at the deadline
+	if (ullDeadline){
+		const ULONGLONG ullNow = GetTickCount64( );
+		if (ullNow >= ullDeadline){
+			return 0;
+		}
+
+		// (Relative due times are negative, in 100-nanosecond units)
+		ULARGE_INTEGER due = { 0 };
+		due.QuadPart = static_cast<ULONGLONG>( -static_cast<LONGLONG>( (ullDeadline - ullNow) * 10000ULL ) );
+		FILETIME ftDue = { due.LowPart, due.HighPart };
+		SetThreadpoolTimer( pContext->pTimer, &ftDue, 0, 0 );
+	}
+
+	// Give a buffer big enough for either command, and the output (both responses' headers fit in 16 bytes)
+	const TBS_HCONTEXT hContext = pContext->hContext;
+	BYTE bBuffer[0x10 + c_cbPerTurn] = { 0 };
+	UINT32 cbResult = sizeof( bBuffer );
+	BYTE generated = 0;
+	if (m_cap == WPGCapTPM20){
+		const UINT32 cbCmd = sizeof( tpm20_get_random_t );
+		tpm20_get_random_t cmd = { 0 };
+		cmd.tag = host_to_be16( TPM2_ST_NO_SESSIONS );
+		cmd.size = host_to_be32( sizeof( cmd ) );
+		cmd.code = host_to_be32( TPM2_CC_GET_RANDOM );
+		cmd.param = host_to_be16( static_cast<unsigned short>( requested ) );
+		CopyMemory( bBuffer, &cmd, cbCmd );
+
+		HRESULT hResult = ::Tbsip_Submit_Command( hContext, TBS_COMMAND_LOCALITY_ZERO, TBS_COMMAND_PRIORITY_NORMAL, bBuffer, cbCmd, bBuffer, &cbResult );
+		if (SUCCEEDED( hResult )){
+			// Check the response code
+			UINT32 uBe32 = 0;
+			CopyMemory( &uBe32, bBuffer + offsetof( tpm20_get_random_t, code ), sizeof( uBe32 ) );
+			if (be32_to_host( uBe32 ) == 0){
+				CopyMemory( &uBe32, bBuffer + offsetof( tpm20_get_random_t, size ), sizeof( uBe32 ) );
+				generated = static_cast<BYTE>( min( be32_to_host( uBe32 ) - cbCmd, static_cast<UINT32>( requested ) ) );
+				CopyMemory( buffer, bBuffer + cbCmd, generated );
+			}
+		}
+	}else{
+		BYTE bCmd[] = {
+			0x00, 0xc1,					// TPM_TAG_RQU_COMMAND
+			0x00, 0x00, 0x00, 0x0e,		// blob length in bytes
+			0x00, 0x00, 0x00, 0x46,		// TPM API code (TPM_ORD_GetRandom)
+			0x00, 0x00, 0x00, 0x00		// # Bytes (copied in below)
+		};
+		const UINT32 cbCmd = sizeof( bCmd );
+		UINT32 uBe32 = host_to_be32( static_cast<UINT32>( requested ) );
+		CopyMemory( bCmd + (cbCmd - sizeof( uBe32 )), &uBe32, sizeof( uBe32 ) );
+
+		HRESULT hResult = ::Tbsip_Submit_Command( hContext, TBS_COMMAND_LOCALITY_ZERO, TBS_COMMAND_PRIORITY_NORMAL, bCmd, cbCmd, bBuffer, &cbResult );
+		if (SUCCEEDED( hResult )){
+			// Get out the number of random bytes returned from the TPM
+			CopyMemory( &uBe32, bBuffer + (cbCmd - sizeof( uBe32 )), sizeof( uBe32 ) );
+			generated = static_cast<BYTE>( min( be32_to_host( uBe32 ), static_cast<UINT32>( requested ) ) );
+			CopyMemory( buffer, bBuffer + cbCmd, generated );
+		}
+	}
+	SecureZeroMemory( bBuffer, sizeof( bBuffer ) );
+
+	// Disarm the timer, making sure it's not still cancelling as we hand the context on
+	if (ullDeadline){
+		SetThreadpoolTimer( pContext->pTimer, NULL, 0, 0 );
+		WaitForThreadpoolTimerCallbacks( pContext->pTimer, TRUE );
+	}
+	return generated;
+}
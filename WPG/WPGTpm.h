@@ -0,0 +1,104 @@
+// WPGTpm.h: declares the process-wide pool of TPM contexts, shared by all of the generators
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_TPM_H__)
+#define __WPG_TPM_H__
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <memory>
+
+// TPM Services Headers
+#include <tbs.h>
+
+// Local Project Headers
+#include "WPGGenerators.h"
+
+// Classes
+//
+
+// Gives the contexts opened on one version of TPM, onto which the GetRandom commands from every
+// generator in the process are scheduled; callers take turns, first-come first-served, with each
+// turn being a single command for a few bytes, so that a long request can't starve a short one.
+// Callers may give a deadline, past which they stop waiting for a turn, and their command in
+// flight (if any) is cancelled
+class tpm_pool_t {
+public:
+	// The most contexts to open on the TPM; it serialises commands anyway, so a second
+	// only serves to keep it fed while the first command's results are being copied out
+	static constexpr DWORD c_cMaxContexts = 2;
+
+	// The most bytes to request from the TPM in one turn
+	static constexpr BYTE c_cbPerTurn = 0x40;
+
+	// Returns the pool for the given version of TPM (WPGCapTPM12 or WPGCapTPM20), which is opened
+	// by the first caller and closed once the last of them lets go of it
+	static ::std::shared_ptr<tpm_pool_t> Get(WPGCap);
+
+	explicit tpm_pool_t(WPGCap);
+	~tpm_pool_t(void);
+
+	tpm_pool_t(const tpm_pool_t&) = delete;
+	tpm_pool_t& operator=(const tpm_pool_t&) = delete;
+
+	// Returns true if the TPM could be opened
+	operator bool(void) const {
+		return m_fAvailable;
+	}
+
+	// Fills the given buffer with random bytes from the TPM, waiting for turns as needed, until
+	// the given deadline (against GetTickCount64, or zero for none); returns the number of bytes
+	// filled, or zero on failure or if the deadline passed first
+	BYTE fill(__out_bcount(cbBuffer) LPVOID, __in BYTE cbBuffer, __in ULONGLONG = 0);
+
+private:
+	// Gives an open context, and the timer which cancels its command if it runs past a deadline
+	struct context_t {
+		TBS_HCONTEXT hContext;
+		PTP_TIMER pTimer;
+	};
+
+	// Gives a caller waiting for a turn; they're queued (on their own stacks) in order of arrival
+	struct waiter_t {
+		waiter_t* pNext;
+		context_t* pContext;
+	};
+
+	// Waits for the caller's turn, and for a context to take it on; returns NULL if the deadline passes first
+	context_t* Acquire(ULONGLONG);
+
+	// Hands the given context to the next caller in line, or else back to the idle ones
+	VOID Release(context_t*);
+
+	// Opens a new context on the TPM
+	BOOL Open(context_t&) const;
+
+	// Submits a single GetRandom command for (up to) the given number of bytes; returns the number received
+	BYTE Submit(context_t*, PBYTE, BYTE, ULONGLONG) const;
+
+	static VOID CALLBACK OnDeadline(PTP_CALLBACK_INSTANCE, PVOID, PTP_TIMER);
+
+	const WPGCap m_cap;
+	BOOL m_fAvailable;
+
+	SRWLOCK m_srw;
+	CONDITION_VARIABLE m_cv;
+
+	// Gives the contexts opened so far, and which of them are idle
+	context_t m_contexts[c_cMaxContexts];
+	DWORD m_cContexts;
+	DWORD m_cMaxContexts;
+	context_t* m_idle[c_cMaxContexts];
+	DWORD m_cIdle;
+
+	// Gives the callers waiting for a turn, first to last
+	waiter_t* m_pWaitersHead;
+	waiter_t* m_pWaitersTail;
+};
+
+#endif // !defined(__WPG_TPM_H__)
@@ -0,0 +1,104 @@
+// WPGUuid.cpp: gives the implementation for generating UUIDs from the password generator's sources.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// UUIDs are filled with raw output from the sources in bulk (so many to each fill of a source), and
+// then have their version and variant bits (and, for version 7, their timestamp and counter) set,
+// and are formatted, by the vector kernels (see encode_t).
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// Declarations
+#include "WPGUuid.h"
+
+// Constants
+//
+
+// The counter in a version 7 UUID: its width, and the mask applied to its (random) starting value
+// for each new timestamp, which leaves at least 2^41 increments before it overflows
+constexpr ULONG64 c_ullUuidCounterLimit = (1ULL << 42);
+constexpr ULONG64 c_ullUuidCounterSeedMask = ((1ULL << 41) - 1);
+
+// The difference between the FILETIME and Unix epochs, in 100ns units
+constexpr ULONG64 c_ullUnixEpoch = 116444736000000000ULL;
+
+// Globals
+//
+
+// The version 7 clock: the timestamp last handed out, and the next counter value at it
+static SRWLOCK g_srwUuidClock = SRWLOCK_INIT;
+static ULONG64 g_ullUuidMilliseconds = 0;
+static ULONG64 g_ullUuidCounter = 0;
+
+// Functions
+//
+
+// Returns the encoder for the widest-available vector extensions
+static const encode_t& WPGUuidEncoder(void) {
+
+	static const std::unique_ptr<encode_t> encoder = get_vex_encode( );
+	return *encoder;
+}
+
+// Reserves a run of the given number of counter values, at a timestamp no earlier than any handed out
+// before, from the version 7 clock; the given seed starts the counter at each new timestamp. If the
+// counter would overflow, the timestamp is run ahead by a millisecond, as RFC 9562 allows
+static VOID WPGUuidReserve(__in SIZE_T cUuids, __in ULONG64 ullSeed, __out ULONG64* pullMilliseconds, __out ULONG64* pullCounter) {
+
+	FILETIME ft = { 0 };
+	GetSystemTimeAsFileTime( &ft );
+	const ULONG64 ullNow = ((static_cast<ULONG64>( ft.dwHighDateTime ) << 32) | ft.dwLowDateTime) - c_ullUnixEpoch;
+	const ULONG64 ullMilliseconds = (ullNow / 10000);
+
+	AcquireSRWLockExclusive( &g_srwUuidClock );
+	if (ullMilliseconds > g_ullUuidMilliseconds){
+		g_ullUuidMilliseconds = ullMilliseconds;
+		g_ullUuidCounter = (ullSeed & c_ullUuidCounterSeedMask);
+	}
+	// Otherwise, the clock hasn't moved on (or has gone back), so carry on from where it was
+	if ((c_ullUuidCounterLimit - g_ullUuidCounter) < cUuids){
+		g_ullUuidMilliseconds++;
+		g_ullUuidCounter = (ullSeed & c_ullUuidCounterSeedMask);
+	}
+	*pullMilliseconds = g_ullUuidMilliseconds;
+	*pullCounter = g_ullUuidCounter;
+	g_ullUuidCounter += cUuids;
+	ReleaseSRWLockExclusive( &g_srwUuidClock );
+}
+
+WPGCaps WPGUuidGenerate(__in WPG_POOL_H wpgPoolHandle, __out_bcount(cUuids * WPG_UUID_SIZE) LPBYTE lpUuids, __in SIZE_T cUuids, __in BYTE bVersion, __in WPGCaps wpgCaps) {
+
+	if ((bVersion != 4) && (bVersion != 7)){
+		return wpgCaps;
+	}
+	if (cUuids == 0){
+		return WPGCapNONE;
+	}
+
+	// Fill all of them at once, so that each fill of a source covers as many as it can
+	const WPGCaps wpgCapsFailed = WPGPoolEntropy( wpgPoolHandle, lpUuids, cUuids * WPG_UUID_SIZE, wpgCaps );
+	if (!WPGSucceeded( wpgCapsFailed )){
+		return wpgCapsFailed;
+	}
+
+	ULONG64 ullMilliseconds = 0, ullCounter = 0;
+	if (bVersion == 7){
+		// Seed the counter from the random bits which the timestamp is about to overwrite
+		ULONG64 ullSeed = 0;
+		CopyMemory( &ullSeed, lpUuids, sizeof( ullSeed ) );
+		WPGUuidReserve( cUuids, ullSeed, &ullMilliseconds, &ullCounter );
+		SecureZeroMemory( &ullSeed, sizeof( ullSeed ) );
+	}
+	WPGUuidEncoder( ).stamp_uuids( lpUuids, cUuids, bVersion, ullMilliseconds, ullCounter );
+	return wpgCapsFailed;
+}
+
+SIZE_T WPGUuidFormat(__in_bcount(cUuids * WPG_UUID_SIZE) const BYTE* lpUuids, __in SIZE_T cUuids, __in CHAR chDelimiter, __out LPSTR pszOut) {
+	return WPGUuidEncoder( ).format_uuids( lpUuids, cUuids, chDelimiter, pszOut );
+}
@@ -0,0 +1,37 @@
+// WPGUuid.h: declares the interface for generating UUIDs from the password generator's sources
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_UUID_H__)
+#define __WPG_UUID_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGPool.h"
+
+// Macros
+//
+
+// The size of a UUID, and the length of its canonical text (without a terminator)
+#define WPG_UUID_SIZE			16
+#define WPG_UUID_CCH			36
+
+// Functions
+//
+
+// Fills the given buffer with the given number of UUIDs of the given version (4, random, or 7, ordered by
+// time) from the raw output of the given sources, across the given pool (see WPGPoolEntropy). Version 7
+// UUIDs carry a counter after the timestamp, so that they sort in the order they're generated, across
+// calls, within the process. Returns an enumeration of the generators which failed, in which case the
+// buffer is zeroed, or the given sources if the version isn't supported
+WPGCaps WPGUuidGenerate(__in WPG_POOL_H, __out_bcount(cUuids * WPG_UUID_SIZE) LPBYTE, __in SIZE_T cUuids, __in BYTE, __in WPGCaps);
+
+// Writes the canonical text of each of the given UUIDs, followed by the given delimiter, to the given buffer,
+// which must have room for (WPG_UUID_CCH+1) characters per UUID; returns the number of characters written
+SIZE_T WPGUuidFormat(__in_bcount(cUuids * WPG_UUID_SIZE) const BYTE*, __in SIZE_T cUuids, __in CHAR, __out LPSTR);
+
+#endif // !defined(__WPG_UUID_H__)
@@ -0,0 +1,309 @@
+// WPGWordlist.cpp: gives the implementation for generating passphrases from a wordlist.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// The list is mapped, rather than read, and indexed up front, by the offset of each word (every
+// line has to be counted before any word can be drawn uniformly); the words are then read straight
+// from the mapping, without being copied. Each word is drawn with just as many bits, from the
+// combined sources, as it takes to index the list, rejecting (and redrawing) those which fall beyond
+// its end, so that every word is equally likely; and each passphrase draws only as many bytes as
+// its words need, topping up for any which were rejected.
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// Declarations
+#include "WPGWordlist.h"
+
+// Constants
+//
+
+// The most bytes of raw output drawn from the sources at a time, for drawing words
+constexpr SIZE_T c_cbWordlistEntropy = 0xF0;
+
+// Types
+//
+
+typedef struct _WPG_WORDLIST_INSTANCE {
+
+	HANDLE hFile;
+	HANDLE hMapping;
+	const CHAR* pszView;
+	DWORD cbView;
+
+	// The offset of each word in the view
+	LPDWORD lpOffsets;
+	DWORD cWords;
+
+	// The bits needed to index the words
+	DWORD cBits;
+
+} WPG_WORDLIST_INSTANCE, *PWPG_WORDLIST_INSTANCE;
+
+// Gives the raw output from which words are drawn (at the end of the buffer), and the bits of it which haven't been used yet
+typedef struct _WPG_WORDLIST_BITS {
+
+	BYTE bEntropy[c_cbWordlistEntropy];
+	SIZE_T cbUsed;
+
+	ULONG64 ullBits;
+	DWORD cBits;
+
+} WPG_WORDLIST_BITS, *PWPG_WORDLIST_BITS;
+
+// Functions
+//
+
+static inline BOOL WPGWordlistIsDigit(__in CHAR ch) {
+	return (ch >= '0') && (ch <= '9');
+}
+
+static inline BOOL WPGWordlistIsSpace(__in CHAR ch) {
+	return (ch == ' ') || (ch == '\t') || (ch == '\r');
+}
+
+// Returns the offset of the start of the word on the line at the given offset, or the offset of the end of the
+// line if there isn't one: past its dice roll (i.e. leading digits, followed by white space) if any, and any white space
+static DWORD WPGWordlistSkip(__in const CHAR* pszView, __in DWORD dwOffset, __in DWORD dwEnd) {
+
+	DWORD dw = dwOffset;
+	while ((dw < dwEnd) && WPGWordlistIsDigit( pszView[dw] )){
+		dw++;
+	}
+	if ((dw == dwOffset) || (dw == dwEnd) || !WPGWordlistIsSpace( pszView[dw] )){
+		dw = dwOffset;
+	}
+	while ((dw < dwEnd) && WPGWordlistIsSpace( pszView[dw] )){
+		dw++;
+	}
+	return dw;
+}
+
+// Returns the length of the word at the given offset: to the end of its line, less any trailing white space
+static DWORD WPGWordlistLength(__in PWPG_WORDLIST_INSTANCE pWordlist, __in DWORD dwOffset) {
+
+	const CHAR* pszWord = pWordlist->pszView + dwOffset;
+	const CHAR* pszEnd = static_cast<const CHAR*>( memchr( pszWord, '\n', pWordlist->cbView - dwOffset ) );
+	DWORD cb = pszEnd ? static_cast<DWORD>( pszEnd - pszWord ) : (pWordlist->cbView - dwOffset);
+	while ((cb > 0) && WPGWordlistIsSpace( pszWord[cb - 1] )){
+		cb--;
+	}
+	return cb;
+}
+
+// Builds the index of the words in the view; returns FALSE (with the last error set) if it couldn't be allocated, or there are no words
+static BOOL WPGWordlistIndex(__in PWPG_WORDLIST_INSTANCE pWordlist) {
+
+	const CHAR* pszView = pWordlist->pszView;
+	const DWORD cbView = pWordlist->cbView;
+
+	// Skip the byte order mark, if any
+	DWORD dwStart = 0;
+	if ((cbView >= 3) && (memcmp( pszView, "\xEF\xBB\xBF", 3 ) == 0)){
+		dwStart = 3;
+	}
+
+	// Count the lines, for an upper bound on the words
+	DWORD cLines = 1;
+	for (const CHAR* psz = pszView + dwStart; (psz = static_cast<const CHAR*>( memchr( psz, '\n', cbView - (psz - pszView) ) )) != NULL; psz++){
+		cLines++;
+	}
+	pWordlist->lpOffsets = static_cast<LPDWORD>( PH_ALLOC( sizeof( DWORD ) * cLines ) );
+	if (pWordlist->lpOffsets == NULL){
+		SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+		return FALSE;
+	}
+
+	// Then index the start of the word on each line (if any)
+	for (DWORD dwLine = dwStart; dwLine < cbView; ){
+		const CHAR* pszEnd = static_cast<const CHAR*>( memchr( pszView + dwLine, '\n', cbView - dwLine ) );
+		const DWORD dwEnd = pszEnd ? static_cast<DWORD>( pszEnd - pszView ) : cbView;
+		const DWORD dwWord = WPGWordlistSkip( pszView, dwLine, dwEnd );
+		if ((dwWord < dwEnd) && (WPGWordlistLength( pWordlist, dwWord ) > 0)){
+			pWordlist->lpOffsets[pWordlist->cWords++] = dwWord;
+		}
+		dwLine = dwEnd + 1;
+	}
+	if (pWordlist->cWords == 0){
+		SetLastError( ERROR_INVALID_DATA );
+		return FALSE;
+	}
+	while ((pWordlist->cWords - 1) >> pWordlist->cBits){
+		pWordlist->cBits++;
+	}
+	return TRUE;
+}
+
+WPG_WORDLIST_H OpenWPGWordlist(__in_z LPCWSTR pszPath) {
+
+	PWPG_WORDLIST_INSTANCE pWordlist = static_cast<PWPG_WORDLIST_INSTANCE>(
+		PH_ALLOC( sizeof( WPG_WORDLIST_INSTANCE ) )
+	);
+	if (pWordlist == NULL){
+		SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+		return NULL;
+	}
+
+	BOOL fReady = FALSE;
+	pWordlist->hFile = CreateFileW( pszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if (pWordlist->hFile != INVALID_HANDLE_VALUE){
+		// The index is of 32-bit offsets; (and an empty file can't be mapped)
+		LARGE_INTEGER size = { 0 };
+		if (!GetFileSizeEx( pWordlist->hFile, &size )){
+			// Leave the last error as it is
+		}else if ((size.QuadPart == 0) || (size.QuadPart > MAXDWORD)){
+			SetLastError( (size.QuadPart == 0) ? ERROR_INVALID_DATA : ERROR_FILE_TOO_LARGE );
+		}else{
+			pWordlist->cbView = static_cast<DWORD>( size.QuadPart );
+			pWordlist->hMapping = CreateFileMappingW( pWordlist->hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+			if (pWordlist->hMapping){
+				pWordlist->pszView = static_cast<const CHAR*>( MapViewOfFile( pWordlist->hMapping, FILE_MAP_READ, 0, 0, 0 ) );
+			}
+			fReady = (pWordlist->pszView != NULL) && WPGWordlistIndex( pWordlist );
+		}
+	}
+	if (!fReady){
+		const DWORD dwError = GetLastError( );
+		CloseWPGWordlist( reinterpret_cast<WPG_WORDLIST_H>( pWordlist ) );
+		SetLastError( dwError );
+		return NULL;
+	}
+	return reinterpret_cast<WPG_WORDLIST_H>( pWordlist );
+}
+
+DWORD GetWPGWordlistSize(__in WPG_WORDLIST_H wpgWordlistHandle) {
+
+	return reinterpret_cast<PWPG_WORDLIST_INSTANCE>( wpgWordlistHandle )->cWords;
+}
+
+// Takes the given number of bits (no more than 32) from the given raw output, drawing more from the sources as
+// needed, but only enough for the given number of bits still wanted in all (including these); returns FALSE if
+// they failed
+static BOOL WPGWordlistTake(__in PWPG_WORDLIST_BITS pBits, __in DWORD cBits, __in ULONG64 cBitsWanted, __in WPG_POOL_H wpgPoolHandle, __in WPGCaps wpgCaps, __out DWORD* pdwValue, __inout WPGCaps* pwpgCapsFailed) {
+
+	while (pBits->cBits < cBits){
+		if (pBits->cbUsed == sizeof( pBits->bEntropy )){
+			const SIZE_T cb = static_cast<SIZE_T>( min( (cBitsWanted - pBits->cBits + 7) / 8, static_cast<ULONG64>( sizeof( pBits->bEntropy ) ) ) );
+			pBits->cbUsed = sizeof( pBits->bEntropy ) - cb;
+			const WPGCaps wpgCapsFailed = WPGPoolEntropy( wpgPoolHandle, pBits->bEntropy + pBits->cbUsed, cb, wpgCaps );
+			*pwpgCapsFailed |= wpgCapsFailed;
+			if (!WPGSucceeded( wpgCapsFailed )){
+				pBits->cbUsed = sizeof( pBits->bEntropy );
+				return FALSE;
+			}
+		}
+		pBits->ullBits |= (static_cast<ULONG64>( pBits->bEntropy[pBits->cbUsed] ) << pBits->cBits);
+		pBits->bEntropy[pBits->cbUsed++] = 0;
+		pBits->cBits += 8;
+	}
+	*pdwValue = static_cast<DWORD>( pBits->ullBits & ((1ULL << cBits) - 1) );
+	pBits->ullBits >>= cBits;
+	pBits->cBits -= cBits;
+	return TRUE;
+}
+
+HRESULT WPGWordlistGenerate(__in WPG_WORDLIST_H wpgWordlistHandle, __in WPG_POOL_H wpgPoolHandle, __in DWORD cWords, __in_z LPCTSTR pszSeparator, __out_ecount(cchBuffer) LPTSTR pszBuffer, __in SIZE_T cchBuffer, __in WPGCaps wpgCaps, __out_opt WPGCaps* pwpgCapsFailed) {
+
+	PWPG_WORDLIST_INSTANCE pWordlist = reinterpret_cast<PWPG_WORDLIST_INSTANCE>( wpgWordlistHandle );
+	if ((pWordlist == NULL) || (wpgPoolHandle == NULL) || (pszBuffer == NULL) || (cchBuffer == 0)){
+		return E_INVALIDARG;
+	}
+	size_t cchSeparator = 0;
+	if (pszSeparator){
+		StringCchLength( pszSeparator, STRSAFE_MAX_CCH, &cchSeparator );
+	}
+
+	WPG_WORDLIST_BITS bits = { 0 };
+	bits.cbUsed = sizeof( bits.bEntropy );
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	HRESULT hResult = S_OK;
+	SIZE_T cch = 0;
+	for (DWORD w = 0; (w < cWords) && SUCCEEDED( hResult ); w++){
+		// Draw the index of the next word, until it's in range
+		DWORD dwIndex = 0;
+		do {
+			const ULONG64 cBitsWanted = static_cast<ULONG64>( cWords - w ) * pWordlist->cBits;
+			if (!WPGWordlistTake( &bits, pWordlist->cBits, cBitsWanted, wpgPoolHandle, wpgCaps, &dwIndex, &wpgCapsFailed )){
+				hResult = E_FAIL;
+				break;
+			}
+		} while (dwIndex >= pWordlist->cWords);
+		if (FAILED( hResult )){
+			break;
+		}
+
+		// Append the separator, then the word, leaving room for the terminator
+		if ((w > 0) && cchSeparator){
+			if ((cchBuffer - cch) <= cchSeparator){
+				hResult = STRSAFE_E_INSUFFICIENT_BUFFER;
+				break;
+			}
+			CopyMemory( pszBuffer + cch, pszSeparator, sizeof( TCHAR ) * cchSeparator );
+			cch += cchSeparator;
+		}
+		const DWORD dwOffset = pWordlist->lpOffsets[dwIndex];
+		const DWORD cbWord = WPGWordlistLength( pWordlist, dwOffset );
+#if defined (UNICODE)
+		// (Given no room at all, MultiByteToWideChar would write nothing, and return the room it needs instead)
+		const int cchRoom = static_cast<int>( min( cchBuffer - cch - 1, static_cast<SIZE_T>( MAXINT ) ) );
+		if (cchRoom == 0){
+			hResult = STRSAFE_E_INSUFFICIENT_BUFFER;
+			break;
+		}
+		const int cchWord = MultiByteToWideChar( CP_UTF8, 0, pWordlist->pszView + dwOffset, static_cast<int>( cbWord ), pszBuffer + cch, cchRoom );
+		if (cchWord <= 0){
+			hResult = (GetLastError( ) == ERROR_INSUFFICIENT_BUFFER) ? STRSAFE_E_INSUFFICIENT_BUFFER : HRESULT_FROM_WIN32( GetLastError( ) );
+			break;
+		}
+		if (cchWord > cchRoom){
+			hResult = STRSAFE_E_INSUFFICIENT_BUFFER;
+			break;
+		}
+		cch += static_cast<SIZE_T>( cchWord );
+#else
+		if ((cchBuffer - cch) <= cbWord){
+			hResult = STRSAFE_E_INSUFFICIENT_BUFFER;
+			break;
+		}
+		CopyMemory( pszBuffer + cch, pWordlist->pszView + dwOffset, cbWord );
+		cch += cbWord;
+#endif
+	}
+	SecureZeroMemory( &bits, sizeof( bits ) );
+	if (pwpgCapsFailed){
+		*pwpgCapsFailed = wpgCapsFailed;
+	}
+
+	if (FAILED( hResult )){
+		SecureZeroMemory( pszBuffer, sizeof( TCHAR ) * cchBuffer );
+		return hResult;
+	}
+	pszBuffer[cch] = TEXT( '\0' );
+	return S_OK;
+}
+
+VOID CloseWPGWordlist(__in WPG_WORDLIST_H wpgWordlistHandle) {
+
+	PWPG_WORDLIST_INSTANCE pWordlist = reinterpret_cast<PWPG_WORDLIST_INSTANCE>( wpgWordlistHandle );
+	if (pWordlist == NULL){
+		return;
+	}
+	if (pWordlist->lpOffsets){
+		PH_FREE( pWordlist->lpOffsets );
+	}
+	if (pWordlist->pszView){
+		UnmapViewOfFile( pWordlist->pszView );
+	}
+	if (pWordlist->hMapping){
+		CloseHandle( pWordlist->hMapping );
+	}
+	if (pWordlist->hFile && (pWordlist->hFile != INVALID_HANDLE_VALUE)){
+		CloseHandle( pWordlist->hFile );
+	}
+	PH_FREE( pWordlist );
+}
@@ -0,0 +1,42 @@
+// WPGWordlist.h: declares the interface for generating passphrases from a wordlist
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_WORDLIST_H__)
+#define __WPG_WORDLIST_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGPool.h"
+
+// Macros
+//
+
+DECLARE_HANDLE(WPG_WORDLIST_H);
+
+// Functions
+//
+
+// Maps the given wordlist, and indexes its words: one per line, in UTF-8 (or ASCII), each optionally preceded by
+// its dice roll (as in diceware lists); blank lines are skipped. The whole list is scanned up front, but the words
+// themselves are read straight from the mapping. Returns NULL (with the last error set) on failure, or if the list
+// has no words
+WPG_WORDLIST_H OpenWPGWordlist(__in_z LPCWSTR);
+
+// Returns the number of words in the given list
+DWORD GetWPGWordlistSize(__in WPG_WORDLIST_H);
+
+// Generates a passphrase of the given number of words, each drawn uniformly from the given list with the raw output
+// of the given sources (see WPGPoolEntropy), and joined with the given separator, into the given buffer, which
+// is null-terminated (or zeroed, on failure). Doesn't allocate. Returns an HRESULT, e.g. STRSAFE_E_INSUFFICIENT_BUFFER
+// if the passphrase doesn't fit, and gives the sources which failed (if any)
+HRESULT WPGWordlistGenerate(__in WPG_WORDLIST_H, __in WPG_POOL_H, __in DWORD, __in_z LPCTSTR, __out_ecount(cchBuffer) LPTSTR, __in SIZE_T cchBuffer, __in WPGCaps, __out_opt WPGCaps*);
+
+// Unmaps the given list, and cleans up after it
+VOID CloseWPGWordlist(__in WPG_WORDLIST_H);
+
+#endif // !defined(__WPG_WORDLIST_H__)
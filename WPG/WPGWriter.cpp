@@ -0,0 +1,459 @@
+// WPGWriter.cpp: gives the implementation of a sink which streams passwords out to a file.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// By default, passwords are encoded into one of a pair of large (page-aligned) buffers while the
+// other is written out, unbuffered, by a thread of the writer's own, so that generating, encoding
+// and writing overlap; the caller only waits when both buffers are still being written, which holds
+// the pool back to the pace of the disk. (Overlapped I/O wouldn't do: Windows completes writes which
+// extend a file's valid data synchronously, however much of it has been allocated, and moving the
+// valid data on up front takes a privilege, and exposes whatever was on the disk before, if the
+// file's never finished.) The file is still allocated up front, given the expected size, so that it
+// isn't grown, and fragmented, a write at a time.
+//
+// Alternatively, passwords are encoded straight into (large) mapped views of the file, which is
+// grown as needed, and trimmed to size at the end, leaving the writing to the cache manager. (Large
+// pages can't back views of files on Windows, only of the paging file, so the views are plain.)
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// Declarations
+#include "WPGWriter.h"
+
+// Constants
+//
+
+// The size of each of the pair of buffers
+constexpr SIZE_T c_cbBuffer = (4 * 1024 * 1024);
+
+// The size (and alignment) to which the last, partial, buffer is padded for unbuffered I/O; a
+// multiple of any sector size we'll meet
+constexpr SIZE_T c_cbSector = 4096;
+
+// The size of each mapped view of the file; a multiple of the allocation granularity
+constexpr SIZE_T c_cbView = (64 * 1024 * 1024);
+
+// The most passwords generated in each chunk of a batch
+constexpr SIZE_T c_cChunkPasswords = 0x8000;
+
+// The most bytes a character encodes to (N.B. surrogates are encoded, one by one, as U+FFFD)
+constexpr SIZE_T c_cbMaxPerChar = 3;
+
+// Types
+//
+
+typedef struct _WPG_WRITER_BUFFER {
+
+	LPBYTE lpData;
+
+	// The write handed to the writer thread from the buffer, if any: where it goes, and the bytes in it
+	BOOL fPending;
+	ULONG64 ullOffset;
+	DWORD cbPending;
+
+	// Set when the write's been handed over, and when it's done, and how it went
+	HANDLE hReady;
+	HANDLE hDone;
+	DWORD cbWritten;
+	DWORD dwError;
+
+} WPG_WRITER_BUFFER, *PWPG_WRITER_BUFFER;
+
+typedef struct _WPG_WRITER_INSTANCE {
+
+	HANDLE hFile;
+	DWORD dwFlags;
+	BYTE bDelimiter;
+
+	// Where passwords are being encoded to: the current buffer, or view, its size and how much of it is used
+	LPBYTE lpTarget;
+	SIZE_T cbTarget;
+	SIZE_T cbUsed;
+
+	// The bytes appended, in all, and where the current buffer (or view) starts in the file
+	ULONG64 ullWritten;
+	ULONG64 ullOffset;
+
+	// For writing: the pair of buffers, which of them is current, and the thread which writes them out
+	WPG_WRITER_BUFFER buffers[2];
+	DWORD dwCurrent;
+	HANDLE hThread;
+	volatile LONG lStop;
+
+	// For mapping: the mapping of the file, its size (so far), and the size it's expected to reach
+	HANDLE hMapping;
+	ULONG64 ullFileSize;
+	ULONG64 ullExpected;
+
+	// The first error encountered, if any
+	DWORD dwError;
+
+} WPG_WRITER_INSTANCE, *PWPG_WRITER_INSTANCE;
+
+// Functions
+//
+
+static BOOL WPGWriterSetEndOfFile(__in HANDLE hFile, __in ULONG64 ullSize) {
+
+	FILE_END_OF_FILE_INFO info = { 0 };
+	info.EndOfFile.QuadPart = static_cast<LONGLONG>( ullSize );
+	return SetFileInformationByHandle( hFile, FileEndOfFileInfo, &info, sizeof( info ) );
+}
+
+// Records the given error, if it's the first, and returns FALSE
+static BOOL WPGWriterFail(__in PWPG_WRITER_INSTANCE pWriter, __in DWORD dwError) {
+
+	if (pWriter->dwError == ERROR_SUCCESS){
+		pWriter->dwError = (dwError != ERROR_SUCCESS) ? dwError : ERROR_WRITE_FAULT;
+	}
+	SetLastError( pWriter->dwError );
+	return FALSE;
+}
+
+// Waits for the write from the given buffer (if any) to complete, and zeroes it for reuse
+static BOOL WPGWriterSettle(__in PWPG_WRITER_INSTANCE pWriter, __in PWPG_WRITER_BUFFER pBuffer) {
+
+	if (!pBuffer->fPending){
+		return TRUE;
+	}
+	WaitForSingleObject( pBuffer->hDone, INFINITE );
+	SecureZeroMemory( pBuffer->lpData, pBuffer->cbPending );
+	pBuffer->fPending = FALSE;
+	if (pBuffer->dwError != ERROR_SUCCESS){
+		return WPGWriterFail( pWriter, pBuffer->dwError );
+	}
+	if (pBuffer->cbWritten != pBuffer->cbPending){
+		return WPGWriterFail( pWriter, ERROR_WRITE_FAULT );
+	}
+	return TRUE;
+}
+
+// Writes the buffers out as they're handed over, which is always by turns, starting with the first (since
+// only the last hand-off can be skipped, for being empty), until it's told to stop
+static DWORD WINAPI WPGWriterThreadProc(__in LPVOID lpParameter) {
+
+	PWPG_WRITER_INSTANCE pWriter = static_cast<PWPG_WRITER_INSTANCE>( lpParameter );
+	for (DWORD dw = 0; ; dw ^= 1){
+		PWPG_WRITER_BUFFER pBuffer = pWriter->buffers + dw;
+		WaitForSingleObject( pBuffer->hReady, INFINITE );
+		if (InterlockedCompareExchange( &(pWriter->lStop), 0, 0 ) > 0){
+			break;
+		}
+
+		// The handle isn't overlapped, so this just says where the write goes
+		OVERLAPPED ov = { 0 };
+		ov.Offset = static_cast<DWORD>( pBuffer->ullOffset );
+		ov.OffsetHigh = static_cast<DWORD>( pBuffer->ullOffset >> 32 );
+		pBuffer->cbWritten = 0;
+		pBuffer->dwError = WriteFile( pWriter->hFile, pBuffer->lpData, pBuffer->cbPending, &(pBuffer->cbWritten), &ov )
+			? ERROR_SUCCESS
+			: GetLastError( );
+		SetEvent( pBuffer->hDone );
+	}
+	return 0;
+}
+
+// Maps the next view of the file, growing the file first if the view would run past its end
+static BOOL WPGWriterMapNext(__in PWPG_WRITER_INSTANCE pWriter) {
+
+	const ULONG64 ullEnd = pWriter->ullOffset + c_cbView;
+	if (ullEnd > pWriter->ullFileSize){
+		if (pWriter->hMapping){
+			CloseHandle( pWriter->hMapping );
+			pWriter->hMapping = NULL;
+		}
+		const ULONG64 ullSize = max( ullEnd, max( pWriter->ullFileSize * 2, pWriter->ullExpected ) );
+		if (!WPGWriterSetEndOfFile( pWriter->hFile, ullSize )){
+			return WPGWriterFail( pWriter, GetLastError( ) );
+		}
+		pWriter->ullFileSize = ullSize;
+		pWriter->hMapping = CreateFileMappingW( pWriter->hFile, NULL, PAGE_READWRITE, 0, 0, NULL );
+		if (pWriter->hMapping == NULL){
+			return WPGWriterFail( pWriter, GetLastError( ) );
+		}
+	}
+	LPVOID lpView = MapViewOfFile( pWriter->hMapping, FILE_MAP_WRITE,
+		static_cast<DWORD>( pWriter->ullOffset >> 32 ), static_cast<DWORD>( pWriter->ullOffset ), c_cbView );
+	if (lpView == NULL){
+		return WPGWriterFail( pWriter, GetLastError( ) );
+	}
+	pWriter->lpTarget = static_cast<LPBYTE>( lpView );
+	pWriter->cbTarget = c_cbView;
+	pWriter->cbUsed = 0;
+	return TRUE;
+}
+
+// Hands off what's been encoded into the current buffer (or view), and moves on to the next; when
+// it's the last, it may be partial
+static BOOL WPGWriterAdvance(__in PWPG_WRITER_INSTANCE pWriter, __in BOOL fLast) {
+
+	if (pWriter->dwFlags & WPG_WRITER_MAPPED){
+		if (pWriter->lpTarget){
+			UnmapViewOfFile( pWriter->lpTarget );
+			pWriter->lpTarget = NULL;
+			pWriter->ullOffset += pWriter->cbTarget;
+		}
+		return fLast || WPGWriterMapNext( pWriter );
+	}
+
+	// Hand the current buffer to the writer thread, padding the last to a whole number of sectors (with
+	// the zeroes left in it from last time), then wait for the other one to be free
+	PWPG_WRITER_BUFFER pBuffer = pWriter->buffers + pWriter->dwCurrent;
+	if (pWriter->cbUsed > 0){
+		const SIZE_T cbWrite = (pWriter->cbUsed + (c_cbSector - 1)) & ~(c_cbSector - 1);
+		pBuffer->ullOffset = pWriter->ullOffset;
+		pBuffer->cbPending = static_cast<DWORD>( cbWrite );
+		pBuffer->fPending = TRUE;
+		SetEvent( pBuffer->hReady );
+		pWriter->ullOffset += cbWrite;
+	}
+	pWriter->dwCurrent ^= 1;
+	pWriter->lpTarget = pWriter->buffers[pWriter->dwCurrent].lpData;
+	pWriter->cbUsed = 0;
+	return WPGWriterSettle( pWriter, pWriter->buffers + pWriter->dwCurrent );
+}
+
+// Encodes the given password (which may be terminated short of its length), and its delimiter, into the given buffer,
+// which must have room for the worst case; returns the number of bytes used
+static SIZE_T WPGWriterEncode(__out LPBYTE lpOut, __in LPCTSTR pszPassword, __in BYTE cchLength, __in BYTE bDelimiter) {
+
+	SIZE_T cb = 0;
+	for (BYTE i = 0; (i < cchLength) && (pszPassword[i] != TEXT( '\0' )); i++){
+#if defined (UNICODE)
+		// Take ASCII a character at a time, and hand anything else (to the end of the password) off
+		const WCHAR wc = pszPassword[i];
+		if (wc >= 0x80){
+			int cchRest = 1;
+			while (((i + cchRest) < cchLength) && (pszPassword[i + cchRest] != L'\0')){
+				cchRest++;
+			}
+			cb += static_cast<SIZE_T>( WideCharToMultiByte( CP_UTF8, 0, pszPassword + i, cchRest,
+				reinterpret_cast<LPSTR>( lpOut + cb ), static_cast<int>( c_cbMaxPerChar * cchRest ), NULL, NULL ) );
+			break;
+		}
+		lpOut[cb++] = static_cast<BYTE>( wc );
+#else
+		lpOut[cb++] = static_cast<BYTE>( pszPassword[i] );
+#endif
+	}
+	lpOut[cb++] = bDelimiter;
+	return cb;
+}
+
+WPG_WRITER_H CreateWPGWriter(__in_z LPCWSTR pszPath, __in DWORD dwFlags, __in ULONG64 ullExpected) {
+
+	const BOOL fMapped = (dwFlags & WPG_WRITER_MAPPED) ? TRUE : FALSE;
+	PWPG_WRITER_INSTANCE pWriter = static_cast<PWPG_WRITER_INSTANCE>(
+		PH_ALLOC( sizeof( WPG_WRITER_INSTANCE ) )
+	);
+	if (pWriter == NULL){
+		SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+		return NULL;
+	}
+	pWriter->dwFlags = dwFlags;
+	pWriter->bDelimiter = (dwFlags & WPG_WRITER_NUL) ? '\0' : '\n';
+	pWriter->ullExpected = ullExpected;
+
+	// Mapping a view for writing needs read access too
+	pWriter->hFile = CreateFileW( pszPath, (fMapped) ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		(fMapped) ? FILE_ATTRIBUTE_NORMAL : (FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING), NULL );
+	if (pWriter->hFile == INVALID_HANDLE_VALUE){
+		const DWORD dwError = GetLastError( );
+		PH_FREE( pWriter );
+		SetLastError( dwError );
+		return NULL;
+	}
+
+	BOOL fReady = FALSE;
+	if (fMapped){
+		fReady = WPGWriterMapNext( pWriter );
+	}else{
+		// Allocate the file up front, if we can, so that it isn't grown a write at a time
+		if (ullExpected > 0){
+			FILE_ALLOCATION_INFO info = { 0 };
+			info.AllocationSize.QuadPart = static_cast<LONGLONG>( (ullExpected + (c_cbSector - 1)) & ~static_cast<ULONG64>( c_cbSector - 1 ) );
+			SetFileInformationByHandle( pWriter->hFile, FileAllocationInfo, &info, sizeof( info ) );
+		}
+		fReady = TRUE;
+		for (DWORD dw = 0; dw < _countof( pWriter->buffers ); dw++){
+			PWPG_WRITER_BUFFER pBuffer = pWriter->buffers + dw;
+			pBuffer->lpData = static_cast<LPBYTE>( VirtualAlloc( NULL, c_cbBuffer, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE ) );
+			pBuffer->hReady = CreateEvent( NULL, FALSE, FALSE, NULL );
+			pBuffer->hDone = CreateEvent( NULL, FALSE, FALSE, NULL );
+			if ((pBuffer->lpData == NULL) || (pBuffer->hReady == NULL) || (pBuffer->hDone == NULL)){
+				WPGWriterFail( pWriter, GetLastError( ) );
+				fReady = FALSE;
+			}
+		}
+		if (fReady){
+			pWriter->hThread = CreateThread( NULL, 0, WPGWriterThreadProc, static_cast<LPVOID>( pWriter ), 0, NULL );
+			if (pWriter->hThread == NULL){
+				WPGWriterFail( pWriter, GetLastError( ) );
+				fReady = FALSE;
+			}
+		}
+		pWriter->lpTarget = pWriter->buffers[0].lpData;
+		pWriter->cbTarget = c_cbBuffer;
+	}
+	if (!fReady){
+		const DWORD dwError = pWriter->dwError;
+		CloseWPGWriter( reinterpret_cast<WPG_WRITER_H>( pWriter ) );
+		SetLastError( dwError );
+		return NULL;
+	}
+	return reinterpret_cast<WPG_WRITER_H>( pWriter );
+}
+
+ULONG64 WPGWriterSize(__in SIZE_T cPasswords, __in BYTE cchLength) {
+
+	return static_cast<ULONG64>( cPasswords ) * ((c_cbMaxPerChar * cchLength) + 1);
+}
+
+BOOL WPGWriterAppend(__in WPG_WRITER_H wpgWriterHandle, __in LPCTSTR pszRecords, __in SIZE_T cRecords, __in BYTE cchLength) {
+
+	PWPG_WRITER_INSTANCE pWriter = reinterpret_cast<PWPG_WRITER_INSTANCE>( wpgWriterHandle );
+	if ((pWriter == NULL) || (pszRecords == NULL)){
+		SetLastError( ERROR_INVALID_PARAMETER );
+		return FALSE;
+	}
+	if (pWriter->dwError != ERROR_SUCCESS){
+		SetLastError( pWriter->dwError );
+		return FALSE;
+	}
+
+	// Encode straight into the buffer while there's room for the worst case, and otherwise by way
+	// of the stack, so that passwords can straddle buffers
+	BYTE bRecord[(c_cbMaxPerChar * 0xFF) + 1];
+	const SIZE_T cbMost = (c_cbMaxPerChar * cchLength) + 1;
+	BOOL fResult = TRUE;
+	for (SIZE_T r = 0; (r < cRecords) && fResult; r++){
+		LPCTSTR pszPassword = pszRecords + (r * (static_cast<SIZE_T>( cchLength ) + 1));
+		if ((pWriter->cbTarget - pWriter->cbUsed) >= cbMost){
+			const SIZE_T cb = WPGWriterEncode( pWriter->lpTarget + pWriter->cbUsed, pszPassword, cchLength, pWriter->bDelimiter );
+			pWriter->cbUsed += cb;
+			pWriter->ullWritten += cb;
+			continue;
+		}
+
+		const SIZE_T cb = WPGWriterEncode( bRecord, pszPassword, cchLength, pWriter->bDelimiter );
+		for (SIZE_T cbDone = 0; (cbDone < cb) && fResult; ){
+			if (pWriter->cbUsed == pWriter->cbTarget){
+				fResult = WPGWriterAdvance( pWriter, FALSE );
+				continue;
+			}
+			const SIZE_T cbCopy = min( cb - cbDone, pWriter->cbTarget - pWriter->cbUsed );
+			CopyMemory( pWriter->lpTarget + pWriter->cbUsed, bRecord + cbDone, cbCopy );
+			pWriter->cbUsed += cbCopy;
+			pWriter->ullWritten += cbCopy;
+			cbDone += cbCopy;
+		}
+	}
+	SecureZeroMemory( bRecord, sizeof( bRecord ) );
+	return fResult;
+}
+
+HRESULT WPGWriterGenerate(__in WPG_WRITER_H wpgWriterHandle, __in WPG_POOL_H wpgPoolHandle, __in PCWPG_BATCH pBatch, __out_opt WPGCaps* pwpgCapsFailed) {
+
+	if (pwpgCapsFailed){
+		*pwpgCapsFailed = WPGCapNONE;
+	}
+	if ((wpgWriterHandle == NULL) || (wpgPoolHandle == NULL) || (pBatch == NULL) || (pBatch->cchLength == 0)){
+		return E_INVALIDARG;
+	}
+
+	// Generate a chunk at a time into the one scratch buffer; the pool works on the next chunk while
+	// the last is still being written out
+	const SIZE_T cChunk = min( pBatch->cPasswords, c_cChunkPasswords );
+	const SIZE_T cchChunk = cChunk * (static_cast<SIZE_T>( pBatch->cchLength ) + 1);
+	LPTSTR pszChunk = static_cast<LPTSTR>( PH_ALLOC( sizeof( TCHAR ) * max( cchChunk, static_cast<SIZE_T>( 1 ) ) ) );
+	if (pszChunk == NULL){
+		return E_OUTOFMEMORY;
+	}
+	HRESULT hResult = S_OK;
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	for (SIZE_T cDone = 0; cDone < pBatch->cPasswords; ){
+		WPG_BATCH batch = *pBatch;
+		batch.pszBuffer = pszChunk;
+		batch.cPasswords = min( cChunk, pBatch->cPasswords - cDone );
+		const WPGCaps wpgCaps = WPGPoolGenerate( wpgPoolHandle, &batch );
+		wpgCapsFailed |= wpgCaps;
+		if (!WPGSucceeded( wpgCaps )){
+			hResult = E_FAIL;
+			break;
+		}
+		if (!WPGWriterAppend( wpgWriterHandle, pszChunk, batch.cPasswords, batch.cchLength )){
+			hResult = HRESULT_FROM_WIN32( GetLastError( ) );
+			break;
+		}
+		cDone += batch.cPasswords;
+	}
+	SecureZeroMemory( pszChunk, sizeof( TCHAR ) * cchChunk );
+	PH_FREE( pszChunk );
+	if (pwpgCapsFailed){
+		*pwpgCapsFailed = wpgCapsFailed;
+	}
+	return hResult;
+}
+
+HRESULT CloseWPGWriter(__in WPG_WRITER_H wpgWriterHandle) {
+
+	PWPG_WRITER_INSTANCE pWriter = reinterpret_cast<PWPG_WRITER_INSTANCE>( wpgWriterHandle );
+	if (pWriter == NULL){
+		return E_INVALIDARG;
+	}
+
+	// Hand off whatever's left, and wait for all of it to be written
+	if ((pWriter->dwError == ERROR_SUCCESS) && (pWriter->lpTarget != NULL)){
+		WPGWriterAdvance( pWriter, TRUE );
+	}
+	for (DWORD dw = 0; dw < _countof( pWriter->buffers ); dw++){
+		WPGWriterSettle( pWriter, pWriter->buffers + dw );
+	}
+	if (pWriter->hThread){
+		// Nothing's pending, so the thread's waiting on one buffer or the other
+		InterlockedIncrement( &(pWriter->lStop) );
+		for (DWORD dw = 0; dw < _countof( pWriter->buffers ); dw++){
+			SetEvent( pWriter->buffers[dw].hReady );
+		}
+		WaitForSingleObject( pWriter->hThread, INFINITE );
+		CloseHandle( pWriter->hThread );
+	}
+	if ((pWriter->dwFlags & WPG_WRITER_MAPPED) && pWriter->lpTarget){
+		UnmapViewOfFile( pWriter->lpTarget );
+	}
+	if (pWriter->hMapping){
+		CloseHandle( pWriter->hMapping );
+	}
+
+	// Trim off the padding (or the rest of the last view)
+	if (pWriter->hFile != INVALID_HANDLE_VALUE){
+		if ((pWriter->dwError == ERROR_SUCCESS) && !WPGWriterSetEndOfFile( pWriter->hFile, pWriter->ullWritten )){
+			WPGWriterFail( pWriter, GetLastError( ) );
+		}
+		CloseHandle( pWriter->hFile );
+	}
+
+	// Cleanup
+	for (DWORD dw = 0; dw < _countof( pWriter->buffers ); dw++){
+		PWPG_WRITER_BUFFER pBuffer = pWriter->buffers + dw;
+		if (pBuffer->lpData){
+			SecureZeroMemory( pBuffer->lpData, c_cbBuffer );
+			VirtualFree( pBuffer->lpData, 0, MEM_RELEASE );
+		}
+		if (pBuffer->hReady){
+			CloseHandle( pBuffer->hReady );
+		}
+		if (pBuffer->hDone){
+			CloseHandle( pBuffer->hDone );
+		}
+	}
+	const DWORD dwError = pWriter->dwError;
+	PH_FREE( pWriter );
+	return (dwError == ERROR_SUCCESS) ? S_OK : HRESULT_FROM_WIN32( dwError );
+}
@@ -0,0 +1,51 @@
+// WPGWriter.h: declares the interface to a sink which streams passwords out to a file
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_WRITER_H__)
+#define __WPG_WRITER_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGPool.h"
+
+// Macros
+//
+
+DECLARE_HANDLE(WPG_WRITER_H);
+
+// Delimit the passwords with NULs, rather than newlines
+#define WPG_WRITER_NUL			0x00000001
+
+// Write through mapped views of the file, rather than with (unbuffered) writes, on a thread of the writer's own
+#define WPG_WRITER_MAPPED		0x00000002
+
+// Functions
+//
+
+// Creates (or truncates) the given file, for writing passwords to, as UTF-8, one per line (or NUL-terminated);
+// the expected size in bytes, if known, lets the file be allocated up front. Returns NULL (with the last error
+// set) on failure
+WPG_WRITER_H CreateWPGWriter(__in_z LPCWSTR, __in DWORD, __in ULONG64);
+
+// Returns the most bytes the given number of passwords, of the given length, can take in the file
+ULONG64 WPGWriterSize(__in SIZE_T, __in BYTE);
+
+// Appends the given passwords, laid out as WPG_BATCH gives them (i.e. as (cchLength+1)-character records), blocking
+// while both of the writer's buffers are being written out; returns FALSE (with the last error set) if the file
+// couldn't be written, after which it never writes again
+BOOL WPGWriterAppend(__in WPG_WRITER_H, __in LPCTSTR, __in SIZE_T, __in BYTE);
+
+// Generates the given batch across the given pool, and appends it to the file, a chunk at a time (so in bounded
+// memory); the batch's buffer is ignored. Returns an HRESULT, and gives the sources which failed (if any)
+HRESULT WPGWriterGenerate(__in WPG_WRITER_H, __in WPG_POOL_H, __in PCWPG_BATCH, __out_opt WPGCaps*);
+
+// Writes out whatever is buffered, trims the file to what was written, and closes it; returns an HRESULT
+// giving the first error encountered by the writer, if any
+HRESULT CloseWPGWriter(__in WPG_WRITER_H);
+
+#endif // !defined(__WPG_WRITER_H__)
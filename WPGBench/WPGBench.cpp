@@ -0,0 +1,554 @@
+// WPGBench.cpp: benchmarks (and verifies) the kernels defined in BitOps.h
+//				 across buffer sizes, alignments and offsets.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// Builds with the solution on Windows; on Linux (or anywhere else with GCC or Clang):
+//
+//   g++ -std=c++14 -O2 -I../WPG WPGBench.cpp ../WPG/BitOps.cpp ../WPG/CpuFeatures.cpp -o wpgbench
+//
+// Usage: wpgbench [max-size-in-bytes]
+//
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// C Standard Library Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Intrinsics Headers
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif // defined(_MSC_VER)
+
+// Local Project Headers
+#include "BitOps.h"
+#include "CpuFeatures.h"
+
+// Constants
+//
+
+// The largest buffer we benchmark, by default
+const size_t c_cbMaxSize = (16 * 1024 * 1024);
+
+// The alignment of the base of each buffer; offsets are applied from there
+const size_t c_cbAlignment = 64;
+
+// The (front, back) offsets at which each size is run
+const size_t c_offsets[][2] = { { 0, 0 }, { 1, 0 }, { 3, 7 }, { 16, 33 } };
+
+// The number of bytes each measurement aims to process, and the cap on its iterations
+const size_t c_cbPerMeasurement = (32 * 1024 * 1024);
+const size_t c_cIterationsMax = (1 << 16);
+
+// The alphabets over which the emitters are run
+static const wchar_t* c_pszAlphabets[] = {
+	L"0123456789abcdef",
+	L"abcdefghijklmnopqrstuvwxyz1234567890ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+	L"abcdefghijklmnopqrstuvwxyz1234567890ABCDEFGHIJKLMNOPQRSTUVWXYZ!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~"
+};
+
+// The token encodings, by name
+static const struct {
+	Encoding encoding;
+	const char* pszName;
+} c_encodings[] = {
+	{ EncodingBASE16, "base16" },
+	{ EncodingBASE32, "base32" },
+	{ EncodingBASE58, "base58" },
+	{ EncodingBASE64, "base64" },
+	{ EncodingBASE64URL, "base64url" }
+};
+
+// The largest buffer over which base58 (being quadratic) is benchmarked
+const size_t c_cbBase58Max = 256;
+
+// The known answers for the encoders: RFC 4648's test vectors, and some for base58
+static const struct {
+	Encoding encoding;
+	const char* pszInput;
+	size_t cbInput; // zero for the length of the string
+	const char* pszExpected;
+} c_knownAnswers[] = {
+	{ EncodingBASE16, "foobar", 0, "666f6f626172" },
+	{ EncodingBASE32, "f", 0, "MY======" },
+	{ EncodingBASE32, "fo", 0, "MZXQ====" },
+	{ EncodingBASE32, "foo", 0, "MZXW6===" },
+	{ EncodingBASE32, "foob", 0, "MZXW6YQ=" },
+	{ EncodingBASE32, "fooba", 0, "MZXW6YTB" },
+	{ EncodingBASE32, "foobar", 0, "MZXW6YTBOI======" },
+	{ EncodingBASE64, "f", 0, "Zg==" },
+	{ EncodingBASE64, "fo", 0, "Zm8=" },
+	{ EncodingBASE64, "foo", 0, "Zm9v" },
+	{ EncodingBASE64, "foobar", 0, "Zm9vYmFy" },
+	{ EncodingBASE64URL, "fo", 0, "Zm8" },
+	{ EncodingBASE64URL, "\xfb\xff", 0, "-_8" },
+	{ EncodingBASE58, "Hello World!", 0, "2NEpo7TZRRrLZSi2U" },
+	{ EncodingBASE58, "\x00\x00\x28\x7f\xb4\xcd", 6, "11233QC4" }
+};
+
+// Types
+//
+
+// Gives a buffer whose base is aligned to c_cbAlignment
+class aligned_buffer_t {
+public:
+	explicit aligned_buffer_t(size_t cb): m_bytes( cb + (2 * c_cbAlignment) ) {
+		const auto address = reinterpret_cast<size_t>( m_bytes.data( ) );
+		m_base = m_bytes.data( ) + ((c_cbAlignment - (address % c_cbAlignment)) % c_cbAlignment);
+	}
+
+	unsigned char* at(size_t offset) {
+		return m_base + offset;
+	}
+
+private:
+	std::vector<unsigned char> m_bytes;
+	unsigned char* m_base;
+};
+
+// Measures elapsed wall-clock time, and (where we can read it) the time-stamp counter
+class stopwatch_t {
+public:
+	stopwatch_t(void): m_start( clock_type::now( ) ), m_cycles( cycles( ) ) { }
+
+	double elapsed_ns(void) const {
+		return static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>( clock_type::now( ) - m_start ).count( ) );
+	}
+
+	// Returns zero where there's no cycle counter to read
+	unsigned long long elapsed_cycles(void) const {
+		return cycles( ) - m_cycles;
+	}
+
+private:
+	typedef std::chrono::steady_clock clock_type;
+
+	static unsigned long long cycles(void) {
+#if defined(BITOPS_X86)
+		return __rdtsc( );
+#else
+		return 0;
+#endif // defined(BITOPS_X86)
+	}
+
+	clock_type::time_point m_start;
+	unsigned long long m_cycles;
+};
+
+// Functions
+//
+
+// Returns the number of iterations for a measurement over the given number of bytes
+static size_t iterations_for(size_t cb) {
+	return (std::max)( static_cast<size_t>( 1 ), (std::min)( c_cIterationsMax, c_cbPerMeasurement / (std::max)( cb, static_cast<size_t>( 1 ) ) ) );
+}
+
+// Prints one row of results
+static void report(const char* pszKernel, const char* pszVex, size_t cb, size_t front, size_t back, size_t cbTotal, const stopwatch_t& watch) {
+
+	const double ns = watch.elapsed_ns( );
+	const double gbps = (ns > 0.0) ? (static_cast<double>( cbTotal ) / ns) : 0.0;
+	const auto cycles = watch.elapsed_cycles( );
+	if (cycles){
+		const double cpb = static_cast<double>( cycles ) / static_cast<double>( cbTotal );
+		printf( "%-8s %-7s %10zu %3zu/%-3zu %10.3f GB/s %9.3f cyc/B\n", pszKernel, pszVex, cb, front, back, gbps, cpb );
+	}else{
+		printf( "%-8s %-7s %10zu %3zu/%-3zu %10.3f GB/s %9s cyc/B\n", pszKernel, pszVex, cb, front, back, gbps, "n/a" );
+	}
+}
+
+// Returns the sizes to be benchmarked, from 1 byte up to the given maximum in powers of 4
+static std::vector<size_t> sizes_up_to(size_t cbMax) {
+
+	std::vector<size_t> sizes;
+	for (size_t cb = 1; cb < cbMax; cb *= 4){
+		sizes.push_back( cb );
+	}
+	sizes.push_back( cbMax );
+	return sizes;
+}
+
+// Checks, and then times, every implementation of xor_t; returns the number of mismatches
+static int bench_xor(const std::vector<size_t>& sizes, size_t cbMax, std::mt19937& rng) {
+
+	int mismatches = 0;
+	aligned_buffer_t front( cbMax ), back( cbMax ), expected( cbMax );
+	std::generate( front.at( 0 ), front.at( cbMax + c_cbAlignment ), [&]( ) { return static_cast<unsigned char>( rng( ) ); } );
+	std::generate( back.at( 0 ), back.at( cbMax + c_cbAlignment ), [&]( ) { return static_cast<unsigned char>( rng( ) ); } );
+
+	printf( "\n%-8s %-7s %10s %7s %15s %15s\n", "kernel", "vex", "bytes", "offsets", "throughput", "cycles" );
+	const auto kernels = get_all_xor( );
+	for (const auto& kernel : kernels){
+		const char* pszVex = get_vex_name( kernel->vex( ) );
+		for (const auto cb : sizes){
+			for (const auto& offsets : c_offsets){
+				unsigned char* f = front.at( offsets[0] );
+				unsigned char* b = back.at( offsets[1] );
+
+				// Verify against the scalar reference, on a copy
+				for (size_t i = 0; i < cb; ++i){
+					*(expected.at( i )) = static_cast<unsigned char>( *(f + i) ^ *(b + i) );
+				}
+				std::vector<unsigned char> saved( f, f + cb );
+				kernel->apply( f, b, cb );
+				if (memcmp( f, expected.at( 0 ), cb ) != 0){
+					printf( "MISMATCH: xor/%s at %zu bytes, offsets %zu/%zu\n", pszVex, cb, offsets[0], offsets[1] );
+					++mismatches;
+				}
+				std::copy( saved.cbegin( ), saved.cend( ), f );
+
+				// Time it; XOR'ing twice leaves the buffer as it was
+				const auto iterations = iterations_for( cb ) | 1;
+				stopwatch_t watch;
+				for (size_t i = 0; i < iterations; ++i){
+					kernel->apply( f, b, cb );
+				}
+				report( "xor", pszVex, cb, offsets[0], offsets[1], (cb * iterations), watch );
+				std::copy( saved.cbegin( ), saved.cend( ), f );
+			}
+		}
+	}
+	return mismatches;
+}
+
+// Checks, and then times, every implementation of emit_t against the separate
+// combine and map stages which it replaces; returns the number of mismatches
+static int bench_emit(const std::vector<size_t>& sizes, size_t cbMax, std::mt19937& rng) {
+
+	int mismatches = 0;
+	aligned_buffer_t front( cbMax ), back( cbMax );
+	std::generate( front.at( 0 ), front.at( cbMax + c_cbAlignment ), [&]( ) { return static_cast<unsigned char>( rng( ) ); } );
+	std::generate( back.at( 0 ), back.at( cbMax + c_cbAlignment ), [&]( ) { return static_cast<unsigned char>( rng( ) ); } );
+	std::vector<map_t::char_type> expected( cbMax ), actual( cbMax );
+	std::vector<map_t::index_type> indices( cbMax ), expected_indices( cbMax );
+
+	const auto combine = get_vex_xor( );
+	const auto kernels = get_all_emit( );
+	const emit_t reference;
+	for (const auto pszAlphabet : c_pszAlphabets){
+		const map_t map( pszAlphabet, wcslen( pszAlphabet ) );
+		printf( "\nemit: %zu-character alphabet (accepts %zu of 256)\n", map.size( ), map.limit( ) );
+		printf( "%-8s %-7s %10s %7s %15s %15s\n", "kernel", "vex", "bytes", "offsets", "throughput", "cycles" );
+		for (const auto cb : sizes){
+			for (const auto& offsets : c_offsets){
+				unsigned char* f = front.at( offsets[0] );
+				unsigned char* b = back.at( offsets[1] );
+				const auto iterations = (iterations_for( cb ) + 1) & ~static_cast<size_t>( 1 );
+
+				// The separate stages: combine in place, then map each byte and write it out;
+				// (an even number of iterations leaves the front buffer as it was)
+				{
+					stopwatch_t watch;
+					for (size_t i = 0; i < iterations; ++i){
+						combine->apply( f, b, cb );
+						size_t n = 0;
+						for (size_t j = 0; j < cb; ++j){
+							const auto value = *(f + j);
+							if (value < map.limit( )){
+								expected[n++] = *(pszAlphabet + (value % map.size( )));
+							}
+						}
+					}
+					report( "separate", get_vex_name( combine->vex( ) ), cb, offsets[0], offsets[1], (cb * iterations), watch );
+				}
+
+				// The fused kernels
+				const auto count = reference.apply( f, b, cb, map, expected.data( ), cb );
+				reference.apply( f, b, cb, map, expected_indices.data( ), cb );
+				for (const auto& kernel : kernels){
+					const char* pszVex = get_vex_name( kernel->vex( ) );
+					const auto n = kernel->apply( f, b, cb, map, actual.data( ), cb );
+					const auto m = kernel->apply( f, b, cb, map, indices.data( ), cb );
+					if ((n != count) || (m != count) ||
+						!std::equal( actual.cbegin( ), actual.cbegin( ) + n, expected.cbegin( ) ) ||
+						!std::equal( indices.cbegin( ), indices.cbegin( ) + m, expected_indices.cbegin( ) )){
+						printf( "MISMATCH: emit/%s at %zu bytes, offsets %zu/%zu\n", pszVex, cb, offsets[0], offsets[1] );
+						++mismatches;
+					}
+
+					stopwatch_t watch;
+					for (size_t i = 0; i < iterations; ++i){
+						kernel->apply( f, b, cb, map, actual.data( ), cb );
+					}
+					report( "fused", pszVex, cb, offsets[0], offsets[1], (cb * iterations), watch );
+				}
+			}
+		}
+	}
+	return mismatches;
+}
+
+// Checks, and then times, bitset_t over alphabet-sized sets; returns the number of mismatches
+template <size_t _capacity>
+static int bench_bitset(std::mt19937& rng, size_t bits) {
+
+	int mismatches = 0;
+	bitset_t<_capacity> bitset( bits );
+
+	// Verify: set every other bit, and check every bit
+	for (size_t i = 0; i < bits; i += 2){
+		bitset.set( i );
+	}
+	bool matches = (bitset.count( ) == ((bits + 1) / 2));
+	for (size_t i = 0; matches && (i < bits); ++i){
+		matches = (bitset.is_set( i ) == ((i % 2) == 0)) && (bitset.find_next_unset( i ) == (((i % 2) == 0) ? (i + 1) : i));
+	}
+	if (!matches){
+		printf( "MISMATCH: bitset of %zu bits\n", bits );
+		++mismatches;
+	}
+
+	// Time the sequence of operations made by Generate, one at a time and in bulk;
+	// each run of indices is as long as the alphabet, i.e. the longest password
+	const size_t runs = 4096;
+	std::vector<unsigned char> indices( runs * bits ), fresh( bits );
+	std::generate( indices.begin( ), indices.end( ), [&]( ) { return static_cast<unsigned char>( rng( ) % bits ); } );
+	size_t hits = 0;
+	stopwatch_t watch;
+	for (size_t r = 0; r < runs; ++r){
+		bitset.reset( );
+		for (size_t i = 0; i < bits; ++i){
+			const auto index = indices[(r * bits) + i];
+			if (bitset.is_set( index )){
+				++hits;
+				continue;
+			}
+			bitset.set( index );
+		}
+	}
+	const double ns = watch.elapsed_ns( ) / static_cast<double>( indices.size( ) );
+
+	size_t misses = 0;
+	watch = stopwatch_t( );
+	for (size_t r = 0; r < runs; ++r){
+		bitset.reset( );
+		misses += bitset.test_and_set( indices.data( ) + (r * bits), bits, fresh.data( ) );
+	}
+	const double nsBulk = watch.elapsed_ns( ) / static_cast<double>( indices.size( ) );
+	if ((hits + misses) != indices.size( )){
+		printf( "MISMATCH: bulk test-and-set of %zu bits\n", bits );
+		++mismatches;
+	}
+	printf( "%-8s %10zu %10.3f ns/op %10.3f ns/op\n", "bitset", bits, ns, nsBulk );
+	return mismatches;
+}
+
+static int bench_bitset(std::mt19937& rng) {
+
+	int mismatches = 0;
+	printf( "\n%-8s %10s %15s %15s\n", "bitset", "bits", "set+test", "bulk" );
+	mismatches += bench_bitset<16>( rng, 16 );
+	mismatches += bench_bitset<64>( rng, 64 );
+	mismatches += bench_bitset<256>( rng, 255 );
+	return mismatches;
+}
+
+// Verifies and times the dedupe kernels over runs of indices as long as the alphabet,
+// i.e. the longest password, for alphabets which need the (full-sized) bitset
+static int bench_dedupe(std::mt19937& rng) {
+
+	int mismatches = 0;
+	printf( "\n%-8s %-7s %10s %15s\n", "dedupe", "vex", "bits", "throughput" );
+	for (size_t bits : { 65, 128, 255 }){
+		const size_t runs = 4096;
+		std::vector<unsigned char> indices( runs * bits );
+		std::generate( indices.begin( ), indices.end( ), [&]( ) { return static_cast<unsigned char>( rng( ) % bits ); } );
+
+		// Compute the reference output
+		std::vector<unsigned char> expected( indices.size( ) );
+		std::vector<size_t> counts( runs );
+		for (size_t r = 0; r < runs; ++r){
+			dedupe_t::bitset_type seen( bits );
+			counts[r] = seen.test_and_set( indices.data( ) + (r * bits), bits, expected.data( ) + (r * bits) );
+		}
+
+		for (const auto& kernel : get_all_dedupe( )){
+			const char* pszVex = get_vex_name( kernel->vex( ) );
+
+			// Verify, in place (as Generate uses it)
+			std::vector<unsigned char> actual( indices );
+			for (size_t r = 0; r < runs; ++r){
+				dedupe_t::bitset_type seen( bits );
+				auto ptr = actual.data( ) + (r * bits);
+				const auto n = kernel->apply( seen, ptr, bits, ptr );
+				if ((n != counts[r]) || !std::equal( ptr, ptr + n, expected.data( ) + (r * bits) )){
+					printf( "MISMATCH: dedupe/%s of %zu bits, run %zu\n", pszVex, bits, r );
+					++mismatches;
+					break;
+				}
+			}
+
+			// Time
+			std::vector<unsigned char> out( bits );
+			size_t survivors = 0;
+			stopwatch_t watch;
+			for (size_t r = 0; r < runs; ++r){
+				dedupe_t::bitset_type seen( bits );
+				survivors += kernel->apply( seen, indices.data( ) + (r * bits), bits, out.data( ) );
+			}
+			const double ns = watch.elapsed_ns( ) / static_cast<double>( indices.size( ) );
+			printf( "%-8s %-7s %10zu %10.3f ns/op (%zu unique)\n", "dedupe", pszVex, bits, ns, survivors );
+		}
+	}
+	return mismatches;
+}
+
+// Checks every implementation of encode_t against the known answers and the scalar
+// reference, then times them; returns the number of mismatches
+static int bench_encode(const std::vector<size_t>& sizes, size_t cbMax, std::mt19937& rng) {
+
+	int mismatches = 0;
+	const auto kernels = get_all_encode( );
+	for (const auto& answer : c_knownAnswers){
+		const auto cb = answer.cbInput ? answer.cbInput : strlen( answer.pszInput );
+		const auto in = reinterpret_cast<const unsigned char*>( answer.pszInput );
+		for (const auto& kernel : kernels){
+			std::string actual( encode_t::encoded_size( answer.encoding, cb ), '\0' );
+			actual.resize( kernel->apply( answer.encoding, in, cb, &actual[0] ) );
+			if (actual != answer.pszExpected){
+				printf( "MISMATCH: encode/%s of \"%s\" gave \"%s\"\n", get_vex_name( kernel->vex( ) ), answer.pszInput, actual.c_str( ) );
+				++mismatches;
+			}
+		}
+	}
+
+	aligned_buffer_t in( cbMax );
+	std::generate( in.at( 0 ), in.at( cbMax + c_cbAlignment ), [&]( ) { return static_cast<unsigned char>( rng( ) ); } );
+	const encode_t reference;
+	for (const auto& named : c_encodings){
+		const auto cbLimit = (named.encoding == EncodingBASE58) ? (std::min)( cbMax, c_cbBase58Max ) : cbMax;
+		std::vector<char> expected( encode_t::encoded_size( named.encoding, cbLimit ) ), actual( expected.size( ) );
+		printf( "\nencode: %s (throughput in bytes encoded)\n", named.pszName );
+		printf( "%-8s %-7s %10s %7s %15s %15s\n", "kernel", "vex", "bytes", "offsets", "throughput", "cycles" );
+		for (auto cb : sizes){
+			cb = (std::min)( cb, cbLimit );
+			for (const auto& offsets : c_offsets){
+				const unsigned char* ptr = in.at( offsets[0] );
+				const auto count = reference.apply( named.encoding, ptr, cb, expected.data( ) );
+				for (const auto& kernel : kernels){
+					const char* pszVex = get_vex_name( kernel->vex( ) );
+					const auto n = kernel->apply( named.encoding, ptr, cb, actual.data( ) );
+					if ((n != count) || !std::equal( actual.cbegin( ), actual.cbegin( ) + n, expected.cbegin( ) )){
+						printf( "MISMATCH: encode/%s/%s at %zu bytes, offset %zu\n", named.pszName, pszVex, cb, offsets[0] );
+						++mismatches;
+					}
+
+					const auto iterations = (named.encoding == EncodingBASE58) ? (std::max)( static_cast<size_t>( 1 ), iterations_for( cb ) / 64 ) : iterations_for( cb );
+					stopwatch_t watch;
+					for (size_t i = 0; i < iterations; ++i){
+						kernel->apply( named.encoding, ptr, cb, actual.data( ) );
+					}
+					report( "encode", pszVex, cb, offsets[0], 0, (cb * iterations), watch );
+				}
+			}
+			if (cb == cbLimit){
+				break;
+			}
+		}
+	}
+	return mismatches;
+}
+
+// Checks every implementation of encode_t's UUID stamping and formatting against the scalar
+// reference (and the layout which RFC 9562 gives), then times them; returns the number of mismatches
+static int bench_uuids(std::mt19937& rng) {
+
+	int mismatches = 0;
+	const size_t count = (1 << 20);
+	const size_t cch = (encode_t::uuid_chars + 1);
+	std::vector<unsigned char> random( count * encode_t::uuid_size );
+	std::generate( random.begin( ), random.end( ), [&]( ) { return static_cast<unsigned char>( rng( ) ); } );
+	std::vector<unsigned char> uuids( random.size( ) );
+	std::vector<char> expected( count * cch ), actual( count * cch );
+
+	const auto kernels = get_all_encode( );
+	const encode_t reference;
+	const unsigned long long ms = 0x017F22E279B0ULL, counter = 0x1FFFFFFFFF0ULL;
+	printf( "\n%-8s %-7s %7s %15s %15s\n", "uuids", "vex", "version", "stamp", "stamp+format" );
+	for (const unsigned version : { 4u, 7u }){
+		// The reference, and its layout: the version and variant digits, and (for version 7) the order
+		std::copy( random.cbegin( ), random.cend( ), uuids.begin( ) );
+		reference.stamp_uuids( uuids.data( ), count, version, ms, counter );
+		reference.format_uuids( uuids.data( ), count, '\n', expected.data( ) );
+		for (size_t i = 0; i < count; ++i){
+			const char* text = expected.data( ) + (i * cch);
+			const bool ordered = (version != 7) || (i == 0) || (memcmp( text - cch, text, encode_t::uuid_chars ) < 0);
+			if ((text[8] != '-') || (text[13] != '-') || (text[14] != static_cast<char>( '0' + version )) || (text[18] != '-') ||
+				!strchr( "89ab", text[19] ) || (text[23] != '-') || (text[36] != '\n') || !ordered){
+				printf( "MISMATCH: uuids/v%u layout at %zu: %.36s\n", version, i, text );
+				++mismatches;
+				break;
+			}
+		}
+
+		for (const auto& kernel : kernels){
+			const char* pszVex = get_vex_name( kernel->vex( ) );
+			for (const size_t n : { static_cast<size_t>( 1 ), static_cast<size_t>( 3 ), count }){
+				std::copy( random.cbegin( ), random.cbegin( ) + (n * encode_t::uuid_size), uuids.begin( ) );
+				kernel->stamp_uuids( uuids.data( ), n, version, ms, counter );
+				const auto written = kernel->format_uuids( uuids.data( ), n, '\n', actual.data( ) );
+				if ((written != (n * cch)) || !std::equal( actual.cbegin( ), actual.cbegin( ) + written, expected.cbegin( ) )){
+					printf( "MISMATCH: uuids/v%u/%s of %zu\n", version, pszVex, n );
+					++mismatches;
+				}
+			}
+
+			// Time stamping alone, then stamping and formatting together
+			stopwatch_t watch;
+			kernel->stamp_uuids( uuids.data( ), count, version, ms, counter );
+			const double ns = watch.elapsed_ns( );
+			watch = stopwatch_t( );
+			kernel->stamp_uuids( uuids.data( ), count, version, ms, counter );
+			kernel->format_uuids( uuids.data( ), count, '\n', actual.data( ) );
+			const double nsFormatted = watch.elapsed_ns( );
+			printf( "%-8s %-7s %7u %10.1f M/s %10.1f M/s\n", "uuids", pszVex, version, (count * 1e3) / ns, (count * 1e3) / nsFormatted );
+		}
+	}
+	return mismatches;
+}
+
+// Gives the entry-point
+int main(int argc, char* argv[]) {
+
+	size_t cbMax = c_cbMaxSize;
+	if (argc > 1){
+		cbMax = static_cast<size_t>( strtoull( argv[1], NULL, 0 ) );
+		if ((cbMax < 1) || (cbMax > c_cbMaxSize)){
+			fprintf( stderr, "Usage: %s [max-size-in-bytes, 1 to %zu]\n", argv[0], c_cbMaxSize );
+			return 1;
+		}
+	}
+
+	printf( "Waveson Password Generator kernel benchmarks\n" );
+	printf( "CPU: %s\n", get_cpu_features( ).describe( ).c_str( ) );
+	printf( "Widest kernels: xor=%s, emit=%s, dedupe=%s, encode=%s\n", get_vex_name( get_vex_xor( )->vex( ) ), get_vex_name( get_vex_emit( )->vex( ) ), get_vex_name( get_vex_dedupe( )->vex( ) ), get_vex_name( get_vex_encode( )->vex( ) ) );
+
+	std::mt19937 rng( 20171217 );
+	const auto sizes = sizes_up_to( cbMax );
+	int mismatches = bench_xor( sizes, cbMax, rng );
+	mismatches += bench_emit( sizes, cbMax, rng );
+	mismatches += bench_bitset( rng );
+	mismatches += bench_dedupe( rng );
+	mismatches += bench_encode( sizes, cbMax, rng );
+	mismatches += bench_uuids( rng );
+	if (mismatches){
+		printf( "\n%d MISMATCH(ES)\n", mismatches );
+		return 2;
+	}
+	printf( "\nAll kernels match the scalar reference.\n" );
+	return 0;
+}
@@ -0,0 +1,87 @@
+// WPGBroker.h: declares the protocol spoken between the password broker and its clients
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// The broker listens on a (local-only, message-mode) named pipe; a client writes one request per
+// message, and reads back one response per request, in the order in which they complete. Since
+// each request and response is a single message, CallNamedPipe is enough for a one-off request.
+//
+
+#if !defined(__WPG_BROKER_H__)
+#define __WPG_BROKER_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGGenerators.h"
+
+// Macros
+//
+
+// The name of the broker's pipe
+#define WPG_BROKER_PIPE_NAME		L"\\\\.\\pipe\\WavesonPasswordBroker"
+
+// The version of the protocol described here
+#define WPG_BROKER_VERSION			1
+
+// The most passwords which may be asked for in one request
+#define WPG_BROKER_MAX_PASSWORDS	0x100
+
+// Types
+//
+
+// Asks the broker for a number of passwords, all alike
+typedef struct _WPG_BROKER_REQUEST {
+
+	// WPG_BROKER_VERSION
+	DWORD dwVersion;
+
+	// Chosen by the client, and echoed back in the response
+	DWORD dwRequestId;
+
+	// The number of passwords, from 1 to WPG_BROKER_MAX_PASSWORDS, and the length of each
+	WORD cPasswords;
+	BYTE cchLength;
+
+	// The policy: the sources to draw from, whether characters may repeat within a password, and the
+	// time (in milliseconds, or zero for no limit) allowed, after which the sources other than the
+	// required ones may be skipped
+	BYTE fDuplicatesAllowed;
+	WPGCaps wpgCaps;
+	WPGCaps wpgCapsRequired;
+	DWORD dwDeadline;
+
+	// The alphabet, null-terminated
+	WCHAR szAlphabet[0x100];
+
+} WPG_BROKER_REQUEST, *PWPG_BROKER_REQUEST;
+
+typedef const WPG_BROKER_REQUEST* PCWPG_BROKER_REQUEST;
+
+// Answers a request; on success, the message continues with the passwords, back-to-back, each
+// cchLength characters long (without terminators)
+typedef struct _WPG_BROKER_RESPONSE {
+
+	DWORD dwVersion;
+	DWORD dwRequestId;
+
+	// S_OK if the passwords follow, E_INVALIDARG if the request was malformed, or E_FAIL if they
+	// couldn't be generated (for the reasons given by wpgCapsFailed)
+	HRESULT hResult;
+	WPGCaps wpgCapsFailed;
+
+	WORD cPasswords;
+	BYTE cchLength;
+
+} WPG_BROKER_RESPONSE, *PWPG_BROKER_RESPONSE;
+
+typedef const WPG_BROKER_RESPONSE* PCWPG_BROKER_RESPONSE;
+
+// Returns the size, in bytes, of the response message carrying the given passwords
+inline DWORD WPGBrokerResponseSize(__in WORD cPasswords, __in BYTE cchLength) {
+	return static_cast<DWORD>( sizeof( WPG_BROKER_RESPONSE ) + (sizeof( WCHAR ) * cPasswords * cchLength) );
+}
+
+#endif // !defined(__WPG_BROKER_H__)
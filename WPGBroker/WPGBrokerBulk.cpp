@@ -0,0 +1,424 @@
+// WPGBrokerBulk.cpp: defines the broker's command-line modes which generate in bulk, without the broker.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// C Standard Library Headers
+#include <math.h>
+#include <stdio.h>
+#include <wchar.h>
+#include <io.h>
+#include <fcntl.h>
+
+// Local Project Headers
+#include "WPGUuid.h"
+#include "WPGWordlist.h"
+#include "WPGWriter.h"
+
+// Declarations
+#include "WPGBrokerBulk.h"
+
+// Constants
+//
+
+// The number of raw bytes generated at a time (a multiple of 3 and 5, so that base64 and base32 need no padding until the end)
+constexpr SIZE_T c_cbBytesChunk = (15 * 0x11000);
+
+// The number of UUIDs generated at a time
+constexpr SIZE_T c_cUuidsChunk = (c_cbBytesChunk / WPG_UUID_SIZE);
+
+// The characters allowed for each word of a passphrase
+constexpr SIZE_T c_cchPassphraseWord = 64;
+
+// Classes
+//
+
+// Gives what the modes have in common: the pool (unless the mode generates on its own thread), the buffers
+// for each chunk (wiped when they're freed), and the stream to which the output goes, if it isn't printed
+class bulk_t {
+public:
+	// The most buffers any one mode needs
+	static constexpr size_t c_cMaxBuffers = 2;
+
+	// Starts the pool, if asked for; output written to the given stream is binary, and the stream is closed
+	// when this is done with (unless it's stdout)
+	explicit bulk_t(BOOL fPool, FILE* pFile = NULL):
+		m_hPool( fPool ? CreateWPGPool( 0 ) : NULL ), m_fPool( fPool ), m_pFile( pFile ), m_cBuffers( 0 ), m_fAllocated( TRUE ), m_buffers{ } {
+		if (m_pFile == stdout){
+			_setmode( _fileno( stdout ), _O_BINARY );
+		}
+	}
+
+	~bulk_t(void) {
+		for (size_t n = 0; n < m_cBuffers; n++){
+			SecureZeroMemory( m_buffers[n].lpBuffer, m_buffers[n].cbBuffer );
+			PH_FREE( m_buffers[n].lpBuffer );
+		}
+		if (m_hPool){
+			DestroyWPGPool( m_hPool );
+		}
+		if (m_pFile && (m_pFile != stdout)){
+			fclose( m_pFile );
+		}
+	}
+
+	bulk_t(const bulk_t&) = delete;
+	bulk_t& operator=(const bulk_t&) = delete;
+
+	WPG_POOL_H Pool(void) const {
+		return m_hPool;
+	}
+
+	// Allocates a buffer of the given number of elements, which lives as long as this does
+	template <typename T>
+	T* Alloc(SIZE_T cElements) {
+
+		const SIZE_T cb = sizeof( T ) * cElements;
+		LPVOID lpBuffer = (m_cBuffers < c_cMaxBuffers) ? PH_ALLOC( cb ) : NULL;
+		if (lpBuffer == NULL){
+			m_fAllocated = FALSE;
+			return NULL;
+		}
+		m_buffers[m_cBuffers].lpBuffer = lpBuffer;
+		m_buffers[m_cBuffers].cbBuffer = cb;
+		m_cBuffers++;
+		return static_cast<T*>( lpBuffer );
+	}
+
+	// Returns TRUE if the pool (if asked for), every buffer, and whatever else the mode needs are ready; otherwise, says not
+	BOOL Started(BOOL fReady = TRUE) const {
+
+		if (fReady && m_fAllocated && (!m_fPool || (m_hPool != NULL))){
+			return TRUE;
+		}
+		fwprintf( stderr, L"Failed to start the generator.\n" );
+		return FALSE;
+	}
+
+	// Returns TRUE if the given sources succeeded; otherwise, says that the given things couldn't be generated
+	static BOOL Generated(WPGCaps wpgCapsFailed, LPCWSTR pszWhat) {
+
+		if (WPGSucceeded( wpgCapsFailed )){
+			return TRUE;
+		}
+		fwprintf( stderr, L"Failed to generate the %s (sources 0x%08X)\n", pszWhat, static_cast<unsigned>( wpgCapsFailed ) );
+		return FALSE;
+	}
+
+	// Writes the given bytes to the stream; returns FALSE, having said so, if they couldn't all be written
+	BOOL Write(const void* lpBuffer, SIZE_T cb, LPCWSTR pszWhat) const {
+
+		if (fwrite( lpBuffer, 1, cb, m_pFile ) == cb){
+			return TRUE;
+		}
+		fwprintf( stderr, L"Failed to write the %s\n", pszWhat );
+		return FALSE;
+	}
+
+	BOOL Flush(void) const {
+		return (fflush( m_pFile ) == 0);
+	}
+
+	// Says how many of the given things were done in the given time, and so at what rate
+	static VOID Report(ULONG64 ullDone, LPCWSTR pszWhat, double dSeconds) {
+		fwprintf( stderr, L"%llu %s(s) in %.3fs (%.0f/s)\n", ullDone, pszWhat, dSeconds, static_cast<double>( ullDone ) / dSeconds );
+	}
+
+private:
+	WPG_POOL_H m_hPool;
+	BOOL m_fPool;
+	FILE* m_pFile;
+
+	size_t m_cBuffers;
+	BOOL m_fAllocated;
+	struct {
+		LPVOID lpBuffer;
+		SIZE_T cbBuffer;
+	} m_buffers[c_cMaxBuffers];
+};
+
+// Functions
+//
+
+WPG_BATCH WPGBulkBatch(__in SIZE_T cPasswords, __in BYTE cchLength, __in_opt LPCWSTR pszAlphabet, __in_opt WPG_PATTERN_H hPattern, __in_opt WPG_POLICY_H hPolicy) {
+
+	WPG_BATCH batch = { 0 };
+	batch.cPasswords = cPasswords;
+	batch.cchLength = cchLength;
+	batch.wpgCaps = c_wpgCapsBulk;
+	batch.pszAlphabet = pszAlphabet;
+	batch.fDuplicatesAllowed = TRUE;
+	batch.hPattern = hPattern;
+	batch.hPolicy = hPolicy;
+	return batch;
+}
+
+int WPGBulkWrite(__in LPCWSTR pszPath, __in const WPG_BATCH& batch, __in DWORD dwFlags) {
+
+	bulk_t bulk( TRUE );
+	if (!bulk.Started( )){
+		return 1;
+	}
+	const SIZE_T cPasswords = batch.cPasswords;
+	WPG_WRITER_H hWriter = CreateWPGWriter( pszPath, dwFlags, WPGWriterSize( cPasswords, batch.cchLength ) );
+	if (hWriter == NULL){
+		fwprintf( stderr, L"Failed to create %s (%lu)\n", pszPath, GetLastError( ) );
+		return 1;
+	}
+
+	stopwatch_t stopwatch;
+	WPGCaps wpgCapsFailed = WPGCapNONE;
+	HRESULT hResult = WPGWriterGenerate( hWriter, bulk.Pool( ), &batch, &wpgCapsFailed );
+	const HRESULT hClosed = CloseWPGWriter( hWriter );
+	const double dSeconds = stopwatch.Seconds( );
+	if (SUCCEEDED( hResult )){
+		hResult = hClosed;
+	}
+
+	if (FAILED( hResult )){
+		fwprintf( stderr, L"Failed to write the passwords (0x%08X, sources 0x%08X)\n",
+			static_cast<unsigned>( hResult ), static_cast<unsigned>( wpgCapsFailed ) );
+		return 1;
+	}
+	bulk_t::Report( static_cast<ULONG64>( cPasswords ), L"password", dSeconds );
+	return 0;
+}
+
+int WPGBulkPrint(__in const WPG_BATCH& passwords) {
+
+	const SIZE_T cPasswords = passwords.cPasswords;
+	const SIZE_T cchStride = static_cast<SIZE_T>( passwords.cchLength ) + 1U;
+	const SIZE_T cChunk = min( cPasswords, c_cbBytesChunk / (sizeof( WCHAR ) * cchStride) );
+	bulk_t bulk( TRUE );
+	LPWSTR pszChunk = bulk.Alloc<WCHAR>( cChunk * cchStride );
+	if (!bulk.Started( )){
+		return 1;
+	}
+
+	WPG_BATCH batch = passwords;
+	batch.pszBuffer = pszChunk;
+
+	stopwatch_t stopwatch;
+	for (SIZE_T cDone = 0; cDone < cPasswords; cDone += batch.cPasswords){
+		batch.cPasswords = min( cChunk, cPasswords - cDone );
+		stopwatch.Lap( );
+		const WPGCaps wpgCapsFailed = WPGPoolGenerate( bulk.Pool( ), &batch );
+		stopwatch.Lapped( );
+		if (!bulk_t::Generated( wpgCapsFailed, L"passwords" )){
+			return 1;
+		}
+		for (SIZE_T n = 0; n < batch.cPasswords; n++){
+			wprintf( L"%s\n", pszChunk + (n * cchStride) );
+		}
+	}
+	fwprintf( stderr, L"%llu password(s) generated at %.0f/s\n", static_cast<ULONG64>( cPasswords ), static_cast<double>( cPasswords ) / stopwatch.LapSeconds( ) );
+	return 0;
+}
+
+int WPGBulkBytes(__in ULONG64 ullBytes, __in BOOL fEncode, __in Encoding encoding, __in_opt LPCWSTR pszPath) {
+
+	FILE* pFile = stdout;
+	if (pszPath && (_wfopen_s( &pFile, pszPath, L"wb" ) != 0)){
+		fwprintf( stderr, L"Failed to create %s\n", pszPath );
+		return 1;
+	}
+	const SIZE_T cchEncoded = encode_t::encoded_size( encoding, c_cbBytesChunk );
+	const auto encoder = get_vex_encode( );
+	bulk_t bulk( TRUE, pFile );
+	LPBYTE lpBytes = bulk.Alloc<BYTE>( c_cbBytesChunk );
+	char* pszEncoded = bulk.Alloc<char>( cchEncoded );
+	if (!bulk.Started( )){
+		return 1;
+	}
+
+	stopwatch_t stopwatch;
+	for (ULONG64 ullDone = 0; ullDone < ullBytes; ){
+		const SIZE_T cb = static_cast<SIZE_T>( min( ullBytes - ullDone, static_cast<ULONG64>( c_cbBytesChunk ) ) );
+		if (!bulk_t::Generated( WPGPoolEntropy( bulk.Pool( ), lpBytes, cb, c_wpgCapsBulk ), L"bytes" )){
+			return 1;
+		}
+		SIZE_T cchWrite = cb;
+		if (fEncode){
+			stopwatch.Lap( );
+			cchWrite = encoder->apply( encoding, lpBytes, cb, pszEncoded );
+			stopwatch.Lapped( );
+		}
+		if (!bulk.Write( fEncode ? static_cast<const void*>( pszEncoded ) : lpBytes, cchWrite, L"bytes" )){
+			return 1;
+		}
+		ullDone += cb;
+	}
+	if (fEncode){
+		fputc( '\n', pFile );
+	}
+	if (!bulk.Flush( )){
+		return 1;
+	}
+	const double dSeconds = stopwatch.Seconds( );
+	fwprintf( stderr, L"%llu byte(s) in %.3fs (%.2f MB/s)\n", ullBytes, dSeconds, static_cast<double>( ullBytes ) / (dSeconds * 1e6) );
+	if (fEncode && (stopwatch.LapSeconds( ) > 0)){
+		fwprintf( stderr, L"Encoded (%hs) at %.2f MB/s\n", get_vex_name( encoder->vex( ) ), static_cast<double>( ullBytes ) / (stopwatch.LapSeconds( ) * 1e6) );
+	}
+	return 0;
+}
+
+int WPGBulkTokens(__in ULONG64 cTokens, __in BYTE cbToken, __in Encoding encoding) {
+
+	// Generate as many whole tokens at a time as fit in a chunk, and encode each onto its own line
+	const SIZE_T cTokensPerChunk = (c_cbBytesChunk / cbToken);
+	const SIZE_T cchToken = encode_t::encoded_size( encoding, cbToken );
+	const auto encoder = get_vex_encode( );
+	bulk_t bulk( TRUE, stdout );
+	LPBYTE lpBytes = bulk.Alloc<BYTE>( c_cbBytesChunk );
+	char* pszEncoded = bulk.Alloc<char>( cTokensPerChunk * (cchToken + 1) );
+	if (!bulk.Started( )){
+		return 1;
+	}
+
+	stopwatch_t stopwatch;
+	ULONG64 ullChars = 0;
+	for (ULONG64 ullDone = 0; ullDone < cTokens; ){
+		const SIZE_T cChunk = static_cast<SIZE_T>( min( cTokens - ullDone, static_cast<ULONG64>( cTokensPerChunk ) ) );
+		if (!bulk_t::Generated( WPGPoolEntropy( bulk.Pool( ), lpBytes, cChunk * cbToken, c_wpgCapsBulk ), L"tokens" )){
+			return 1;
+		}
+		stopwatch.Lap( );
+		SIZE_T cch = 0;
+		for (SIZE_T t = 0; t < cChunk; t++){
+			cch += encoder->apply( encoding, lpBytes + (t * cbToken), cbToken, pszEncoded + cch );
+			pszEncoded[cch++] = '\n';
+		}
+		stopwatch.Lapped( );
+		if (!bulk.Write( pszEncoded, cch, L"tokens" )){
+			return 1;
+		}
+		ullChars += cch;
+		ullDone += cChunk;
+	}
+	if (!bulk.Flush( )){
+		return 1;
+	}
+	bulk_t::Report( cTokens, L"token", stopwatch.Seconds( ) );
+	const double dEncoding = stopwatch.LapSeconds( );
+	if (dEncoding > 0){
+		fwprintf( stderr, L"Encoded (%hs) at %.2f MB/s in, %.2f MB/s out\n", get_vex_name( encoder->vex( ) ),
+			static_cast<double>( cTokens * cbToken ) / (dEncoding * 1e6), static_cast<double>( ullChars ) / (dEncoding * 1e6) );
+	}
+	return 0;
+}
+
+int WPGBulkUuids(__in ULONG64 cUuids, __in BYTE bVersion) {
+
+	bulk_t bulk( TRUE, stdout );
+	LPBYTE lpUuids = bulk.Alloc<BYTE>( c_cUuidsChunk * WPG_UUID_SIZE );
+	LPSTR pszText = bulk.Alloc<CHAR>( c_cUuidsChunk * (WPG_UUID_CCH + 1) );
+	if (!bulk.Started( )){
+		return 1;
+	}
+
+	stopwatch_t stopwatch;
+	for (ULONG64 ullDone = 0; ullDone < cUuids; ){
+		const SIZE_T cChunk = static_cast<SIZE_T>( min( cUuids - ullDone, static_cast<ULONG64>( c_cUuidsChunk ) ) );
+		if (!bulk_t::Generated( WPGUuidGenerate( bulk.Pool( ), lpUuids, cChunk, bVersion, c_wpgCapsBulk ), L"UUIDs" )){
+			return 1;
+		}
+		stopwatch.Lap( );
+		const SIZE_T cch = WPGUuidFormat( lpUuids, cChunk, '\n', pszText );
+		stopwatch.Lapped( );
+		if (!bulk.Write( pszText, cch, L"UUIDs" )){
+			return 1;
+		}
+		ullDone += cChunk;
+	}
+	if (!bulk.Flush( )){
+		return 1;
+	}
+	bulk_t::Report( cUuids, L"UUID", stopwatch.Seconds( ) );
+	if (stopwatch.LapSeconds( ) > 0){
+		fwprintf( stderr, L"Formatted (%hs) at %.0f/s\n", get_vex_name( get_vex_encode( )->vex( ) ), static_cast<double>( cUuids ) / stopwatch.LapSeconds( ) );
+	}
+	return 0;
+}
+
+int WPGBulkPassphrases(__in LPCWSTR pszPath, __in DWORD cWords, __in ULONG64 cPassphrases, __in LPCWSTR pszSeparator) {
+
+	stopwatch_t stopwatch;
+	WPG_WORDLIST_H hWordlist = OpenWPGWordlist( pszPath );
+	const double dOpening = stopwatch.Seconds( );
+	if (hWordlist == NULL){
+		fwprintf( stderr, L"Failed to open the wordlist (error %lu)\n", GetLastError( ) );
+		return 1;
+	}
+	const DWORD cListed = GetWPGWordlistSize( hWordlist );
+
+	// Size the buffer for the longest passphrase allowed
+	const SIZE_T cchBuffer = (cWords * (c_cchPassphraseWord + wcslen( pszSeparator ))) + 1;
+	bulk_t bulk( TRUE );
+	LPWSTR pszPassphrase = bulk.Alloc<WCHAR>( cchBuffer );
+	int iResult = (bulk.Started( )) ? 0 : 1;
+	for (ULONG64 ullDone = 0; (ullDone < cPassphrases) && (iResult == 0); ullDone++){
+		WPGCaps wpgCapsFailed = WPGCapNONE;
+		stopwatch.Lap( );
+		const HRESULT hResult = WPGWordlistGenerate( hWordlist, bulk.Pool( ), cWords, pszSeparator, pszPassphrase, cchBuffer, c_wpgCapsBulk, &wpgCapsFailed );
+		stopwatch.Lapped( );
+		if (FAILED( hResult )){
+			fwprintf( stderr, L"Failed to generate the passphrase (0x%08X, sources 0x%08X)\n", static_cast<unsigned>( hResult ), static_cast<unsigned>( wpgCapsFailed ) );
+			iResult = 1;
+			break;
+		}
+		wprintf( L"%s\n", pszPassphrase );
+	}
+	if (iResult == 0){
+		// Each word gives log2 of the size of the list in bits
+		const double dBitsPerWord = log( static_cast<double>( cListed ) ) / log( 2.0 );
+		fwprintf( stderr, L"Opened %lu word(s) in %.3fs; %.2f bits per word, %.1f per passphrase\n",
+			cListed, dOpening, dBitsPerWord, dBitsPerWord * cWords );
+		fwprintf( stderr, L"%llu passphrase(s) in %.3fs (generated at %.0f/s)\n", cPassphrases,
+			stopwatch.Seconds( ), static_cast<double>( cPassphrases ) / stopwatch.LapSeconds( ) );
+	}
+	CloseWPGWordlist( hWordlist );
+	return iResult;
+}
+
+int WPGBulkSymbols(__in WPG_ALPHABET_H hAlphabet, __in ULONG64 cPasswords, __in BYTE cSymbols) {
+
+	// Size the chunk for the longest passwords, i.e. four bytes per symbol
+	const SIZE_T cbPassword = (4 * static_cast<SIZE_T>( cSymbols )) + 1;
+	const SIZE_T cPerChunk = c_cbBytesChunk / cbPassword;
+	std::shared_ptr<wpg_t> wpg = wpg_t::New( );
+	bulk_t bulk( FALSE, stdout );
+	LPSTR pszText = bulk.Alloc<CHAR>( cPerChunk * cbPassword );
+	if (!bulk.Started( wpg != nullptr )){
+		return 1;
+	}
+
+	stopwatch_t stopwatch;
+	for (ULONG64 ullDone = 0; ullDone < cPasswords; ){
+		const SIZE_T cChunk = static_cast<SIZE_T>( min( cPasswords - ullDone, static_cast<ULONG64>( cPerChunk ) ) );
+		SIZE_T cb = 0;
+		for (SIZE_T n = 0; n < cChunk; n++){
+			SIZE_T cbPasswordWritten = 0;
+			if (!bulk_t::Generated( WPGAlphabetGenerateUtf8( hAlphabet, *wpg, pszText + cb, cSymbols, TRUE, &cbPasswordWritten, c_wpgCapsBulk ), L"passwords" )){
+				return 1;
+			}
+			cb += cbPasswordWritten;
+			pszText[cb++] = '\n';
+		}
+		if (!bulk.Write( pszText, cb, L"passwords" )){
+			return 1;
+		}
+		ullDone += cChunk;
+	}
+	if (!bulk.Flush( )){
+		return 1;
+	}
+	bulk_t::Report( cPasswords, L"password", stopwatch.Seconds( ) );
+	return 0;
+}
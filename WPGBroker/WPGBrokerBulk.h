@@ -0,0 +1,101 @@
+// WPGBrokerBulk.h: declares the broker's command-line modes which generate in bulk, without the broker,
+//					and the timing they share with the rest
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_BROKER_BULK_H__)
+#define __WPG_BROKER_BULK_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "WPGPool.h"
+#include "WPGAlphabet.h"
+
+// Constants
+//
+
+// The sources from which every mode draws
+constexpr WPGCaps c_wpgCapsBulk = (WPGCapRDRAND | WPGCapTPM12 | WPGCapTPM20);
+
+// Classes
+//
+
+// Times the work from when it's constructed, and, in laps, whichever part of it is to be reported on separately
+class stopwatch_t {
+public:
+	stopwatch_t(void): m_llLaps( 0 ) {
+		QueryPerformanceFrequency( &m_frequency );
+		QueryPerformanceCounter( &m_start );
+		m_lap = m_start;
+	}
+
+	// Starts, and stops, a lap
+	VOID Lap(void) {
+		QueryPerformanceCounter( &m_lap );
+	}
+
+	VOID Lapped(void) {
+		LARGE_INTEGER now = { 0 };
+		QueryPerformanceCounter( &now );
+		m_llLaps += (now.QuadPart - m_lap.QuadPart);
+	}
+
+	// Returns the seconds since it was constructed
+	double Seconds(void) const {
+		LARGE_INTEGER now = { 0 };
+		QueryPerformanceCounter( &now );
+		return Seconds( now.QuadPart - m_start.QuadPart );
+	}
+
+	// Returns the seconds spent in laps, in all
+	double LapSeconds(void) const {
+		return Seconds( m_llLaps );
+	}
+
+private:
+	double Seconds(LONGLONG llCounts) const {
+		return static_cast<double>( llCounts ) / static_cast<double>( m_frequency.QuadPart );
+	}
+
+	LARGE_INTEGER m_frequency;
+	LARGE_INTEGER m_start;
+	LARGE_INTEGER m_lap;
+	LONGLONG m_llLaps;
+};
+
+// Functions
+//
+// (Each of the modes returns the process's exit code, having said on stderr what went wrong, if anything)
+
+// Returns a batch of the given number of passwords, of the given length, drawn from all of the sources, and from the
+// given alphabet (allowing duplicates), or pattern, or policy
+WPG_BATCH WPGBulkBatch(__in SIZE_T, __in BYTE, __in_opt LPCWSTR, __in_opt WPG_PATTERN_H, __in_opt WPG_POLICY_H);
+
+// Generates the given batch straight to the given file (see WPGWriter.h), with the given WPG_WRITER_ flags
+int WPGBulkWrite(__in LPCWSTR, __in const WPG_BATCH&, __in DWORD);
+
+// Generates the given batch, a chunk at a time, and prints its passwords, one per line
+int WPGBulkPrint(__in const WPG_BATCH&);
+
+// Generates the given number of raw bytes, to the given file or else to stdout, as binary or in the given encoding
+int WPGBulkBytes(__in ULONG64, __in BOOL fEncode, __in Encoding, __in_opt LPCWSTR);
+
+// Generates the given number of tokens, each encoding the given number of raw bytes, and prints them, one per line
+int WPGBulkTokens(__in ULONG64, __in BYTE, __in Encoding);
+
+// Generates the given number of UUIDs, of the given version (4 or 7), and prints them, one per line
+int WPGBulkUuids(__in ULONG64, __in BYTE);
+
+// Generates the given number of passphrases, of the given number of words from the given list, and joined with the
+// given separator, and prints them, one per line
+int WPGBulkPassphrases(__in LPCWSTR, __in DWORD, __in ULONG64, __in LPCWSTR);
+
+// Generates the given number of passwords of the given number of symbols from the given alphabet, on this thread, and
+// writes them straight out as UTF-8, one per line
+int WPGBulkSymbols(__in WPG_ALPHABET_H, __in ULONG64, __in BYTE);
+
+#endif // !defined(__WPG_BROKER_BULK_H__)
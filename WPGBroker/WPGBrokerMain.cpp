@@ -0,0 +1,484 @@
+// WPGBrokerMain.cpp: defines the entry point for the password broker, and for asking it for passwords.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+// Usage: wpgbroker [workers]
+//          Serves the broker's pipe, with the given number of workers (or one per logical processor), until Ctrl+C
+//
+//        wpgbroker /generate count length [alphabet]
+//          Asks the running broker for passwords, and prints them, one per line
+//
+//        wpgbroker /bench [seconds] [consumers]
+//          Measures how fast the given number of consumers (default: one) can take from the running broker's entropy ring
+//
+//        wpgbroker /write path count length [alphabet] [/nul] [/mapped]
+//          Generates passwords straight to the given file (without the broker), one per line or NUL-terminated
+//
+//        wpgbroker /pattern pattern count [path] [/nul] [/mapped]
+//          Generates passwords (without the broker) from the given pattern (see WPG\WPGPattern.h), e.g. Cvcc-9999-XXXX,
+//          to the given file (as /write does) or else to stdout, one per line
+//
+//        wpgbroker /policy count length [alphabet] [/upper:n] [/lower:n] [/digit:n] [/symbol:n] [/run:n] [/exclude:chars] [/path:path]
+//          Generates passwords (without the broker) which have at least the given numbers of upper case letters, lower
+//          case letters, digits and symbols, no runs of any one character longer than given, and none of the excluded
+//          characters, to the given file (as /write does) or else to stdout, one per line
+//
+//        wpgbroker /alphabet alphabet count length [path] [/nul] [/mapped]
+//          Generates passwords (without the broker) of the given number of symbols, drawn from the alphabet in the given
+//          file (in UTF-8, of up to 2^20 code points, e.g. CJK or emoji; see WPG\WPGAlphabet.h), to the given file (as
+//          /write does) or else straight to stdout, as UTF-8, one per line
+//
+//        wpgbroker /bytes count [/hex | /base32 | /base64] [path]
+//          Generates the given number of raw (health-tested) random bytes (without the broker), to the given
+//          file or else to stdout, as binary, hex, base32 or base64
+//
+//        wpgbroker /tokens count bytes [/hex | /base32 | /base58 | /base64 | /base64url]
+//          Generates tokens (without the broker), each encoding the given number of raw random bytes, and
+//          prints them, one per line
+//
+//        wpgbroker /uuids count [/v7]
+//          Generates version 4 (or 7) UUIDs (without the broker), and prints them, one per line
+//
+//        wpgbroker /passphrase wordlist [words] [count] [separator]
+//          Generates passphrases (without the broker) of the given number of words (default: six), drawn from
+//          the given list, one per line, and joined with the given separator (default: a space)
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// C Standard Library Headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+
+// Local Project Headers
+#include "WPGBrokerServer.h"
+#include "WPGBrokerBulk.h"
+#include "WPGWriter.h"
+
+// Constants
+//
+
+// The alphabet used unless another is given
+const WCHAR c_szDefaultAlphabet[] = L"abcdefghijklmnopqrstuvwxyz1234567890ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+// The time, in milliseconds, to wait for an instance of the pipe to be free
+constexpr DWORD c_dwPipeTimeout = 5000;
+
+// The most consumers to benchmark at once, and the size of each of their reads
+constexpr DWORD c_cMaxBenchConsumers = 64;
+constexpr SIZE_T c_cbBenchRead = 0x1000;
+
+// The most raw bytes in a token
+constexpr unsigned long c_cbMaxToken = 0xF0;
+
+// The most words per passphrase
+constexpr unsigned long c_cMaxPassphraseWords = 64;
+
+// The encodings which can be asked for by name
+static const struct {
+	LPCWSTR pszSwitch;
+	Encoding encoding;
+} c_encodings[] = {
+	{ L"/hex", EncodingBASE16 },
+	{ L"/base32", EncodingBASE32 },
+	{ L"/base58", EncodingBASE58 },
+	{ L"/base64", EncodingBASE64 },
+	{ L"/base64url", EncodingBASE64URL }
+};
+
+// Types
+//
+
+// Gives the state of one of the benchmark's consumers
+typedef struct _WPG_BENCH_CONSUMER {
+
+	WPG_RING_H hRing;
+	volatile LONG* plStop;
+
+	// The bytes taken, and the reads which came back short
+	ULONG64 ullBytes;
+	ULONG64 ullShort;
+
+} WPG_BENCH_CONSUMER, *PWPG_BENCH_CONSUMER;
+
+// Globals
+//
+
+static broker_t* g_pBroker = NULL;
+
+// Functions
+//
+
+static BOOL WINAPI OnConsoleCtrl(DWORD dwCtrlType) {
+
+	if ((dwCtrlType == CTRL_C_EVENT) || (dwCtrlType == CTRL_BREAK_EVENT) || (dwCtrlType == CTRL_CLOSE_EVENT)){
+		if (g_pBroker){
+			g_pBroker->Stop( );
+		}
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static int Serve(DWORD dwWorkers) {
+
+	broker_t broker( dwWorkers );
+	if (!broker){
+		fwprintf( stderr, L"Failed to start the generator.\n" );
+		return 1;
+	}
+
+	g_pBroker = &broker;
+	SetConsoleCtrlHandler( OnConsoleCtrl, TRUE );
+	wprintf( L"Serving %s (Ctrl+C to stop)..\n", WPG_BROKER_PIPE_NAME );
+	const HRESULT hResult = broker.Run( );
+	SetConsoleCtrlHandler( OnConsoleCtrl, FALSE );
+	g_pBroker = NULL;
+	if (FAILED( hResult )){
+		fwprintf( stderr, (hResult == HRESULT_FROM_WIN32( ERROR_ACCESS_DENIED ))
+			? L"Failed to open the pipe; is the broker already running? (0x%08X)\n"
+			: L"Failed to serve the pipe (0x%08X)\n", static_cast<unsigned>( hResult ) );
+		return 1;
+	}
+	return 0;
+}
+
+static int Generate(WORD cPasswords, BYTE cchLength, LPCWSTR pszAlphabet) {
+
+	WPG_BROKER_REQUEST request = { 0 };
+	request.dwVersion = WPG_BROKER_VERSION;
+	request.dwRequestId = GetCurrentProcessId( );
+	request.cPasswords = cPasswords;
+	request.cchLength = cchLength;
+	request.fDuplicatesAllowed = TRUE;
+	request.wpgCaps = c_wpgCapsBulk;
+	StringCchCopyW( request.szAlphabet, _countof( request.szAlphabet ), pszAlphabet );
+
+	// Each request and its response are single messages, so one call does the lot
+	const DWORD cbResponse = WPGBrokerResponseSize( cPasswords, cchLength );
+	PWPG_BROKER_RESPONSE pResponse = static_cast<PWPG_BROKER_RESPONSE>( PH_ALLOC( cbResponse ) );
+	if (pResponse == NULL){
+		return 1;
+	}
+	stopwatch_t stopwatch;
+	DWORD cbRead = 0;
+	const BOOL fCalled = CallNamedPipeW( WPG_BROKER_PIPE_NAME, &request, sizeof( request ), pResponse, cbResponse, &cbRead, c_dwPipeTimeout );
+	const double dSeconds = stopwatch.Seconds( );
+
+	int iResult = 1;
+	if (!fCalled){
+		fwprintf( stderr, L"Failed to reach the broker (%lu)\n", GetLastError( ) );
+	}else if ((cbRead < sizeof( WPG_BROKER_RESPONSE )) || (pResponse->dwRequestId != request.dwRequestId)){
+		fwprintf( stderr, L"Unexpected response from the broker\n" );
+	}else if (FAILED( pResponse->hResult ) || (cbRead != WPGBrokerResponseSize( pResponse->cPasswords, pResponse->cchLength ))){
+		fwprintf( stderr, L"The broker failed the request (0x%08X, sources 0x%08X)\n",
+			static_cast<unsigned>( pResponse->hResult ), static_cast<unsigned>( pResponse->wpgCapsFailed ) );
+	}else{
+		LPCWSTR pszPassword = reinterpret_cast<LPCWSTR>( pResponse + 1 );
+		for (WORD w = 0; w < pResponse->cPasswords; w++, pszPassword += pResponse->cchLength){
+			wprintf( L"%.*s\n", static_cast<int>( pResponse->cchLength ), pszPassword );
+		}
+		fwprintf( stderr, L"%u password(s) in %.3fms\n", static_cast<unsigned>( pResponse->cPasswords ), 1000.0 * dSeconds );
+		iResult = 0;
+	}
+	SecureZeroMemory( pResponse, cbResponse );
+	PH_FREE( pResponse );
+	SecureZeroMemory( &request, sizeof( request ) );
+	return iResult;
+}
+
+static DWORD WINAPI BenchConsumerThreadProc(LPVOID lpParameter) {
+
+	PWPG_BENCH_CONSUMER pConsumer = static_cast<PWPG_BENCH_CONSUMER>( lpParameter );
+	BYTE bBuffer[c_cbBenchRead];
+	while (InterlockedCompareExchange( pConsumer->plStop, 0, 0 ) == 0){
+		const SIZE_T cbRead = WPGRingRead( pConsumer->hRing, bBuffer, sizeof( bBuffer ) );
+		pConsumer->ullBytes += cbRead;
+		if (cbRead < sizeof( bBuffer )){
+			pConsumer->ullShort++;
+			SwitchToThread( );
+		}
+	}
+	SecureZeroMemory( bBuffer, sizeof( bBuffer ) );
+	return 0;
+}
+
+static int Bench(DWORD dwSeconds, DWORD cConsumers) {
+
+	// Each consumer opens the ring for itself, as separate processes would
+	WPG_BENCH_CONSUMER consumers[c_cMaxBenchConsumers] = { 0 };
+	HANDLE hThreads[c_cMaxBenchConsumers] = { 0 };
+	volatile LONG lStop = 0;
+	DWORD cStarted = 0;
+	for (; cStarted < cConsumers; cStarted++){
+		consumers[cStarted].plStop = &lStop;
+		consumers[cStarted].hRing = OpenWPGRing( );
+		if (consumers[cStarted].hRing == NULL){
+			fwprintf( stderr, L"Failed to open the entropy ring; is the broker running? (%lu)\n", GetLastError( ) );
+			break;
+		}
+		hThreads[cStarted] = CreateThread( NULL, 0, BenchConsumerThreadProc, consumers + cStarted, 0, NULL );
+		if (hThreads[cStarted] == NULL){
+			CloseWPGRing( consumers[cStarted].hRing );
+			break;
+		}
+	}
+
+	stopwatch_t stopwatch;
+	if (cStarted == cConsumers){
+		Sleep( dwSeconds * 1000 );
+	}
+	InterlockedExchange( &lStop, 1 );
+	WaitForMultipleObjects( cStarted, hThreads, TRUE, INFINITE );
+
+	const double dSeconds = stopwatch.Seconds( );
+	ULONG64 ullBytes = 0;
+	for (DWORD dw = 0; dw < cStarted; dw++){
+		wprintf( L"Consumer %lu: %.2f MB/s (%llu short read(s))\n", dw,
+			static_cast<double>( consumers[dw].ullBytes ) / (dSeconds * 1e6), consumers[dw].ullShort );
+		ullBytes += consumers[dw].ullBytes;
+		CloseHandle( hThreads[dw] );
+		CloseWPGRing( consumers[dw].hRing );
+	}
+	if (cStarted < cConsumers){
+		return 1;
+	}
+	wprintf( L"In all: %.2f MB/s over %.1fs\n", static_cast<double>( ullBytes ) / (dSeconds * 1e6), dSeconds );
+	return 0;
+}
+
+// Picks the writer's switches (see WPG_WRITER_NUL and WPG_WRITER_MAPPED) out from amongst the positional arguments
+// which follow the mode, keeping up to the given number of the latter; returns the number kept
+static int ParseWriterArgs(int argc, wchar_t* argv[], LPCWSTR* pszArgs, int cMaxArgs, DWORD* pdwFlags) {
+
+	int cArgs = 0;
+	for (int i = 2; i < argc; i++){
+		if (_wcsicmp( argv[i], L"/nul" ) == 0){
+			*pdwFlags |= WPG_WRITER_NUL;
+		}else if (_wcsicmp( argv[i], L"/mapped" ) == 0){
+			*pdwFlags |= WPG_WRITER_MAPPED;
+		}else if (cArgs < cMaxArgs){
+			pszArgs[cArgs++] = argv[i];
+		}
+	}
+	return cArgs;
+}
+
+// Returns TRUE, with the encoding, if the given argument names one
+static BOOL ParseEncoding(LPCWSTR pszArg, Encoding* pEncoding) {
+
+	for (const auto& named : c_encodings){
+		if (_wcsicmp( pszArg, named.pszSwitch ) == 0){
+			*pEncoding = named.encoding;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+int wmain(int argc, wchar_t* argv[]) {
+
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/generate" ) == 0)){
+		const unsigned long ulPasswords = (argc > 2) ? wcstoul( argv[2], NULL, 10 ) : 1;
+		const unsigned long ulLength = (argc > 3) ? wcstoul( argv[3], NULL, 10 ) : 16;
+		if ((ulPasswords == 0) || (ulPasswords > WPG_BROKER_MAX_PASSWORDS) || (ulLength == 0) || (ulLength > 0xFF)){
+			fwprintf( stderr, L"Usage: %s /generate count(1-%u) length(1-255) [alphabet]\n", argv[0], static_cast<unsigned>( WPG_BROKER_MAX_PASSWORDS ) );
+			return 1;
+		}
+		return Generate( static_cast<WORD>( ulPasswords ), static_cast<BYTE>( ulLength ), (argc > 4) ? argv[4] : c_szDefaultAlphabet );
+	}
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/write" ) == 0)){
+		DWORD dwFlags = 0;
+		LPCWSTR pszArgs[4] = { NULL, NULL, NULL, c_szDefaultAlphabet };
+		const int cArgs = ParseWriterArgs( argc, argv, pszArgs, _countof( pszArgs ), &dwFlags );
+		const unsigned long long ullPasswords = (cArgs > 1) ? wcstoull( pszArgs[1], NULL, 10 ) : 0;
+		const unsigned long ulLength = (cArgs > 2) ? wcstoul( pszArgs[2], NULL, 10 ) : 0;
+		if ((cArgs < 3) || (ullPasswords == 0) || (ullPasswords > MAXLONG) || (ulLength == 0) || (ulLength > 0xFF) || (pszArgs[3][0] == L'\0')){
+			fwprintf( stderr, L"Usage: %s /write path count length(1-255) [alphabet] [/nul] [/mapped]\n", argv[0] );
+			return 1;
+		}
+		return WPGBulkWrite( pszArgs[0], WPGBulkBatch( static_cast<SIZE_T>( ullPasswords ), static_cast<BYTE>( ulLength ), pszArgs[3], NULL, NULL ), dwFlags );
+	}
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/pattern" ) == 0)){
+		DWORD dwFlags = 0;
+		LPCWSTR pszArgs[3] = { NULL, NULL, NULL };
+		const int cArgs = ParseWriterArgs( argc, argv, pszArgs, _countof( pszArgs ), &dwFlags );
+		const unsigned long long ullPasswords = (cArgs > 1) ? wcstoull( pszArgs[1], NULL, 10 ) : 0;
+		if ((cArgs < 2) || (ullPasswords == 0) || (ullPasswords > MAXLONG)){
+			fwprintf( stderr, L"Usage: %s /pattern pattern count [path] [/nul] [/mapped]\n", argv[0] );
+			return 1;
+		}
+		SIZE_T cchError = 0;
+		WPG_PATTERN_H hPattern = CompileWPGPattern( pszArgs[0], &cchError );
+		if (hPattern == NULL){
+			fwprintf( stderr, L"Failed to compile the pattern, at offset %llu\n", static_cast<ULONG64>( cchError ) );
+			return 1;
+		}
+		fwprintf( stderr, L"%u character(s), %.1f bits per password\n", static_cast<unsigned>( GetWPGPatternLength( hPattern ) ), GetWPGPatternBits( hPattern ) );
+		const WPG_BATCH batch = WPGBulkBatch( static_cast<SIZE_T>( ullPasswords ), GetWPGPatternLength( hPattern ), NULL, hPattern, NULL );
+		const int iResult = (pszArgs[2]) ? WPGBulkWrite( pszArgs[2], batch, dwFlags ) : WPGBulkPrint( batch );
+		CloseWPGPattern( hPattern );
+		return iResult;
+	}
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/alphabet" ) == 0)){
+		DWORD dwFlags = 0;
+		LPCWSTR pszArgs[4] = { NULL, NULL, NULL, NULL };
+		const int cArgs = ParseWriterArgs( argc, argv, pszArgs, _countof( pszArgs ), &dwFlags );
+		const unsigned long long ullPasswords = (cArgs > 1) ? wcstoull( pszArgs[1], NULL, 10 ) : 0;
+		const unsigned long ulSymbols = (cArgs > 2) ? wcstoul( pszArgs[2], NULL, 10 ) : 0;
+		if ((cArgs < 3) || (ullPasswords == 0) || (ullPasswords > MAXLONG) || (ulSymbols == 0) || (ulSymbols > 0xFF)){
+			fwprintf( stderr, L"Usage: %s /alphabet alphabet count length(1-255) [path] [/nul] [/mapped]\n", argv[0] );
+			return 1;
+		}
+		stopwatch_t stopwatch;
+		WPG_ALPHABET_H hAlphabet = LoadWPGAlphabet( pszArgs[0] );
+		const double dLoading = stopwatch.Seconds( );
+		if (hAlphabet == NULL){
+			fwprintf( stderr, L"Failed to load the alphabet (error %lu)\n", GetLastError( ) );
+			return 1;
+		}
+
+		// Each symbol gives log2 of the size of the alphabet in bits
+		const DWORD cAlphabet = GetWPGAlphabetSize( hAlphabet );
+		const double dBitsPerSymbol = log( static_cast<double>( cAlphabet ) ) / log( 2.0 );
+		fwprintf( stderr, L"Loaded %lu symbol(s) in %.3fs; %.2f bits per symbol, %.1f per password\n",
+			cAlphabet, dLoading, dBitsPerSymbol, dBitsPerSymbol * ulSymbols );
+
+		// The file is written from the pool's records, in UTF-16, which have to have room for each symbol
+		int iResult = 1;
+		const unsigned long ulLength = ulSymbols * GetWPGAlphabetUnits( hAlphabet );
+		if (pszArgs[3] == NULL){
+			iResult = WPGBulkSymbols( hAlphabet, static_cast<ULONG64>( ullPasswords ), static_cast<BYTE>( ulSymbols ) );
+		}else if (ulLength > 0xFF){
+			fwprintf( stderr, L"The alphabet has symbols beyond the BMP, so passwords written to a file may have at most %u\n", 0xFFU / GetWPGAlphabetUnits( hAlphabet ) );
+		}else{
+			WPG_BATCH batch = WPGBulkBatch( static_cast<SIZE_T>( ullPasswords ), static_cast<BYTE>( ulLength ), NULL, NULL, NULL );
+			batch.hAlphabet = hAlphabet;
+			iResult = WPGBulkWrite( pszArgs[3], batch, dwFlags );
+		}
+		CloseWPGAlphabet( hAlphabet );
+		return iResult;
+	}
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/policy" ) == 0)){
+		static const struct {
+			LPCWSTR pszSwitch;
+			WPGPolicyClass policyClass;
+		} c_classes[] = {
+			{ L"/upper:", WPGPolicyUPPER },
+			{ L"/lower:", WPGPolicyLOWER },
+			{ L"/digit:", WPGPolicyDIGIT },
+			{ L"/symbol:", WPGPolicySYMBOL }
+		};
+
+		// Pick the rules out from amongst the positional arguments
+		WPG_POLICY policy = { 0 };
+		LPCWSTR pszArgs[3] = { NULL, NULL, c_szDefaultAlphabet };
+		LPCWSTR pszPath = NULL;
+		int cArgs = 0;
+		BOOL fValid = TRUE;
+		for (int i = 2; (i < argc) && fValid; i++){
+			BOOL fRule = FALSE;
+			for (const auto& named : c_classes){
+				const size_t cchSwitch = wcslen( named.pszSwitch );
+				if (_wcsnicmp( argv[i], named.pszSwitch, cchSwitch ) == 0){
+					const unsigned long ulMinimum = wcstoul( argv[i] + cchSwitch, NULL, 10 );
+					fValid = (ulMinimum <= 0xFF);
+					policy.cMinimum[named.policyClass] = static_cast<BYTE>( ulMinimum );
+					fRule = TRUE;
+				}
+			}
+			if (fRule){
+				continue;
+			}
+			if (_wcsnicmp( argv[i], L"/run:", 5 ) == 0){
+				const unsigned long ulRun = wcstoul( argv[i] + 5, NULL, 10 );
+				fValid = (ulRun <= 0xFF);
+				policy.cchMaxRun = static_cast<BYTE>( ulRun );
+			}else if (_wcsnicmp( argv[i], L"/exclude:", 9 ) == 0){
+				policy.pszExclude = argv[i] + 9;
+			}else if (_wcsnicmp( argv[i], L"/path:", 6 ) == 0){
+				pszPath = argv[i] + 6;
+			}else if (cArgs < _countof( pszArgs )){
+				pszArgs[cArgs++] = argv[i];
+			}
+		}
+		const unsigned long long ullPasswords = (cArgs > 0) ? wcstoull( pszArgs[0], NULL, 10 ) : 0;
+		const unsigned long ulLength = (cArgs > 1) ? wcstoul( pszArgs[1], NULL, 10 ) : 0;
+		if (!fValid || (cArgs < 2) || (ullPasswords == 0) || (ullPasswords > MAXLONG) || (ulLength == 0) || (ulLength > 0xFF)){
+			fwprintf( stderr, L"Usage: %s /policy count length(1-255) [alphabet] [/upper:n] [/lower:n] [/digit:n] [/symbol:n] [/run:n] [/exclude:chars] [/path:path]\n", argv[0] );
+			return 1;
+		}
+		WPG_POLICY_H hPolicy = CompileWPGPolicy( pszArgs[2], static_cast<BYTE>( ulLength ), &policy );
+		if (hPolicy == NULL){
+			fwprintf( stderr, L"No password of that length, from that alphabet, can satisfy the policy.\n" );
+			return 1;
+		}
+		const WPG_BATCH batch = WPGBulkBatch( static_cast<SIZE_T>( ullPasswords ), static_cast<BYTE>( ulLength ), NULL, NULL, hPolicy );
+		const int iResult = (pszPath) ? WPGBulkWrite( pszPath, batch, 0 ) : WPGBulkPrint( batch );
+		CloseWPGPolicy( hPolicy );
+		return iResult;
+	}
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/bytes" ) == 0)){
+		BOOL fEncode = FALSE;
+		Encoding encoding = EncodingBASE16;
+		LPCWSTR pszPath = NULL;
+		for (int i = 3; i < argc; i++){
+			if (ParseEncoding( argv[i], &encoding )){
+				fEncode = TRUE;
+			}else{
+				pszPath = argv[i];
+			}
+		}
+		const unsigned long long ullBytes = (argc > 2) ? wcstoull( argv[2], NULL, 10 ) : 0;
+		if ((ullBytes == 0) || (fEncode && (encoding != EncodingBASE16) && (encoding != EncodingBASE32) && (encoding != EncodingBASE64))){
+			fwprintf( stderr, L"Usage: %s /bytes count [/hex | /base32 | /base64] [path]\n", argv[0] );
+			return 1;
+		}
+		return WPGBulkBytes( static_cast<ULONG64>( ullBytes ), fEncode, encoding, pszPath );
+	}
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/tokens" ) == 0)){
+		Encoding encoding = EncodingBASE64URL;
+		const unsigned long long ullTokens = (argc > 2) ? wcstoull( argv[2], NULL, 10 ) : 0;
+		const unsigned long ulBytes = (argc > 3) ? wcstoul( argv[3], NULL, 10 ) : 0;
+		if ((ullTokens == 0) || (ulBytes == 0) || (ulBytes > c_cbMaxToken) || ((argc > 4) && !ParseEncoding( argv[4], &encoding ))){
+			fwprintf( stderr, L"Usage: %s /tokens count bytes(1-%lu) [/hex | /base32 | /base58 | /base64 | /base64url]\n", argv[0], c_cbMaxToken );
+			return 1;
+		}
+		return WPGBulkTokens( static_cast<ULONG64>( ullTokens ), static_cast<BYTE>( ulBytes ), encoding );
+	}
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/uuids" ) == 0)){
+		const unsigned long long ullUuids = (argc > 2) ? wcstoull( argv[2], NULL, 10 ) : 0;
+		const BOOL fOrdered = ((argc > 3) && (_wcsicmp( argv[3], L"/v7" ) == 0));
+		if ((ullUuids == 0) || ((argc > 3) && !fOrdered)){
+			fwprintf( stderr, L"Usage: %s /uuids count [/v7]\n", argv[0] );
+			return 1;
+		}
+		return WPGBulkUuids( static_cast<ULONG64>( ullUuids ), fOrdered ? 7 : 4 );
+	}
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/passphrase" ) == 0)){
+		const unsigned long ulWords = (argc > 3) ? wcstoul( argv[3], NULL, 10 ) : 6;
+		const unsigned long long ullPassphrases = (argc > 4) ? wcstoull( argv[4], NULL, 10 ) : 1;
+		if ((argc < 3) || (ulWords == 0) || (ulWords > c_cMaxPassphraseWords) || (ullPassphrases == 0)){
+			fwprintf( stderr, L"Usage: %s /passphrase wordlist [words(1-%lu)] [count] [separator]\n", argv[0], c_cMaxPassphraseWords );
+			return 1;
+		}
+		return WPGBulkPassphrases( argv[2], static_cast<DWORD>( ulWords ), static_cast<ULONG64>( ullPassphrases ), (argc > 5) ? argv[5] : L" " );
+	}
+	if ((argc > 1) && (_wcsicmp( argv[1], L"/bench" ) == 0)){
+		const unsigned long ulSeconds = (argc > 2) ? wcstoul( argv[2], NULL, 10 ) : 5;
+		const unsigned long ulConsumers = (argc > 3) ? wcstoul( argv[3], NULL, 10 ) : 1;
+		if ((ulSeconds == 0) || (ulSeconds > 3600) || (ulConsumers == 0) || (ulConsumers > c_cMaxBenchConsumers)){
+			fwprintf( stderr, L"Usage: %s /bench [seconds(1-3600)] [consumers(1-%lu)]\n", argv[0], c_cMaxBenchConsumers );
+			return 1;
+		}
+		return Bench( static_cast<DWORD>( ulSeconds ), static_cast<DWORD>( ulConsumers ) );
+	}
+	return Serve( (argc > 1) ? static_cast<DWORD>( wcstoul( argv[1], NULL, 10 ) ) : 0 );
+}
@@ -0,0 +1,614 @@
+// WPGBrokerServer.cpp: gives the implementation of the password broker.
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+// Includes
+//
+
+// Precompiled Headers
+#include "Stdafx.h"
+
+// C++ Standard Library Headers
+#include <new>
+#include <algorithm>
+
+// Declarations
+#include "WPGBrokerServer.h"
+
+// Constants
+//
+
+// The keys with which the packets on the completion port are posted
+constexpr ULONG_PTR c_keyPipe = 1;
+constexpr ULONG_PTR c_keyJob = 2;
+constexpr ULONG_PTR c_keyStop = 3;
+
+// The number of jobs to keep with the pool, per worker
+constexpr DWORD c_cJobsPerWorker = 2;
+
+// The size of each pipe instance's outbound buffer; enough for a full response of 16-character passwords
+constexpr DWORD c_cbOutBuffer = 0x2000;
+
+// Types
+//
+
+// Identifies the I/O outstanding on a client's pipe
+enum io_op_t {
+	io_op_connect = 0,
+	io_op_read,
+	io_op_write
+};
+
+// Gives an overlapped I/O on a client's pipe; the completion port hands it back to us
+struct broker_t::io_t {
+	OVERLAPPED ov;
+	io_op_t op;
+	client_t* pClient;
+};
+
+// Gives a connection (or a pipe instance waiting for one)
+struct broker_t::client_t : public ::std::enable_shared_from_this<broker_t::client_t> {
+	client_t(void): hPipe( INVALID_HANDLE_VALUE ), fConnected( FALSE ), fClosed( FALSE ), fReading( FALSE ), fWriting( FALSE ),
+		fWaiting( FALSE ), cPendingIo( 0 ), cOutstanding( 0 ), ioRead{ }, ioWrite{ }, request{ } {
+		ioRead.pClient = ioWrite.pClient = this;
+		ioWrite.op = io_op_write;
+	}
+
+	HANDLE hPipe;
+	BOOL fConnected;
+	BOOL fClosed;
+	BOOL fReading;
+	BOOL fWriting;
+
+	// TRUE if the client is in line for a turn
+	BOOL fWaiting;
+
+	DWORD cPendingIo;
+
+	// The passwords the client has asked for, which haven't yet been written back to it
+	DWORD cOutstanding;
+
+	// Connecting and reading alternate on the one I/O, since a client has to connect before it can be read
+	io_t ioRead;
+	io_t ioWrite;
+	WPG_BROKER_REQUEST request;
+
+	// The requests with passwords still to be handed to the pool, first to last
+	::std::deque<::std::shared_ptr<request_t>> requests;
+
+	// The responses still to be written, first to last, with the number of passwords each settles
+	::std::deque<::std::pair<::std::vector<BYTE>, WORD>> responses;
+};
+
+// Gives a request which has been accepted from a client
+struct broker_t::request_t {
+	request_t(const ::std::shared_ptr<client_t>& client, const WPG_BROKER_REQUEST& request):
+		client( client ), request( request ), ullDeadline( 0 ), cDispatched( 0 ), cDone( 0 ), fFailed( FALSE ), wpgCapsFailed( WPGCapNONE ),
+		passwords( static_cast<size_t>( request.cPasswords ) * request.cchLength ) {
+		if (request.dwDeadline){
+			ullDeadline = GetTickCount64( ) + request.dwDeadline;
+		}
+	}
+
+	~request_t(void) {
+		SecureZeroMemory( passwords.data( ), sizeof( WCHAR ) * passwords.size( ) );
+	}
+
+	// Returns true if the given request's passwords can be generated in the same job as this one's
+	bool alike(const request_t& other) const {
+		return (request.cchLength == other.request.cchLength)
+			&& (request.fDuplicatesAllowed == other.request.fDuplicatesAllowed)
+			&& (request.wpgCaps == other.request.wpgCaps)
+			&& (request.wpgCapsRequired == other.request.wpgCapsRequired)
+			&& (request.dwDeadline == other.request.dwDeadline)
+			&& (wcscmp( request.szAlphabet, other.request.szAlphabet ) == 0);
+	}
+
+	::std::shared_ptr<client_t> client;
+	WPG_BROKER_REQUEST request;
+	ULONGLONG ullDeadline;
+
+	// The number of passwords handed to the pool, and the number generated (or not)
+	WORD cDispatched;
+	WORD cDone;
+
+	BOOL fFailed;
+	WPGCaps wpgCapsFailed;
+	::std::vector<WCHAR> passwords;
+};
+
+// Gives a job with the pool: one or more passwords, alike, generated back-to-back into one buffer
+struct broker_t::job_t {
+	// Gives the request that one of the passwords in the buffer is for, and where it goes
+	struct segment_t {
+		::std::shared_ptr<request_t> request;
+		WORD iPassword;
+	};
+
+	WPG_POOL_JOB job;
+	broker_t* pBroker;
+	TCHAR sz[0x100];
+	::std::vector<segment_t> segments;
+};
+
+// Functions
+//
+
+// Returns the number of distinct characters in the given string
+static size_t CountDistinct(const WCHAR* psz, size_t cch) {
+
+	size_t cDistinct = 0;
+	for (size_t i = 0; i < cch; i++){
+		if (wmemchr( psz, psz[i], i ) == NULL){
+			cDistinct++;
+		}
+	}
+	return cDistinct;
+}
+
+broker_t::broker_t(DWORD dwWorkers): m_wpg( wpg_t::New( ) ), m_hPool( NULL ), m_hRing( NULL ), m_hPort( NULL ), m_fFirst( TRUE ), m_fStopping( FALSE ),
+	m_dwInFlight( 0 ), m_dwMaxInFlight( 0 ), m_cListening( 0 ) {
+
+	m_hPool = CreateWPGPoolEx( dwWorkers, m_wpg );
+	if (m_hPool){
+		m_dwMaxInFlight = GetWPGPoolSize( m_hPool ) * c_cJobsPerWorker;
+	}
+	m_hPort = CreateIoCompletionPort( INVALID_HANDLE_VALUE, NULL, 0, 1 );
+}
+
+broker_t::~broker_t(void) {
+
+	// N.B. Run doesn't return until the jobs in flight have drained, so the pool is idle by now
+	if (m_hRing){
+		DestroyWPGRing( m_hRing );
+	}
+	if (m_hPool){
+		DestroyWPGPool( m_hPool );
+	}
+	if (m_hPort){
+		CloseHandle( m_hPort );
+	}
+}
+
+HRESULT broker_t::Run(void) {
+
+	// Keep a few instances of the pipe listening, so that clients don't have to queue to connect
+	for (DWORD dw = 0; dw < c_cListeners; dw++){
+		const HRESULT hResult = Listen( );
+		if (FAILED( hResult )){
+			return hResult;
+		}
+	}
+
+	// Share the generator's output with local processes too; we can do without, if another process got there first
+	if ((m_hRing == NULL) && m_wpg){
+		m_hRing = CreateWPGRing( m_wpg, m_wpg->Caps( ), c_cRingSlots );
+	}
+
+	// Serve until asked to stop, and then until everything in flight has drained
+	while (!m_fStopping || !m_clients.empty( ) || (m_dwInFlight > 0)){
+		DWORD dwBytes = 0;
+		ULONG_PTR ulKey = 0;
+		LPOVERLAPPED lpOverlapped = NULL;
+		const BOOL fSucceeded = GetQueuedCompletionStatus( m_hPort, &dwBytes, &ulKey, &lpOverlapped, INFINITE );
+		if (lpOverlapped == NULL){
+			if (!fSucceeded){
+				return HRESULT_FROM_WIN32( GetLastError( ) );
+			}
+			if (ulKey == c_keyStop){
+				// N.B. closing a client may forget it, so work from a copy
+				m_fStopping = TRUE;
+				const decltype(m_clients) clients( m_clients );
+				::std::for_each( clients.cbegin( ), clients.cend( ), [&](const decltype(m_clients)::value_type& client) {
+					Close( *client );
+				} );
+			}
+			continue;
+		}
+
+		if (ulKey == c_keyJob){
+			job_t* pJob = reinterpret_cast<job_t*>( lpOverlapped );
+			OnJobDone( pJob, static_cast<WPGCaps>( dwBytes ) );
+			continue;
+		}
+
+		// Hold on to the client while its I/O is handled, since that may close it
+		io_t* pIo = CONTAINING_RECORD( lpOverlapped, io_t, ov );
+		const ::std::shared_ptr<client_t> keep( pIo->pClient->shared_from_this( ) );
+		client_t& client = *keep;
+		const DWORD dwError = (fSucceeded) ? ERROR_SUCCESS : GetLastError( );
+		client.cPendingIo--;
+		switch (pIo->op){
+		case io_op_connect:
+			OnConnected( client, dwError );
+			break;
+
+		case io_op_read:
+			OnRead( client, dwBytes, dwError );
+			break;
+
+		case io_op_write:
+			OnWritten( client, dwError );
+			break;
+		}
+		Reap( client );
+	}
+	return S_OK;
+}
+
+VOID broker_t::Stop(void) {
+	PostQueuedCompletionStatus( m_hPort, 0, c_keyStop, NULL );
+}
+
+HRESULT broker_t::Listen(void) {
+
+	if (m_fStopping){
+		return S_FALSE;
+	}
+
+	// Only ever answer local clients; the first instance also makes sure that there's no other broker already
+	DWORD dwOpenMode = (PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED);
+	if (m_fFirst){
+		dwOpenMode |= FILE_FLAG_FIRST_PIPE_INSTANCE;
+	}
+	const HANDLE hPipe = CreateNamedPipeW(
+		WPG_BROKER_PIPE_NAME,
+		dwOpenMode,
+		(PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS),
+		PIPE_UNLIMITED_INSTANCES,
+		c_cbOutBuffer,
+		sizeof( WPG_BROKER_REQUEST ),
+		0,
+		NULL
+	);
+	if (hPipe == INVALID_HANDLE_VALUE){
+		return HRESULT_FROM_WIN32( GetLastError( ) );
+	}
+	m_fFirst = FALSE;
+	if (CreateIoCompletionPort( hPipe, m_hPort, c_keyPipe, 0 ) == NULL){
+		const HRESULT hResult = HRESULT_FROM_WIN32( GetLastError( ) );
+		CloseHandle( hPipe );
+		return hResult;
+	}
+
+	::std::shared_ptr<client_t> client( new (::std::nothrow) client_t( ) );
+	if (!client){
+		CloseHandle( hPipe );
+		return E_OUTOFMEMORY;
+	}
+	client->hPipe = hPipe;
+	client->ioRead.op = io_op_connect;
+	m_clients.push_back( client );
+	m_cListening++;
+
+	// A client may have connected between the pipe being created and our waiting for one, in
+	// which case there's no completion to wait for
+	client->cPendingIo++;
+	if (ConnectNamedPipe( hPipe, &(client->ioRead.ov) ) == FALSE){
+		const DWORD dwError = GetLastError( );
+		if (dwError != ERROR_IO_PENDING){
+			client->cPendingIo--;
+			OnConnected( *client, (dwError == ERROR_PIPE_CONNECTED) ? ERROR_SUCCESS : dwError );
+			Reap( *client );
+		}
+	}
+	return S_OK;
+}
+
+VOID broker_t::OnConnected(client_t& client, DWORD dwError) {
+
+	m_cListening--;
+	if ((dwError != ERROR_SUCCESS) || client.fClosed){
+		Close( client );
+	}else{
+		client.fConnected = TRUE;
+		client.ioRead.op = io_op_read;
+		Read( client );
+	}
+
+	// Replace the instance which was listening
+	while ((m_cListening < c_cListeners) && (Listen( ) == S_OK)){
+	}
+}
+
+VOID broker_t::Read(client_t& client) {
+
+	if (client.fClosed || client.fReading || (client.cOutstanding >= c_cMaxOutstanding)){
+		return;
+	}
+
+	// N.B. the read's completion is queued to the port even if it finishes straight away
+	ZeroMemory( &(client.ioRead.ov), sizeof( client.ioRead.ov ) );
+	client.fReading = TRUE;
+	client.cPendingIo++;
+	if (ReadFile( client.hPipe, &(client.request), sizeof( client.request ), NULL, &(client.ioRead.ov) ) == FALSE){
+		if (GetLastError( ) != ERROR_IO_PENDING){
+			client.fReading = FALSE;
+			client.cPendingIo--;
+			Close( client );
+		}
+	}
+}
+
+VOID broker_t::OnRead(client_t& client, DWORD dwBytes, DWORD dwError) {
+
+	client.fReading = FALSE;
+	if (client.fClosed){
+		return;
+	}
+	if (dwError == ERROR_SUCCESS){
+		Accept( client, dwBytes );
+		Read( client );
+		Dispatch( );
+	}else{
+		// Including ERROR_MORE_DATA, since we don't know where the next request would start
+		Close( client );
+	}
+}
+
+VOID broker_t::Accept(client_t& client, DWORD dwBytes) {
+
+	// Check the request over before accepting it; without duplicates, a password can't be any
+	// longer than the number of distinct characters it's drawn from
+	WPG_BROKER_REQUEST& request = client.request;
+	const size_t cchAlphabet = wcsnlen( request.szAlphabet, _countof( request.szAlphabet ) );
+	const bool fValid = (dwBytes == sizeof( request ))
+		&& (request.dwVersion == WPG_BROKER_VERSION)
+		&& (request.cPasswords > 0) && (request.cPasswords <= WPG_BROKER_MAX_PASSWORDS)
+		&& (request.cchLength > 0)
+		&& (cchAlphabet > 0) && (cchAlphabet < _countof( request.szAlphabet ))
+		&& (request.fDuplicatesAllowed || (request.cchLength <= CountDistinct( request.szAlphabet, cchAlphabet )));
+	if (!fValid){
+		Reject( client, (dwBytes >= sizeof( DWORD ) * 2) ? request.dwRequestId : 0 );
+		SecureZeroMemory( &request, sizeof( request ) );
+		return;
+	}
+
+	::std::shared_ptr<request_t> accepted( new (::std::nothrow) request_t( client.shared_from_this( ), request ) );
+	SecureZeroMemory( &request, sizeof( request ) );
+	if (!accepted || (accepted->passwords.size( ) == 0)){
+		Close( client );
+		return;
+	}
+	client.cOutstanding += accepted->request.cPasswords;
+	client.requests.push_back( accepted );
+	if (!client.fWaiting){
+		client.fWaiting = TRUE;
+		m_turns.push_back( &client );
+	}
+}
+
+VOID broker_t::Dispatch(void) {
+
+	while ((m_dwInFlight < m_dwMaxInFlight) && !m_turns.empty( )){
+		client_t& client = *(m_turns.front( ));
+		m_turns.pop_front( );
+		client.fWaiting = FALSE;
+		if (client.requests.empty( )){
+			continue;
+		}
+
+		job_t* pJob = new (::std::nothrow) job_t( );
+		if (pJob == NULL){
+			m_turns.push_front( &client );
+			client.fWaiting = TRUE;
+			break;
+		}
+
+		// Take this client's turn, and then top the job up from any of the others in line which want the same
+		const request_t& first = *(client.requests.front( ));
+		const DWORD cPerJob = (first.request.fDuplicatesAllowed)
+			? static_cast<DWORD>( (_countof( pJob->sz ) - 1) / first.request.cchLength )
+			: 1;
+		Take( *pJob, client, cPerJob );
+		for (auto it = m_turns.begin( ); (it != m_turns.end( )) && (pJob->segments.size( ) < cPerJob); ++it){
+			Take( *pJob, **it, cPerJob );
+		}
+		m_turns.erase( ::std::remove_if( m_turns.begin( ), m_turns.end( ), [](client_t* pClient) {
+			if (pClient->requests.empty( )){
+				pClient->fWaiting = FALSE;
+				return true;
+			}
+			return false;
+		} ), m_turns.end( ) );
+		if (!client.requests.empty( ) && !client.fWaiting){
+			client.fWaiting = TRUE;
+			m_turns.push_back( &client );
+		}
+
+		// Set it up from the first of its passwords; give it the earliest of their deadlines
+		const request_t& request = *(pJob->segments.front( ).request);
+		pJob->pBroker = this;
+		pJob->job.pszBuffer = pJob->sz;
+		pJob->job.cchLength = static_cast<BYTE>( pJob->segments.size( ) * request.request.cchLength );
+		pJob->job.wpgCaps = request.request.wpgCaps;
+		pJob->job.pszAlphabet = request.request.szAlphabet;
+		pJob->job.fDuplicatesAllowed = request.request.fDuplicatesAllowed;
+		pJob->job.deadline.wpgCapsRequired = request.request.wpgCapsRequired;
+		::std::for_each( pJob->segments.cbegin( ), pJob->segments.cend( ), [&](const job_t::segment_t& segment) {
+			const ULONGLONG ullDeadline = segment.request->ullDeadline;
+			if (ullDeadline && ((pJob->job.deadline.ullDeadline == 0) || (ullDeadline < pJob->job.deadline.ullDeadline))){
+				pJob->job.deadline.ullDeadline = ullDeadline;
+			}
+		} );
+		pJob->job.pfnCallback = OnPoolJobDone;
+		pJob->job.lpContext = pJob;
+		m_dwInFlight++;
+		if (!WPGPoolSubmit( m_hPool, &(pJob->job) )){
+			OnJobDone( pJob, pJob->job.wpgCaps );
+		}
+	}
+}
+
+VOID broker_t::Take(job_t& job, client_t& client, DWORD cPerJob) {
+
+	while ((job.segments.size( ) < cPerJob) && !client.requests.empty( )){
+		const ::std::shared_ptr<request_t>& request = client.requests.front( );
+		if (!job.segments.empty( ) && !job.segments.front( ).request->alike( *request )){
+			break;
+		}
+		while ((job.segments.size( ) < cPerJob) && (request->cDispatched < request->request.cPasswords)){
+			job.segments.push_back( job_t::segment_t{ request, request->cDispatched++ } );
+		}
+		if (request->cDispatched < request->request.cPasswords){
+			break;
+		}
+		client.requests.pop_front( );
+	}
+}
+
+VOID CALLBACK broker_t::OnPoolJobDone(PWPG_POOL_JOB pPoolJob, WPGCaps wpgCapsFailed) {
+
+	// Hand it back to the thread which does all of the bookkeeping
+	job_t* pJob = static_cast<job_t*>( pPoolJob->lpContext );
+	PostQueuedCompletionStatus( pJob->pBroker->m_hPort, static_cast<DWORD>( wpgCapsFailed ), c_keyJob, reinterpret_cast<LPOVERLAPPED>( pJob ) );
+}
+
+VOID broker_t::OnJobDone(job_t* pJob, WPGCaps wpgCapsFailed) {
+
+	m_dwInFlight--;
+
+	// Deal out the passwords to their requests, in order, and respond to those which are now complete
+	const bool fSucceeded = WPGSucceeded( wpgCapsFailed ) && (pJob->job.cchGenerated == pJob->job.cchLength);
+	size_t cchOffset = 0;
+	::std::for_each( pJob->segments.cbegin( ), pJob->segments.cend( ), [&](const job_t::segment_t& segment) {
+		request_t& request = *(segment.request);
+		const BYTE cchLength = request.request.cchLength;
+		if (fSucceeded){
+			CopyMemory( request.passwords.data( ) + (static_cast<size_t>( segment.iPassword ) * cchLength), pJob->sz + cchOffset, sizeof( WCHAR ) * cchLength );
+		}else{
+			request.fFailed = TRUE;
+		}
+		request.wpgCapsFailed |= wpgCapsFailed;
+		cchOffset += cchLength;
+		if (++(request.cDone) == request.request.cPasswords){
+			Respond( request );
+		}
+	} );
+	SecureZeroMemory( pJob->sz, sizeof( pJob->sz ) );
+	delete pJob;
+	Dispatch( );
+}
+
+VOID broker_t::Respond(request_t& request) {
+
+	client_t& client = *(request.client);
+	if (client.fClosed){
+		return;
+	}
+
+	// Send the passwords only if they were all generated
+	const WORD cPasswords = (request.fFailed) ? 0 : request.request.cPasswords;
+	const BYTE cchLength = (request.fFailed) ? 0 : request.request.cchLength;
+	::std::vector<BYTE> message( WPGBrokerResponseSize( cPasswords, cchLength ) );
+	PWPG_BROKER_RESPONSE pResponse = reinterpret_cast<PWPG_BROKER_RESPONSE>( message.data( ) );
+	pResponse->dwVersion = WPG_BROKER_VERSION;
+	pResponse->dwRequestId = request.request.dwRequestId;
+	pResponse->hResult = (request.fFailed) ? E_FAIL : S_OK;
+	pResponse->wpgCapsFailed = request.wpgCapsFailed;
+	pResponse->cPasswords = cPasswords;
+	pResponse->cchLength = cchLength;
+	if (cPasswords > 0){
+		CopyMemory( pResponse + 1, request.passwords.data( ), sizeof( WCHAR ) * cPasswords * cchLength );
+	}
+	SecureZeroMemory( request.passwords.data( ), sizeof( WCHAR ) * request.passwords.size( ) );
+	Queue( client, ::std::move( message ), request.request.cPasswords );
+}
+
+VOID broker_t::Reject(client_t& client, DWORD dwRequestId) {
+
+	::std::vector<BYTE> message( WPGBrokerResponseSize( 0, 0 ) );
+	PWPG_BROKER_RESPONSE pResponse = reinterpret_cast<PWPG_BROKER_RESPONSE>( message.data( ) );
+	pResponse->dwVersion = WPG_BROKER_VERSION;
+	pResponse->dwRequestId = dwRequestId;
+	pResponse->hResult = E_INVALIDARG;
+	Queue( client, ::std::move( message ), 0 );
+}
+
+VOID broker_t::Queue(client_t& client, ::std::vector<BYTE>&& message, WORD cPasswords) {
+
+	client.responses.emplace_back( ::std::move( message ), cPasswords );
+	Write( client );
+}
+
+VOID broker_t::Write(client_t& client) {
+
+	if (client.fClosed || client.fWriting || client.responses.empty( )){
+		return;
+	}
+
+	const ::std::vector<BYTE>& message = client.responses.front( ).first;
+	ZeroMemory( &(client.ioWrite.ov), sizeof( client.ioWrite.ov ) );
+	client.fWriting = TRUE;
+	client.cPendingIo++;
+	if (WriteFile( client.hPipe, message.data( ), static_cast<DWORD>( message.size( ) ), NULL, &(client.ioWrite.ov) ) == FALSE){
+		if (GetLastError( ) != ERROR_IO_PENDING){
+			client.fWriting = FALSE;
+			client.cPendingIo--;
+			Close( client );
+		}
+	}
+}
+
+VOID broker_t::OnWritten(client_t& client, DWORD dwError) {
+
+	client.fWriting = FALSE;
+	if (client.fClosed){
+		return;
+	}
+	if (dwError != ERROR_SUCCESS){
+		Close( client );
+		return;
+	}
+
+	// Settle the passwords which were sent, which may let us read from the client again
+	auto& response = client.responses.front( );
+	SecureZeroMemory( response.first.data( ), response.first.size( ) );
+	client.cOutstanding -= response.second;
+	client.responses.pop_front( );
+	Write( client );
+	Read( client );
+}
+
+VOID broker_t::Close(client_t& client) {
+
+	if (client.fClosed){
+		return;
+	}
+	client.fClosed = TRUE;
+
+	// Forget whatever hadn't been handed to the pool yet; whatever has will be dropped when it's done
+	if (client.fWaiting){
+		m_turns.erase( ::std::find( m_turns.begin( ), m_turns.end( ), &client ) );
+		client.fWaiting = FALSE;
+	}
+	client.requests.clear( );
+	::std::for_each( client.responses.begin( ), client.responses.end( ), [](decltype(client.responses)::value_type& response) {
+		SecureZeroMemory( response.first.data( ), response.first.size( ) );
+	} );
+	client.responses.clear( );
+	if (client.cPendingIo > 0){
+		CancelIoEx( client.hPipe, NULL );
+	}else{
+		Reap( client );
+	}
+}
+
+VOID broker_t::Reap(client_t& client) {
+
+	if (!client.fClosed || (client.cPendingIo > 0) || (client.hPipe == INVALID_HANDLE_VALUE)){
+		return;
+	}
+	if (client.fConnected){
+		DisconnectNamedPipe( client.hPipe );
+	}
+	CloseHandle( client.hPipe );
+	client.hPipe = INVALID_HANDLE_VALUE;
+
+	// N.B. the client lives on for as long as any of its requests are still with the pool
+	m_clients.remove_if( [&](const decltype(m_clients)::value_type& other) {
+		return (other.get( ) == &client);
+	} );
+}
@@ -0,0 +1,126 @@
+// WPGBrokerServer.h: declares the password broker, which serves the clients of its pipe from one pooled generator
+//
+// Waveson Password Generator
+// Author: Stephen Higgins, https://github.com/viathefalcon
+//
+
+#if !defined(__WPG_BROKER_SERVER_H__)
+#define __WPG_BROKER_SERVER_H__
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <deque>
+#include <list>
+#include <memory>
+#include <vector>
+
+// Local Project Headers
+#include "WPGPool.h"
+#include "WPGRing.h"
+#include "WPGBroker.h"
+
+// Classes
+//
+
+// Accepts clients on the broker's pipe, and generates their requests across a pool of workers which
+// share one generator. All of the pipe I/O, and the bookkeeping, is done on the thread which calls
+// Run; the workers hand their results back to it through the same completion port.
+//
+// Clients take turns, round-robin, each turn being one job for the pool; jobs for passwords which
+// may repeat characters are topped up with passwords for other requests with the same policy, so
+// that concurrent requests share their fills from the sources. A client with too many passwords
+// outstanding isn't read from again until some of them have been written back to it.
+//
+// While it serves, the broker also keeps the shared entropy ring (see WPGRing.h) filled from the
+// same generator, for local processes which want raw bytes rather than passwords.
+class broker_t {
+public:
+	// The most passwords a client may have outstanding before it stops being read from
+	static constexpr DWORD c_cMaxOutstanding = (4 * WPG_BROKER_MAX_PASSWORDS);
+
+	// The number of pipe instances kept listening for new clients
+	static constexpr DWORD c_cListeners = 4;
+
+	// The number of slots in the entropy ring
+	static constexpr DWORD c_cRingSlots = 0x1000;
+
+	// Starts a broker with the given number of workers, or one per logical processor if zero
+	explicit broker_t(DWORD dwWorkers = 0);
+	~broker_t(void);
+
+	broker_t(const broker_t&) = delete;
+	broker_t& operator=(const broker_t&) = delete;
+
+	operator bool() const {
+		return (m_hPool != NULL) && (m_hPort != NULL);
+	}
+
+	// Serves clients until Stop is called; returns an HRESULT
+	HRESULT Run(void);
+
+	// Asks Run to return, once the work in flight has drained; callable from any thread
+	VOID Stop(void);
+
+private:
+	struct client_t;
+	struct request_t;
+	struct job_t;
+	struct io_t;
+
+	// Opens a new pipe instance, and waits for a client to connect to it
+	HRESULT Listen(void);
+
+	// Handles the completion of the given I/O on a client's pipe
+	VOID OnConnected(client_t&, DWORD);
+	VOID OnRead(client_t&, DWORD, DWORD);
+	VOID OnWritten(client_t&, DWORD);
+
+	// Starts reading the next request from, or writing the next response to, the given client
+	VOID Read(client_t&);
+	VOID Write(client_t&);
+
+	// Validates and queues the request just read from the given client
+	VOID Accept(client_t&, DWORD);
+
+	// Queues the response to the given (complete) request, or to a malformed one, with the given ID
+	VOID Respond(request_t&);
+	VOID Reject(client_t&, DWORD);
+
+	// Queues the given response message to the given client, which settles the given number of its outstanding passwords
+	VOID Queue(client_t&, ::std::vector<BYTE>&&, WORD);
+
+	// Hands jobs to the pool, taking turns between the clients, while there's room for them
+	VOID Dispatch(void);
+
+	// Moves the given client's next passwords (up to the given number in all) which share the job's policy into it
+	VOID Take(job_t&, client_t&, DWORD);
+
+	// Records the results of the given job against its requests, and responds to any which are now complete
+	VOID OnJobDone(job_t*, WPGCaps);
+
+	static VOID CALLBACK OnPoolJobDone(PWPG_POOL_JOB, WPGCaps);
+
+	// Stops serving the given client, and forgets it once its I/O has drained
+	VOID Close(client_t&);
+	VOID Reap(client_t&);
+
+	::std::shared_ptr<wpg_t> m_wpg;
+	WPG_POOL_H m_hPool;
+	WPG_RING_H m_hRing;
+	HANDLE m_hPort;
+	BOOL m_fFirst;
+	BOOL m_fStopping;
+
+	// The jobs with the pool, and the most there may be
+	DWORD m_dwInFlight;
+	DWORD m_dwMaxInFlight;
+
+	// Every client (including those listening), and those with passwords waiting for a turn, in turn order
+	::std::list<::std::shared_ptr<client_t>> m_clients;
+	::std::deque<client_t*> m_turns;
+	DWORD m_cListening;
+};
+
+#endif // !defined(__WPG_BROKER_SERVER_H__)